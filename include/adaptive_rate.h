@@ -0,0 +1,81 @@
+#ifndef ADAPTIVE_RATE_H
+#define ADAPTIVE_RATE_H
+
+#include <stdint.h>
+
+// Sample-rate policy for adaptive captures.
+//
+// The capture is cut into windows; at the end of each one the policy gets
+// the edges seen and the window length and picks the rate for the next.
+// Rates are the configured maximum divided by powers of two, down to the
+// minimum, so a capture only ever uses a handful of rates. Density is
+// answered at once: a window that needs a higher rate jumps straight
+// to it. Idle is answered slowly: the rate halves only after idleWindows
+// windows in a row would have been served by a lower one, so a pause
+// between two bursts does not throw away resolution.
+//
+// This header is plain C++; replaying a synthetic edge pattern through
+// update() on a host shows the rate sequence the capture task would use.
+
+#define ADAPTIVE_SAMPLES_PER_EDGE 32  // Samples wanted between edges on average
+#define ADAPTIVE_WINDOW_MS 50         // Length of one decision window
+#define ADAPTIVE_IDLE_WINDOWS 4       // Quiet windows before the rate halves
+
+class AdaptiveRatePolicy {
+private:
+    uint32_t maxRate;
+    uint32_t minRate;
+    uint32_t samplesPerEdge;
+    uint8_t idleWindows;
+    uint32_t rate;     // Rate of the current window
+    uint8_t quiet;     // Consecutive windows that wanted less than rate
+
+    // Lowest ladder step at or above the wanted rate
+    uint32_t stepFor(uint64_t wanted) const {
+        uint32_t step = maxRate;
+        while (step / 2 >= minRate && step / 2 >= wanted) step /= 2;
+        return step;
+    }
+
+public:
+    AdaptiveRatePolicy()
+        : maxRate(1), minRate(1), samplesPerEdge(ADAPTIVE_SAMPLES_PER_EDGE), idleWindows(ADAPTIVE_IDLE_WINDOWS),
+          rate(1), quiet(0) {}
+
+    // Starts at the maximum so the first burst is not missed
+    void begin(uint32_t highest, uint32_t lowest, uint32_t perEdge = ADAPTIVE_SAMPLES_PER_EDGE,
+               uint8_t windows = ADAPTIVE_IDLE_WINDOWS) {
+        maxRate = highest ? highest : 1;
+        minRate = lowest && lowest < maxRate ? lowest : maxRate;
+        samplesPerEdge = perEdge ? perEdge : 1;
+        idleWindows = windows ? windows : 1;
+        rate = maxRate;
+        quiet = 0;
+    }
+
+    // Edges counted over a window of windowUs; returns the next window's rate
+    uint32_t update(uint32_t edges, uint64_t windowUs) {
+        if (windowUs == 0) return rate;
+        uint64_t wanted = (uint64_t)edges * samplesPerEdge * 1000000ULL / windowUs;
+        uint32_t step = stepFor(wanted);
+
+        if (step > rate) {
+            rate = step;
+            quiet = 0;
+        } else if (step < rate) {
+            if (++quiet >= idleWindows) {
+                rate /= 2;
+                quiet = 0;
+            }
+        } else {
+            quiet = 0;
+        }
+        return rate;
+    }
+
+    uint32_t getRate() const { return rate; }
+    uint32_t getMinRate() const { return minRate; }
+    uint32_t getMaxRate() const { return maxRate; }
+};
+
+#endif // ADAPTIVE_RATE_H
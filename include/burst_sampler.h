@@ -0,0 +1,65 @@
+#ifndef BURST_SAMPLER_H
+#define BURST_SAMPLER_H
+
+#include <Arduino.h>
+
+#define BURST_MAX_SAMPLES 65536   // One byte per sample, allocated when the burst backend starts
+#define BURST_UNROLL 8            // Reads per loop iteration in the unpaced loop
+#define BURST_MAX_MASKED_US 100000 // Longest paced burst; the interrupt watchdog fires at 300 ms
+
+// Result of one burst
+struct BurstResult {
+    uint32_t samples;    // Samples read
+    uint64_t cycles;     // CPU cycles from the first read to the last
+    uint32_t rate;       // Achieved rate, samples over the cycles they took
+};
+
+// Dedicated-GPIO burst sampler (ESP32-S3).
+//
+// The channel pins form a dedicated-GPIO input bundle, which the CPU reads
+// with a single instruction (ee.get_gpio_in) instead of a peripheral-bus
+// load of GPIO_IN_REG. A burst reads a fixed number of samples with
+// interrupts masked into a preallocated buffer, one byte per sample with
+// bit c = channel c, and is then handed to the normal storage path.
+//
+// Unpaced, the loop is unrolled and reads back to back; below that rate
+// each read waits for its slot on the cycle counter. A paced burst is cut
+// to BURST_MAX_MASKED_US of samples so interrupts are never masked long
+// enough to trip the interrupt watchdog. The achieved rate is measured
+// from the cycle counter for every burst rather than assumed.
+// Other targets have no dedicated GPIO and begin() fails.
+class BurstSampler {
+private:
+    void* bundle;          // dedic_gpio_bundle_handle_t
+    uint32_t inOffset;     // First bundle channel's bit in the input word
+    uint8_t channelBits;
+    uint8_t* buffer;
+    uint32_t capacity;
+    BurstResult last;
+
+public:
+    BurstSampler();
+    ~BurstSampler();
+
+    bool begin(const uint8_t* pins, uint8_t count, uint32_t samples);
+    void end();
+
+    // Read `samples` at `rate` (0 or above the loop's limit = as fast as
+    // possible) with interrupts masked on this core, at most maxSamplesAt(rate)
+    BurstResult capture(uint32_t samples, uint32_t rate);
+
+    // Samples a burst at `rate` can take within BURST_MAX_MASKED_US
+    static uint32_t maxSamplesAt(uint32_t rate) {
+        if (rate == 0) return BURST_MAX_SAMPLES;
+        uint64_t samples = (uint64_t)rate * BURST_MAX_MASKED_US / 1000000;
+        if (samples > BURST_MAX_SAMPLES) return BURST_MAX_SAMPLES;
+        return samples ? (uint32_t)samples : 1;
+    }
+
+    const uint8_t* getData() const { return buffer; }
+    uint32_t getCapacity() const { return capacity; }
+    const BurstResult& getLastResult() const { return last; }
+    const char* getName() const { return "Dedicated GPIO burst"; }
+};
+
+#endif // BURST_SAMPLER_H
@@ -0,0 +1,146 @@
+#ifndef CAPTURE_CLOCK_H
+#define CAPTURE_CLOCK_H
+
+#include <stdint.h>
+
+// Cycle-counter timebase for the polled capture schedule.
+//
+// micros() cannot express periods below 1 us, so rates above 1 MHz (and any
+// period that is not a whole number of microseconds) were rounded. The
+// schedule instead counts CPU cycles, and slot n is due exactly at
+//   n * clockHz / rate
+// cycles after the start, kept with an integer phase accumulator rather than
+// a rounded period. This header is plain C++ so a host build can drive the
+// schedule from a SyntheticClock and measure the rate error.
+
+// Free-running cycle counter
+class CaptureClock {
+public:
+    virtual ~CaptureClock() {}
+
+    virtual uint32_t getCycleCount() = 0;       // Wraps at 2^32
+    virtual uint32_t getFrequency() const = 0;  // Cycles per second
+    virtual const char* getName() const = 0;
+};
+
+// Extends a 32-bit counter to 64 bits. It must be read at least once per
+// wrap (~17.9 s at 240 MHz) to stay monotonic.
+class CycleTimeline {
+private:
+    CaptureClock* clock;
+    uint32_t last;
+    uint64_t elapsed;
+
+public:
+    CycleTimeline() : clock(nullptr), last(0), elapsed(0) {}
+
+    void start(CaptureClock* source) {
+        clock = source;
+        last = clock->getCycleCount();
+        elapsed = 0;
+    }
+
+    // Cycles since start()
+    uint64_t now() {
+        uint32_t current = clock->getCycleCount();
+        elapsed += (uint32_t)(current - last);
+        last = current;
+        return elapsed;
+    }
+
+    // Place a counter value read elsewhere (e.g. in an ISR) on the timeline.
+    // It must lie within 2^31 cycles of the latest reading, before or after.
+    uint64_t at(uint32_t cycles) {
+        int32_t delta = (int32_t)(cycles - last);
+        if (delta <= 0) return elapsed - (uint32_t)(-delta);
+        elapsed += (uint32_t)delta;
+        last = cycles;
+        return elapsed;
+    }
+};
+
+// Fixed-rate slot grid in clock cycles
+class SlotScheduler {
+private:
+    uint32_t clockHz;
+    uint32_t rate;
+    uint32_t periodWhole;  // clockHz / rate
+    uint32_t periodFrac;   // clockHz % rate, in units of 1/rate cycle
+    uint32_t phase;        // Accumulated fraction, < rate
+    uint64_t slot;         // Next slot
+    uint64_t due;          // Cycle the next slot is due at
+
+public:
+    SlotScheduler() : clockHz(1), rate(1), periodWhole(1), periodFrac(0), phase(0), slot(0), due(0) {}
+
+    void begin(uint32_t clockFrequency, uint32_t sampleRate) {
+        clockHz = clockFrequency ? clockFrequency : 1;
+        rate = sampleRate ? sampleRate : 1;
+        periodWhole = clockHz / rate;
+        periodFrac = clockHz % rate;
+        jumpTo(0);
+    }
+
+    // Move to an arbitrary slot, e.g. after the caller fell behind
+    void jumpTo(uint64_t target) {
+        slot = target;
+        // target * clockHz split so it cannot overflow on multi-hour runs
+        uint64_t product = (target / rate) * (uint64_t)clockHz;
+        uint64_t rest = (target % rate) * (uint64_t)clockHz;
+        due = product + rest / rate;
+        phase = (uint32_t)(rest % rate);
+    }
+
+    void advance() {
+        slot++;
+        due += periodWhole;
+        phase += periodFrac;
+        if (phase >= rate) {
+            phase -= rate;
+            due++;
+        }
+    }
+
+    // Last slot due at or before the given cycle
+    uint64_t slotAt(uint64_t cycles) const {
+        return (cycles / clockHz) * rate + ((cycles % clockHz) * rate) / clockHz;
+    }
+
+    uint64_t nextSlot() const { return slot; }
+    uint64_t nextDue() const { return due; }
+    uint32_t getPeriodCycles() const { return periodWhole; }  // Rounded down
+    uint32_t getClockFrequency() const { return clockHz; }
+};
+
+// Rate actually achieved: samples read over the cycles they took
+inline uint32_t measureRate(uint64_t samples, uint64_t cycles, uint32_t clockHz) {
+    if (cycles == 0) return 0;
+    return (uint32_t)((samples * clockHz + cycles / 2) / cycles);
+}
+
+// Host-side clock. Time only moves when advance() is called, plus an optional
+// fixed cost per read to model the loop around it.
+class SyntheticClock : public CaptureClock {
+private:
+    uint32_t frequency;
+    uint64_t cycles;
+    uint32_t cyclesPerRead;
+
+public:
+    explicit SyntheticClock(uint32_t frequencyHz, uint32_t readCost = 0)
+        : frequency(frequencyHz), cycles(0), cyclesPerRead(readCost) {}
+
+    uint32_t getCycleCount() override {
+        cycles += cyclesPerRead;
+        return (uint32_t)cycles;
+    }
+
+    uint32_t getFrequency() const override { return frequency; }
+    const char* getName() const override { return "Synthetic"; }
+
+    void advance(uint64_t n) { cycles += n; }
+    void setReadCost(uint32_t n) { cyclesPerRead = n; }
+    uint64_t getTotalCycles() const { return cycles; }
+};
+
+#endif // CAPTURE_CLOCK_H
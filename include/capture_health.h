@@ -0,0 +1,74 @@
+#ifndef CAPTURE_HEALTH_H
+#define CAPTURE_HEALTH_H
+
+#include <stdint.h>
+
+// Capture-loop health counters.
+//
+// ScheduleHealth is fed by the polled schedule with the cycle time of each
+// pin read and the cycle its slot was due at. Intervals between reads go
+// into a log2 histogram (bin k holds [2^k, 2^(k+1)) cycles), so a loop
+// that holds its rate shows one tall bin and stalls show up as a tail.
+// CallTimer sums the time the storage side spends in one kind of call.
+//
+// The producer and loop() write these without locking and the web task
+// reads them; a reading may be one update behind, which is fine for
+// diagnostics. Nothing here runs unless instrumentation is enabled.
+// This header is plain C++ so the binning can be checked on a host.
+
+#define HEALTH_HISTOGRAM_BINS 32
+
+struct ScheduleHealth {
+    uint32_t intervals[HEALTH_HISTOGRAM_BINS];  // Read-to-read intervals, log2 cycles
+    uint32_t reads;
+    uint32_t lateReads;       // Read closer to the next slot than to its own
+    uint32_t worstLatency;    // Largest read-after-due, in cycles
+    uint64_t lastRead;        // Cycle of the previous read, 0 = none yet
+
+    void reset() {
+        for (uint32_t i = 0; i < HEALTH_HISTOGRAM_BINS; i++) intervals[i] = 0;
+        reads = 0;
+        lateReads = 0;
+        worstLatency = 0;
+        lastRead = 0;
+    }
+
+    static uint32_t binFor(uint64_t cycles) {
+        uint32_t bin = 0;
+        while (cycles > 1 && bin < HEALTH_HISTOGRAM_BINS - 1) {
+            cycles >>= 1;
+            bin++;
+        }
+        return bin;
+    }
+
+    // now >= due; period is the slot spacing in cycles
+    void recordRead(uint64_t now, uint64_t due, uint32_t period) {
+        if (lastRead != 0) intervals[binFor(now - lastRead)]++;
+        lastRead = now ? now : 1;
+        uint64_t latency = now - due;
+        if (latency > worstLatency) worstLatency = latency > 0xFFFFFFFF ? 0xFFFFFFFF : (uint32_t)latency;
+        if (latency * 2 > period) lateReads++;
+        reads++;
+    }
+};
+
+struct CallTimer {
+    uint32_t calls;
+    uint64_t totalUs;
+    uint32_t maxUs;
+
+    void reset() {
+        calls = 0;
+        totalUs = 0;
+        maxUs = 0;
+    }
+
+    void add(uint32_t us) {
+        calls++;
+        totalUs += us;
+        if (us > maxUs) maxUs = us;
+    }
+};
+
+#endif // CAPTURE_HEALTH_H
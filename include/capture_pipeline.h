@@ -0,0 +1,28 @@
+#ifndef CAPTURE_PIPELINE_H
+#define CAPTURE_PIPELINE_H
+
+#include <stdint.h>
+
+// Per-sample plane writes, specialised on the channel count.
+//
+// The producer stores each sample as one bit in each channel's bit plane.
+// With the channel count as a template parameter the loop is unrolled and
+// the shifts are constants, so the analyzer picks one instantiation when a
+// capture starts instead of looping over a runtime count for every sample.
+// This header is plain C++ so the per-sample cost of each variant can be
+// timed on a host.
+
+// Set bit `bit` of the current word in each of the Channels planes, which
+// lie planeWords apart. Bit 0 starts a new word, so stale bits from the
+// chunk's previous use are masked off; the mask is the same for every
+// plane, so the unrolled loop has no branches.
+template <uint8_t Channels>
+inline void writePlaneBits(uint32_t* word, uint32_t planeWords, uint32_t bit, uint8_t levels) {
+    uint32_t keep = bit ? 0xFFFFFFFFu : 0;
+    for (uint8_t c = 0; c < Channels; c++) {
+        *word = (*word & keep) | ((uint32_t)((levels >> c) & 1) << bit);
+        word += planeWords;
+    }
+}
+
+#endif // CAPTURE_PIPELINE_H
@@ -0,0 +1,68 @@
+#ifndef COUNTER_SERIES_H
+#define COUNTER_SERIES_H
+
+#include <stdint.h>
+
+// Time series of counter-mode aggregates.
+//
+// One entry per interval instead of one bit per sample: a day of
+// one-minute intervals is COUNTER_SERIES_ENTRIES * 20 bytes. When the ring
+// is full the oldest interval is overwritten. Intervals are contiguous, so
+// only the first start is kept; entry i starts where entry i - 1 ended.
+// This header is plain C++ so the series can be checked on a host.
+
+#define COUNTER_SERIES_ENTRIES 1440   // A day at one-minute intervals
+
+struct CounterInterval {
+    uint32_t durationUs;   // Measured length of the interval
+    uint32_t edges;        // Rising + falling edges counted by the hardware
+    uint32_t highUs;       // Time the input spent high
+    uint32_t minPeriodNs;  // Shortest rising-to-rising period seen, 0 = none
+    uint32_t maxPeriodNs;  // Longest rising-to-rising period seen, 0 = none
+
+    // Full periods per second; both edges are counted
+    double frequency() const { return durationUs ? edges * 500000.0 / durationUs : 0; }
+    double dutyPercent() const { return durationUs ? highUs * 100.0 / durationUs : 0; }
+};
+
+class CounterSeries {
+private:
+    CounterInterval entries[COUNTER_SERIES_ENTRIES];
+    uint32_t head;        // Next entry written
+    uint32_t count;       // Valid entries, up to COUNTER_SERIES_ENTRIES
+    uint64_t firstStart;  // Start of the oldest kept entry, us
+    uint64_t nextStart;   // Start of the next entry, us
+
+public:
+    CounterSeries() : head(0), count(0), firstStart(0), nextStart(0) {}
+
+    void begin(uint64_t startUs) {
+        head = 0;
+        count = 0;
+        firstStart = startUs;
+        nextStart = startUs;
+    }
+
+    void push(const CounterInterval& interval) {
+        if (count == COUNTER_SERIES_ENTRIES) {
+            firstStart += entries[head].durationUs;  // Oldest entry is overwritten
+        } else {
+            count++;
+        }
+        entries[head] = interval;
+        head = (head + 1) % COUNTER_SERIES_ENTRIES;
+        nextStart += interval.durationUs;
+    }
+
+    // Oldest first
+    const CounterInterval& at(uint32_t index) const {
+        return entries[(head + COUNTER_SERIES_ENTRIES - count + index) % COUNTER_SERIES_ENTRIES];
+    }
+
+    uint32_t size() const { return count; }
+    uint32_t capacity() const { return COUNTER_SERIES_ENTRIES; }
+    uint64_t getFirstStart() const { return firstStart; }
+    uint64_t getNextStart() const { return nextStart; }
+};
+
+#endif // COUNTER_SERIES_H
@@ -0,0 +1,16 @@
+#ifndef CPU_CYCLE_CLOCK_H
+#define CPU_CYCLE_CLOCK_H
+
+#include <Arduino.h>
+#include "capture_clock.h"
+
+// Xtensa CCOUNT register. The counter is per core, so it must only be read
+// from the capture task, which is pinned to CAPTURE_TASK_CORE.
+class CpuCycleClock : public CaptureClock {
+public:
+    uint32_t getCycleCount() override { return ESP.getCycleCount(); }
+    uint32_t getFrequency() const override { return getCpuFrequencyMhz() * 1000000UL; }
+    const char* getName() const override { return "CCOUNT"; }
+};
+
+#endif // CPU_CYCLE_CLOCK_H
@@ -0,0 +1,62 @@
+#ifndef DMA_SAMPLER_H
+#define DMA_SAMPLER_H
+
+#include <Arduino.h>
+#include "sampler.h"
+
+#if CONFIG_IDF_TARGET_ESP32S3
+
+#include <esp_private/gdma.h>
+#include <hal/dma_types.h>
+
+// ESP32-S3 LCD_CAM camera-mode capture.
+//
+// The CAM peripheral latches its 8 data inputs on every PCLK edge and GDMA
+// writes the bytes into a circular chain of descriptors. PCLK is the LCD_CAM
+// clock divider output, looped back through an otherwise unused pin, so the
+// sample rate is set purely in hardware. Each descriptor ends with an EOF
+// whose ISR publishes the finished block to the consumer.
+class DmaSampler : public Sampler {
+private:
+    uint8_t pclkPin;
+    uint8_t dataPins[8];    // CAM data line c <- dataPins[c]
+    uint8_t dataPinCount;
+    uint32_t actualRate;
+    ClockDivider divider;
+    bool configured;
+    bool running;
+
+    gdma_channel_handle_t rxChannel;
+    dma_descriptor_t* descriptors;
+    uint8_t* blockBuffers;
+    BlockRing ring;
+    uint32_t heldSlot;
+    uint64_t heldSequence;
+
+    static bool IRAM_ATTR onReceiveEof(gdma_channel_handle_t channel, gdma_event_data_t* event, void* context);
+
+    bool allocateBuffers();
+    void freeBuffers();
+    void configureCamera();
+    void routePins();
+
+public:
+    explicit DmaSampler(uint8_t pclkLoopbackPin);
+    ~DmaSampler() override;
+
+    bool begin(uint32_t sampleRate, const uint8_t* pins, uint8_t count) override;
+    void end() override;
+    bool start() override;
+    void stop() override;
+
+    bool acquireBlock(SampleBlock& block) override;
+    bool releaseBlock() override;
+
+    uint32_t getActualSampleRate() const override { return actualRate; }
+    uint32_t getOverrunCount() const override { return ring.getOverruns(); }
+    const char* getName() const override { return "LCD_CAM DMA"; }
+};
+
+#endif // CONFIG_IDF_TARGET_ESP32S3
+
+#endif // DMA_SAMPLER_H
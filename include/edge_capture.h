@@ -0,0 +1,57 @@
+#ifndef EDGE_CAPTURE_H
+#define EDGE_CAPTURE_H
+
+#include <Arduino.h>
+#include <atomic>
+#include "spsc_ring.h"
+
+#define EDGE_RING_EVENTS 1024  // Edges buffered between the ISR and the capture task
+
+// Level change seen by the GPIO interrupt
+struct EdgeEvent {
+    uint32_t cycles;  // CCOUNT when the ISR read the pins
+    uint8_t levels;   // Channel levels after the edge, bit c = channel c
+};
+
+// GPIO edge-interrupt capture.
+//
+// For sparse signals polling spends nearly all its reads on an unchanged
+// level. Here a CHANGE interrupt on every channel pin reads GPIO_IN_REG and
+// the cycle counter and pushes the pair into a wait-free ring that the
+// capture task drains; nothing runs between edges.
+//
+// CCOUNT is per core and the interrupt is serviced on the core that
+// attached it, so begin() must be called from the capture task.
+//
+// Edges lost are counted as overruns: when the ring is full, and when an
+// interrupt finds the levels unchanged, which means two edges arrived
+// before the ISR could read the first one.
+class EdgeCapture {
+private:
+    SpscRing<EdgeEvent, EDGE_RING_EVENTS> ring;
+    uint8_t pins[8];
+    uint8_t pinCount;
+    uint8_t lastLevels;               // Written by the ISR only
+    std::atomic<uint32_t> edges;
+    std::atomic<uint32_t> overruns;
+    TaskHandle_t notifyTask;          // Woken when the ring goes from empty to non-empty
+    bool attached;
+
+    static void IRAM_ATTR onEdge(void* context);
+
+public:
+    EdgeCapture();
+    ~EdgeCapture();
+
+    // Attach the interrupts; `levels` is the state edges are compared against
+    bool begin(const uint8_t* channelPins, uint8_t count, uint8_t levels, TaskHandle_t task);
+    void end();
+
+    bool pop(EdgeEvent& event) { return ring.pop(event); }
+    bool isActive() const { return attached; }
+    uint32_t getEdgeCount() const { return edges.load(std::memory_order_relaxed); }
+    uint32_t getOverrunCount() const { return overruns.load(std::memory_order_relaxed); }
+    const char* getName() const { return "GPIO edge IRQ"; }
+};
+
+#endif // EDGE_CAPTURE_H
@@ -0,0 +1,221 @@
+#ifndef ENVELOPE_STORE_H
+#define ENVELOPE_STORE_H
+
+#include <stdint.h>
+#include <atomic>
+#include "packed_sample_store.h"
+
+// Decimated capture storage: one envelope per bucket of samples.
+//
+// Each bucket keeps the levels at its first sample, which channels changed
+// inside it, the number of edges and the shortest and longest pulse that
+// ended in it. A pulse narrower than a bucket still shows up as a bucket
+// with edges and a small minimum width, so glitches survive downsampling.
+// Capture length is bounded by the bucket count, not the sample count:
+// the 128 KB arena holds about 10900 buckets, which at 10 Hz and 100
+// samples per bucket is over 30 hours.
+//
+// Like PackedSampleStore it is a ring with a wrap mode for the pre-trigger
+// window, lives in memory owned by the caller and has a single writer;
+// readers only look below the count, which is published with release.
+// This header is plain C++ so bucket contents can be checked on a host.
+
+#define ENVELOPE_NO_PULSE 0  // minPulse / maxPulse when no pulse ended in the bucket
+
+struct EnvelopeBucket {
+    uint8_t firstLevels;   // Levels at the first sample (bit c = channel c)
+    uint8_t toggled;       // Channels with at least one edge in the bucket
+    uint16_t transitions;  // Edges on all channels, saturating
+    uint32_t minPulse;     // Shortest pulse that ended here, in samples
+    uint32_t maxPulse;     // Longest pulse that ended here, in samples
+};
+
+class EnvelopeStore {
+private:
+    static const uint64_t NO_EDGE = ~0ULL;
+
+    EnvelopeBucket* buckets;
+    uint32_t capacity;       // Buckets in the attached memory
+    uint32_t head;           // Physical index of logical bucket 0
+    std::atomic<uint32_t> count;
+    bool wrap;
+    uint32_t bucketSamples;  // Samples per bucket
+    uint8_t channels;
+    SampleTimebase timebase; // firstIndex = first sample of bucket 0
+
+    // Bucket being filled
+    EnvelopeBucket current;
+    uint32_t filled;         // Samples already in current
+    bool started;            // At least one sample seen
+    uint8_t lastLevels;
+    uint64_t position;       // Samples appended since the store was reset
+    uint64_t lastEdge[8];    // Position of each channel's latest edge
+
+    void openBucket(uint8_t levels) {
+        current.firstLevels = levels;
+        current.toggled = 0;
+        current.transitions = 0;
+        current.minPulse = ENVELOPE_NO_PULSE;
+        current.maxPulse = ENVELOPE_NO_PULSE;
+    }
+
+    void closeBucket() {
+        filled = 0;
+        if (capacity == 0) return;
+        uint32_t stored = count.load(std::memory_order_relaxed);
+        if (stored == capacity) {
+            if (!wrap) return;  // Full: the bucket is dropped
+            head = (head + 1) % capacity;
+            timebase.firstIndex += bucketSamples;
+            stored--;
+        }
+        buckets[(head + stored) % capacity] = current;
+        count.store(stored + 1, std::memory_order_release);
+    }
+
+    void pushLevels(uint8_t levels) {
+        if (!started) {
+            started = true;
+            lastLevels = levels;
+        }
+        if (filled == 0) openBucket(levels);
+
+        uint8_t changed = levels ^ lastLevels;
+        for (uint8_t c = 0; changed; c++, changed >>= 1) {
+            if (!(changed & 1)) continue;
+            // The run before a channel's first edge began before the
+            // capture, so its width is unknown
+            if (lastEdge[c] != NO_EDGE) {
+                uint64_t width = position - lastEdge[c];
+                uint32_t pulse = width > 0xFFFFFFFF ? 0xFFFFFFFF : (uint32_t)width;
+                if (current.minPulse == ENVELOPE_NO_PULSE || pulse < current.minPulse) current.minPulse = pulse;
+                if (pulse > current.maxPulse) current.maxPulse = pulse;
+            }
+            lastEdge[c] = position;
+            current.toggled |= 1 << c;
+            if (current.transitions < 0xFFFF) current.transitions++;
+        }
+        lastLevels = levels;
+        position++;
+        if (++filled == bucketSamples) closeBucket();
+    }
+
+    // n more samples at lastLevels, whole buckets at a time
+    void holdLevels(uint64_t n) {
+        while (n > 0) {
+            if (filled == 0) openBucket(lastLevels);
+            uint32_t take = bucketSamples - filled;
+            if (take > n) take = (uint32_t)n;
+            filled += take;
+            position += take;
+            n -= take;
+            if (filled == bucketSamples) closeBucket();
+        }
+    }
+
+public:
+    EnvelopeStore()
+        : buckets(nullptr), capacity(0), head(0), count(0), wrap(false), bucketSamples(1), channels(1) {
+        timebase = SampleTimebase();
+        reset();
+    }
+
+    void attach(void* storage, uint32_t bytes) {
+        buckets = (EnvelopeBucket*)storage;
+        capacity = bytes / sizeof(EnvelopeBucket);
+        reset();
+    }
+
+    // Both empty the store
+    void setChannels(uint8_t n) {
+        channels = n ? (n > 8 ? 8 : n) : 1;
+        reset();
+    }
+    void setBucketSamples(uint32_t samples) {
+        bucketSamples = samples ? samples : 1;
+        reset();
+    }
+
+    void reset() {
+        count.store(0, std::memory_order_release);
+        head = 0;
+        wrap = false;
+        timebase = SampleTimebase();
+        filled = 0;
+        started = false;
+        lastLevels = 0;
+        position = 0;
+        for (uint8_t c = 0; c < 8; c++) lastEdge[c] = NO_EDGE;
+    }
+
+    // Keep at most the newest `keep` finished buckets
+    void trimTo(uint32_t keep) {
+        uint32_t stored = count.load(std::memory_order_relaxed);
+        if (stored <= keep) return;
+        uint32_t drop = stored - keep;
+        count.store(keep, std::memory_order_release);
+        head = (uint32_t)(((uint64_t)head + drop) % capacity);
+        timebase.firstIndex += (uint64_t)drop * bucketSamples;
+    }
+
+    void setWrap(bool enable) { wrap = enable; }
+    bool isWrapping() const { return wrap; }
+
+    void setTimebase(const SampleTimebase& tb) { timebase = tb; }
+    const SampleTimebase& getTimebase() const { return timebase; }
+    bool hasTimebase() const { return timebase.rate != 0; }
+
+    // Fold n samples starting at bit `first` of each source plane (plane c
+    // starts `planeStride` words after bits) into the buckets. Stretches
+    // where no channel changes are taken up to a word at a time.
+    void append(const uint32_t* bits, uint32_t planeStride, uint32_t first, uint32_t n) {
+        while (n > 0) {
+            uint32_t shift = first & 31;
+            uint32_t take = 32 - shift;
+            if (take > n) take = n;
+            uint32_t mask = (take == 32 ? 0xFFFFFFFF : ((1u << take) - 1)) << shift;
+
+            bool steady = started;
+            for (uint8_t c = 0; c < channels && steady; c++) {
+                uint32_t expect = ((lastLevels >> c) & 1) ? mask : 0;
+                steady = (bits[c * planeStride + (first >> 5)] & mask) == expect;
+            }
+
+            if (steady) {
+                holdLevels(take);
+            } else {
+                for (uint32_t i = 0; i < take; i++) {
+                    uint32_t bit = first + i;
+                    uint8_t levels = 0;
+                    for (uint8_t c = 0; c < channels; c++) {
+                        levels |= ((bits[c * planeStride + (bit >> 5)] >> (bit & 31)) & 1) << c;
+                    }
+                    pushLevels(levels);
+                }
+            }
+            first += take;
+            n -= take;
+        }
+    }
+
+    // Finished buckets, oldest first
+    uint32_t size() const { return count.load(std::memory_order_acquire); }
+    const EnvelopeBucket& at(uint32_t index) const { return buckets[(head + index) % capacity]; }
+    bool full() const { return !wrap && size() >= capacity; }
+    uint32_t getCapacity() const { return capacity; }
+    uint32_t getBucketSamples() const { return bucketSamples; }
+
+    // The bucket still being filled, covering getPendingSamples() samples
+    const EnvelopeBucket& getPending() const { return current; }
+    uint32_t getPendingSamples() const { return filled; }
+
+    // Samples covered by the finished and pending buckets
+    uint64_t getSampleCount() const { return (uint64_t)size() * bucketSamples + filled; }
+
+    // Time of the first sample of logical bucket index
+    uint64_t timestampAt(uint32_t index) const {
+        return timebase.timestampAt(timebase.firstIndex + (uint64_t)index * bucketSamples);
+    }
+};
+
+#endif // ENVELOPE_STORE_H
@@ -0,0 +1,475 @@
+#ifndef FLASH_FORMAT_H
+#define FLASH_FORMAT_H
+
+#include <stdint.h>
+#include <string.h>
+
+// On-flash capture file, format version 2.
+//
+//   FlashStorageHeader              64 bytes at offset 0
+//   chunk 0 .. chunk_count-1        chunk_bytes each, back to back
+//   FlashIndexEntry[chunk_count]    written when the capture is finalized
+//   FlashIndexTrailer
+//
+// Every chunk starts with a FlashChunkHeader and is padded to chunk_bytes,
+// so chunk i lives at header_bytes + i * chunk_bytes. A chunk decodes on
+// its own: its header carries the time (and for edges the levels) the
+// payload continues from, and its CRC32 covers the payload. The index is
+// a copy of the chunk headers' positions, so a reader can binary-search
+// for a sample or a time with one small read per step. A file whose
+// capture never finished has index_offset 0; its chunks are still found
+// from the file size and can be searched through their headers.
+//
+// A circular capture (FLASH_HEADER_CIRCULAR) keeps its chunks in a ring of
+// ring_chunks slots: the chunk with sequence s is in slot s % ring_chunks,
+// so once the ring is full each new chunk replaces the oldest. chunk_count
+// counts every chunk written and the index lists the kept ones oldest
+// first, so a reader sees one contiguous run starting at a sequence above
+// 0. Without an index the oldest chunk is found where the sequence numbers
+// in the slots step back.
+//
+// Payloads by codec:
+//   FLASH_CODEC_RECORDS      FlashSampleRecord; each chunk opens with a keyframe
+//   FLASH_CODEC_TRANSITIONS  varint sample deltas to the next edge, plus the
+//                            new levels byte when channels > 1; an edge never
+//                            straddles two chunks
+//   FLASH_CODEC_COMPRESSED   CompressedSample; the first entry's delta is
+//                            relative to the chunk's first_timestamp
+// For edges, sample numbers count every sample; for records and compressed
+// entries they count what is stored.
+//
+// All fields are little-endian, as written by the ESP32. The CRC is the
+// common CRC-32 (zlib / IEEE 802.3), so any tool can check a chunk. This
+// header is plain C++: FlashCaptureReader opens a capture pulled off the
+// device on a host as well as on the device itself.
+
+#define FLASH_FORMAT_MAGIC 0x4C4F4749    // "LOGI"
+#define FLASH_FORMAT_VERSION 2
+#define FLASH_CHUNK_MAGIC 0x4B4E4843     // "CHNK"
+#define FLASH_INDEX_MAGIC 0x58444E49     // "INDX"
+
+#define FLASH_CODEC_RECORDS 0
+#define FLASH_CODEC_TRANSITIONS 1
+#define FLASH_CODEC_COMPRESSED 2
+
+#define FLASH_HEADER_FINALIZED 0x01      // Index written, counts final
+#define FLASH_HEADER_CIRCULAR 0x02       // Chunks rotate through ring_chunks slots
+
+#define FLASH_NO_CHUNK -1
+
+// Sample as written to flash. A record carries the time since the previous
+// record, so it stays 8 bytes. Every FLASH_KEYFRAME_INTERVAL records (and
+// whenever a delta would not fit) a keyframe record holding the upper half
+// of the absolute time precedes a record whose time is the lower half.
+#define FLASH_RECORD_KEYFRAME 0x01
+struct FlashSampleRecord {
+    uint32_t time;   // Delta in us, or one half of a keyframe time
+    uint8_t flags;   // FLASH_RECORD_*
+    uint8_t levels;  // Channel levels, bit c = channel c
+};
+
+// Compressed sample structures
+struct CompressedSample {
+    uint32_t timestamp;  // us since the previous entry (the first is relative to compressedBaseTime)
+    uint16_t count;      // Run length or delta count
+    uint8_t data;        // Channel levels
+    uint8_t type;        // Compression type flag
+};
+
+// Flash storage metadata, at the start of the file
+struct FlashStorageHeader {
+    uint32_t magic;           // FLASH_FORMAT_MAGIC
+    uint16_t version;         // FLASH_FORMAT_VERSION
+    uint16_t header_bytes;    // Offset of chunk 0
+    uint32_t chunk_bytes;     // Size of every chunk, header included
+    uint32_t sample_rate;     // Sample rate used
+    uint32_t sample_count;    // Total samples stored
+    uint32_t buffer_size;     // Buffer configuration
+    uint32_t trigger_index;   // Sample number of the trigger, 0xFFFFFFFF if none
+    uint32_t chunk_count;     // Chunks written (final once FLASH_HEADER_FINALIZED)
+    uint64_t first_timestamp; // Time of the first stored sample, us
+    uint64_t last_timestamp;  // Time of the last stored sample, us
+    uint32_t index_offset;    // File offset of the chunk index, 0 = none
+    uint8_t codec;            // FLASH_CODEC_*
+    uint8_t channels;         // Channels per sample
+    uint8_t compression;      // Compression type of FLASH_CODEC_COMPRESSED entries
+    uint8_t flags;            // FLASH_HEADER_*
+    uint32_t ring_chunks;     // Slots of a circular capture, 0 = linear
+    uint32_t crc32;           // Of the bytes above
+};
+
+struct FlashChunkHeader {
+    uint32_t magic;           // FLASH_CHUNK_MAGIC
+    uint32_t sequence;        // Chunk number in the file
+    uint64_t first_timestamp; // Time the payload continues from, us
+    uint32_t first_sample;    // Sample number at first_timestamp
+    uint32_t sample_count;    // Samples the payload covers
+    uint16_t payload_bytes;   // Used bytes after this header
+    uint8_t codec;            // FLASH_CODEC_*
+    uint8_t levels;           // Edges: levels at first_sample
+    uint32_t crc32;           // Of the payload bytes
+};
+
+struct FlashIndexEntry {
+    uint64_t first_timestamp;
+    uint32_t first_sample;
+    uint32_t sample_count;
+};
+
+struct FlashIndexTrailer {
+    uint32_t magic;           // FLASH_INDEX_MAGIC
+    uint32_t count;           // Entries before the trailer
+    uint32_t crc32;           // Of the entries
+    uint32_t reserved;
+};
+
+static_assert(sizeof(FlashSampleRecord) == 8, "Flash record layout");
+static_assert(sizeof(CompressedSample) == 8, "Compressed entry layout");
+static_assert(sizeof(FlashStorageHeader) == 64, "Flash header layout");
+static_assert(sizeof(FlashChunkHeader) == 32, "Chunk header layout");
+static_assert(sizeof(FlashIndexEntry) == 16, "Index entry layout");
+static_assert(sizeof(FlashIndexTrailer) == 16, "Index trailer layout");
+
+// CRC-32 (reflected, polynomial 0xEDB88320); pass the previous result to continue
+inline uint32_t flashCrc32(const void* data, uint32_t length, uint32_t crc = 0) {
+    static const uint32_t nibbles[16] = {
+        0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC, 0x76DC4190, 0x6B6B51F4, 0x4DB26158, 0x5005713C,
+        0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C, 0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C,
+    };
+    const uint8_t* p = (const uint8_t*)data;
+    crc = ~crc;
+    while (length--) {
+        crc ^= *p++;
+        crc = (crc >> 4) ^ nibbles[crc & 0x0F];
+        crc = (crc >> 4) ^ nibbles[crc & 0x0F];
+    }
+    return ~crc;
+}
+
+inline uint32_t flashHeaderCrc(const FlashStorageHeader& header) {
+    return flashCrc32(&header, (uint32_t)(sizeof(header) - sizeof(header.crc32)));
+}
+
+// Random-access byte source the reader pulls a file through
+class FlashByteSource {
+public:
+    virtual ~FlashByteSource() {}
+    virtual uint32_t size() = 0;
+    virtual bool read(uint32_t offset, void* data, uint32_t length) = 0;
+};
+
+// Whole file in memory
+class FlashMemorySource : public FlashByteSource {
+private:
+    const uint8_t* bytes;
+    uint32_t length;
+
+public:
+    FlashMemorySource(const void* data, uint32_t size) : bytes((const uint8_t*)data), length(size) {}
+    uint32_t size() override { return length; }
+    bool read(uint32_t offset, void* data, uint32_t n) override {
+        if (offset > length || n > length - offset) return false;
+        memcpy(data, bytes + offset, n);
+        return true;
+    }
+};
+
+// Reader and verifier for version 2 files. Decoding needs a scratch buffer
+// of at least chunk_bytes; the reader itself allocates nothing.
+class FlashCaptureReader {
+public:
+    enum Status {
+        FLASH_OK,
+        FLASH_TOO_SHORT,
+        FLASH_BAD_MAGIC,
+        FLASH_BAD_VERSION,
+        FLASH_BAD_HEADER_CRC,
+        FLASH_BAD_GEOMETRY,
+        FLASH_BAD_INDEX,
+        FLASH_BAD_CHUNK,
+        FLASH_BAD_CHUNK_CRC,
+        FLASH_READ_FAILED,
+    };
+
+private:
+    FlashByteSource* source;
+    FlashStorageHeader header;
+    uint32_t chunks;
+    bool indexed;
+    uint32_t ring;          // Slots of a circular file, 0 = linear
+    uint32_t ringStart;     // Slot of chunk 0
+    uint32_t firstChunk;    // Sequence of chunk 0
+
+public:
+    FlashCaptureReader() : source(nullptr), chunks(0), indexed(false), ring(0), ringStart(0), firstChunk(0) {
+        memset(&header, 0, sizeof(header));
+    }
+
+    Status open(FlashByteSource* src) {
+        source = src;
+        chunks = 0;
+        indexed = false;
+        ring = 0;
+        ringStart = 0;
+        firstChunk = 0;
+        uint32_t fileSize = source->size();
+        if (fileSize < sizeof(header)) return FLASH_TOO_SHORT;
+        if (!source->read(0, &header, sizeof(header))) return FLASH_READ_FAILED;
+        if (header.magic != FLASH_FORMAT_MAGIC) return FLASH_BAD_MAGIC;
+        if (header.version != FLASH_FORMAT_VERSION) return FLASH_BAD_VERSION;
+        if (header.crc32 != flashHeaderCrc(header)) return FLASH_BAD_HEADER_CRC;
+        if (header.header_bytes < sizeof(header) || header.chunk_bytes <= sizeof(FlashChunkHeader)) {
+            return FLASH_BAD_GEOMETRY;
+        }
+
+        if (header.flags & FLASH_HEADER_CIRCULAR) ring = header.ring_chunks;
+
+        if (header.index_offset != 0) {
+            // The index must sit right after the last chunk (the last slot)
+            uint32_t kept = ring && header.chunk_count > ring ? ring : header.chunk_count;
+            FlashIndexTrailer trailer;
+            uint64_t end = (uint64_t)header.header_bytes + (uint64_t)kept * header.chunk_bytes;
+            uint64_t trailerAt = (uint64_t)header.index_offset + (uint64_t)kept * sizeof(FlashIndexEntry);
+            if (header.index_offset != end || trailerAt + sizeof(trailer) > fileSize) return FLASH_BAD_INDEX;
+            if (!source->read((uint32_t)trailerAt, &trailer, sizeof(trailer))) return FLASH_READ_FAILED;
+            if (trailer.magic != FLASH_INDEX_MAGIC || trailer.count != kept) return FLASH_BAD_INDEX;
+            chunks = kept;
+            firstChunk = header.chunk_count - kept;
+            ringStart = ring ? firstChunk % ring : 0;
+            indexed = true;
+        } else {
+            // Unfinished capture: every whole chunk on flash counts
+            chunks = (fileSize - header.header_bytes) / header.chunk_bytes;
+            if (ring && chunks >= ring) {
+                chunks = ring;
+                return findRingStart();
+            }
+        }
+        return FLASH_OK;
+    }
+
+    const FlashStorageHeader& getHeader() const { return header; }
+    uint32_t getChunkCount() const { return chunks; }
+    bool isIndexed() const { return indexed; }
+    bool isFinalized() const { return (header.flags & FLASH_HEADER_FINALIZED) != 0; }
+    bool isCircular() const { return ring != 0; }
+    uint32_t getFirstSequence() const { return firstChunk; }  // Chunks before it were overwritten
+
+    // Time of sample n of an edge file, as the capture's timebase has it
+    uint64_t edgeTime(uint64_t n) const {
+        uint32_t rate = header.sample_rate ? header.sample_rate : 1;
+        return header.first_timestamp + (n / rate) * 1000000ULL + (n % rate) * 1000000ULL / rate;
+    }
+
+    uint32_t chunkOffset(uint32_t chunk) const {
+        uint32_t slot = ring ? (ringStart + chunk) % ring : chunk;
+        return header.header_bytes + slot * header.chunk_bytes;
+    }
+
+    Status readChunkHeader(uint32_t chunk, FlashChunkHeader& out) {
+        if (chunk >= chunks) return FLASH_BAD_CHUNK;
+        if (!source->read(chunkOffset(chunk), &out, sizeof(out))) return FLASH_READ_FAILED;
+        if (out.magic != FLASH_CHUNK_MAGIC || out.sequence != firstChunk + chunk ||
+            out.payload_bytes > header.chunk_bytes - sizeof(FlashChunkHeader)) {
+            return FLASH_BAD_CHUNK;
+        }
+        return FLASH_OK;
+    }
+
+    // From the index when there is one, else from the chunk header
+    Status readIndexEntry(uint32_t chunk, FlashIndexEntry& out) {
+        if (chunk >= chunks) return FLASH_BAD_CHUNK;
+        if (indexed) {
+            uint32_t at = header.index_offset + chunk * sizeof(FlashIndexEntry);
+            return source->read(at, &out, sizeof(out)) ? FLASH_OK : FLASH_READ_FAILED;
+        }
+        FlashChunkHeader chunkHeader;
+        Status status = readChunkHeader(chunk, chunkHeader);
+        if (status != FLASH_OK) return status;
+        out.first_timestamp = chunkHeader.first_timestamp;
+        out.first_sample = chunkHeader.first_sample;
+        out.sample_count = chunkHeader.sample_count;
+        return FLASH_OK;
+    }
+
+    // Chunk holding sample n (the last chunk starting at or before it)
+    int32_t findChunkBySample(uint32_t sample) {
+        return findChunk(sample, false);
+    }
+
+    // Chunk holding the first sample at or after time t
+    int32_t findChunkByTime(uint64_t time) {
+        return findChunk(time, true);
+    }
+
+    // Reads chunk `chunk` into scratch and checks its CRC; the payload
+    // starts at scratch + sizeof(FlashChunkHeader)
+    Status loadChunk(uint32_t chunk, uint8_t* scratch) {
+        FlashChunkHeader* chunkHeader = (FlashChunkHeader*)scratch;
+        Status status = readChunkHeader(chunk, *chunkHeader);
+        if (status != FLASH_OK) return status;
+        if (!source->read(chunkOffset(chunk) + sizeof(FlashChunkHeader), scratch + sizeof(FlashChunkHeader),
+                          chunkHeader->payload_bytes)) {
+            return FLASH_READ_FAILED;
+        }
+        uint32_t crc = flashCrc32(scratch + sizeof(FlashChunkHeader), chunkHeader->payload_bytes);
+        return crc == chunkHeader->crc32 ? FLASH_OK : FLASH_BAD_CHUNK_CRC;
+    }
+
+    // Calls visit(sample, timestamp, levels) for each stored sample of the
+    // chunk (each edge for edge files, plus the starting levels in chunk 0)
+    // until it returns false. scratch must hold chunk_bytes.
+    template <typename Visitor>
+    Status decodeChunk(uint32_t chunk, uint8_t* scratch, Visitor visit) {
+        Status status = loadChunk(chunk, scratch);
+        if (status != FLASH_OK) return status;
+        return decodeLoaded(scratch, visit);
+    }
+
+    // Same for a chunk already read and checked by loadChunk()
+    template <typename Visitor>
+    Status decodeLoaded(const uint8_t* loaded, Visitor visit) const {
+        const FlashChunkHeader& chunkHeader = *(const FlashChunkHeader*)loaded;
+        const uint8_t* payload = loaded + sizeof(FlashChunkHeader);
+        uint32_t length = chunkHeader.payload_bytes;
+        uint32_t sample = chunkHeader.first_sample;
+
+        if (chunkHeader.codec == FLASH_CODEC_RECORDS) {
+            uint64_t time = chunkHeader.first_timestamp;
+            bool keyframe = false;
+            uint32_t upper = 0;
+            for (uint32_t at = 0; at + sizeof(FlashSampleRecord) <= length; at += sizeof(FlashSampleRecord)) {
+                FlashSampleRecord record;
+                memcpy(&record, payload + at, sizeof(record));
+                if (record.flags & FLASH_RECORD_KEYFRAME) {
+                    upper = record.time;
+                    keyframe = true;
+                    continue;
+                }
+                time = keyframe ? ((uint64_t)upper << 32) | record.time : time + record.time;
+                keyframe = false;
+                if (!visit(sample++, time, record.levels)) break;
+            }
+        } else if (chunkHeader.codec == FLASH_CODEC_COMPRESSED) {
+            uint64_t time = chunkHeader.first_timestamp;
+            for (uint32_t at = 0; at + sizeof(CompressedSample) <= length; at += sizeof(CompressedSample)) {
+                CompressedSample entry;
+                memcpy(&entry, payload + at, sizeof(entry));
+                time += entry.timestamp;
+                if (!visit(sample++, time, entry.data)) break;
+            }
+        } else if (chunkHeader.codec == FLASH_CODEC_TRANSITIONS) {
+            uint8_t levels = chunkHeader.levels;
+            uint64_t position = sample;
+            if (chunkHeader.sequence == 0 && !visit(sample, edgeTime(position), levels)) return FLASH_OK;
+            uint32_t at = 0;
+            while (at < length) {
+                uint64_t delta = 0;
+                uint8_t shift = 0;
+                uint8_t byte;
+                do {
+                    byte = payload[at++];
+                    delta |= (uint64_t)(byte & 0x7F) << shift;
+                    shift += 7;
+                } while ((byte & 0x80) && at < length && shift < 64);
+                if (byte & 0x80) return FLASH_BAD_CHUNK;
+                if (header.channels > 1) {
+                    if (at >= length) return FLASH_BAD_CHUNK;
+                    levels = payload[at++];
+                } else {
+                    levels ^= 1;
+                }
+                position += delta;
+                if (!visit((uint32_t)position, edgeTime(position), levels)) break;
+            }
+        } else {
+            return FLASH_BAD_CHUNK;
+        }
+        return FLASH_OK;
+    }
+
+    // Checks every chunk and the index against the chunk headers; returns
+    // the first problem found and the number of bad chunks in *badChunks
+    Status verify(uint8_t* scratch, uint32_t* badChunks = nullptr) {
+        Status first = FLASH_OK;
+        uint32_t bad = 0;
+        uint32_t indexCrc = 0;
+        for (uint32_t i = 0; i < chunks; i++) {
+            Status status = loadChunk(i, scratch);
+            const FlashChunkHeader& chunkHeader = *(const FlashChunkHeader*)scratch;
+            if (status == FLASH_OK && chunkHeader.codec != header.codec) status = FLASH_BAD_CHUNK;
+            if (status == FLASH_OK && indexed) {
+                FlashIndexEntry entry;
+                status = readIndexEntry(i, entry);
+                if (status == FLASH_OK && (entry.first_sample != chunkHeader.first_sample ||
+                                           entry.first_timestamp != chunkHeader.first_timestamp ||
+                                           entry.sample_count != chunkHeader.sample_count)) {
+                    status = FLASH_BAD_INDEX;
+                }
+                if (status == FLASH_OK) indexCrc = flashCrc32(&entry, sizeof(entry), indexCrc);
+            }
+            if (status != FLASH_OK) {
+                if (first == FLASH_OK) first = status;
+                bad++;
+            }
+        }
+        if (indexed && bad == 0) {
+            FlashIndexTrailer trailer;
+            uint32_t at = header.index_offset + chunks * sizeof(FlashIndexEntry);
+            if (!source->read(at, &trailer, sizeof(trailer))) {
+                first = FLASH_READ_FAILED;
+            } else if (trailer.crc32 != indexCrc) {
+                first = FLASH_BAD_INDEX;
+            }
+        }
+        if (badChunks) *badChunks = bad;
+        return first;
+    }
+
+private:
+    Status readSlotSequence(uint32_t slot, uint32_t& sequence) {
+        FlashChunkHeader slotHeader;
+        if (!source->read(header.header_bytes + slot * header.chunk_bytes, &slotHeader, sizeof(slotHeader))) {
+            return FLASH_READ_FAILED;
+        }
+        if (slotHeader.magic != FLASH_CHUNK_MAGIC) return FLASH_BAD_CHUNK;
+        sequence = slotHeader.sequence;
+        return FLASH_OK;
+    }
+
+    // Full ring without an index: slots up to the newest chunk follow on
+    // from slot 0's sequence, the slots after it are one lap older
+    Status findRingStart() {
+        uint32_t base;
+        Status status = readSlotSequence(0, base);
+        if (status != FLASH_OK) return status;
+        uint32_t lo = 0;
+        uint32_t hi = ring;
+        while (hi - lo > 1) {
+            uint32_t mid = lo + (hi - lo) / 2;
+            uint32_t sequence;
+            status = readSlotSequence(mid, sequence);
+            if (status != FLASH_OK) return status;
+            if (sequence - mid == base) lo = mid; else hi = mid;
+        }
+        ringStart = hi == ring ? 0 : hi;
+        firstChunk = hi == ring ? base : base + hi - ring;
+        return FLASH_OK;
+    }
+
+    int32_t findChunk(uint64_t key, bool byTime) {
+        if (chunks == 0) return FLASH_NO_CHUNK;
+        uint32_t lo = 0;
+        uint32_t hi = chunks;
+        while (hi - lo > 1) {
+            uint32_t mid = lo + (hi - lo) / 2;
+            FlashIndexEntry entry;
+            if (readIndexEntry(mid, entry) != FLASH_OK) return FLASH_NO_CHUNK;
+            uint64_t start = byTime ? entry.first_timestamp : entry.first_sample;
+            if (start <= key) lo = mid; else hi = mid;
+        }
+        return (int32_t)lo;
+    }
+};
+
+#endif // FLASH_FORMAT_H
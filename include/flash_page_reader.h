@@ -0,0 +1,149 @@
+#ifndef FLASH_PAGE_READER_H
+#define FLASH_PAGE_READER_H
+
+#include <stdint.h>
+#include "flash_format.h"
+
+// Paged access to a flash capture.
+//
+// A page is the samples numbered [first, first + count). The chunk holding
+// `first` is found by binary search over the chunk index, and only the
+// chunks the page overlaps are read and decoded, so a page deep into an
+// 800K-sample capture costs what the first page costs. Verified chunks
+// are kept in a small LRU cache, so a UI scrolling back and forth over
+// the same stretch does not read or CRC-check it again.
+//
+// Chunks never change once written, so a cached chunk stays valid until
+// the file is replaced; its owner calls invalidate() then. This header is
+// plain C++; the cache memory is supplied by the caller.
+
+#define FLASH_CACHE_NO_CHUNK 0xFFFFFFFF
+
+template <uint8_t Slots>
+class FlashChunkCache {
+private:
+    uint8_t* buffers[Slots];
+    uint32_t chunks[Slots];    // Chunk in each slot, FLASH_CACHE_NO_CHUNK if empty
+    uint32_t lastUse[Slots];   // 0 = empty, so empty slots are taken first
+    uint32_t clock;
+    uint32_t hits;
+    uint32_t misses;
+
+public:
+    FlashChunkCache() : clock(0), hits(0), misses(0) {
+        for (uint8_t i = 0; i < Slots; i++) buffers[i] = nullptr;
+        invalidate();
+    }
+
+    // memory holds Slots * chunkBytes
+    void attach(uint8_t* memory, uint32_t chunkBytes) {
+        for (uint8_t i = 0; i < Slots; i++) buffers[i] = memory ? memory + i * chunkBytes : nullptr;
+        invalidate();
+    }
+
+    bool isAttached() const { return buffers[0] != nullptr; }
+
+    void invalidate() {
+        for (uint8_t i = 0; i < Slots; i++) {
+            chunks[i] = FLASH_CACHE_NO_CHUNK;
+            lastUse[i] = 0;
+        }
+    }
+
+    // Chunk bytes (header, then payload), read and checked on a miss;
+    // nullptr if the chunk cannot be read or fails its CRC
+    const uint8_t* get(FlashCaptureReader& reader, uint32_t chunk) {
+        uint8_t victim = 0;
+        for (uint8_t i = 0; i < Slots; i++) {
+            if (chunks[i] == chunk) {
+                lastUse[i] = ++clock;
+                hits++;
+                return buffers[i];
+            }
+            if (lastUse[i] < lastUse[victim]) victim = i;
+        }
+        misses++;
+        if (!buffers[victim] || reader.loadChunk(chunk, buffers[victim]) != FlashCaptureReader::FLASH_OK) {
+            chunks[victim] = FLASH_CACHE_NO_CHUNK;
+            lastUse[victim] = 0;
+            return nullptr;
+        }
+        chunks[victim] = chunk;
+        lastUse[victim] = ++clock;
+        return buffers[victim];
+    }
+
+    uint32_t getHits() const { return hits; }
+    uint32_t getMisses() const { return misses; }
+};
+
+// Calls visit(sample, timestamp, levels) for every sample of the page, in
+// order, until it returns false. For edge files the page is the levels at
+// `first` followed by each edge inside the range, since the samples
+// between edges are not stored.
+template <uint8_t Slots, typename Visitor>
+FlashCaptureReader::Status readFlashPage(FlashCaptureReader& reader, FlashChunkCache<Slots>& cache,
+                                         uint32_t first, uint32_t count, Visitor visit) {
+    if (count == 0 || reader.getChunkCount() == 0) return FlashCaptureReader::FLASH_OK;
+
+    // A circular capture has lost its oldest samples; the page starts at
+    // the first one kept
+    FlashIndexEntry oldest;
+    FlashCaptureReader::Status status = reader.readIndexEntry(0, oldest);
+    if (status != FlashCaptureReader::FLASH_OK) return status;
+    if (first < oldest.first_sample) {
+        uint32_t lost = oldest.first_sample - first;
+        if (lost >= count) return FlashCaptureReader::FLASH_OK;
+        first += lost;
+        count -= lost;
+    }
+    int32_t start = reader.findChunkBySample(first);
+    if (start == FLASH_NO_CHUNK) return FlashCaptureReader::FLASH_BAD_INDEX;
+
+    uint64_t end = (uint64_t)first + count;
+    bool edges = reader.getHeader().codec == FLASH_CODEC_TRANSITIONS;
+    bool opened = false;   // Edges: levels at `first` reported
+    bool done = false;
+    uint8_t levels = 0;
+    bool haveLevels = false;
+
+    for (uint32_t chunk = (uint32_t)start; chunk < reader.getChunkCount() && !done; chunk++) {
+        const uint8_t* loaded = cache.get(reader, chunk);
+        if (!loaded) return FlashCaptureReader::FLASH_BAD_CHUNK_CRC;
+        const FlashChunkHeader& chunkHeader = *(const FlashChunkHeader*)loaded;
+        if (chunkHeader.first_sample >= end) break;
+        levels = chunkHeader.levels;
+        haveLevels = true;
+
+        status = reader.decodeLoaded(loaded,
+            [&](uint32_t sample, uint64_t timestamp, uint8_t sampleLevels) -> bool {
+                if (sample < first) {
+                    levels = sampleLevels;
+                    return true;
+                }
+                if (sample >= end) {
+                    done = true;
+                    return false;
+                }
+                if (edges && !opened) {
+                    opened = true;
+                    if (sample > first && !visit(first, reader.edgeTime(first), levels)) {
+                        done = true;
+                        return false;
+                    }
+                }
+                if (!visit(sample, timestamp, sampleLevels)) {
+                    done = true;
+                    return false;
+                }
+                return true;
+            });
+        if (status != FlashCaptureReader::FLASH_OK) return status;
+    }
+
+    // No edge inside the range: the page is one level
+    if (edges && !opened && haveLevels) visit(first, reader.edgeTime(first), levels);
+    return FlashCaptureReader::FLASH_OK;
+}
+
+#endif // FLASH_PAGE_READER_H
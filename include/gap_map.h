@@ -0,0 +1,59 @@
+#ifndef GAP_MAP_H
+#define GAP_MAP_H
+
+#include <stdint.h>
+#include <atomic>
+
+// Stretches of a polled capture whose slots were not read in time.
+//
+// Storage has no per-sample timestamps, so a slot the producer missed is
+// still stored, holding the previous level, to keep later samples on the
+// grid. Each such stretch is recorded here by capture index so exports
+// can mark those samples as filled rather than read. Adjacent stretches
+// merge. Once the map is full further gaps are only counted. The producer
+// is the only writer and publishes the count with release; readers only
+// look below it.
+
+#define GAP_MAP_MAX_GAPS 256  // Separate gaps kept per capture
+
+struct SampleGap {
+    uint64_t index;  // Capture index of the first filled slot
+    uint64_t count;  // Slots filled with the held level
+};
+
+class GapMap {
+private:
+    SampleGap gaps[GAP_MAP_MAX_GAPS];
+    std::atomic<uint32_t> count;
+    std::atomic<uint64_t> unlisted;  // Filled slots of gaps that did not fit
+
+public:
+    GapMap() : count(0), unlisted(0) {}
+
+    void clear() {
+        count.store(0, std::memory_order_release);
+        unlisted.store(0, std::memory_order_release);
+    }
+
+    void add(uint64_t index, uint64_t slots) {
+        if (slots == 0) return;
+        uint32_t n = count.load(std::memory_order_relaxed);
+        if (n > 0 && gaps[n - 1].index + gaps[n - 1].count == index) {
+            // Readers may see the old length for a moment, as with any gap still growing
+            gaps[n - 1].count += slots;
+            return;
+        }
+        if (n >= GAP_MAP_MAX_GAPS) {
+            unlisted.fetch_add(slots, std::memory_order_relaxed);
+            return;
+        }
+        gaps[n] = {index, slots};
+        count.store(n + 1, std::memory_order_release);
+    }
+
+    uint32_t size() const { return count.load(std::memory_order_acquire); }
+    const SampleGap& at(uint32_t i) const { return gaps[i]; }
+    uint64_t getUnlisted() const { return unlisted.load(std::memory_order_relaxed); }
+};
+
+#endif // GAP_MAP_H
@@ -5,7 +5,33 @@
 #include <ArduinoJson.h>
 #include <Preferences.h>
 #include <vector>
+#include <atomic>
+#include <memory>
 #include <LittleFS.h>
+#include <esp_timer.h>
+#include "sampler.h"
+#include "dma_sampler.h"
+#include "edge_capture.h"
+#include "rmt_capture.h"
+#include "mcpwm_capture.h"
+#include "burst_sampler.h"
+#include "pulse_counter.h"
+#include "counter_series.h"
+#include "capture_clock.h"
+#include "cpu_cycle_clock.h"
+#include "spsc_ring.h"
+#include "capture_pipeline.h"
+#include "packed_sample_store.h"
+#include "transition_store.h"
+#include "envelope_store.h"
+#include "adaptive_rate.h"
+#include "capture_health.h"
+#include "gap_map.h"
+#include "flash_format.h"
+#include "flash_page_reader.h"
+#include "segment_log.h"
+#include "partition_flash.h"
+#include "trigger_engine.h"
 
 #ifdef ATOMS3_BUILD
     #include <M5AtomS3.h>
@@ -13,9 +39,9 @@
 #endif
 
 // Configuration constants - Optimized for shared 8MB Flash storage
-#define MAX_CHANNELS 1  // Only GPIO1 for maximum efficiency
-#define BUFFER_SIZE 16384  // Safe RAM buffer size
-#define MAX_BUFFER_SIZE 262144  // Max buffer size (flash storage required)
+#define MAX_CHANNELS 8  // Channels captured from one GPIO_IN_REG read
+#define BUFFER_SIZE 1048576  // RAM buffer size in samples (bit-packed, 128KB)
+#define MAX_BUFFER_SIZE 1048576  // Max buffer size
 
 // Shared 8MB Flash allocation (6MB usable after system partition):
 // - UART: 2MB (400K entries @ 50 bytes avg) 
@@ -24,6 +50,7 @@
 #define FLASH_BUFFER_SIZE 400000     // 400K samples (~2MB) - Default balanced size
 #define MAX_FLASH_BUFFER_SIZE 800000 // 800K samples (~4MB) - Max logic storage 
 #define FLASH_CHUNK_SIZE 4096        // Write chunks of 4KB to flash
+#define FLASH_CHUNK_PAYLOAD (FLASH_CHUNK_SIZE - sizeof(FlashChunkHeader))  // Data bytes per chunk
 #define MAX_UART_FLASH_ENTRIES 400000 // 400K UART entries (~2MB) - Shared flash limit
 #define DEFAULT_SAMPLE_RATE 1000000  // 1MHz
 #define MIN_SAMPLE_RATE 10           // 10Hz (ultra-low frequency monitoring)
@@ -38,28 +65,127 @@
     #define CHANNEL_0_PIN 2   // GPIO2 - Single channel mode
 #endif
 
+// Pins a channel mask may select. Channels must sit in GPIO_IN_REG (GPIO0-31)
+// so every sample is one register read.
+#ifdef ATOMS3_BUILD
+    // Header and Grove pins G1, G2, G5, G6, G7, G8
+    #define CHANNEL_PINS_ALLOWED 0x000001E6
+#else
+    // GPIO0-31 except the SPI flash pins 6-11
+    #define CHANNEL_PINS_ALLOWED 0xFFFFF03F
+#endif
+
+// Unconnected pin used to loop the LCD_CAM clock back into CAM_PCLK for DMA sampling
+#define DMA_PCLK_LOOPBACK_PIN 40
+
+// Capture task (sample producer) - runs apart from loop(), UART and web handlers
+#define CAPTURE_TASK_CORE 1
+#define CAPTURE_TASK_PRIORITY 5         // Above loopTask (1) and async_tcp (3)
+#define CAPTURE_YIELD_INTERVAL_US 20000 // Polled capture gives core 1 one tick this often for loop()
+#define CAPTURE_TASK_STACK 4096
+#define CAPTURE_STORE_TASK_CORE 0
+#define CAPTURE_STORE_TASK_PRIORITY 1   // Same as loopTask; only moves chunks into storage
+#define CAPTURE_STORE_TASK_STACK 6144   // Drains can stop a capture and finalize the flash file
+#define FLASH_WRITER_TASK_CORE 0
+#define FLASH_WRITER_TASK_PRIORITY 2    // Above loopTask, below async_tcp
+#define FLASH_WRITER_TASK_STACK 4096
+#define FLASH_WRITE_BUFFERS 3           // Chunk buffers: one filling, the rest queued or being written
+#define RAW_LOG_SEGMENT_BYTES 65536     // Raw log segment: one 64 KB block erase, 15 chunks
+#define RAW_LOG_ERASE_AHEAD 2           // Raw log segments the writer keeps erased ahead
+#define FLASH_RING_RESERVE_BYTES 262144 // LittleFS space a circular capture leaves for UART logs
+#define CAPTURE_CHUNK_SAMPLES 4096      // Samples per chunk handed to the storage side (multiple of 32)
+
+// Decimated (envelope) capture: samples folded into each stored bucket
+#define ENVELOPE_DEFAULT_SAMPLES 100
+#define ENVELOPE_MAX_SAMPLES 10000000
+
+// Adaptive-rate capture: lowest rate the polled schedule drops to when idle
+#define ADAPTIVE_DEFAULT_MIN_RATE 1000
+#define CAPTURE_RING_CHUNKS 8           // Chunks in the producer -> consumer ring (power of two)
+#define CAPTURE_RATE_UPDATE_US 20000    // Polled capture refreshes its achieved rate this often
+#define EDGE_FILL_LAG_US 1000           // Edge capture fills the held level this far behind the present
+#define CAPTURE_NO_TRIGGER 0xFFFFFFFF   // Chunk / capture without a trigger point
+#define MAX_CAPTURE_SEGMENTS 32         // Segments the RAM buffer can be split into
+#define FLASH_DRAIN_SAMPLES 8192        // Staged samples (or encoded bytes) written to flash per process()
+#define FLASH_PAGE_CACHE_CHUNKS 4       // Verified flash chunks kept for paged reads (4KB each)
+#define FLASH_PAGE_MAX_SAMPLES 2000     // Largest page getFlashDataAsJSON() returns
+#define FLASH_MAX_CAPTURE_SAMPLES 0xFFF00000  // Flash captures stop here; chunk headers number samples in 32 bits
+#define FLASH_KEYFRAME_INTERVAL 4096    // Flash records between 64-bit time keyframes
+#define COUNTER_MIN_INTERVAL_MS 100     // Counter mode aggregation interval range
+#define COUNTER_MAX_INTERVAL_MS 3600000
+
+// Monotonic 64-bit microseconds since boot; micros() wraps every ~71.6 minutes
+inline uint64_t captureMicros() {
+    return (uint64_t)esp_timer_get_time();
+}
+
+// Unpacked sample, as produced by the store iterator
 struct Sample {
-    uint32_t timestamp;  // Timestamp in microseconds
-    bool data;           // Single bit data for GPIO1 (more memory efficient)
+    uint64_t timestamp;  // Timestamp in microseconds (64-bit timeline)
+    uint8_t data;        // Channel levels, bit c = channel c (bit 0 = GPIO1)
+};
+
+// Filled flash chunk handed to the writer task
+struct FlashWriteJob {
+    uint8_t* buffer;   // FLASH_CHUNK_SIZE bytes, header included
+    uint32_t offset;   // File offset of the chunk
 };
 
-// Compressed sample structures
-struct CompressedSample {
-    uint32_t timestamp;  // Base timestamp
-    uint16_t count;      // Run length or delta count
-    bool data;           // Data value
-    uint8_t type;        // Compression type flag
+// Block of captured samples published by the capture task. Levels are packed
+// one bit per sample into one plane per channel, so a chunk holds
+// CAPTURE_CHUNK_SAMPLES / channels samples; consecutive chunks of a capture
+// are gap-free.
+struct CaptureChunk {
+    uint32_t generation;      // Capture that produced the chunk (stale chunks are dropped)
+    uint32_t count;           // Valid samples
+    uint32_t planeWords;      // Words per channel plane in bits[]
+    SampleTimebase timebase;  // firstIndex = capture index of bits[0] bit 0
+    uint32_t triggerOffset;   // Sample that fired the trigger, CAPTURE_NO_TRIGGER if none
+    uint32_t bits[CAPTURE_CHUNK_SAMPLES / 32];
 };
 
-// Flash storage metadata
-struct FlashStorageHeader {
-    uint32_t magic;         // Magic number for validation
-    uint32_t version;       // Storage format version
-    uint32_t sample_count;  // Total samples stored
-    uint32_t buffer_size;   // Buffer configuration
-    uint32_t sample_rate;   // Sample rate used
-    uint32_t compression;   // Compression type
-    uint32_t crc32;         // Data integrity check
+// One finished trigger window of a segmented capture. The stores' views
+// point into the segment's slice of the RAM arena, which is not written
+// again until the next capture starts.
+struct CaptureSegment {
+    bool transitions;                    // Which view holds the data
+    PackedSampleStore::Snapshot samples;
+    TransitionStore::Snapshot edges;
+    uint64_t sampleCount;                // Samples covered
+    uint32_t triggerIndex;               // Sample number of the trigger, CAPTURE_NO_TRIGGER if none
+    uint64_t triggerTime;                // Timeline of the trigger sample (first sample if none)
+};
+
+// Cursor of a streamed capture download. The header is built up front; rows
+// are produced from the snapshot a few at a time as the client reads, so
+// the whole capture never sits in RAM as JSON or CSV text. The stream ends
+// early, marked as truncated, once the memory behind the snapshot may have
+// been rewritten (see LogicAnalyzer::exportIntact()).
+struct CaptureExport {
+    CaptureSegment segment;
+    PackedSampleStore::Iterator samples;
+    TransitionStore::Iterator edges;
+    uint32_t generation;    // captureGeneration when the snapshot was taken
+    bool live;              // Snapshot of the live store, not of a finished segment
+    bool csv;
+    bool envelope;          // Rows are envelope buckets (live store, not the snapshot)
+    uint32_t buckets;       // Envelope: complete buckets at the start
+    uint32_t pendingSamples;  // Envelope: samples in the last, still filling bucket
+    EnvelopeBucket pending; // Envelope: copy of that bucket
+    uint64_t firstIndex;    // Envelope: capture index of bucket 0 at the start
+    uint64_t rows;          // Rows produced so far
+    uint64_t lastOffset;    // Transitions: last edge, for the closing row
+    uint8_t lastLevels;
+    bool closed;            // Transitions: closing row produced
+    bool done;
+    String text;            // Produced and not yet handed out
+    uint32_t sent;          // Bytes of text already handed out
+    String tail;            // Sent after the last row
+
+    explicit CaptureExport(const CaptureSegment& s)
+        : segment(s), samples(segment.samples.iterate()), edges(segment.edges.iterate()), generation(0),
+          live(false), csv(false), envelope(false), buckets(0), pendingSamples(0), pending(), firstIndex(0),
+          rows(0), lastOffset(0), lastLevels(0), closed(false), done(false), sent(0) {}
 };
 
 enum TriggerMode {
@@ -68,7 +194,12 @@ enum TriggerMode {
     TRIGGER_FALLING_EDGE,
     TRIGGER_BOTH_EDGES,
     TRIGGER_HIGH_LEVEL,
-    TRIGGER_LOW_LEVEL
+    TRIGGER_LOW_LEVEL,
+    TRIGGER_SEQUENCE,     // Multi-stage program, see trigger_engine.h
+    TRIGGER_PULSE_SHORTER, // Pulse of the trigger level ended before the trigger width
+    TRIGGER_PULSE_LONGER,  // Pulse of the trigger level ended after the trigger width
+    TRIGGER_GLITCH,        // Pulse of either level shorter than the trigger width
+    TRIGGER_TIMEOUT        // No edge for the trigger width
 };
 
 enum BufferMode {
@@ -85,6 +216,21 @@ enum CompressionType {
     COMPRESS_HYBRID       // RLE + Delta combined
 };
 
+enum CaptureEncoding {
+    ENCODING_SAMPLES,     // Every sample, one bit each
+    ENCODING_TRANSITIONS, // Initial level + varint edge deltas only
+    ENCODING_ENVELOPE     // Per bucket: first level, edge count, min/max pulse (RAM only)
+};
+
+enum CaptureBackend {
+    BACKEND_AUTO,         // DMA sampler when the rate allows it, otherwise polling
+    BACKEND_POLLED,       // Always poll on the cycle-counter schedule
+    BACKEND_EDGE_IRQ,     // GPIO edge interrupts, the held level fills the slots between edges
+    BACKEND_RMT,          // RMT receiver durations, channel 0 only
+    BACKEND_MCPWM,        // MCPWM capture timer latched on each edge, up to 3 channels
+    BACKEND_BURST         // Fixed-length dedicated-GPIO burst with interrupts masked (ESP32-S3)
+};
+
 enum UartDuplexMode {
     UART_FULL_DUPLEX,     // Traditional RX + TX on separate pins
     UART_HALF_DUPLEX      // Single wire bidirectional communication
@@ -92,22 +238,123 @@ enum UartDuplexMode {
 
 class LogicAnalyzer {
 private:
-    Sample buffer[BUFFER_SIZE];
-    volatile uint32_t writeIndex;
-    volatile uint32_t readIndex;
-    volatile bool capturing;
+    // RAM capture arena, used by whichever encoding the capture runs with.
+    // In the flash modes the store only stages data until it is written.
+    uint32_t captureMemory[BUFFER_SIZE / 32];
+    PackedSampleStore packedStore;          // ENCODING_SAMPLES
+    TransitionStore transitionStore;        // ENCODING_TRANSITIONS
+    EnvelopeStore envelopeStore;            // ENCODING_ENVELOPE
+    CaptureEncoding activeEncoding;         // Encoding of the current/last capture
+    CaptureBackend activeBackend;           // Backend of the current/last capture (AUTO = DMA sampler)
+    
+    // Pre-trigger window: while a trigger is armed the active store wraps;
+    // when it fires the window is trimmed to preTriggerPercent in place
+    bool triggerSeen;               // Trigger fired in the current/last capture
+    uint64_t triggerCaptureIndex;   // Capture index of the trigger sample
+    uint64_t captureFirstIndex;     // Capture index of the first kept sample
+    
+    // Segmented capture: the RAM arena is split into slices, each trigger
+    // fills one and the trigger is re-armed without clearing anything
+    uint8_t segmentsActive;                  // Slices in the current capture (1 = not segmented)
+    uint8_t segmentsDone;                    // Finished segments
+    CaptureSegment segments[MAX_CAPTURE_SEGMENTS];
+    std::atomic<bool> rearmRequested;        // Consumer -> producer: arm the trigger again
+    bool transitionHeaderWritten;   // Flash edge state set up from the store's start levels
+    
+    std::atomic<bool> capturing;
     
     uint32_t sampleRate;
-    uint8_t gpio1Pin;  // Single GPIO1 pin for optimized performance
-    
-    // Trigger configuration for GPIO1
+    uint8_t gpio1Pin;  // Channel 0 pin
+    
+    // Channels, in ascending GPIO order; all come from one GPIO_IN_REG read
+    uint8_t channelCount;
+    uint8_t channelPins[MAX_CHANNELS];
+    uint8_t triggerChannel;      // Channel the trigger watches
+    uint32_t chunkSamples;       // Samples per capture chunk for the current channel count
+    
+    // Capture pipeline, chosen when a capture starts so the per-sample path
+    // has no mode checks: the producer's plane writer for the channel count
+    // and trigger, and the storage writer for the buffer mode and codec
+    typedef bool (LogicAnalyzer::*LevelAppender)(uint8_t levels);
+    typedef void (LogicAnalyzer::*SampleWriter)(const Sample& sample);
+    LevelAppender levelAppender;
+    SampleWriter sampleWriter;
+    
+    // Trigger configuration
     TriggerMode triggerMode;
-    bool lastState;      // Single bit for GPIO1 state
-    bool triggerArmed;
+    bool triggerActive;              // Current capture waits for the trigger (mode has a program)
+    std::atomic<bool> triggerArmed;
+    TriggerProgram triggerProgram;   // Parsed TRIGGER_SEQUENCE program
+    TriggerEngine triggerEngine;     // Program of the current capture, run by the producer
+    const char* triggerProgramError; // Parse error of the last setTriggerProgram()
     
     // Timing
-    uint32_t lastSampleTime;
-    uint32_t sampleInterval;
+    uint64_t lastSampleTime;
+    CaptureClock* captureClock;          // Cycle counter the polled schedule runs on
+    bool ownsCaptureClock;               // captureClock was created by the analyzer
+    std::atomic<uint32_t> achievedRate;  // Measured rate of the current/last capture
+    
+    // Hardware-paced sampling (DMA blocks instead of micros() polling)
+    Sampler* sampler;              // Backend, nullptr when only polling is available
+    bool ownsSampler;              // sampler was created by the analyzer
+    bool samplerActive;            // Current capture is fed by the sampler
+    uint64_t samplerStartTime;     // captureMicros() when the sampler was started
+    uint32_t samplerRate;          // Achieved hardware rate for the current capture
+    uint32_t samplerBlocksDrained; // Blocks consumed in the current capture
+    
+    // Edge-interrupt capture (sparse signals: no work between edges)
+    EdgeCapture edgeCapture;
+    bool edgeActive;               // Current capture is fed by edge interrupts
+    
+    // RMT receiver capture (hardware-timed levels, one channel)
+    RmtCapture rmtCapture;
+    bool rmtActive;                // Current capture is fed by the RMT receiver
+    
+    // MCPWM capture (edge times latched in hardware, up to 3 channels)
+    McpwmCapture mcpwmCapture;
+    bool mcpwmActive;              // Current capture is fed by the MCPWM capture channels
+    
+    // Dedicated-GPIO burst (fixed sample count, then the capture stops)
+    BurstSampler burstSampler;
+    bool burstActive;              // Current capture is a burst
+    std::atomic<bool> burstDone;   // Producer has handed the whole burst to storage
+    
+    // Adaptive rate: the polled schedule follows edge density; sample
+    // indices stay contiguous and the markers keep timestamps exact
+    RateMap rateMap;
+    AdaptiveRatePolicy ratePolicy;
+    bool adaptiveActive;                 // Current/last capture ran at an adaptive rate
+    std::atomic<uint32_t> adaptiveCurrentRate;  // Rate the producer is sampling at now
+    
+    // Capture-loop health (per capture, only gathered when enabled)
+    bool healthActive;
+    ScheduleHealth scheduleHealth;  // Polled schedule: read intervals, lateness
+    CallTimer storeTimer;           // Staged writes into the flash / compressed modes
+    CallTimer flushTimer;           // Flash write-buffer flushes
+    
+    // Counter mode: per-interval frequency / duty aggregates, no samples stored
+    PulseCounter pulseCounter;
+    CounterSeries counterSeries;
+    bool counterActive;
+    uint32_t counterIntervalStart;  // millis() when the current interval began
+    
+    // Capture task (producer, core 1) -> store task (consumer, core 0)
+    SpscRing<CaptureChunk, CAPTURE_RING_CHUNKS> captureRing;
+    CaptureChunk* openChunk;                    // Producer's claimed, partially filled slot
+    TaskHandle_t captureTaskHandle;
+    TaskHandle_t captureStoreHandle;
+    SemaphoreHandle_t storeLock;                // Recursive: one consumer, and starts / stops against it
+    std::atomic<bool> producerWaiting;          // Producer blocked on a full ring, wake it after a pop
+    uint32_t producerGeneration;                // Generation the producer is filling
+    SampleTimebase producerTimebase;            // Timeline of the run being captured
+    uint64_t producerNextIndex;                 // Capture index the next stored sample must have
+    bool producerStoring;                       // Trigger passed, samples are being stored
+    uint8_t producerLevels;                     // Last stored levels (held across missed slots)
+    std::atomic<uint32_t> captureGeneration;    // Bumped by startCapture() and stopCapture()
+    std::atomic<bool> captureTaskBusy;          // Producer is inside a capture run
+    std::atomic<bool> triggerFired;             // Set by producer, logged by consumer
+    std::atomic<uint32_t> captureMissedSamples; // Slots not read in time, stored as the held level
+    GapMap captureGaps;                         // Where those slots are
     
     // Serial logging
     std::vector<String> serialLogBuffer;
@@ -121,10 +368,27 @@ private:
         uint32_t sampleRate = DEFAULT_SAMPLE_RATE;  // 1MHz default
         uint8_t gpioPin = CHANNEL_0_PIN;           // GPIO1 on AtomS3
         TriggerMode triggerMode = TRIGGER_NONE;    // No trigger by default
+        uint32_t channelMask = 1UL << CHANNEL_0_PIN; // GPIOs captured, one channel per set bit
+        uint8_t triggerChannel = 0;                // Channel index the trigger watches
+        String triggerProgram = "";                // TRIGGER_SEQUENCE program text
+        uint8_t segmentCount = 1;                  // RAM buffer segments, one trigger each (1 = off)
+        uint64_t triggerWidthNs = 1000000;         // Pulse width / timeout of the width triggers
+        uint8_t triggerPulseLevel = 1;             // Pulse polarity, 1 = high pulse
         uint32_t bufferSize = FLASH_BUFFER_SIZE;   // 1M samples - Default Flash storage
         uint8_t preTriggerPercent = 10;            // % of buffer for pre-trigger data
         BufferMode bufferMode = BUFFER_FLASH;      // Default to Flash buffer for more storage
         CompressionType compression = COMPRESS_NONE; // No compression by default
+        CaptureEncoding encoding = ENCODING_SAMPLES; // Store every sample by default
+        CaptureBackend captureBackend = BACKEND_AUTO; // How the pins are read
+        uint32_t rmtFilterNs = 0;                  // RMT glitch filter, 0 = off
+        uint32_t rmtIdleUs = 1000;                 // RMT frame ends after this long without an edge
+        uint32_t burstSamples = BURST_MAX_SAMPLES; // Samples per burst capture
+        uint32_t envelopeSamples = ENVELOPE_DEFAULT_SAMPLES; // Samples per envelope bucket
+        bool adaptiveRate = false;                  // Follow edge density between minimum and sampleRate
+        uint32_t adaptiveMinRate = ADAPTIVE_DEFAULT_MIN_RATE;
+        bool captureHealth = false;                 // Gather capture-loop health per capture
+        bool rawPartition = false;                  // Flash captures go to the raw log partition, not LittleFS
+        uint32_t counterIntervalMs = 60000;        // Counter mode aggregation interval
         bool enabled = true;
         bool streamingMode = false;                // Continuous streaming
         uint32_t maxFlashSamples = FLASH_BUFFER_SIZE; // Flash buffer limit
@@ -172,31 +436,152 @@ private:
     uint32_t flashSamplesWritten; // Count of samples written to flash
     uint32_t flashWritePosition;  // Current write position in flash
     bool flashStorageActive;      // Flash storage currently active
-    FlashStorageHeader flashHeader; // Flash storage metadata
-    
-    // Intelligent Flash Management
+    FlashStorageHeader flashHeader; // Flash storage metadata, written at offset 0
+    FlashChunkHeader flashChunk;    // Header of the chunk being filled
+    uint32_t flashChunkCount;       // Chunks already in the file
+    FlashChunkCache<FLASH_PAGE_CACHE_CHUNKS> flashPageCache;  // Chunks of the current file read for pages
+    uint8_t* flashPageMemory;       // Cache slots, allocated on the first page request
+    
+    // Edge currently being copied from the transition store; flash chunks
+    // only end between edges
+    uint8_t flashEdgeBytes[VARINT_MAX_BYTES + 1];
+    uint8_t flashEdgeLength;
+    uint8_t flashEdgeShift;
+    uint64_t flashEdgeDelta;
+    uint32_t flashEdgeSample;       // Sample number of the last edge written
+    uint8_t flashEdgeLevels;        // Levels after that edge
+    
+    // Intelligent Flash Management: a circular capture rotates its chunks
+    // through a ring of slots, so it runs until stopped (or until the part
+    // after its trigger is written) and keeps the newest ring of chunks
     bool circularFlashMode;       // Enable circular overwriting of old data
     uint32_t maxFlashSizeBytes;   // Maximum flash allocation (shared with UART)
-    void checkFlashSpaceAndRotate(); // Check available space and rotate if needed
+    uint32_t flashRingChunks;     // Ring slots of the current capture, 0 = linear
+    uint32_t flashStopChunk;      // Chunk count that ends a triggered circular capture
+    void checkFlashSpaceAndRotate(); // Size the ring from the space available (capture start)
+    uint32_t flashChunkOffset(uint32_t sequence) const;  // File offset of a chunk, by sequence
+    uint32_t flashKeptChunks() const;                     // Chunks on flash (all of them unless circular)
     
     // Compression state
     CompressedSample* compressedBuffer; // Compressed sample buffer
     uint32_t compressedCount;           // Number of compressed samples
-    uint32_t lastTimestamp;             // For delta compression
-    bool lastData;                      // For run-length encoding
+    uint64_t lastTimestamp;             // For delta compression
+    uint64_t compressedBaseTime;        // Time the first compressed entry is relative to
+    uint64_t compressedLastTime;        // Time of the last compressed entry
+    uint8_t lastData;                   // For run-length encoding
     uint16_t runLength;                 // Current run length
     
     // Streaming capture state
     bool streamingActive;       // Streaming mode active
     uint32_t streamingCount;    // Total samples streamed
-    uint8_t* flashWriteBuffer;  // Write buffer for flash chunks
+    uint8_t* flashWriteBuffer;  // Chunk being filled, one of the pool buffers
+    uint8_t* flashWritePool;    // FLASH_WRITE_BUFFERS chunk buffers
+    
+    // loop() fills chunks and queues them; the writer task does the LittleFS
+    // writes, so a slow write or erase no longer holds up draining the
+    // capture ring. The file is only opened or closed with the queue empty.
+    SpscRing<FlashWriteJob, 4> flashWriteJobs;  // loop() -> writer task
+    SpscRing<uint8_t*, 4> flashFreeBuffers;     // Writer task -> loop()
+    TaskHandle_t flashWriterHandle;
+    bool flashFinalizing;                       // Last chunks of a file: wait for a buffer, never drop
+    std::atomic<uint32_t> flashWriteOverruns;   // Chunks dropped with every buffer in the queue
+    std::atomic<uint32_t> flashWriteErrors;     // Chunk writes that failed (flash full)
+    CallTimer flashWriteTimer;                  // Writer task time per chunk
+    
+    // Raw log partition: with rawPartition set, flash captures skip LittleFS
+    // and the writer task appends chunks to a segment log on the partition,
+    // erasing segments ahead of the head while it has nothing queued
+    PartitionFlash rawFlash;
+    SegmentLog rawLog;                          // Only the writer task writes it
+    std::atomic<bool> rawLogActive;             // Current/last flash capture went to the raw log
+    bool rawLogOpen;                            // Counterpart of flashDataFile
+    FlashStorageHeader rawLogMeta;              // Header the log is started with, set before chunk 0 is queued
     uint32_t bufferPosition;    // Position in write buffer
+    uint64_t flashLastTimestamp;      // Time of the last record written to flash
+    uint32_t flashRecordsSinceKeyframe;
     
     // Private methods - optimized for GPIO1
     void initializeGPIO1();
     bool readGPIO1();
-    bool checkTrigger(bool currentState);
-    void addSample(bool data);
+    uint8_t readChannels();         // All channels from one GPIO_IN_REG read
+    void applyChannelLayout();      // Size chunks and stores for channelCount
+    void attachCaptureMemory(uint8_t segment);  // Point the stores at the arena or one segment slice
+    CaptureSegment snapshotCapture() const;     // Current stores as a segment
+    bool finishSegment();           // Keep the filled segment; false once all are used
+    void addChannelsJSON(JsonDocument& doc) const;
+    String captureHeaderCSV(bool envelope) const;  // Comment lines and the column line
+    String captureColumnsCSV() const;            // Column line of the sample rows
+    void openExport(CaptureExport& stream, const JsonDocument& info, const char* rowsKey) const;
+    bool nextExportRow(CaptureExport& stream) const;  // Append one row to stream.text; false at the end
+    bool exportIntact(const CaptureExport& stream) const;  // Snapshot memory not rewritten since; storeLock held
+    void appendSampleRow(CaptureExport& stream, uint64_t sample, uint64_t timestamp, uint8_t levels) const;
+    void appendBucketRow(CaptureExport& stream, uint32_t bucket) const;
+    String csvChannelColumns(uint8_t levels) const;  // ",b1,b2..." for channels after the first
+    void loadTriggerEngine();       // Compile the trigger mode or program for the next capture
+    void storeSample(const Sample& sample); // Flash / streaming / compressed writers
+    template <BufferMode Mode, CompressionType Codec>
+    void storeSampleAs(const Sample& sample);
+    template <CompressionType Codec>
+    void compressSampleAs(const Sample& sample);
+    template <CompressionType Codec>
+    void streamSampleAs(const Sample& sample);
+    void selectSampleWriter();      // Pick storeSampleAs<> for the buffer mode and codec
+    void stageChunkBits(const CaptureChunk* chunk, uint32_t first, uint32_t count);
+    bool stagingHasRoom(uint32_t samples) const;
+    bool flashSampleLimitReached() const;   // Flash capture is about to outgrow 32-bit sample numbers
+    void applyTrigger(uint64_t captureIndex);
+    void writeStagedData(uint32_t limit);   // Drain the staging store into the flash modes
+    void writePackedSamples(uint32_t limit);
+    void writeTransitions(uint32_t limit);
+    bool usesTransitionStore() const;
+    bool usesEnvelopeStore() const;
+    void addRateMarkersJSON(JsonDocument& doc) const;  // Rate changes of an adaptive capture
+    void addGapsJSON(JsonDocument& doc) const;         // Slots filled with the held level
+    void addHealthJSON(JsonDocument& doc) const;
+    bool beginFlashWrite(uint32_t length);  // Make room in the current chunk; true if it is empty
+    void writeFlashBytes(const uint8_t* data, uint32_t length);
+    void writeCompressedEntries();  // Streamed compressed entries to flash
+    void openFlashFile();           // Create the file with its header, or reopen it after the last chunk
+    void fillFlashHeader();         // Header fields of a new capture file or raw log
+    void writeFlashHeader(File& file);
+    uint8_t flashCodec() const;
+    uint32_t compressedDeltaTo(uint64_t timestamp);  // us since the previous compressed entry
+    void drainSampler();            // Consume finished sampler blocks
+    bool startSampler();
+    
+    // Capture task
+    static void captureTaskEntry(void* param);
+    static bool onSamplerBlockReady(void* context);
+    void captureTaskLoop();
+    void runPolledCapture();
+    void runSamplerCapture();
+    void runEdgeCapture();
+    void runRmtCapture();
+    void runMcpwmCapture();
+    void runBurstCapture();
+    bool captureEdge(uint8_t levels, uint64_t slot);  // Hold the last levels up to slot, then store levels
+    bool holdCaptureLevels(uint64_t slot);           // Hold the last levels up to (not including) slot
+    bool captureSample(uint8_t levels, uint64_t index);
+    bool claimCaptureChunk();
+    void completeCaptureWord(uint32_t first, uint8_t levels);  // Trigger / re-arm on a full 32-sample word
+    bool appendCaptureLevels(uint8_t levels);
+    template <uint8_t Channels, bool Triggered>
+    bool appendCaptureLevelsAs(uint8_t levels);
+    bool appendCaptureRun(uint8_t levels, uint64_t count);     // Same levels repeated, whole words at a time
+    void flushCaptureChunk();
+    static void captureStoreTaskEntry(void* param);
+    void captureStoreLoop();
+    void drainCaptureRing();        // Consumer: move published chunks into storage
+    void serviceCounter();          // Close the counter interval when it is due
+    void waitForCaptureTaskIdle();
+    
+    // Flash writer task
+    static void flashWriterTaskEntry(void* param);
+    void flashWriterLoop();
+    bool writeFlashChunk(const uint8_t* chunk, uint32_t offset);
+    void waitForFlashWriter();      // Until every queued chunk is on flash, however long that takes
+    void addFlashWriterJSON(JsonDocument& doc) const;
+    bool isFlashOutputOpen() const;  // File or raw log ready for chunks
     
     // Half-Duplex private methods
     void setupHalfDuplexPin(bool txMode);
@@ -206,7 +591,7 @@ private:
     
     // Dual-mode monitoring (UART + Logic on same pin)
     bool dualModeActive;                    // Both UART and Logic active on same pin
-    void processDualModeData(bool currentState); // Process both UART and Logic data
+    void processDualModeData();             // UART side of dual mode (logic runs in the capture task)
     bool isDualModeCompatible() const;      // Check if both can run simultaneously
     
 public:
@@ -225,14 +610,85 @@ public:
     // Configuration
     void setSampleRate(uint32_t rate);
     uint32_t getSampleRate() const;
+    void setSampler(Sampler* backend);          // Replace the capture backend (e.g. simulated on host)
+    bool isHardwareSampling() const;            // True while the sampler feeds the capture
+    uint32_t getMissedSampleCount() const;     // Slots filled with the held level because capture fell behind
+    void setCaptureClock(CaptureClock* clock);  // Replace the cycle counter (e.g. synthetic on host)
+    uint32_t getAchievedSampleRate() const;     // Pin reads (or hardware samples) per second actually taken
+    
+    // Transition-only capture (capacity scales with edges, not duration)
+    void setCaptureEncoding(CaptureEncoding encoding);
+    CaptureEncoding getCaptureEncoding() const;
+    String getCaptureEncodingString() const;   // Encoding of the current/last capture
+    uint32_t getEdgeCount() const;
+    uint32_t getStorageUsedPercent() const;    // Fill level of RAM or flash in any encoding
+    void setEnvelopeSamples(uint32_t samples);  // Samples per bucket of an envelope capture
+    uint32_t getEnvelopeSamples() const;
+    void setAdaptiveRate(bool enable, uint32_t minRate);  // Polled captures between minRate and the sample rate
+    bool isAdaptiveRate() const;
+    uint32_t getAdaptiveMinRate() const;
+    uint32_t getCurrentSampleRate() const;      // Rate the capture is running at now (varies when adaptive)
+    void setCaptureHealth(bool enable);         // Interval histogram, late reads and call timing per capture
+    bool isCaptureHealth() const;
+    void setRawPartition(bool enable);          // Flash captures to the raw log partition instead of LittleFS
+    bool isRawPartition() const;
+    void setCircularFlash(bool enable);         // Flash captures overwrite their oldest chunks instead of stopping
+    bool isCircularFlash() const;
+    uint32_t getTriggerIndex() const;          // Stored sample number of the trigger, CAPTURE_NO_TRIGGER if none
+    String getSamplerName() const;
+    
+    // Capture backend (applies from the next startCapture())
+    void setCaptureBackend(CaptureBackend backend);
+    CaptureBackend getCaptureBackend() const;
+    String getCaptureBackendString() const;
+    uint32_t getEdgeInterruptCount() const;     // Edges queued by the edge backend in the current/last capture
+    uint32_t getEdgeOverrunCount() const;       // Edges lost: ring full or faster than the ISR
+    void setRmtTiming(uint32_t filterNs, uint32_t idleUs);  // RMT glitch filter and idle threshold
+    uint32_t getRmtFilterNs() const;
+    uint32_t getRmtIdleUs() const;
+    double getTimestampResolutionNs() const;    // How finely the backend of the current/last capture times edges
+    void setBurstSamples(uint32_t samples);     // Length of a burst capture, up to BURST_MAX_SAMPLES
+    uint32_t getBurstSamples() const;
+    uint32_t getBurstRate() const;              // Measured rate of the last burst
+    
+    // Multi-channel capture (up to MAX_CHANNELS pins from CHANNEL_PINS_ALLOWED)
+    bool setChannelMask(uint32_t mask);         // false if the mask selects no or disallowed pins
+    uint32_t getChannelMask() const;
+    uint8_t getChannelCount() const;
+    uint8_t getChannelPin(uint8_t channel) const;
+    void setTriggerChannel(uint8_t channel);
+    uint8_t getTriggerChannel() const;
+    
+    // Segmented capture (RAM buffer mode): each trigger fills the next segment
+    void setSegmentCount(uint8_t count);        // 1 disables, up to MAX_CAPTURE_SEGMENTS
+    uint8_t getSegmentCount() const;
+    uint8_t getCompletedSegments() const;
+    String getSegmentsAsJSON() const;           // Index, samples and trigger time of each segment
+    std::shared_ptr<CaptureExport> exportSegment(uint8_t index, bool csv);  // nullptr if no such segment
+    
+    // Counter mode on the channel 0 pin (PCNT edge counts, runs beside or instead of a capture)
+    bool startCounter();
+    void stopCounter();
+    bool isCounterRunning() const;
+    void setCounterInterval(uint32_t ms);
+    uint32_t getCounterInterval() const;
+    String getCounterAsJSON(uint32_t last) const;  // Status and the newest `last` intervals
+    String getCounterAsCSV() const;                // Whole series
     
     // Trigger configuration for GPIO1
     void setTrigger(TriggerMode mode);
     void disableTrigger();
     TriggerMode getTriggerMode() const;
+    bool setTriggerProgram(const String& program);  // Selects TRIGGER_SEQUENCE; "" clears
+    String getTriggerProgram() const;
+    String getTriggerProgramError() const;          // Why the last program was rejected
+    void setTriggerWidth(uint64_t widthNs, uint8_t pulseLevel);  // For the pulse, glitch and timeout modes
+    uint64_t getTriggerWidth() const;
+    uint8_t getTriggerPulseLevel() const;
     
     // Data access
-    String getDataAsJSON();
+    std::shared_ptr<CaptureExport> exportCapture(bool csv);  // Streamed JSON or CSV of the capture
+    size_t readExport(CaptureExport& stream, uint8_t* buffer, size_t maxLen) const;  // 0 once finished
     void clearBuffer();
     uint32_t getBufferUsage() const;
     uint32_t getCurrentBufferSize() const;  // Get current configured buffer size
@@ -295,8 +751,9 @@ public:
     void initFlashLogicStorage();   // Initialize flash for logic analyzer
     void enableFlashBuffering(BufferMode mode, uint32_t maxSamples = FLASH_BUFFER_SIZE);
     void writeToFlash(const Sample& sample);     // Write single sample to flash
-    void flushFlashBuffer();        // Flush write buffer to flash
-    String getFlashDataAsJSON(uint32_t offset = 0, uint32_t count = 1000);
+    void flushFlashBuffer();        // Write the current chunk to flash
+    void finalizeFlashFile();       // Last chunk, chunk index and final header
+    String getFlashDataAsJSON(uint32_t offset = 0, uint32_t count = 1000);  // Counters and the samples [offset, offset + count)
     void clearFlashLogicData();     // Clear flash logic data
     uint32_t getFlashSampleCount() const;
     float getFlashStorageUsedMB() const;
@@ -304,8 +761,8 @@ public:
     // Compression Methods
     void enableCompression(CompressionType type);
     void compressSample(const Sample& sample);   // Add sample to compression buffer
-    void compressRunLength(bool data, uint32_t timestamp, uint16_t count);
-    void compressDelta(uint32_t timestamp, bool data);
+    void compressRunLength(uint8_t data, uint64_t timestamp, uint16_t count);
+    void compressDelta(uint64_t timestamp, uint8_t data);
     String getCompressedDataAsJSON();
     uint32_t getCompressionRatio() const;        // Returns compression percentage
     void clearCompressedBuffer();
@@ -323,9 +780,6 @@ public:
     String getBufferModeString() const;
     String getAdvancedStatusJSON() const;        // Comprehensive status
     
-    // Data export
-    String getDataAsCSV();
-    
     // Utility functions
     void printStatus();
     void printChannelStates();
@@ -0,0 +1,62 @@
+#ifndef MCPWM_CAPTURE_H
+#define MCPWM_CAPTURE_H
+
+#include <Arduino.h>
+#include <atomic>
+#include <driver/mcpwm.h>
+#include "spsc_ring.h"
+
+#define MCPWM_CAPTURE_CHANNELS 3          // Capture inputs of one MCPWM unit
+#define MCPWM_CAPTURE_CLOCK_HZ 80000000   // Capture timer runs on APB, 12.5 ns per tick
+#define MCPWM_RING_EVENTS 1024            // Edges buffered between the ISR and the capture task
+
+// Edge latched by a capture channel
+struct CaptureEdge {
+    uint32_t ticks;   // Capture timer value latched by the hardware on the edge
+    uint32_t cycles;  // CCOUNT when the ISR ran, only used to count timer wraps
+    uint8_t levels;   // Channel levels after the edge, bit c = channel c
+};
+
+// MCPWM capture-unit timestamping.
+//
+// Each capture channel latches the free-running capture timer on the edge
+// itself, so edge times carry no interrupt or task latency, only the
+// 12.5 ns timer resolution. The ISR just forwards the latched value.
+//
+// The timer is 32 bits and wraps every ~53.7 s; the ISR's cycle count is
+// coarse but enough to tell how many wraps lie between two edges.
+//
+// An edge is lost when the next edge on the same channel comes before the
+// ISR has read the latch; the following edge then has the same direction
+// as the previous one, which is counted as an overrun.
+class McpwmCapture {
+private:
+    SpscRing<CaptureEdge, MCPWM_RING_EVENTS> ring;
+    uint8_t pins[MCPWM_CAPTURE_CHANNELS];
+    uint8_t pinCount;
+    uint8_t lastLevels;               // Written by the ISR only
+    std::atomic<uint32_t> edges;
+    std::atomic<uint32_t> overruns;
+    TaskHandle_t notifyTask;          // Woken when the ring goes from empty to non-empty
+    bool attached;
+
+    static bool IRAM_ATTR onCapture(mcpwm_unit_t unit, mcpwm_capture_channel_id_t channel,
+                                    const cap_event_data_t* event, void* context);
+
+public:
+    McpwmCapture();
+    ~McpwmCapture();
+
+    // Enable one capture channel per pin; `levels` is the state at the start
+    bool begin(const uint8_t* channelPins, uint8_t count, uint8_t levels, TaskHandle_t task);
+    void end();
+
+    bool pop(CaptureEdge& edge) { return ring.pop(edge); }
+    bool isActive() const { return attached; }
+    uint32_t getEdgeCount() const { return edges.load(std::memory_order_relaxed); }
+    uint32_t getOverrunCount() const { return overruns.load(std::memory_order_relaxed); }
+    uint32_t getResolution() const { return MCPWM_CAPTURE_CLOCK_HZ; }
+    const char* getName() const { return "MCPWM capture"; }
+};
+
+#endif // MCPWM_CAPTURE_H
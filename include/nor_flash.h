@@ -0,0 +1,23 @@
+#ifndef NOR_FLASH_H
+#define NOR_FLASH_H
+
+#include <stdint.h>
+
+// Raw NOR flash region.
+//
+// NOR programming can only clear bits; setting them back takes an erase of
+// a whole erase block. A region is erased in multiples of eraseBytes() at
+// aligned offsets, and a byte can only be written once per erase. This
+// header is plain C++ so the same segment logic runs on a data partition
+// of the ESP32's flash (PartitionFlash) and on a host (SimulatedNorFlash).
+class NorFlash {
+public:
+    virtual ~NorFlash() {}
+    virtual uint32_t size() const = 0;
+    virtual uint32_t eraseBytes() const = 0;
+    virtual bool erase(uint32_t offset, uint32_t length) = 0;
+    virtual bool write(uint32_t offset, const void* data, uint32_t length) = 0;
+    virtual bool read(uint32_t offset, void* data, uint32_t length) = 0;
+};
+
+#endif // NOR_FLASH_H
@@ -0,0 +1,291 @@
+#ifndef PACKED_SAMPLE_STORE_H
+#define PACKED_SAMPLE_STORE_H
+
+#include <stdint.h>
+#include <atomic>
+#include "rate_map.h"
+
+// Fixed-rate timeline shared by every sample of a capture. Sample n (counted
+// from the start of the capture, not of the store) was taken at
+//   baseTime + floor(n * 1000000 / rate) microseconds
+// so no per-sample timestamp has to be stored. Times are 64-bit so the
+// timeline does not wrap on multi-hour captures. An adaptive-rate capture
+// sets rates, and times then come from its rate-change markers instead.
+struct SampleTimebase {
+    uint64_t baseTime;    // Monotonic microseconds of sample index 0
+    uint32_t rate;        // Samples per second, 0 = not set
+    uint64_t firstIndex;  // Capture index of the first stored sample
+    const RateMap* rates; // Rate changes of an adaptive capture, nullptr = fixed rate
+
+    // Microseconds from sample 0 to sample index, split so it cannot overflow
+    static uint64_t offsetOf(uint64_t index, uint32_t rate, uint32_t& remainder) {
+        if (rate == 0) rate = 1;
+        uint64_t rest = (index % rate) * 1000000ULL;
+        remainder = (uint32_t)(rest % rate);
+        return (index / rate) * 1000000ULL + rest / rate;
+    }
+
+    uint64_t timestampAt(uint64_t index) const {
+        if (rates) return rates->timestampAt(index);
+        uint32_t remainder;
+        return baseTime + offsetOf(index, rate, remainder);
+    }
+};
+
+// Copy n (<= 32) bits starting at bit position `bit` of an LSB-first bit array
+inline uint32_t readPackedBits(const uint32_t* words, uint32_t bit, uint32_t n) {
+    uint32_t shift = bit & 31;
+    uint64_t value = words[bit >> 5] >> shift;
+    if (shift + n > 32) {
+        value |= (uint64_t)words[(bit >> 5) + 1] << (32 - shift);
+    }
+    return n == 32 ? (uint32_t)value : (uint32_t)value & ((1u << n) - 1);
+}
+
+// One-bit-per-sample-per-channel capture storage.
+//
+// Levels are packed LSB first into 32-bit words and timestamps are derived
+// from the timebase, so a sample costs one bit instead of an 8-byte
+// {timestamp, level} record. A single writer appends; readers on other tasks
+// only look below the count, which is published with release after the bits
+// are in place. The words live in memory owned by the caller so the same RAM
+// can back another capture encoding.
+//
+// The store is a ring: samples can be dropped from the front (consume/trimTo)
+// without moving the rest, and in wrap mode new samples overwrite the oldest
+// ones. That is what keeps a pre-trigger window while a trigger is armed.
+//
+// Multi-channel captures keep one bit plane per channel: the memory is split
+// into `channels` equal planes and sample i of channel c is bit i of plane c.
+// Levels are handed out as a byte with bit c = channel c.
+class PackedSampleStore {
+private:
+    uint32_t* words;
+    uint32_t totalBits;   // Attached memory, in bits
+    uint32_t capacity;    // Samples per plane (bits), multiple of 32
+    uint32_t planeWords;  // Stride between planes
+    uint8_t channels;
+    uint32_t head;      // Physical bit of logical sample 0
+    std::atomic<uint32_t> count;
+    bool wrap;          // Overwrite the oldest samples instead of filling up
+    SampleTimebase timebase;
+
+    void advanceHead(uint32_t n) {
+        head = (uint32_t)(((uint64_t)head + n) % capacity);
+        timebase.firstIndex += n;
+    }
+
+public:
+    // Walks stored samples in order, stepping the timestamp with an integer
+    // remainder instead of dividing for every sample.
+    class Iterator {
+    private:
+        const uint32_t* words;
+        uint32_t capacity;
+        uint32_t planeWords;
+        uint8_t channels;
+        uint32_t index;     // Logical
+        uint32_t physical;
+        uint32_t end;
+        uint64_t timestamp;
+        uint32_t periodWhole;
+        uint32_t periodFrac;
+        uint32_t phase;
+        uint32_t rate;
+        uint64_t firstIndex;
+        const RateMap* rates;
+
+    public:
+        Iterator(const uint32_t* words, uint32_t capacity, uint32_t planeWords, uint8_t channels,
+                 uint32_t head, const SampleTimebase& tb, uint32_t first, uint32_t end)
+            : words(words), capacity(capacity), planeWords(planeWords), channels(channels),
+              index(first), end(end) {
+            physical = capacity ? (uint32_t)(((uint64_t)head + first) % capacity) : 0;
+            rate = tb.rate ? tb.rate : 1;
+            firstIndex = tb.firstIndex;
+            rates = tb.rates;
+            timestamp = tb.baseTime + SampleTimebase::offsetOf(tb.firstIndex + first, rate, phase);
+            periodWhole = 1000000 / rate;
+            periodFrac = 1000000 % rate;
+        }
+
+        bool next(uint64_t& sampleTimestamp, uint8_t& levels) {
+            if (index >= end) return false;
+            sampleTimestamp = rates ? rates->timestampAt(firstIndex + index) : timestamp;
+            const uint32_t* word = words + (physical >> 5);
+            levels = (*word >> (physical & 31)) & 1;
+            for (uint8_t c = 1; c < channels; c++) {
+                word += planeWords;
+                levels |= ((*word >> (physical & 31)) & 1) << c;
+            }
+
+            index++;
+            if (++physical == capacity) physical = 0;
+            timestamp += periodWhole;
+            phase += periodFrac;
+            if (phase >= rate) {
+                phase -= rate;
+                timestamp++;
+            }
+            return true;
+        }
+
+        uint32_t position() const { return index; }
+    };
+
+    // Frozen view of the store, e.g. a finished capture segment whose memory
+    // is no longer written. Valid as long as the memory is not reused.
+    struct Snapshot {
+        const uint32_t* words;
+        uint32_t capacity;
+        uint32_t planeWords;
+        uint8_t channels;
+        uint32_t head;
+        uint32_t count;
+        SampleTimebase timebase;
+
+        Iterator iterate() const {
+            return Iterator(words, capacity, planeWords, channels, head, timebase, 0, count);
+        }
+        uint64_t timestampAt(uint32_t index) const {
+            return timebase.timestampAt(timebase.firstIndex + index);
+        }
+    };
+
+    PackedSampleStore()
+        : words(nullptr), totalBits(0), capacity(0), planeWords(0), channels(1), head(0), count(0), wrap(false) {
+        timebase = SampleTimebase();
+    }
+
+    void attach(uint32_t* storage, uint32_t capacityBits) {
+        words = storage;
+        totalBits = capacityBits;
+        setChannels(1);
+    }
+
+    // Split the memory into one plane per channel; empties the store
+    void setChannels(uint8_t n) {
+        channels = n ? n : 1;
+        capacity = (totalBits / channels) & ~31u;
+        planeWords = capacity >> 5;
+        reset();
+    }
+
+    uint8_t getChannels() const { return channels; }
+
+    // Empty the store and forget the timeline
+    void reset() {
+        count.store(0, std::memory_order_release);
+        head = 0;
+        wrap = false;
+        timebase = SampleTimebase();
+    }
+
+    // Drop the n oldest samples; the timeline moves on with them
+    void consume(uint32_t n) {
+        uint32_t stored = count.load(std::memory_order_relaxed);
+        if (n > stored) n = stored;
+        count.store(stored - n, std::memory_order_release);
+        advanceHead(n);
+    }
+
+    // Keep at most the newest `keep` samples
+    void trimTo(uint32_t keep) {
+        uint32_t stored = count.load(std::memory_order_relaxed);
+        if (stored > keep) consume(stored - keep);
+    }
+
+    void setWrap(bool enable) { wrap = enable; }
+    bool isWrapping() const { return wrap; }
+
+    void setTimebase(const SampleTimebase& tb) { timebase = tb; }
+    const SampleTimebase& getTimebase() const { return timebase; }
+    bool hasTimebase() const { return timebase.rate != 0; }
+
+    // Append n samples starting at bit `first` of each source plane; plane c
+    // starts `planeStride` words after bits. Bits are copied a word at a
+    // time. Returns how many were stored; in wrap mode that is always n,
+    // otherwise it stops when the store is full.
+    uint32_t append(const uint32_t* bits, uint32_t planeStride, uint32_t first, uint32_t n) {
+        uint32_t stored = count.load(std::memory_order_relaxed);
+        uint32_t taken = n;
+
+        if (wrap) {
+            if (n > capacity) {
+                // Only the newest capacity bits can survive
+                advanceHead(stored + (n - capacity));
+                first += n - capacity;
+                stored = 0;
+                n = capacity;
+            }
+            if (stored + n > capacity) {
+                uint32_t drop = stored + n - capacity;
+                advanceHead(drop);
+                stored -= drop;
+            }
+        } else if (n > capacity - stored) {
+            n = taken = capacity - stored;
+        }
+
+        uint32_t start = (uint32_t)(((uint64_t)head + stored) % capacity);
+        for (uint8_t c = 0; c < channels; c++) {
+            const uint32_t* source = bits + c * planeStride;
+            uint32_t* plane = words + c * planeWords;
+            uint32_t pos = start;
+            for (uint32_t i = 0; i < n; ) {
+                uint32_t shift = pos & 31;
+                uint32_t take = 32 - shift;
+                if (take > n - i) take = n - i;
+                uint32_t value = readPackedBits(source, first + i, take);
+                // Merge, since the bits above may still hold the oldest samples of the ring
+                uint32_t mask = (take == 32 ? 0xFFFFFFFF : ((1u << take) - 1)) << shift;
+                uint32_t& word = plane[pos >> 5];
+                word = (word & ~mask) | (value << shift);
+                pos += take;
+                if (pos == capacity) pos = 0;  // capacity is word aligned
+                i += take;
+            }
+        }
+
+        count.store(stored + n, std::memory_order_release);
+        return taken;
+    }
+
+    // Single-channel convenience
+    uint32_t append(const uint32_t* bits, uint32_t n) {
+        return append(bits, 0, 0, n);
+    }
+
+    uint32_t size() const { return count.load(std::memory_order_acquire); }
+    bool empty() const { return size() == 0; }
+    bool full() const { return !wrap && size() >= capacity; }
+    uint32_t getCapacity() const { return capacity; }
+    uint32_t getFreeSpace() const { return capacity - size(); }
+
+    uint8_t levelsAt(uint32_t index) const {
+        uint32_t physical = (uint32_t)(((uint64_t)head + index) % capacity);
+        uint8_t levels = 0;
+        for (uint8_t c = 0; c < channels; c++) {
+            levels |= ((words[c * planeWords + (physical >> 5)] >> (physical & 31)) & 1) << c;
+        }
+        return levels;
+    }
+
+    uint64_t timestampAt(uint32_t index) const {
+        return timebase.timestampAt(timebase.firstIndex + index);
+    }
+
+    Snapshot snapshot() const {
+        return {words, capacity, planeWords, channels, head, size(), timebase};
+    }
+
+    // Samples [first, first + n), clamped to what is stored right now
+    Iterator iterate(uint32_t first = 0, uint32_t n = 0xFFFFFFFF) const {
+        uint32_t stored = size();
+        if (first > stored) first = stored;
+        uint32_t end = (n > stored - first) ? stored : first + n;
+        return Iterator(words, capacity, planeWords, channels, head, timebase, first, end);
+    }
+};
+
+#endif // PACKED_SAMPLE_STORE_H
@@ -0,0 +1,34 @@
+#ifndef PARTITION_FLASH_H
+#define PARTITION_FLASH_H
+
+#include <Arduino.h>
+#include <esp_partition.h>
+#include "nor_flash.h"
+
+#define RAW_LOG_PARTITION_LABEL "logdata"  // Data partition for the raw capture log
+
+// Data partition of the ESP32's own flash, written through esp_partition.
+//
+// No file system sits in between: a write is one SPI program operation and
+// an erase one sector or block erase, so timing depends only on the flash
+// chip. The partition is found by label; it has to be in the partition
+// table (see partitions_atoms3_rawlog.csv) and must not overlap LittleFS.
+class PartitionFlash : public NorFlash {
+private:
+    const esp_partition_t* partition;
+
+public:
+    PartitionFlash();
+
+    bool begin(const char* label = RAW_LOG_PARTITION_LABEL);
+    bool isAvailable() const { return partition != nullptr; }
+    uint32_t getAddress() const;
+
+    uint32_t size() const override;
+    uint32_t eraseBytes() const override;
+    bool erase(uint32_t offset, uint32_t length) override;
+    bool write(uint32_t offset, const void* data, uint32_t length) override;
+    bool read(uint32_t offset, void* data, uint32_t length) override;
+};
+
+#endif // PARTITION_FLASH_H
@@ -0,0 +1,61 @@
+#ifndef PULSE_COUNTER_H
+#define PULSE_COUNTER_H
+
+#include <Arduino.h>
+#include <driver/pcnt.h>
+#include "counter_series.h"
+
+#define COUNTER_PCNT_UNIT PCNT_UNIT_0
+#define COUNTER_PCNT_LIMIT 30000      // Counter wraps here into the overflow total
+#define COUNTER_TIMED_EDGES 2000      // Edges per interval timed by the interrupt
+
+// PCNT frequency / duty counter.
+//
+// The pulse counter counts both edges in hardware at any rate the pin can
+// follow, so edge counts and frequency are exact and cost nothing per edge.
+// PCNT cannot time anything, so a CHANGE interrupt timestamps the first
+// COUNTER_TIMED_EDGES edges of each interval with the cycle counter, then
+// masks itself until the next interval. High time is the duty over that
+// timed window applied to the whole interval; min/max period are the
+// extremes within it. Below COUNTER_TIMED_EDGES edges per interval both
+// cover every edge.
+class PulseCounter {
+private:
+    uint8_t pin;
+    bool running;
+    volatile uint32_t overflows;  // Counter wraps at COUNTER_PCNT_LIMIT
+
+    // Interrupt timing state, shared with sample() under the spinlock
+    portMUX_TYPE lock;
+    uint32_t timedEdges;
+    uint32_t lastEdge;            // CCOUNT of the last timed edge
+    uint32_t lastRise;
+    bool haveEdge;
+    bool haveRise;
+    uint8_t level;                // Level after lastEdge
+    uint64_t highCycles;          // Time high within the timed window
+    uint64_t timedCycles;         // Length of the timed window
+    uint32_t minPeriod;           // Cycles
+    uint32_t maxPeriod;
+    uint32_t lastSampleTime;      // micros() of the previous sample()
+    uint64_t lastTotal;           // Edge total at the previous sample()
+
+    static void IRAM_ATTR onLimit(void* context);
+    static void IRAM_ATTR onEdge(void* context);
+    uint64_t readTotal();         // Edges since begin()
+
+public:
+    PulseCounter();
+    ~PulseCounter();
+
+    bool begin(uint8_t inputPin);
+    void end();
+
+    // Aggregate of everything since the previous call (or begin()); restarts timing
+    CounterInterval sample();
+
+    bool isRunning() const { return running; }
+    uint8_t getPin() const { return pin; }
+};
+
+#endif // PULSE_COUNTER_H
@@ -0,0 +1,73 @@
+#ifndef RATE_MAP_H
+#define RATE_MAP_H
+
+#include <stdint.h>
+#include <atomic>
+
+// Rate-change markers of an adaptive-rate capture.
+//
+// Sample indices stay contiguous across a rate change; each marker records
+// the capture index where a new rate starts and the time of that sample, so
+//   time(n) = marker.time + floor((n - marker.index) * 1000000 / marker.rate)
+// for the last marker at or before n. Marker times come from the cycle
+// counter at the switch, so rounding never carries from one stretch into
+// the next. The producer appends markers before any sample they cover is
+// published; readers only look below the count, published with release.
+
+#define RATE_MAP_MAX_MARKERS 512  // Rate changes kept per capture
+
+struct RateMarker {
+    uint64_t index;  // Capture index of the first sample at this rate
+    uint64_t time;   // Monotonic microseconds of that sample
+    uint32_t rate;   // Samples per second from here on
+};
+
+class RateMap {
+private:
+    RateMarker markers[RATE_MAP_MAX_MARKERS];
+    std::atomic<uint32_t> count;
+
+public:
+    RateMap() : count(0) {}
+
+    // First stretch of a capture
+    void begin(uint64_t time, uint32_t rate) {
+        markers[0] = {0, time, rate ? rate : 1};
+        count.store(1, std::memory_order_release);
+    }
+
+    void clear() { count.store(0, std::memory_order_release); }
+
+    // false once the map is full; the caller then keeps its current rate
+    bool add(uint64_t index, uint64_t time, uint32_t rate) {
+        uint32_t n = count.load(std::memory_order_relaxed);
+        if (n >= RATE_MAP_MAX_MARKERS) return false;
+        markers[n] = {index, time, rate ? rate : 1};
+        count.store(n + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool full() const { return size() >= RATE_MAP_MAX_MARKERS; }
+    uint32_t size() const { return count.load(std::memory_order_acquire); }
+    const RateMarker& at(uint32_t i) const { return markers[i]; }
+
+    // Last marker at or before the capture index (the first one if none is)
+    const RateMarker& markerFor(uint64_t index) const {
+        uint32_t lo = 0;
+        uint32_t hi = size();
+        while (hi - lo > 1) {
+            uint32_t mid = lo + (hi - lo) / 2;
+            if (markers[mid].index <= index) lo = mid; else hi = mid;
+        }
+        return markers[lo];
+    }
+
+    uint64_t timestampAt(uint64_t index) const {
+        const RateMarker& m = markerFor(index);
+        uint64_t n = index > m.index ? index - m.index : 0;
+        // Split so n * 1000000 cannot overflow on multi-hour runs
+        return m.time + (n / m.rate) * 1000000ULL + (n % m.rate) * 1000000ULL / m.rate;
+    }
+};
+
+#endif // RATE_MAP_H
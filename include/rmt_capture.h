@@ -0,0 +1,56 @@
+#ifndef RMT_CAPTURE_H
+#define RMT_CAPTURE_H
+
+#include <Arduino.h>
+#include <driver/rmt.h>
+#include "rmt_symbols.h"
+
+#define RMT_RX_MEM_BLOCKS 4         // 48-symbol (S3) / 64-symbol blocks given to the receiver
+#define RMT_RX_RING_BYTES 16384     // Driver ring buffer holding finished frames
+
+// RMT receiver capture.
+//
+// The receiver times every level in hardware (12.5 ns at divider 1) and
+// writes duration symbols, so a capture costs nothing per sample and only
+// a little per frame. A frame closes once the input has been idle for the
+// idle threshold; its symbols land in the driver's ring buffer and are
+// placed on the capture timeline by RmtTimeline.
+//
+// Durations inside a frame are exact. Gaps between frames are not timed
+// by the receiver, so each frame is anchored by the cycle count at which
+// it was received, minus its own length and the idle threshold; the error
+// is the interrupt and task latency, a few microseconds.
+//
+// One pin only: a receiver channel watches a single input.
+class RmtCapture {
+private:
+    rmt_channel_t channel;
+    RingbufHandle_t rxRing;
+    bool installed;
+    uint32_t resolutionHz;
+    uint16_t idleTicks;
+    uint32_t frames;
+    uint32_t symbols;
+
+public:
+    RmtCapture();
+    ~RmtCapture();
+
+    // idleUs sets the clock divider (the 15-bit idle threshold must cover
+    // it); filterNs drops pulses shorter than that, up to ~3.2 us
+    bool begin(uint8_t pin, uint32_t idleUs, uint32_t filterNs);
+    void end();
+
+    // Next finished frame, waiting up to `wait`; release() it when done
+    bool receive(const uint32_t*& frame, size_t& count, TickType_t wait);
+    void release(const uint32_t* frame);
+
+    bool isActive() const { return installed; }
+    uint32_t getResolution() const { return resolutionHz; }
+    uint16_t getIdleTicks() const { return idleTicks; }
+    uint32_t getFrameCount() const { return frames; }
+    uint32_t getSymbolCount() const { return symbols; }
+    const char* getName() const { return "RMT receiver"; }
+};
+
+#endif // RMT_CAPTURE_H
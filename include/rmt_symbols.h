@@ -0,0 +1,142 @@
+#ifndef RMT_SYMBOLS_H
+#define RMT_SYMBOLS_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// RMT receive symbols -> capture timeline.
+//
+// The RMT receiver measures how long the input stays at each level and
+// writes the durations as 32-bit symbols, two levels per symbol:
+//   bits  0..14 duration0, bit 15 level0, bits 16..30 duration1, bit 31 level1
+// (rmt_item32_t / rmt_symbol_word_t). A zero duration marks the end of a
+// frame, which the receiver closes once the input has been idle for its
+// idle threshold. This header is plain C++ so recorded symbol dumps can be
+// replayed on a host and the converted runs checked.
+
+#define RMT_SOURCE_CLOCK_HZ 80000000  // APB clock the receiver counts in
+#define RMT_MAX_DURATION 32767        // 15-bit duration and idle threshold
+#define RMT_MAX_FILTER_TICKS 255      // 8-bit glitch filter, in APB cycles
+#define RMT_MAX_CLOCK_DIVIDER 255
+
+inline uint32_t rmtDuration0(uint32_t symbol) { return symbol & 0x7FFF; }
+inline uint8_t rmtLevel0(uint32_t symbol) { return (symbol >> 15) & 1; }
+inline uint32_t rmtDuration1(uint32_t symbol) { return (symbol >> 16) & 0x7FFF; }
+inline uint8_t rmtLevel1(uint32_t symbol) { return symbol >> 31; }
+
+inline uint32_t makeRmtSymbol(uint8_t level0, uint32_t duration0, uint8_t level1, uint32_t duration1) {
+    return (duration0 & 0x7FFF) | ((uint32_t)(level0 & 1) << 15) |
+           ((duration1 & 0x7FFF) << 16) | ((uint32_t)(level1 & 1) << 31);
+}
+
+// Smallest divider whose 15-bit tick count still covers the idle threshold;
+// the resolution is RMT_SOURCE_CLOCK_HZ / divider (12.5 ns at 1)
+inline uint8_t rmtClockDivider(uint32_t idleUs) {
+    uint64_t ticks = (uint64_t)idleUs * (RMT_SOURCE_CLOCK_HZ / 1000000);
+    uint64_t divider = (ticks + RMT_MAX_DURATION - 1) / RMT_MAX_DURATION;
+    if (divider < 1) divider = 1;
+    if (divider > RMT_MAX_CLOCK_DIVIDER) divider = RMT_MAX_CLOCK_DIVIDER;
+    return (uint8_t)divider;
+}
+
+// Glitch filter threshold in APB cycles; pulses shorter than this are dropped
+inline uint8_t rmtFilterTicks(uint32_t filterNs) {
+    uint32_t ticks = (uint32_t)((uint64_t)filterNs * (RMT_SOURCE_CLOCK_HZ / 1000000) / 1000);
+    return ticks > RMT_MAX_FILTER_TICKS ? RMT_MAX_FILTER_TICKS : (uint8_t)ticks;
+}
+
+// Ticks covered by one frame's symbols, up to its end marker
+inline uint64_t rmtFrameTicks(const uint32_t* symbols, size_t count) {
+    uint64_t ticks = 0;
+    for (size_t i = 0; i < count; i++) {
+        uint32_t d0 = rmtDuration0(symbols[i]);
+        if (d0 == 0) break;
+        ticks += d0;
+        uint32_t d1 = rmtDuration1(symbols[i]);
+        if (d1 == 0) break;
+        ticks += d1;
+    }
+    return ticks;
+}
+
+// Places frames on the fixed-rate slot grid of the capture. Durations are
+// summed in ticks and only converted at run ends, so rounding never
+// accumulates across a frame. A level shorter than one sample period can
+// fall between two slots and vanish, exactly as it would when sampled.
+//
+// The sink is called as sink(level, slots) for each run of whole slots and
+// returns false to stop.
+class RmtTimeline {
+private:
+    uint32_t resolutionHz;  // RMT ticks per second
+    uint32_t rate;          // Capture slots per second
+    uint64_t ticks;         // Position on the timeline
+    uint64_t slot;          // Slots already handed to the sink
+    uint8_t level;          // Level at the current position
+
+    uint64_t slotAt(uint64_t tick) const {
+        // Split so tick * rate cannot overflow on multi-hour runs
+        return (tick / resolutionHz) * rate + ((tick % resolutionHz) * rate) / resolutionHz;
+    }
+
+    template <typename Sink>
+    bool advance(uint8_t runLevel, uint64_t duration, Sink& sink) {
+        ticks += duration;
+        level = runLevel;
+        uint64_t end = slotAt(ticks);
+        if (end == slot) return true;
+        uint64_t slots = end - slot;
+        slot = end;
+        return sink(runLevel, slots);
+    }
+
+public:
+    RmtTimeline() : resolutionHz(1), rate(1), ticks(0), slot(0), level(0) {}
+
+    void begin(uint32_t tickHz, uint32_t sampleRate, uint8_t initialLevel) {
+        resolutionHz = tickHz ? tickHz : 1;
+        rate = sampleRate ? sampleRate : 1;
+        ticks = 0;
+        slot = 0;
+        level = initialLevel & 1;
+    }
+
+    // Hold the current level up to the given tick (e.g. the start of the
+    // next frame); positions already passed are ignored
+    template <typename Sink>
+    bool holdUntil(uint64_t tick, Sink sink) {
+        if (tick <= ticks) return true;
+        return advance(level, tick - ticks, sink);
+    }
+
+    // One received frame. The end marker carries the idle level, which the
+    // line held for idleTicks before the receiver closed the frame.
+    template <typename Sink>
+    bool feedFrame(const uint32_t* symbols, size_t count, uint32_t idleTicks, Sink sink) {
+        uint8_t idleLevel = level;
+        for (size_t i = 0; i < count; i++) {
+            uint32_t d0 = rmtDuration0(symbols[i]);
+            if (d0 == 0) {
+                idleLevel = rmtLevel0(symbols[i]);
+                break;
+            }
+            if (!advance(rmtLevel0(symbols[i]), d0, sink)) return false;
+            idleLevel = level;
+            uint32_t d1 = rmtDuration1(symbols[i]);
+            if (d1 == 0) {
+                idleLevel = rmtLevel1(symbols[i]);
+                break;
+            }
+            if (!advance(rmtLevel1(symbols[i]), d1, sink)) return false;
+            idleLevel = level;
+        }
+        return advance(idleLevel, idleTicks, sink);
+    }
+
+    uint64_t getTicks() const { return ticks; }
+    uint64_t getSlots() const { return slot; }
+    uint8_t getLevel() const { return level; }
+    uint32_t getResolution() const { return resolutionHz; }
+};
+
+#endif // RMT_SYMBOLS_H
@@ -0,0 +1,177 @@
+#ifndef SAMPLER_H
+#define SAMPLER_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <atomic>
+
+// Hardware-paced sampling interface.
+//
+// A Sampler fills fixed-size blocks at the configured rate without any CPU
+// work per sample and hands finished blocks to a single consumer in order.
+// This header is plain C++ so the same block hand-off logic runs on the
+// ESP32-S3 (DmaSampler) and on a Linux host (SimulatedSampler).
+
+#define CAM_SOURCE_CLOCK_HZ 160000000  // LCD_CAM clock source (PLL_F160M)
+#define CAM_MAX_DIVIDER 256            // cam_clkm_div_num range is 2..256
+#define CAM_MIN_DIVIDER 2
+#define CAM_MAX_FRACTION 63            // cam_clkm_div_a/b are 6-bit fields
+#define DMA_BLOCK_SIZE 4092            // Samples per block (one GDMA descriptor, max 4095)
+#define DMA_BLOCK_COUNT 12             // Blocks in the circular DMA ring (~48KB)
+
+// One finished block. One byte per sample, laid out exactly as the LCD_CAM
+// parallel input writes it: bit c is capture channel c.
+struct SampleBlock {
+    const uint8_t* data;   // Sample bytes (bit c = level of channel c)
+    uint32_t count;        // Number of samples in the block
+    uint64_t firstIndex;   // Absolute index of data[0] since start()
+};
+
+// Clock divider as programmed into cam_clkm_div_num/a/b:
+// f = source / (integer + numerator / denominator)
+struct ClockDivider {
+    uint16_t integer;
+    uint8_t numerator;
+    uint8_t denominator;
+};
+
+// Pick the divider closest to targetHz and return the rate it really produces.
+inline uint32_t computeClockDivider(uint32_t sourceHz, uint32_t targetHz, ClockDivider& div) {
+    if (targetHz == 0) targetHz = 1;
+
+    uint32_t integer = sourceHz / targetHz;
+    uint32_t remainder = sourceHz % targetHz;
+    if (integer < CAM_MIN_DIVIDER) {
+        integer = CAM_MIN_DIVIDER;
+        remainder = 0;
+    }
+    if (integer >= CAM_MAX_DIVIDER) {
+        integer = CAM_MAX_DIVIDER;
+        remainder = 0;
+    }
+
+    // Best fraction b/a for remainder/targetHz with a, b <= 63
+    uint32_t bestA = 1, bestB = 0;
+    uint64_t bestErr = remainder;  // |remainder * a - b * target| / a with a = 1, b = 0
+    for (uint32_t a = 1; a <= CAM_MAX_FRACTION && remainder != 0; a++) {
+        uint32_t b = (uint32_t)(((uint64_t)remainder * a + targetHz / 2) / targetHz);
+        int64_t diff = (int64_t)remainder * a - (int64_t)b * targetHz;
+        uint64_t err = diff < 0 ? -diff : diff;
+        // Compare err / a against bestErr / bestA without dividing
+        if (err * bestA < bestErr * a) {
+            bestErr = err;
+            bestA = a;
+            bestB = b;
+        }
+    }
+    if (bestB >= bestA) {
+        integer++;
+        bestB = 0;
+    }
+    if (integer > CAM_MAX_DIVIDER) integer = CAM_MAX_DIVIDER;
+
+    div.integer = integer;
+    div.numerator = bestB;
+    div.denominator = bestB ? bestA : 0;
+
+    return (uint32_t)(((uint64_t)sourceHz * bestA) / ((uint64_t)integer * bestA + bestB));
+}
+
+inline uint32_t getMinHardwareSampleRate() {
+    return CAM_SOURCE_CLOCK_HZ / CAM_MAX_DIVIDER;
+}
+
+// In-order hand-off of a ring of blocks from one producer (DMA EOF ISR) to
+// one consumer. The hardware never waits for the consumer, so a block that
+// is overwritten before it is released is counted as an overrun and skipped.
+class BlockRing {
+private:
+    std::atomic<uint32_t> completed;  // Blocks finished by the producer
+    uint32_t consumed;                // Blocks handed to the consumer
+    uint32_t slots;
+    uint32_t overruns;
+
+public:
+    BlockRing() : completed(0), consumed(0), slots(2), overruns(0) {}
+
+    void reset(uint32_t slotCount) {
+        slots = slotCount < 2 ? 2 : slotCount;
+        consumed = 0;
+        overruns = 0;
+        completed.store(0, std::memory_order_release);
+    }
+
+    // Producer side, safe to call from an ISR (single writer, no RMW needed)
+    void publish() {
+        completed.store(completed.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+
+    uint32_t getCompleted() const {
+        return completed.load(std::memory_order_acquire);
+    }
+
+    // Consumer side. The producer is always filling slot (completed % slots),
+    // so at most slots - 1 finished blocks can still be intact.
+    bool acquire(uint32_t& slot, uint64_t& sequence) {
+        uint32_t done = completed.load(std::memory_order_acquire);
+        uint32_t pending = done - consumed;
+        if (pending == 0) return false;
+        if (pending > slots - 1) {
+            overruns += pending - (slots - 1);
+            consumed = done - (slots - 1);
+        }
+        slot = consumed % slots;
+        sequence = consumed;
+        return true;
+    }
+
+    // Returns false if the producer lapped the block while it was being read
+    bool release() {
+        uint32_t done = completed.load(std::memory_order_acquire);
+        bool intact = (done - consumed) <= slots - 1;
+        if (!intact) overruns++;
+        consumed++;
+        return intact;
+    }
+
+    uint32_t getOverruns() const { return overruns; }
+};
+
+// Called by the producer each time a block is finished. On hardware this runs
+// in the DMA ISR; return true if it woke a higher-priority task.
+typedef bool (*BlockReadyCallback)(void* context);
+
+// Capture backend that fills sample blocks at a fixed rate
+class Sampler {
+protected:
+    BlockReadyCallback blockReady;
+    void* blockReadyContext;
+
+    bool notifyBlockReady() {
+        return blockReady ? blockReady(blockReadyContext) : false;
+    }
+
+public:
+    Sampler() : blockReady(nullptr), blockReadyContext(nullptr) {}
+    virtual ~Sampler() {}
+
+    void setBlockReadyCallback(BlockReadyCallback callback, void* context) {
+        blockReady = callback;
+        blockReadyContext = context;
+    }
+
+    // Channel c of every sample comes from pins[c]; false if rate/pins unsupported
+    virtual bool begin(uint32_t sampleRate, const uint8_t* pins, uint8_t count) = 0;
+    virtual void end() = 0;
+    virtual bool start() = 0;
+    virtual void stop() = 0;
+
+    virtual bool acquireBlock(SampleBlock& block) = 0;  // Oldest finished block, non-blocking
+    virtual bool releaseBlock() = 0;                    // false if the block was overwritten
+
+    virtual uint32_t getActualSampleRate() const = 0;   // Rate after divider rounding
+    virtual uint32_t getOverrunCount() const = 0;       // Blocks lost to a late consumer
+    virtual const char* getName() const = 0;
+};
+
+#endif // SAMPLER_H
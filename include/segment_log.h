@@ -0,0 +1,364 @@
+#ifndef SEGMENT_LOG_H
+#define SEGMENT_LOG_H
+
+#include <stdint.h>
+#include <string.h>
+#include <atomic>
+#include "nor_flash.h"
+#include "flash_format.h"
+
+// Log-structured ring of fixed-size slots on raw NOR flash.
+//
+// The region is cut into erase-aligned segments. Slot 0 of a segment holds
+// a SegmentHeader plus the caller's metadata (the capture header), so any
+// segment that survives on its own can still be decoded; the other slots
+// hold data. A log is only ever appended to: the head segment fills slot by
+// slot, then the next segment in the ring is opened. Erases are kept off
+// that path: service(), called while the writer has nothing queued, erases
+// up to eraseAhead segments in front of the head, so an append normally
+// costs one program operation. An append that finds its segment not yet
+// erased erases it inline and counts that.
+//
+// A full ring either refuses further appends or, in wrap mode, gives up its
+// oldest segment. In wrap mode pre-erasing also consumes the oldest
+// segments, so the data kept is the ring less the erased-ahead segments.
+//
+// Each log has an epoch. mount() finds the newest epoch on flash after a
+// reset, so the last log can be read back and the next one starts after
+// it, which spreads erases over the whole region. A data slot must not
+// start with an erased word, which is how mount() finds the end of the
+// log. The single writer publishes the slot count with release; readers
+// only look below it.
+
+#define SEGMENT_MAGIC 0x4D474553      // "SEGM"
+#define SEGMENT_META_MAX 64           // Metadata bytes copied into every segment header
+#define SEGMENT_ERASED_WORD 0xFFFFFFFF
+
+struct SegmentHeader {
+    uint32_t magic;        // SEGMENT_MAGIC
+    uint32_t epoch;        // Log the segment belongs to
+    uint32_t sequence;     // Segment number within the log
+    uint32_t firstSlot;    // Log slot number of the segment's first data slot
+    uint32_t slotBytes;
+    uint32_t metaBytes;    // Metadata following the header
+    uint32_t reserved;
+    uint32_t crc32;        // Of the header above and the metadata
+};
+
+class SegmentLog {
+private:
+    NorFlash* flash;
+    uint32_t segmentBytes;
+    uint32_t slotBytes;
+    uint32_t segments;
+    uint32_t slotsPerSegment;   // Data slots, slot 0 is the header
+    uint8_t eraseAhead;
+
+    uint8_t meta[SEGMENT_META_MAX];
+    uint32_t metaBytes;
+    uint32_t epoch;
+    bool active;                // Accepting appends
+    bool wrap;
+    bool full;
+
+    uint32_t tailSegment;       // Physical segment of the oldest kept data
+    uint32_t headSegment;       // Physical segment being filled
+    uint32_t headSequence;
+    uint32_t headSlot;          // Next data slot in the head segment
+    uint32_t erasedAhead;       // Segments after the head known to be erased
+    uint32_t nextSegment;       // Where the next log starts
+    std::atomic<uint32_t> firstSlot;  // Log slot number of the oldest kept slot
+    std::atomic<uint32_t> slotCount;  // Slots kept
+
+    // Counters
+    uint32_t inlineErases;
+    uint32_t aheadErases;
+    uint32_t droppedSegments;
+    uint32_t writeErrors;
+
+    uint32_t segmentOffset(uint32_t segment) const { return segment * segmentBytes; }
+    uint32_t following(uint32_t segment) const { return (segment + 1) % segments; }
+    uint32_t liveSegments() const { return (headSegment + segments - tailSegment) % segments + 1; }
+
+    bool readHeader(uint32_t segment, SegmentHeader& header, uint8_t* metaOut) {
+        if (!flash->read(segmentOffset(segment), &header, sizeof(header))) return false;
+        if (header.magic != SEGMENT_MAGIC || header.slotBytes != slotBytes || header.metaBytes > SEGMENT_META_MAX) {
+            return false;
+        }
+        uint8_t buffer[SEGMENT_META_MAX];
+        uint8_t* m = metaOut ? metaOut : buffer;
+        if (!flash->read(segmentOffset(segment) + sizeof(header), m, header.metaBytes)) return false;
+        uint32_t crc = flashCrc32(&header, sizeof(header) - sizeof(header.crc32));
+        return flashCrc32(m, header.metaBytes, crc) == header.crc32;
+    }
+
+    bool writeHeader(uint32_t segment, uint32_t sequence, uint32_t first) {
+        SegmentHeader header = {SEGMENT_MAGIC, epoch, sequence, first, slotBytes, metaBytes, 0, 0};
+        uint32_t crc = flashCrc32(&header, sizeof(header) - sizeof(header.crc32));
+        header.crc32 = flashCrc32(meta, metaBytes, crc);
+        return flash->write(segmentOffset(segment), &header, sizeof(header)) &&
+               flash->write(segmentOffset(segment) + sizeof(header), meta, metaBytes);
+    }
+
+    // The oldest segment leaves the log (wrap mode)
+    void dropTail() {
+        tailSegment = following(tailSegment);
+        firstSlot.store(firstSlot.load(std::memory_order_relaxed) + slotsPerSegment, std::memory_order_release);
+        slotCount.store(slotCount.load(std::memory_order_relaxed) - slotsPerSegment, std::memory_order_release);
+        droppedSegments++;
+    }
+
+    // Make `segment` writable: pre-erased, or erased now
+    bool prepare(uint32_t segment) {
+        if (erasedAhead > 0) {
+            erasedAhead--;
+            return true;
+        }
+        inlineErases++;
+        return flash->erase(segmentOffset(segment), segmentBytes);
+    }
+
+public:
+    SegmentLog()
+        : flash(nullptr), segmentBytes(0), slotBytes(0), segments(0), slotsPerSegment(0), eraseAhead(0), metaBytes(0),
+          epoch(0), active(false), wrap(false), full(false), tailSegment(0), headSegment(0), headSequence(0),
+          headSlot(0), erasedAhead(0), nextSegment(0), firstSlot(0), slotCount(0), inlineErases(0), aheadErases(0),
+          droppedSegments(0), writeErrors(0) {}
+
+    // segmentBytes must be a multiple of the erase size and of slotBytes,
+    // and slot 0 must fit the header and the metadata
+    bool begin(NorFlash* nor, uint32_t segmentSize, uint32_t slotSize, uint8_t eraseSegmentsAhead) {
+        flash = nor;
+        segmentBytes = segmentSize;
+        slotBytes = slotSize;
+        eraseAhead = eraseSegmentsAhead;
+        active = false;
+        if (!flash || !segmentBytes || !slotBytes || segmentBytes % flash->eraseBytes() || segmentBytes % slotBytes ||
+            slotBytes < sizeof(SegmentHeader) + SEGMENT_META_MAX) {
+            segments = 0;
+            return false;
+        }
+        segments = flash->size() / segmentBytes;
+        slotsPerSegment = segmentBytes / slotBytes - 1;
+        if (segments < 2 || slotsPerSegment == 0) {
+            segments = 0;
+            return false;
+        }
+        return true;
+    }
+
+    bool isReady() const { return segments != 0; }
+
+    // Finds the newest log on flash; returns its slot count (0 if none).
+    // The log can then be read; the next start() opens a new one after it.
+    uint32_t mount() {
+        active = false;
+        erasedAhead = 0;  // Unknown after a reset
+        firstSlot.store(0, std::memory_order_release);
+        slotCount.store(0, std::memory_order_release);
+        nextSegment = 0;
+        epoch = 0;
+        if (!segments) return 0;
+
+        bool found = false;
+        SegmentHeader header;
+        uint32_t tailSequence = 0;
+        for (uint32_t s = 0; s < segments; s++) {
+            if (!readHeader(s, header, nullptr)) continue;
+            bool newer = !found || (int32_t)(header.epoch - epoch) > 0;
+            if (newer) {
+                found = true;
+                epoch = header.epoch;
+                tailSegment = headSegment = s;
+                tailSequence = headSequence = header.sequence;
+            } else if (header.epoch == epoch) {
+                if (header.sequence < tailSequence) {
+                    tailSegment = s;
+                    tailSequence = header.sequence;
+                }
+                if (header.sequence > headSequence) {
+                    headSegment = s;
+                    headSequence = header.sequence;
+                }
+            }
+        }
+        if (!found) return 0;
+
+        // Data slots in the head segment run up to the first erased one
+        headSlot = 0;
+        while (headSlot < slotsPerSegment) {
+            uint32_t word;
+            if (!flash->read(segmentOffset(headSegment) + (headSlot + 1) * slotBytes, &word, sizeof(word)) ||
+                word == SEGMENT_ERASED_WORD) {
+                break;
+            }
+            headSlot++;
+        }
+        SegmentHeader tail;
+        SegmentHeader head;
+        readHeader(tailSegment, tail, meta);
+        readHeader(headSegment, head, nullptr);
+        metaBytes = tail.metaBytes;
+        firstSlot.store(tail.firstSlot, std::memory_order_release);
+        slotCount.store(head.firstSlot + headSlot - tail.firstSlot, std::memory_order_release);
+        nextSegment = following(headSegment);
+        return slotCount.load(std::memory_order_relaxed);
+    }
+
+    // Opens a new log after the previous one; metadata goes into every
+    // segment header (at most SEGMENT_META_MAX bytes)
+    bool start(const void* metadata, uint32_t length, bool wrapMode) {
+        if (!segments) return false;
+        if (active) stop();
+        metaBytes = length < SEGMENT_META_MAX ? length : SEGMENT_META_MAX;
+        memcpy(meta, metadata, metaBytes);
+        wrap = wrapMode;
+        full = false;
+        epoch++;
+        firstSlot.store(0, std::memory_order_release);
+        slotCount.store(0, std::memory_order_release);
+
+        // Segments erased ahead of the previous head start at nextSegment
+        headSegment = tailSegment = nextSegment;
+        headSequence = 0;
+        headSlot = 0;
+        active = prepare(headSegment) && writeHeader(headSegment, 0, 0);
+        if (!active) writeErrors++;
+        return active;
+    }
+
+    // Ends the log; it stays readable
+    void stop() {
+        active = false;
+        nextSegment = following(headSegment);
+        // Segments erased ahead of the head are still erased for the next log
+    }
+
+    bool append(const void* data) {
+        if (!active || full) return false;
+
+        if (headSlot == slotsPerSegment) {
+            uint32_t next = following(headSegment);
+            if (next == tailSegment) {
+                if (!wrap) {
+                    full = true;
+                    return false;
+                }
+                dropTail();
+            }
+            uint32_t first = firstSlot.load(std::memory_order_relaxed) + slotCount.load(std::memory_order_relaxed);
+            if (!prepare(next) || !writeHeader(next, headSequence + 1, first)) {
+                writeErrors++;
+                active = false;
+                return false;
+            }
+            headSegment = next;
+            headSequence++;
+            headSlot = 0;
+        }
+
+        if (!flash->write(segmentOffset(headSegment) + (headSlot + 1) * slotBytes, data, slotBytes)) {
+            writeErrors++;
+            return false;
+        }
+        headSlot++;
+        slotCount.store(slotCount.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Erases one segment ahead of the head if fewer than eraseAhead are;
+    // returns whether it did
+    bool service() {
+        if (!active || full || erasedAhead >= eraseAhead || erasedAhead + 1 >= segments) return false;
+        uint32_t target = (headSegment + erasedAhead + 1) % segments;
+        if (segments - liveSegments() <= erasedAhead) {
+            // The segment still holds kept data
+            if (!wrap) return false;
+            dropTail();
+        }
+        if (!flash->erase(segmentOffset(target), segmentBytes)) {
+            writeErrors++;
+            return false;
+        }
+        erasedAhead++;
+        aheadErases++;
+        return true;
+    }
+
+    // Log slots are numbered from the start of the log; the oldest ones are
+    // gone once a wrapping log gives up segments
+    uint32_t getFirstSlot() const { return firstSlot.load(std::memory_order_acquire); }
+    uint32_t getSlotCount() const { return slotCount.load(std::memory_order_acquire); }
+
+    // length bytes from offset within the slot
+    bool readSlot(uint32_t slot, uint32_t offset, void* data, uint32_t length) {
+        uint32_t first = getFirstSlot();
+        if (slot < first || slot - first >= getSlotCount() || offset > slotBytes || length > slotBytes - offset) {
+            return false;
+        }
+        uint32_t at = slot - first;
+        uint32_t segment = (tailSegment + at / slotsPerSegment) % segments;
+        return flash->read(segmentOffset(segment) + (at % slotsPerSegment + 1) * slotBytes + offset, data, length);
+    }
+
+    // Metadata the log was started with
+    uint32_t getMeta(void* out, uint32_t length) const {
+        uint32_t n = length < metaBytes ? length : metaBytes;
+        memcpy(out, meta, n);
+        return n;
+    }
+
+    bool isActive() const { return active; }
+    bool isFull() const { return full; }
+    bool isWrapping() const { return wrap; }
+    uint32_t getEpoch() const { return epoch; }
+    uint32_t getSegments() const { return segments; }
+    uint32_t getSegmentBytes() const { return segmentBytes; }
+    uint32_t getSlotBytes() const { return slotBytes; }
+    uint32_t getSlotsPerSegment() const { return slotsPerSegment; }
+    uint32_t getCapacitySlots() const { return segments * slotsPerSegment; }
+    uint32_t getErasedAhead() const { return erasedAhead; }
+    uint32_t getInlineErases() const { return inlineErases; }
+    uint32_t getAheadErases() const { return aheadErases; }
+    uint32_t getDroppedSegments() const { return droppedSegments; }
+    uint32_t getWriteErrors() const { return writeErrors; }
+};
+
+// A log of flash-format chunks, one per slot, seen as a version 2 file
+// without an index: the header the log was started with, then the chunks
+// kept when the source was made. A wrapping log no longer starts at chunk
+// 0, so it is presented as a full circular file whose ring starts at slot
+// 0. FlashCaptureReader and the page reader work on it unchanged.
+class SegmentLogSource : public FlashByteSource {
+private:
+    SegmentLog& log;
+    FlashStorageHeader header;
+    uint32_t firstSlot;
+    uint32_t slots;
+
+public:
+    explicit SegmentLogSource(SegmentLog& segmentLog)
+        : log(segmentLog), firstSlot(segmentLog.getFirstSlot()), slots(segmentLog.getSlotCount()) {
+        memset(&header, 0, sizeof(header));
+        log.getMeta(&header, sizeof(header));
+        header.chunk_bytes = log.getSlotBytes();
+        header.index_offset = 0;
+        header.flags = log.isWrapping() ? FLASH_HEADER_CIRCULAR : 0;
+        header.ring_chunks = log.isWrapping() ? slots : 0;
+        header.crc32 = flashHeaderCrc(header);
+    }
+
+    uint32_t size() override { return sizeof(header) + slots * log.getSlotBytes(); }
+
+    bool read(uint32_t offset, void* data, uint32_t length) override {
+        if (offset < sizeof(header)) {
+            if (length > sizeof(header) - offset) return false;
+            memcpy(data, (const uint8_t*)&header + offset, length);
+            return true;
+        }
+        offset -= sizeof(header);
+        return log.readSlot(firstSlot + offset / log.getSlotBytes(), offset % log.getSlotBytes(), data, length);
+    }
+};
+
+#endif // SEGMENT_LOG_H
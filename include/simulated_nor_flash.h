@@ -0,0 +1,64 @@
+#ifndef SIMULATED_NOR_FLASH_H
+#define SIMULATED_NOR_FLASH_H
+
+#include "nor_flash.h"
+#include <string.h>
+#include <vector>
+
+// Host-side NOR flash with the rules of the real part enforced.
+//
+// Erases must be block-aligned and set every byte to 0xFF. A write that
+// would have to turn a 0 bit back into 1 is refused and counted, so a
+// segment manager that forgets an erase fails a test instead of silently
+// storing garbage. Erases are counted per block to check wear spreading.
+class SimulatedNorFlash : public NorFlash {
+private:
+    std::vector<uint8_t> bytes;
+    uint32_t blockBytes;
+    std::vector<uint32_t> eraseCounts;
+    uint32_t violations;       // Writes refused for lack of an erase
+    uint64_t programmedBytes;
+
+public:
+    SimulatedNorFlash(uint32_t size, uint32_t eraseSize = 4096)
+        : bytes(size, 0xFF), blockBytes(eraseSize), eraseCounts(size / eraseSize, 0), violations(0),
+          programmedBytes(0) {}
+
+    uint32_t size() const override { return (uint32_t)bytes.size(); }
+    uint32_t eraseBytes() const override { return blockBytes; }
+
+    bool erase(uint32_t offset, uint32_t length) override {
+        if (offset % blockBytes || length % blockBytes || offset > size() || length > size() - offset) return false;
+        memset(&bytes[offset], 0xFF, length);
+        for (uint32_t block = offset / blockBytes; block < (offset + length) / blockBytes; block++) {
+            eraseCounts[block]++;
+        }
+        return true;
+    }
+
+    bool write(uint32_t offset, const void* data, uint32_t length) override {
+        if (offset > size() || length > size() - offset) return false;
+        const uint8_t* src = (const uint8_t*)data;
+        for (uint32_t i = 0; i < length; i++) {
+            if ((bytes[offset + i] & src[i]) != src[i]) {
+                violations++;
+                return false;
+            }
+        }
+        for (uint32_t i = 0; i < length; i++) bytes[offset + i] &= src[i];
+        programmedBytes += length;
+        return true;
+    }
+
+    bool read(uint32_t offset, void* data, uint32_t length) override {
+        if (offset > size() || length > size() - offset) return false;
+        memcpy(data, &bytes[offset], length);
+        return true;
+    }
+
+    uint32_t getEraseCount(uint32_t block) const { return eraseCounts[block]; }
+    uint32_t getViolations() const { return violations; }
+    uint64_t getProgrammedBytes() const { return programmedBytes; }
+};
+
+#endif // SIMULATED_NOR_FLASH_H
@@ -0,0 +1,110 @@
+#ifndef SIMULATED_SAMPLER_H
+#define SIMULATED_SAMPLER_H
+
+#include "sampler.h"
+#include <vector>
+
+// Host-side stand-in for the LCD_CAM DMA sampler.
+//
+// It uses the same clock divider and block ring as DmaSampler, but the
+// "hardware" only runs when advance() is called. A signal callback supplies
+// the level for every sample index, so tests can check the achieved rate,
+// block ordering and overrun accounting against a known waveform.
+class SimulatedSampler : public Sampler {
+public:
+    typedef uint8_t (*SignalFunction)(uint64_t sampleIndex, void* context);
+
+private:
+    std::vector<uint8_t> storage;
+    uint32_t blockSize;
+    uint32_t blockCount;
+    BlockRing ring;
+
+    SignalFunction signal;
+    void* signalContext;
+
+    uint32_t actualRate;
+    bool running;
+    uint64_t elapsedNs;        // Simulated time since start()
+    uint64_t samplesProduced;  // Samples written into the ring
+    uint32_t heldSlot;
+    uint64_t heldSequence;
+
+public:
+    SimulatedSampler(uint32_t blockSize = DMA_BLOCK_SIZE, uint32_t blockCount = DMA_BLOCK_COUNT)
+        : blockSize(blockSize), blockCount(blockCount < 2 ? 2 : blockCount),
+          signal(nullptr), signalContext(nullptr), actualRate(0), running(false),
+          elapsedNs(0), samplesProduced(0), heldSlot(0), heldSequence(0) {}
+
+    void setSignal(SignalFunction fn, void* context = nullptr) {
+        signal = fn;
+        signalContext = context;
+    }
+
+    bool begin(uint32_t sampleRate, const uint8_t* pins, uint8_t count) override {
+        (void)pins;
+        (void)count;
+        if (sampleRate < getMinHardwareSampleRate()) return false;
+        ClockDivider div;
+        actualRate = computeClockDivider(CAM_SOURCE_CLOCK_HZ, sampleRate, div);
+        storage.assign((size_t)blockSize * blockCount, 0);
+        return true;
+    }
+
+    void end() override {
+        running = false;
+        storage.clear();
+    }
+
+    bool start() override {
+        if (storage.empty()) return false;
+        ring.reset(blockCount);
+        elapsedNs = 0;
+        samplesProduced = 0;
+        running = true;
+        return true;
+    }
+
+    void stop() override {
+        running = false;
+    }
+
+    // Run the emulated hardware for the given time, completing blocks as the
+    // DMA would. Samples are produced at exactly actualRate.
+    void advance(uint64_t nanoseconds) {
+        if (!running) return;
+        elapsedNs += nanoseconds;
+        uint64_t due = (elapsedNs * actualRate) / 1000000000ULL;
+        while (samplesProduced < due) {
+            uint32_t slot = (uint32_t)((samplesProduced / blockSize) % blockCount);
+            uint32_t offset = (uint32_t)(samplesProduced % blockSize);
+            storage[(size_t)slot * blockSize + offset] = signal ? signal(samplesProduced, signalContext) : 0;
+            samplesProduced++;
+            if (samplesProduced % blockSize == 0) {
+                ring.publish();  // Same point where the GDMA raises in_suc_eof
+                notifyBlockReady();
+            }
+        }
+    }
+
+    bool acquireBlock(SampleBlock& block) override {
+        if (!ring.acquire(heldSlot, heldSequence)) return false;
+        block.data = &storage[(size_t)heldSlot * blockSize];
+        block.count = blockSize;
+        block.firstIndex = heldSequence * blockSize;
+        return true;
+    }
+
+    bool releaseBlock() override {
+        return ring.release();
+    }
+
+    uint32_t getActualSampleRate() const override { return actualRate; }
+    uint32_t getOverrunCount() const override { return ring.getOverruns(); }
+    const char* getName() const override { return "Simulated DMA"; }
+
+    uint64_t getSamplesProduced() const { return samplesProduced; }
+    uint32_t getBlockSize() const { return blockSize; }
+};
+
+#endif // SIMULATED_SAMPLER_H
@@ -0,0 +1,86 @@
+#ifndef SPSC_RING_H
+#define SPSC_RING_H
+
+#include <stdint.h>
+#include <atomic>
+
+// Wait-free single-producer/single-consumer ring.
+//
+// head is only written by the producer and tail only by the consumer, so
+// neither side ever waits or retries. A slot's contents are published with
+// a release store of head and observed with an acquire load, and returned
+// with a release store of tail. Both counters run freely and are masked on
+// access, so all Capacity slots are usable.
+//
+// Large elements can be filled and drained in place with claim()/publish()
+// and front()/pop() to avoid copying them through the ring.
+template <typename T, uint32_t Capacity>
+class SpscRing {
+    static_assert(Capacity >= 2 && (Capacity & (Capacity - 1)) == 0, "SpscRing capacity must be a power of two");
+
+private:
+    static const uint32_t MASK = Capacity - 1;
+
+    T slots[Capacity];
+    std::atomic<uint32_t> head;  // Next slot the producer publishes
+    std::atomic<uint32_t> tail;  // Next slot the consumer reads
+
+public:
+    SpscRing() : head(0), tail(0) {}
+
+    // ----- Producer side -----
+
+    // Slot that the next publish() will hand over, or nullptr if the ring is full.
+    // Nothing is visible to the consumer until publish().
+    T* claim() {
+        uint32_t h = head.load(std::memory_order_relaxed);
+        if (h - tail.load(std::memory_order_acquire) == Capacity) return nullptr;
+        return &slots[h & MASK];
+    }
+
+    void publish() {
+        head.store(head.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+
+    bool push(const T& value) {
+        T* slot = claim();
+        if (!slot) return false;
+        *slot = value;
+        publish();
+        return true;
+    }
+
+    // ----- Consumer side -----
+
+    // Oldest published slot, or nullptr if the ring is empty
+    T* front() {
+        uint32_t t = tail.load(std::memory_order_relaxed);
+        if (head.load(std::memory_order_acquire) == t) return nullptr;
+        return &slots[t & MASK];
+    }
+
+    void pop() {
+        tail.store(tail.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+
+    bool pop(T& value) {
+        T* slot = front();
+        if (!slot) return false;
+        value = *slot;
+        pop();
+        return true;
+    }
+
+    // ----- Either side (snapshot, may be stale by the time it is used) -----
+
+    uint32_t size() const {
+        uint32_t t = tail.load(std::memory_order_acquire);  // Tail first so head - tail never underflows
+        return head.load(std::memory_order_acquire) - t;
+    }
+
+    bool empty() const { return size() == 0; }
+    bool full() const { return size() == Capacity; }
+    static uint32_t capacity() { return Capacity; }
+};
+
+#endif // SPSC_RING_H
@@ -0,0 +1,332 @@
+#ifndef TRANSITION_STORE_H
+#define TRANSITION_STORE_H
+
+#include <stdint.h>
+#include <atomic>
+#include "packed_sample_store.h"
+
+#define VARINT_MAX_BYTES 10  // A 64-bit value in LEB128
+
+// Transition-only capture storage.
+//
+// Instead of one bit per sample, only level changes are kept, so capacity
+// scales with the number of edges rather than with capture duration. The
+// store holds the levels of its first sample plus a stream of varint deltas,
+// each the distance in samples from the previous edge (or from the first
+// sample) to the next edge. Written out, the stream is
+//   [initial levels byte] [varint delta]...
+// With one channel every edge toggles the level. With more, an edge is a
+// sample where any channel changes and each delta is followed by the new
+// levels byte (bit c = channel c). Positions and deltas are 64-bit, so a
+// sparse capture can cover more than 2^32 samples. Timestamps come from the
+// same fixed-rate timebase as the packed store.
+//
+// The bytes form a ring. Dropping the oldest edge makes that edge the new
+// first sample, so a pre-trigger window can be kept (wrap mode) and trimmed
+// without moving the rest. Memory is owned by the caller, as with
+// PackedSampleStore. One writer appends; readers only look below the
+// published byte count.
+class TransitionStore {
+private:
+    uint8_t* bytes;
+    uint32_t capacity;                  // Encoded bytes that fit
+    uint32_t head;                      // Physical byte of the oldest delta
+    std::atomic<uint32_t> used;         // Encoded bytes held
+    std::atomic<uint64_t> sampleCount;  // Samples covered (equivalent sample count)
+    uint32_t edgeCount;                 // Edges held
+    uint64_t lastEdge;                  // Sample offset of the last edge (0 = first sample)
+    uint8_t channels;
+    uint8_t startLevels;                // Levels of the first sample
+    uint8_t levels;                     // Levels of the most recent sample
+    bool started;
+    bool storeFull;
+    bool wrap;                          // Drop the oldest edges instead of filling up
+    SampleTimebase timebase;            // firstIndex = capture index of the first sample
+
+    uint32_t edgeBytes() const { return channels > 1 ? VARINT_MAX_BYTES + 1 : VARINT_MAX_BYTES; }
+
+    void putByte(uint8_t value) {
+        uint32_t n = used.load(std::memory_order_relaxed);
+        bytes[(uint32_t)(((uint64_t)head + n) % capacity)] = value;
+        used.store(n + 1, std::memory_order_release);
+    }
+
+    void putVarint(uint64_t value) {
+        uint32_t n = used.load(std::memory_order_relaxed);
+        uint32_t pos = (uint32_t)(((uint64_t)head + n) % capacity);
+        while (value >= 0x80) {
+            bytes[pos] = (uint8_t)(value | 0x80);
+            if (++pos == capacity) pos = 0;
+            n++;
+            value >>= 7;
+        }
+        bytes[pos] = (uint8_t)value;
+        used.store(n + 1, std::memory_order_release);
+    }
+
+    // Remove the oldest edge; it becomes the first sample
+    void popEdge() {
+        uint32_t n = used.load(std::memory_order_relaxed);
+        uint64_t delta = 0;
+        uint32_t shift = 0;
+        uint32_t length = 0;
+        while (length < n) {
+            uint8_t b = bytes[head];
+            if (++head == capacity) head = 0;
+            length++;
+            delta |= (uint64_t)(b & 0x7F) << shift;
+            if (!(b & 0x80)) break;
+            shift += 7;
+        }
+        if (channels > 1) {
+            startLevels = bytes[head];
+            if (++head == capacity) head = 0;
+            length++;
+        } else {
+            startLevels ^= 1;
+        }
+        used.store(n - length, std::memory_order_release);
+        sampleCount.store(sampleCount.load(std::memory_order_relaxed) - delta, std::memory_order_release);
+        lastEdge -= delta;
+        timebase.firstIndex += delta;
+        edgeCount--;
+    }
+
+    // Levels of every channel at bit `bit` of the per-channel words
+    uint8_t levelsAt(const uint32_t* planeWords, uint32_t bit) const {
+        uint8_t result = 0;
+        for (uint8_t c = 0; c < channels; c++) {
+            result |= ((planeWords[c] >> bit) & 1) << c;
+        }
+        return result;
+    }
+
+public:
+    // Decodes the stream back into (sample offset, levels) pairs
+    class Iterator {
+    private:
+        const uint8_t* bytes;
+        uint32_t capacity;
+        uint32_t pos;
+        uint32_t remaining;
+        uint64_t offset;
+        uint8_t channels;
+        uint8_t levels;
+        bool started;
+
+    public:
+        Iterator(const uint8_t* bytes, uint32_t capacity, uint32_t head, uint32_t used,
+                 uint8_t channels, uint8_t startLevels, bool hasSamples)
+            : bytes(bytes), capacity(capacity), pos(head), remaining(used), offset(0),
+              channels(channels), levels(startLevels), started(!hasSamples) {}
+
+        // sampleOffset is counted from the first stored sample
+        bool next(uint64_t& sampleOffset, uint8_t& edgeLevels) {
+            if (!started) {
+                started = true;
+                sampleOffset = 0;
+                edgeLevels = levels;
+                return true;
+            }
+
+            uint64_t delta = 0;
+            uint32_t shift = 0;
+            while (remaining > 0) {
+                uint8_t b = bytes[pos];
+                if (++pos == capacity) pos = 0;
+                remaining--;
+                delta |= (uint64_t)(b & 0x7F) << shift;
+                if (!(b & 0x80)) {
+                    if (channels > 1) {
+                        if (remaining == 0) return false;
+                        levels = bytes[pos];
+                        if (++pos == capacity) pos = 0;
+                        remaining--;
+                    } else {
+                        levels ^= 1;
+                    }
+                    offset += delta;
+                    sampleOffset = offset;
+                    edgeLevels = levels;
+                    return true;
+                }
+                shift += 7;
+            }
+            return false;  // End of stream
+        }
+    };
+
+    // Frozen view of the store (see PackedSampleStore::Snapshot)
+    struct Snapshot {
+        const uint8_t* bytes;
+        uint32_t capacity;
+        uint32_t head;
+        uint32_t used;
+        uint64_t sampleCount;
+        uint32_t edgeCount;
+        uint8_t channels;
+        uint8_t startLevels;
+        SampleTimebase timebase;
+
+        Iterator iterate() const {
+            return Iterator(bytes, capacity, head, used, channels, startLevels, sampleCount > 0);
+        }
+        uint64_t timestampAt(uint64_t sampleOffset) const {
+            return timebase.timestampAt(timebase.firstIndex + sampleOffset);
+        }
+    };
+
+    TransitionStore() : bytes(nullptr), capacity(0), head(0), used(0), sampleCount(0), channels(1) {
+        reset();
+    }
+
+    void attach(uint8_t* storage, uint32_t capacityBytes) {
+        bytes = storage;
+        capacity = capacityBytes;
+        reset();
+    }
+
+    void reset() {
+        head = 0;
+        used.store(0, std::memory_order_release);
+        sampleCount.store(0, std::memory_order_release);
+        edgeCount = 0;
+        lastEdge = 0;
+        startLevels = 0;
+        levels = 0;
+        started = false;
+        storeFull = false;
+        wrap = false;
+        timebase = SampleTimebase();
+    }
+
+    // Channels per sample (1..8); empties the store
+    void setChannels(uint8_t n) {
+        channels = n ? n : 1;
+        reset();
+    }
+
+    uint8_t getChannels() const { return channels; }
+
+    // Hand the oldest n encoded bytes to another writer (flash). The sample
+    // accounting is unchanged; iterate() only decodes a store that has never
+    // been consumed.
+    void consumeBytes(uint32_t n) {
+        uint32_t held = used.load(std::memory_order_relaxed);
+        if (n > held) n = held;
+        head = (uint32_t)(((uint64_t)head + n) % capacity);
+        used.store(held - n, std::memory_order_release);
+        storeFull = false;
+    }
+
+    // Contiguous run of unconsumed bytes starting at the oldest one
+    uint32_t peekBytes(const uint8_t*& data) const {
+        uint32_t held = getUsedBytes();
+        uint32_t run = capacity - head;
+        data = bytes + head;
+        return held < run ? held : run;
+    }
+
+    // Keep at most `keep` encoded bytes by dropping the oldest edges
+    void trimBytes(uint32_t keep) {
+        while (used.load(std::memory_order_relaxed) > keep && edgeCount > 0) {
+            popEdge();
+        }
+    }
+
+    void setWrap(bool enable) { wrap = enable; }
+    bool isWrapping() const { return wrap; }
+
+    void setTimebase(const SampleTimebase& tb) { timebase = tb; }
+    const SampleTimebase& getTimebase() const { return timebase; }
+    bool hasTimebase() const { return timebase.rate != 0; }
+
+    // Append n samples starting at bit `first` of each source plane; plane c
+    // starts `planeStride` words after bits. Edges are found a word at a time
+    // by comparing each bit with its predecessor in every plane. Returns how
+    // many samples were taken; fewer than n means the store is full.
+    uint32_t append(const uint32_t* bits, uint32_t planeStride, uint32_t first, uint32_t n) {
+        if (n == 0 || storeFull) return 0;
+        uint64_t base = sampleCount.load(std::memory_order_relaxed);
+        uint32_t words[8];
+
+        if (!started) {
+            started = true;
+            levels = 0;
+            for (uint8_t c = 0; c < channels; c++) {
+                levels |= readPackedBits(bits + c * planeStride, first, 1) << c;
+            }
+            startLevels = levels;
+        }
+
+        for (uint32_t i = 0; i < n; i += 32) {
+            uint32_t valid = (n - i) < 32 ? (n - i) : 32;
+            uint32_t edges = 0;
+            for (uint8_t c = 0; c < channels; c++) {
+                uint32_t word = readPackedBits(bits + c * planeStride, first + i, valid);
+                words[c] = word;
+                edges |= word ^ ((word << 1) | ((levels >> c) & 1));
+            }
+            if (valid < 32) edges &= (1u << valid) - 1;
+
+            while (edges) {
+                uint32_t bit = __builtin_ctz(edges);
+                uint64_t position = base + i + bit;
+                while (used.load(std::memory_order_relaxed) + edgeBytes() > capacity) {
+                    if (wrap && edgeCount > 0) {
+                        // popEdge moves the first sample forward; keep offsets relative to it
+                        uint64_t before = sampleCount.load(std::memory_order_relaxed);
+                        popEdge();
+                        uint64_t dropped = before - sampleCount.load(std::memory_order_relaxed);
+                        base -= dropped;
+                        position -= dropped;
+                        continue;
+                    }
+                    // Keep only the samples before the edge that did not fit
+                    storeFull = true;
+                    if (bit) levels = levelsAt(words, bit - 1);
+                    sampleCount.store(position, std::memory_order_release);
+                    return (uint32_t)(position - base);
+                }
+                putVarint(position - lastEdge);
+                if (channels > 1) {
+                    putByte(levelsAt(words, bit));
+                }
+                lastEdge = position;
+                edgeCount++;
+                edges &= edges - 1;
+            }
+
+            levels = levelsAt(words, valid - 1);
+            sampleCount.store(base + i + valid, std::memory_order_release);
+        }
+        return n;
+    }
+
+    // Single-channel convenience
+    uint32_t append(const uint32_t* bits, uint32_t n) {
+        return append(bits, 0, 0, n);
+    }
+
+    uint32_t getUsedBytes() const { return used.load(std::memory_order_acquire); }
+    uint32_t getFreeBytes() const { return capacity - getUsedBytes(); }
+    uint32_t getCapacityBytes() const { return capacity; }
+    uint64_t getSampleCount() const { return sampleCount.load(std::memory_order_acquire); }
+    uint32_t getEdgeCount() const { return edgeCount; }
+    uint8_t getStartLevels() const { return startLevels; }
+    bool full() const { return storeFull; }
+
+    uint64_t timestampAt(uint64_t sampleOffset) const {
+        return timebase.timestampAt(timebase.firstIndex + sampleOffset);
+    }
+
+    Iterator iterate() const {
+        return Iterator(bytes, capacity, head, getUsedBytes(), channels, startLevels, getSampleCount() > 0);
+    }
+
+    Snapshot snapshot() const {
+        return {bytes, capacity, head, getUsedBytes(), getSampleCount(), edgeCount, channels, startLevels, timebase};
+    }
+};
+
+#endif // TRANSITION_STORE_H
@@ -0,0 +1,404 @@
+#ifndef TRIGGER_ENGINE_H
+#define TRIGGER_ENGINE_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define TRIGGER_MAX_STAGES 8
+
+// Multi-stage trigger programs evaluated 32 samples at a time.
+//
+// A program is a sequence of stages that must complete in order, plus a
+// holdoff and an occurrence count. It is written as comma separated terms:
+//   rise@0, low@0>=50us, fall@0*3, holdoff=1ms, nth=2
+// Stage terms:
+//   rise, fall, edge        edge on a channel; *N waits for the Nth one
+//   high, low               level on a channel; >=T requires it held for T
+//   pattern:MASK=VALUE      channels in MASK equal VALUE (bit c = channel c)
+//   hpulse<T, hpulse>T      high pulse shorter / longer than T, at its end
+//   lpulse<T, lpulse>T      the same for low pulses
+//   pulse<T, pulse>T        either polarity (pulse<T is a glitch trigger)
+//   idle>=T                 no edge for T
+//   @C selects the channel (default: the configured trigger channel)
+// Times take ns, us, ms or s; a bare number counts samples.
+// Program terms:
+//   holdoff=T   ignore T after arming and after each completed sequence
+//   nth=N       fire on the Nth completed sequence
+//
+// The engine works on the capture chunk's bit planes. Each condition is
+// turned into a 32-bit match word with shifts and masks, edge counts are
+// popcounts and hold times are runs of ones, so the cost is per word and
+// per stage rather than per sample. Pulse widths and timeouts are measured
+// between edge positions, so they are only compared at transitions and an
+// idle word costs one test. Plain C++ so a host build can feed it
+// synthetic waveforms.
+
+enum TriggerOp : uint8_t {
+    TRIGGER_OP_RISE,
+    TRIGGER_OP_FALL,
+    TRIGGER_OP_EDGE,
+    TRIGGER_OP_HIGH,
+    TRIGGER_OP_LOW,
+    TRIGGER_OP_PATTERN,
+    TRIGGER_OP_PULSE_SHORTER,  // Pulse of level `value` (2 = either) ended before `hold`
+    TRIGGER_OP_PULSE_LONGER,   // Pulse of level `value` (2 = either) ended after `hold`
+    TRIGGER_OP_IDLE            // No edge for `hold`
+};
+
+#define TRIGGER_PULSE_EITHER 2
+
+// A duration as written in the program; converted at arm time so the
+// program does not depend on the sample rate it was written for
+struct TriggerSpan {
+    uint64_t amount;
+    bool samples;   // amount counts samples instead of nanoseconds
+
+    uint32_t toSamples(uint32_t rate) const {
+        if (samples) return amount > 0xFFFFFFFFULL ? 0xFFFFFFFF : (uint32_t)amount;
+        // Round up so a hold time is never shorter than written
+        uint64_t whole = (amount / 1000000000ULL) * rate;
+        uint64_t part = ((amount % 1000000000ULL) * rate + 999999999ULL) / 1000000000ULL;
+        uint64_t n = whole + part;
+        return n > 0xFFFFFFFFULL ? 0xFFFFFFFF : (uint32_t)n;
+    }
+};
+
+struct TriggerStage {
+    TriggerOp op;
+    uint8_t channel;
+    uint8_t mask;       // Pattern channels
+    uint8_t value;      // Pattern levels, or pulse level
+    uint32_t count;     // Edges to wait for (edge ops)
+    TriggerSpan hold;   // Minimum time the level holds (level ops), pulse width or timeout
+};
+
+struct TriggerProgram {
+    TriggerStage stages[TRIGGER_MAX_STAGES];
+    uint8_t stageCount;
+    TriggerSpan holdoff;
+    uint32_t occurrences;  // Fire on this completed sequence (1 = first)
+
+    void clear() {
+        stageCount = 0;
+        holdoff = {0, true};
+        occurrences = 1;
+    }
+
+    bool addStage(TriggerOp op, uint8_t channel, uint32_t count = 1, TriggerSpan hold = {1, true}) {
+        if (stageCount >= TRIGGER_MAX_STAGES) return false;
+        TriggerStage& stage = stages[stageCount++];
+        stage.op = op;
+        stage.channel = channel;
+        stage.mask = 0;
+        stage.value = 0;
+        stage.count = count ? count : 1;
+        stage.hold = hold;
+        return true;
+    }
+
+    // Parse the text form above. Returns nullptr on success, otherwise a
+    // static description of the first error.
+    const char* parse(const char* text, uint8_t defaultChannel, uint8_t channels) {
+        clear();
+        const char* p = text;
+        while (*p) {
+            while (*p == ' ' || *p == ',' || *p == ';') p++;
+            if (!*p) break;
+
+            if (!strncmp(p, "holdoff=", 8)) {
+                p += 8;
+                if (!parseSpan(p, holdoff)) return "bad holdoff time";
+                continue;
+            }
+            if (!strncmp(p, "nth=", 4)) {
+                char* end;
+                occurrences = strtoul(p + 4, &end, 10);
+                if (end == p + 4 || occurrences == 0) return "bad nth count";
+                p = end;
+                continue;
+            }
+
+            TriggerStage stage = {TRIGGER_OP_EDGE, defaultChannel, 0, 0, 1, {1, true}};
+            if (!strncmp(p, "rise", 4)) { stage.op = TRIGGER_OP_RISE; p += 4; }
+            else if (!strncmp(p, "fall", 4)) { stage.op = TRIGGER_OP_FALL; p += 4; }
+            else if (!strncmp(p, "edge", 4)) { stage.op = TRIGGER_OP_EDGE; p += 4; }
+            else if (!strncmp(p, "hpulse", 6)) { stage.op = TRIGGER_OP_PULSE_SHORTER; stage.value = 1; p += 6; }
+            else if (!strncmp(p, "lpulse", 6)) { stage.op = TRIGGER_OP_PULSE_SHORTER; stage.value = 0; p += 6; }
+            else if (!strncmp(p, "pulse", 5)) { stage.op = TRIGGER_OP_PULSE_SHORTER; stage.value = TRIGGER_PULSE_EITHER; p += 5; }
+            else if (!strncmp(p, "idle", 4)) { stage.op = TRIGGER_OP_IDLE; p += 4; }
+            else if (!strncmp(p, "high", 4)) { stage.op = TRIGGER_OP_HIGH; p += 4; }
+            else if (!strncmp(p, "low", 3)) { stage.op = TRIGGER_OP_LOW; p += 3; }
+            else if (!strncmp(p, "pattern:", 8)) {
+                char* end;
+                stage.op = TRIGGER_OP_PATTERN;
+                stage.mask = (uint8_t)strtoul(p + 8, &end, 0);
+                if (end == p + 8 || *end != '=') return "pattern needs MASK=VALUE";
+                p = end + 1;
+                stage.value = (uint8_t)strtoul(p, &end, 0);
+                if (end == p || stage.mask == 0) return "pattern needs MASK=VALUE";
+                if (stage.mask >> channels) return "pattern uses a channel that is not captured";
+                stage.value &= stage.mask;
+                p = end;
+            } else {
+                return "unknown trigger condition";
+            }
+
+            if (stage.op == TRIGGER_OP_PULSE_SHORTER) {
+                // Width comparison is part of the condition
+                if (*p == '>' && p[1] != '=') stage.op = TRIGGER_OP_PULSE_LONGER;
+                else if (*p != '<') return "pulse needs <T or >T";
+                p++;
+                if (!parseSpan(p, stage.hold)) return "bad pulse width";
+            } else if (stage.op == TRIGGER_OP_IDLE) {
+                if (p[0] != '>' || p[1] != '=') return "idle needs >=T";
+                p += 2;
+                if (!parseSpan(p, stage.hold)) return "bad idle time";
+            }
+
+            // Modifiers, in any order
+            for (;;) {
+                char* end;
+                if (*p == '@') {
+                    stage.channel = (uint8_t)strtoul(p + 1, &end, 10);
+                    if (end == p + 1 || stage.channel >= channels) return "bad trigger channel";
+                    p = end;
+                } else if (*p == '*') {
+                    stage.count = strtoul(p + 1, &end, 10);
+                    if (end == p + 1 || stage.count == 0) return "bad edge count";
+                    if (stage.op > TRIGGER_OP_EDGE) return "counts apply to edges only";
+                    p = end;
+                } else if (p[0] == '>' && p[1] == '=') {
+                    p += 2;
+                    if (!parseSpan(p, stage.hold)) return "bad hold time";
+                    if (stage.op <= TRIGGER_OP_EDGE || stage.op > TRIGGER_OP_PATTERN) {
+                        return "hold times apply to levels only";
+                    }
+                } else {
+                    break;
+                }
+            }
+            if (*p && *p != ',' && *p != ';' && *p != ' ') return "unexpected character";
+            if (stageCount >= TRIGGER_MAX_STAGES) return "too many stages";
+            stages[stageCount++] = stage;
+        }
+        return stageCount ? nullptr : "no trigger stages";
+    }
+
+private:
+    static bool parseSpan(const char*& p, TriggerSpan& span) {
+        char* end;
+        uint64_t amount = strtoull(p, &end, 10);
+        if (end == p) return false;
+        p = end;
+        span.samples = false;
+        if (!strncmp(p, "ns", 2)) { span.amount = amount; p += 2; }
+        else if (!strncmp(p, "us", 2)) { span.amount = amount * 1000ULL; p += 2; }
+        else if (!strncmp(p, "ms", 2)) { span.amount = amount * 1000000ULL; p += 2; }
+        else if (*p == 's') { span.amount = amount * 1000000000ULL; p += 1; }
+        else { span.amount = amount; span.samples = true; }
+        return true;
+    }
+};
+
+// Runs a TriggerProgram over successive 32-sample words
+class TriggerEngine {
+private:
+    TriggerProgram program;
+    uint32_t need[TRIGGER_MAX_STAGES];  // Edges or held samples per stage, at the armed rate
+    uint32_t holdoffSamples;
+    uint8_t stage;          // Current stage
+    uint32_t progress;      // Edges seen or current run length in this stage
+    uint32_t sinceEdge;     // Sample periods from the last edge (or stage start) to the word start
+    bool edgeSeen;          // A pulse start has been seen in this stage
+    uint32_t holdoffLeft;
+    uint32_t occurrencesLeft;
+    uint8_t previous;       // Levels of the last sample fed
+    bool fired;
+
+    // Samples of the current word that satisfy a stage, bit i = sample i
+    uint32_t matchWord(const TriggerStage& s, const uint32_t* words, uint32_t stride, uint8_t channels) const {
+        if (s.op == TRIGGER_OP_PATTERN) {
+            uint32_t match = 0xFFFFFFFF;
+            for (uint8_t c = 0; c < channels; c++) {
+                if (!((s.mask >> c) & 1)) continue;
+                uint32_t w = words[c * stride];
+                match &= ((s.value >> c) & 1) ? w : ~w;
+            }
+            return match;
+        }
+        uint32_t w = words[s.channel * stride];
+        uint32_t before = (w << 1) | ((previous >> s.channel) & 1);
+        switch (s.op) {
+            case TRIGGER_OP_RISE: return w & ~before;
+            case TRIGGER_OP_FALL: return ~w & before;
+            case TRIGGER_OP_EDGE: return w ^ before;
+            case TRIGGER_OP_HIGH: return w;
+            default:              return ~w;
+        }
+    }
+
+    void enterStage(uint8_t index) {
+        stage = index;
+        progress = 0;
+        sinceEdge = 0;
+        edgeSeen = false;
+    }
+
+    // Pulse and timeout stages from sample `pos`: only the edges are
+    // visited. Returns the completing sample or -1; updates sinceEdge.
+    int32_t scanEdges(const TriggerStage& s, uint32_t w, uint32_t before, uint32_t pos, uint32_t valid) {
+        uint32_t edges = (w ^ before) & (valid == 32 ? 0xFFFFFFFF : (1u << valid) - 1) & (0xFFFFFFFF << pos);
+        uint32_t width = need[stage];
+        uint32_t cursor = pos;
+
+        while (edges) {
+            uint32_t b = __builtin_ctz(edges);
+            uint64_t length = (uint64_t)sinceEdge + (b - cursor);
+            if (s.op == TRIGGER_OP_IDLE) {
+                if (length >= width) return cursor + (width - sinceEdge);
+            } else if (edgeSeen) {
+                uint8_t level = (before >> b) & 1;  // Level the edge ends
+                bool polarity = s.value == TRIGGER_PULSE_EITHER || s.value == level;
+                bool qualifies = s.op == TRIGGER_OP_PULSE_SHORTER ? length < width : length > width;
+                if (polarity && qualifies) return b;
+            }
+            edgeSeen = true;
+            sinceEdge = 0;
+            cursor = b;
+            edges &= edges - 1;
+        }
+
+        uint64_t elapsed = (uint64_t)sinceEdge + (valid - cursor);
+        if (s.op == TRIGGER_OP_IDLE && elapsed - 1 >= width) {
+            return cursor + (width - sinceEdge);
+        }
+        sinceEdge = elapsed > 0xFFFFFFFF ? 0xFFFFFFFF : (uint32_t)elapsed;
+        return -1;
+    }
+
+public:
+    TriggerEngine() : holdoffSamples(0), stage(0), progress(0), sinceEdge(0), edgeSeen(false), holdoffLeft(0),
+                      occurrencesLeft(1), previous(0), fired(false) {
+        program.clear();
+    }
+
+    void load(const TriggerProgram& p) { program = p; }
+    const TriggerProgram& getProgram() const { return program; }
+    bool hasProgram() const { return program.stageCount > 0; }
+
+    // Convert times to samples and start from the first stage; `levels`
+    // is what the inputs read just before the first sample fed
+    void arm(uint32_t sampleRate, uint8_t levels) {
+        for (uint8_t i = 0; i < program.stageCount; i++) {
+            const TriggerStage& s = program.stages[i];
+            uint32_t n = s.op <= TRIGGER_OP_EDGE ? s.count : s.hold.toSamples(sampleRate);
+            need[i] = n ? n : 1;
+        }
+        holdoffSamples = program.holdoff.toSamples(sampleRate);
+        holdoffLeft = holdoffSamples;
+        occurrencesLeft = program.occurrences ? program.occurrences : 1;
+        previous = levels;
+        fired = false;
+        enterStage(0);
+    }
+
+    bool hasFired() const { return fired; }
+    uint8_t getStage() const { return stage; }
+
+    // Feed the next `valid` (1..32) samples: word c * stride holds channel c.
+    // Returns the bit of the sample that completed the program, or -1.
+    int32_t feed(const uint32_t* words, uint32_t stride, uint8_t channels, uint32_t valid) {
+        int32_t result = -1;
+        uint32_t validMask = valid == 32 ? 0xFFFFFFFF : (1u << valid) - 1;
+        uint32_t pos = 0;
+
+        while (!fired && program.stageCount && pos < valid) {
+            if (holdoffLeft) {
+                uint32_t skip = valid - pos < holdoffLeft ? valid - pos : holdoffLeft;
+                holdoffLeft -= skip;
+                pos += skip;
+                continue;
+            }
+
+            const TriggerStage& s = program.stages[stage];
+            if (s.op >= TRIGGER_OP_PULSE_SHORTER) {
+                uint32_t w = words[s.channel * stride];
+                uint32_t before = (w << 1) | ((previous >> s.channel) & 1);
+                int32_t done = scanEdges(s, w, before, pos, valid);
+                if (done < 0) break;
+                pos = done + 1;
+                if (stage + 1 < program.stageCount) {
+                    enterStage(stage + 1);
+                } else if (--occurrencesLeft == 0) {
+                    fired = true;
+                    result = done;
+                } else {
+                    enterStage(0);
+                    holdoffLeft = holdoffSamples;
+                }
+                continue;
+            }
+            uint32_t match = matchWord(s, words, stride, channels) & validMask & (0xFFFFFFFF << pos);
+            uint32_t remaining = need[stage] - progress;
+            int32_t done = -1;
+
+            if (s.op <= TRIGGER_OP_EDGE) {
+                // Nth edge: popcount, then drop the lower edges to find it
+                uint32_t edges = __builtin_popcount(match);
+                if (edges < remaining) {
+                    progress += edges;
+                    pos = valid;
+                } else {
+                    for (uint32_t i = 1; i < remaining; i++) match &= match - 1;
+                    done = __builtin_ctz(match);
+                }
+            } else {
+                // Level held for `remaining` more samples: walk runs of ones,
+                // a run that reaches the end of the word carries over
+                while (pos < valid) {
+                    uint32_t x = match >> pos;
+                    if (progress == 0) {
+                        if (!x) { pos = valid; break; }
+                        uint32_t skip = __builtin_ctz(x);
+                        pos += skip;
+                        x >>= skip;
+                    }
+                    uint32_t ones = x == 0xFFFFFFFF ? 32 : __builtin_ctz(~x);
+                    if (progress + ones >= need[stage]) {
+                        done = pos + (need[stage] - progress) - 1;
+                        break;
+                    }
+                    if (pos + ones == valid) {
+                        progress += ones;
+                        pos = valid;
+                    } else {
+                        progress = 0;
+                        pos += ones;
+                    }
+                }
+            }
+
+            if (done < 0) break;
+            pos = done + 1;
+            if (stage + 1 < program.stageCount) {
+                enterStage(stage + 1);
+            } else if (--occurrencesLeft == 0) {
+                fired = true;
+                result = done;
+            } else {
+                enterStage(0);
+                holdoffLeft = holdoffSamples;
+            }
+        }
+
+        uint8_t levels = 0;
+        for (uint8_t c = 0; c < channels; c++) {
+            levels |= ((words[c * stride] >> (valid - 1)) & 1) << c;
+        }
+        previous = levels;
+        return result;
+    }
+};
+
+#endif // TRIGGER_ENGINE_H
@@ -0,0 +1,128 @@
+#include "burst_sampler.h"
+
+#if CONFIG_IDF_TARGET_ESP32S3
+
+#include <driver/dedic_gpio.h>
+#include <esp_heap_caps.h>
+#include <hal/dedic_gpio_cpu_ll.h>
+
+BurstSampler::BurstSampler() {
+    bundle = nullptr;
+    inOffset = 0;
+    channelBits = 0;
+    buffer = nullptr;
+    capacity = 0;
+    last = {0, 0, 0};
+}
+
+BurstSampler::~BurstSampler() {
+    end();
+}
+
+bool BurstSampler::begin(const uint8_t* pins, uint8_t count, uint32_t samples) {
+    if (count == 0 || count > 8) return false;
+    if (samples == 0 || samples > BURST_MAX_SAMPLES) return false;
+    end();
+
+    int gpios[8];
+    for (uint8_t i = 0; i < count; i++) {
+        gpios[i] = pins[i];
+    }
+    dedic_gpio_bundle_config_t config = {};
+    config.gpio_array = gpios;
+    config.array_size = count;
+    config.flags.in_en = 1;
+    dedic_gpio_bundle_handle_t handle = nullptr;
+    if (dedic_gpio_new_bundle(&config, &handle) != ESP_OK) return false;
+    bundle = handle;
+    dedic_gpio_get_in_offset(handle, &inOffset);
+    channelBits = (uint8_t)((1u << count) - 1);
+
+    // Internal RAM: PSRAM stores would stall the loop
+    buffer = (uint8_t*)heap_caps_malloc(samples, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    if (!buffer) {
+        end();
+        return false;
+    }
+    capacity = samples;
+    return true;
+}
+
+void BurstSampler::end() {
+    if (bundle) {
+        dedic_gpio_del_bundle((dedic_gpio_bundle_handle_t)bundle);
+        bundle = nullptr;
+    }
+    if (buffer) {
+        heap_caps_free(buffer);
+        buffer = nullptr;
+    }
+    capacity = 0;
+}
+
+BurstResult IRAM_ATTR BurstSampler::capture(uint32_t samples, uint32_t rate) {
+    if (!buffer) return {0, 0, 0};
+    if (samples > capacity) samples = capacity;
+    if (samples > maxSamplesAt(rate)) samples = maxSamplesAt(rate);
+
+    uint32_t clockHz = ESP.getCpuFreqMHz() * 1000000;
+    // Slot period in 1/65536 cycles; 0 runs the unpaced loop
+    uint64_t period = rate ? ((uint64_t)clockHz << 16) / rate : 0;
+    if (period < (12ULL << 16)) period = 0;  // The paced loop needs ~12 cycles a read
+    if (period == 0) samples -= samples % BURST_UNROLL;
+
+    uint8_t* out = buffer;
+    uint8_t* limit = buffer + samples;
+    uint64_t cycles = 0;  // Since the first read, extended past the 32-bit counter's wrap
+    uint32_t seen;
+
+    portDISABLE_INTERRUPTS();
+    seen = ESP.getCycleCount();
+    if (period == 0) {
+        while (out < limit) {
+            out[0] = dedic_gpio_cpu_ll_read_in();
+            out[1] = dedic_gpio_cpu_ll_read_in();
+            out[2] = dedic_gpio_cpu_ll_read_in();
+            out[3] = dedic_gpio_cpu_ll_read_in();
+            out[4] = dedic_gpio_cpu_ll_read_in();
+            out[5] = dedic_gpio_cpu_ll_read_in();
+            out[6] = dedic_gpio_cpu_ll_read_in();
+            out[7] = dedic_gpio_cpu_ll_read_in();
+            out += BURST_UNROLL;
+        }
+    } else {
+        uint64_t due = 0;
+        while (out < limit) {
+            while (cycles < (due >> 16)) {
+                uint32_t now = ESP.getCycleCount();
+                cycles += (uint32_t)(now - seen);
+                seen = now;
+            }
+            *out++ = dedic_gpio_cpu_ll_read_in();
+            due += period;
+        }
+    }
+    cycles += (uint32_t)(ESP.getCycleCount() - seen);
+    portENABLE_INTERRUPTS();
+
+    // Bundle bits to channel bits
+    for (uint32_t i = 0; i < samples; i++) {
+        buffer[i] = (buffer[i] >> inOffset) & channelBits;
+    }
+
+    last.samples = samples;
+    last.cycles = cycles;
+    last.rate = cycles ? (uint32_t)(((uint64_t)samples * clockHz + cycles / 2) / cycles) : 0;
+    return last;
+}
+
+#else
+
+// No dedicated GPIO on this target
+BurstSampler::BurstSampler() : bundle(nullptr), inOffset(0), channelBits(0), buffer(nullptr), capacity(0), last({0, 0, 0}) {}
+BurstSampler::~BurstSampler() {}
+bool BurstSampler::begin(const uint8_t* pins, uint8_t count, uint32_t samples) { return false; }
+void BurstSampler::end() {}
+BurstResult BurstSampler::capture(uint32_t samples, uint32_t rate) { return {0, 0, 0}; }
+
+#endif // CONFIG_IDF_TARGET_ESP32S3
@@ -0,0 +1,220 @@
+#include "dma_sampler.h"
+
+#if CONFIG_IDF_TARGET_ESP32S3
+
+#include <driver/gpio.h>
+#include <driver/periph_ctrl.h>
+#include <esp_heap_caps.h>
+#include <esp_rom_gpio.h>
+#include <soc/gpio_sig_map.h>
+#include <soc/lcd_cam_struct.h>
+
+#ifndef GPIO_MATRIX_CONST_ONE_INPUT
+    #define GPIO_MATRIX_CONST_ONE_INPUT 0x38   // Constant high input of the GPIO matrix
+#endif
+#ifndef GPIO_MATRIX_CONST_ZERO_INPUT
+    #define GPIO_MATRIX_CONST_ZERO_INPUT 0x3C  // Constant low input of the GPIO matrix
+#endif
+
+DmaSampler::DmaSampler(uint8_t pclkLoopbackPin) {
+    pclkPin = pclkLoopbackPin;
+    dataPinCount = 0;
+    actualRate = 0;
+    divider = {0, 0, 0};
+    configured = false;
+    running = false;
+    rxChannel = nullptr;
+    descriptors = nullptr;
+    blockBuffers = nullptr;
+    heldSlot = 0;
+    heldSequence = 0;
+}
+
+DmaSampler::~DmaSampler() {
+    end();
+}
+
+bool DmaSampler::allocateBuffers() {
+    if (!descriptors) {
+        descriptors = (dma_descriptor_t*)heap_caps_calloc(DMA_BLOCK_COUNT, sizeof(dma_descriptor_t),
+                                                          MALLOC_CAP_DMA | MALLOC_CAP_INTERNAL);
+    }
+    if (!blockBuffers) {
+        blockBuffers = (uint8_t*)heap_caps_malloc(DMA_BLOCK_SIZE * DMA_BLOCK_COUNT,
+                                                  MALLOC_CAP_DMA | MALLOC_CAP_INTERNAL);
+    }
+    if (!descriptors || !blockBuffers) {
+        freeBuffers();
+        return false;
+    }
+
+    // Circular chain, one block per descriptor. owner_check is disabled so
+    // the DMA keeps running whether or not the consumer has caught up.
+    for (uint32_t i = 0; i < DMA_BLOCK_COUNT; i++) {
+        descriptors[i].dw0.size = DMA_BLOCK_SIZE;
+        descriptors[i].dw0.length = 0;
+        descriptors[i].dw0.suc_eof = 0;
+        descriptors[i].dw0.owner = DMA_DESCRIPTOR_BUFFER_OWNER_DMA;
+        descriptors[i].buffer = blockBuffers + i * DMA_BLOCK_SIZE;
+        descriptors[i].next = &descriptors[(i + 1) % DMA_BLOCK_COUNT];
+    }
+    return true;
+}
+
+void DmaSampler::freeBuffers() {
+    if (descriptors) {
+        heap_caps_free(descriptors);
+        descriptors = nullptr;
+    }
+    if (blockBuffers) {
+        heap_caps_free(blockBuffers);
+        blockBuffers = nullptr;
+    }
+}
+
+void DmaSampler::routePins() {
+    // Channel c on CAM data bit c, unused data lines tied low
+    for (int i = 0; i < 8; i++) {
+        if (i < dataPinCount) {
+            gpio_set_direction((gpio_num_t)dataPins[i], GPIO_MODE_INPUT);
+            esp_rom_gpio_connect_in_signal(dataPins[i], CAM_DATA_IN0_IDX + i, false);
+        } else {
+            esp_rom_gpio_connect_in_signal(GPIO_MATRIX_CONST_ZERO_INPUT, CAM_DATA_IN0_IDX + i, false);
+        }
+    }
+
+    // Free-running frame: VSYNC/HSYNC/DE held active
+    esp_rom_gpio_connect_in_signal(GPIO_MATRIX_CONST_ONE_INPUT, CAM_V_SYNC_IDX, false);
+    esp_rom_gpio_connect_in_signal(GPIO_MATRIX_CONST_ONE_INPUT, CAM_H_SYNC_IDX, false);
+    esp_rom_gpio_connect_in_signal(GPIO_MATRIX_CONST_ONE_INPUT, CAM_H_ENABLE_IDX, false);
+
+    // Divided LCD_CAM clock out on the loopback pin and back in as PCLK
+    esp_rom_gpio_pad_select_gpio(pclkPin);
+    gpio_set_direction((gpio_num_t)pclkPin, GPIO_MODE_INPUT_OUTPUT);
+    esp_rom_gpio_connect_out_signal(pclkPin, CAM_CLK_IDX, false, false);
+    esp_rom_gpio_connect_in_signal(pclkPin, CAM_PCLK_IDX, false);
+}
+
+void DmaSampler::configureCamera() {
+    LCD_CAM.cam_ctrl.val = 0;
+    LCD_CAM.cam_ctrl.cam_clk_sel = 3;  // PLL_F160M
+    LCD_CAM.cam_ctrl.cam_clkm_div_num = divider.integer & 0xFF;  // 256 is encoded as 0
+    LCD_CAM.cam_ctrl.cam_clkm_div_a = divider.denominator;
+    LCD_CAM.cam_ctrl.cam_clkm_div_b = divider.numerator;
+    LCD_CAM.cam_ctrl.cam_stop_en = 0;
+    LCD_CAM.cam_ctrl.cam_vs_eof_en = 0;  // EOF every cam_rec_data_bytelen + 1 bytes
+    LCD_CAM.cam_ctrl.cam_byte_order = 0;
+    LCD_CAM.cam_ctrl.cam_bit_order = 0;
+
+    LCD_CAM.cam_ctrl1.val = 0;
+    LCD_CAM.cam_ctrl1.cam_rec_data_bytelen = DMA_BLOCK_SIZE - 1;
+    LCD_CAM.cam_ctrl1.cam_2byte_en = 0;
+    LCD_CAM.cam_ctrl1.cam_vh_de_mode_en = 0;
+    LCD_CAM.cam_ctrl1.cam_vsync_filter_en = 0;
+
+    LCD_CAM.cam_rgb_yuv.val = 0;
+    LCD_CAM.cam_ctrl.cam_update = 1;
+}
+
+bool DmaSampler::begin(uint32_t sampleRate, const uint8_t* pins, uint8_t count) {
+    if (sampleRate < getMinHardwareSampleRate()) {
+        return false;  // Below the LCD_CAM divider range, caller falls back to polling
+    }
+    if (count == 0 || count > 8) return false;  // One CAM data line per channel
+    if (running) stop();
+
+    for (uint8_t i = 0; i < count; i++) {
+        dataPins[i] = pins[i];
+    }
+    dataPinCount = count;
+    actualRate = computeClockDivider(CAM_SOURCE_CLOCK_HZ, sampleRate, divider);
+
+    if (!allocateBuffers()) {
+        return false;
+    }
+
+    if (!rxChannel) {
+        gdma_channel_alloc_config_t channelConfig = {};
+        channelConfig.direction = GDMA_CHANNEL_DIRECTION_RX;
+        if (gdma_new_channel(&channelConfig, &rxChannel) != ESP_OK) {
+            rxChannel = nullptr;
+            freeBuffers();
+            return false;
+        }
+        gdma_connect(rxChannel, GDMA_MAKE_TRIGGER(GDMA_TRIG_PERIPH_CAM, 0));
+
+        gdma_strategy_config_t strategy = {};
+        strategy.auto_update_desc = false;
+        strategy.owner_check = false;
+        gdma_apply_strategy(rxChannel, &strategy);
+
+        gdma_rx_event_callbacks_t callbacks = {};
+        callbacks.on_recv_eof = onReceiveEof;
+        gdma_register_rx_event_callbacks(rxChannel, &callbacks, this);
+    }
+
+    periph_module_enable(PERIPH_LCD_CAM_MODULE);
+    routePins();
+    configureCamera();
+
+    configured = true;
+    return true;
+}
+
+void DmaSampler::end() {
+    stop();
+    if (rxChannel) {
+        gdma_disconnect(rxChannel);
+        gdma_del_channel(rxChannel);
+        rxChannel = nullptr;
+    }
+    freeBuffers();
+    configured = false;
+}
+
+bool DmaSampler::start() {
+    if (!configured) return false;
+
+    ring.reset(DMA_BLOCK_COUNT);
+
+    LCD_CAM.cam_ctrl1.cam_reset = 1;
+    LCD_CAM.cam_ctrl1.cam_reset = 0;
+    LCD_CAM.cam_ctrl1.cam_afifo_reset = 1;
+    LCD_CAM.cam_ctrl1.cam_afifo_reset = 0;
+
+    gdma_reset(rxChannel);
+    gdma_start(rxChannel, (intptr_t)&descriptors[0]);
+
+    LCD_CAM.cam_ctrl.cam_update = 1;
+    LCD_CAM.cam_ctrl1.cam_start = 1;
+    running = true;
+    return true;
+}
+
+void DmaSampler::stop() {
+    if (!running) return;
+    LCD_CAM.cam_ctrl1.cam_start = 0;
+    gdma_stop(rxChannel);
+    running = false;
+}
+
+bool IRAM_ATTR DmaSampler::onReceiveEof(gdma_channel_handle_t channel, gdma_event_data_t* event, void* context) {
+    // Descriptors complete strictly in chain order, so a counter is enough
+    DmaSampler* self = static_cast<DmaSampler*>(context);
+    self->ring.publish();
+    return self->notifyBlockReady();
+}
+
+bool DmaSampler::acquireBlock(SampleBlock& block) {
+    if (!ring.acquire(heldSlot, heldSequence)) return false;
+    block.data = blockBuffers + heldSlot * DMA_BLOCK_SIZE;
+    block.count = DMA_BLOCK_SIZE;
+    block.firstIndex = heldSequence * DMA_BLOCK_SIZE;
+    return true;
+}
+
+bool DmaSampler::releaseBlock() {
+    return ring.release();
+}
+
+#endif // CONFIG_IDF_TARGET_ESP32S3
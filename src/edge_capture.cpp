@@ -0,0 +1,78 @@
+#include "edge_capture.h"
+#include <soc/gpio_reg.h>
+
+EdgeCapture::EdgeCapture() {
+    pinCount = 0;
+    lastLevels = 0;
+    edges = 0;
+    overruns = 0;
+    notifyTask = nullptr;
+    attached = false;
+}
+
+EdgeCapture::~EdgeCapture() {
+    end();
+}
+
+bool EdgeCapture::begin(const uint8_t* channelPins, uint8_t count, uint8_t levels, TaskHandle_t task) {
+    if (count == 0 || count > 8) return false;
+    end();
+
+    // Leftovers of the previous run would carry stale cycle counts
+    EdgeEvent stale;
+    while (ring.pop(stale)) {}
+
+    for (uint8_t i = 0; i < count; i++) {
+        pins[i] = channelPins[i];
+    }
+    pinCount = count;
+    lastLevels = levels;
+    edges = 0;
+    overruns = 0;
+    notifyTask = task;
+
+    for (uint8_t i = 0; i < pinCount; i++) {
+        attachInterruptArg(digitalPinToInterrupt(pins[i]), onEdge, this, CHANGE);
+    }
+    attached = true;
+    return true;
+}
+
+void EdgeCapture::end() {
+    if (!attached) return;
+    for (uint8_t i = 0; i < pinCount; i++) {
+        detachInterrupt(digitalPinToInterrupt(pins[i]));
+    }
+    attached = false;
+}
+
+void IRAM_ATTR EdgeCapture::onEdge(void* context) {
+    EdgeCapture* self = static_cast<EdgeCapture*>(context);
+    uint32_t cycles = ESP.getCycleCount();
+    uint32_t in = REG_READ(GPIO_IN_REG);
+
+    uint8_t levels = 0;
+    for (uint8_t c = 0; c < self->pinCount; c++) {
+        levels |= ((in >> self->pins[c]) & 1) << c;
+    }
+
+    // Same levels as last time: the pin went back before it was read
+    if (levels == self->lastLevels) {
+        self->overruns.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    self->lastLevels = levels;
+
+    bool wasEmpty = self->ring.size() == 0;
+    if (!self->ring.push({cycles, levels})) {
+        self->overruns.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    self->edges.fetch_add(1, std::memory_order_relaxed);
+
+    if (wasEmpty && self->notifyTask) {
+        BaseType_t woken = pdFALSE;
+        vTaskNotifyGiveFromISR(self->notifyTask, &woken);
+        if (woken == pdTRUE) portYIELD_FROM_ISR();
+    }
+}
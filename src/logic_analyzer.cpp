@@ -31,22 +31,9 @@ bool LogicAnalyzer::isDualModeCompatible() const {
     return (uartConfig.rxPin == logicConfig.gpioPin);
 }
 
-void LogicAnalyzer::processDualModeData(bool currentState) {
-    // Process Logic Analyzer data
-    if (triggerMode != TRIGGER_NONE && !triggerArmed) {
-        if (checkTrigger(currentState)) {
-            triggerArmed = true;
-            addLogEntry("Dual-mode trigger activated on GPIO" + String(logicConfig.gpioPin));
-            Serial.println("Dual-mode trigger activated!");
-        }
-        lastState = currentState;
-        // Don't return - still process UART data
-    }
-    
-    // Add Logic sample
-    if (triggerArmed) {
-        addSample(currentState);
-    }
+void LogicAnalyzer::processDualModeData() {
+    // Logic samples on the shared pin are taken by the capture task;
+    // this side only decodes the UART stream
     
     // Process UART data simultaneously
     if (uartSerial && uartSerial->available()) {
@@ -77,15 +64,6 @@ void LogicAnalyzer::processDualModeData(bool currentState) {
         addUartEntry(uartRxBuffer + " [DUAL-TIMEOUT]", true);
         uartRxBuffer = "";
     }
-    
-    lastState = currentState;
-    
-    // Stop Logic capture if buffer is full
-    if (isBufferFull()) {
-        addLogEntry("Dual-mode Logic buffer full - stopping capture");
-        capturing = false;
-        Serial.println("Dual-mode Logic buffer full, capture stopped");
-    }
 }
 
 String LogicAnalyzer::getDualModeStatus() const {
@@ -95,7 +73,7 @@ String LogicAnalyzer::getDualModeStatus() const {
     doc["uart_pin"] = uartConfig.rxPin;
     doc["logic_pin"] = logicConfig.gpioPin;
     doc["uart_monitoring"] = uartMonitoringEnabled;
-    doc["logic_capturing"] = capturing;
+    doc["logic_capturing"] = capturing.load();
     doc["logic_samples"] = getBufferUsage();
     doc["uart_entries"] = getUartLogCount();
     
@@ -107,15 +85,77 @@ String LogicAnalyzer::getDualModeStatus() const {
 #endif
 
 LogicAnalyzer::LogicAnalyzer() {
-    writeIndex = 0;
-    readIndex = 0;
+    packedStore.attach(captureMemory, BUFFER_SIZE);
+    transitionStore.attach((uint8_t*)captureMemory, sizeof(captureMemory));
+    activeEncoding = ENCODING_SAMPLES;
+    triggerSeen = false;
+    triggerCaptureIndex = 0;
+    captureFirstIndex = 0;
+    segmentsActive = 1;
+    segmentsDone = 0;
+    rearmRequested = false;
+    transitionHeaderWritten = false;
     capturing = false;
     sampleRate = DEFAULT_SAMPLE_RATE;
     gpio1Pin = CHANNEL_0_PIN;  // GPIO1 pin
+    channelCount = 1;
+    channelPins[0] = CHANNEL_0_PIN;
+    triggerChannel = 0;
+    chunkSamples = CAPTURE_CHUNK_SAMPLES;
+    levelAppender = &LogicAnalyzer::appendCaptureLevelsAs<1, true>;
+    sampleWriter = &LogicAnalyzer::storeSampleAs<BUFFER_RAM, COMPRESS_NONE>;
     triggerMode = TRIGGER_NONE;
-    lastState = false;
+    triggerActive = false;
     triggerArmed = false;
+    triggerProgram.clear();
+    triggerProgramError = nullptr;
     lastSampleTime = 0;
+    captureClock = new CpuCycleClock();
+    ownsCaptureClock = true;
+    achievedRate = 0;
+    
+    // Hardware-paced sampling backend (LCD_CAM + GDMA on ESP32-S3)
+#if CONFIG_IDF_TARGET_ESP32S3
+    sampler = new DmaSampler(DMA_PCLK_LOOPBACK_PIN);
+    ownsSampler = true;
+#else
+    sampler = nullptr;
+    ownsSampler = false;
+#endif
+    samplerActive = false;
+    samplerStartTime = 0;
+    samplerRate = 0;
+    samplerBlocksDrained = 0;
+    edgeActive = false;
+    rmtActive = false;
+    mcpwmActive = false;
+    burstActive = false;
+    burstDone = false;
+    adaptiveActive = false;
+    adaptiveCurrentRate = 0;
+    healthActive = false;
+    scheduleHealth.reset();
+    storeTimer.reset();
+    flushTimer.reset();
+    counterActive = false;
+    counterIntervalStart = 0;
+    activeBackend = BACKEND_POLLED;
+    
+    // Capture task state
+    openChunk = nullptr;
+    captureTaskHandle = nullptr;
+    captureStoreHandle = nullptr;
+    storeLock = nullptr;
+    producerWaiting = false;
+    producerGeneration = 0;
+    producerTimebase = SampleTimebase();
+    producerNextIndex = 0;
+    producerStoring = false;
+    producerLevels = 0;
+    captureGeneration = 0;
+    captureTaskBusy = false;
+    triggerFired = false;
+    captureMissedSamples = 0;
     
     // UART monitoring initialization
     uartSerial = nullptr;
@@ -146,31 +186,65 @@ LogicAnalyzer::LogicAnalyzer() {
     flashSamplesWritten = 0;
     flashWritePosition = 0;
     flashStorageActive = false;
+    flashLastTimestamp = 0;
+    flashRecordsSinceKeyframe = 0;
+    flashChunkCount = 0;
+    flashPageMemory = nullptr;
+    circularFlashMode = false;
+    maxFlashSizeBytes = 0;
+    flashRingChunks = 0;
+    flashStopChunk = 0xFFFFFFFF;
+    memset(&flashHeader, 0, sizeof(flashHeader));
+    memset(&flashChunk, 0, sizeof(flashChunk));
+    flashEdgeLength = 0;
     compressedBuffer = nullptr;
     compressedCount = 0;
     lastTimestamp = 0;
-    lastData = false;
+    compressedBaseTime = 0;
+    compressedLastTime = 0;
+    lastData = 0;
     runLength = 0;
     streamingActive = false;
     streamingCount = 0;
     flashWriteBuffer = nullptr;
+    flashWritePool = nullptr;
+    flashWriterHandle = nullptr;
+    flashFinalizing = false;
+    flashWriteOverruns = 0;
+    flashWriteErrors = 0;
+    flashWriteTimer.reset();
+    rawLogActive = false;
+    rawLogOpen = false;
+    memset(&rawLogMeta, 0, sizeof(rawLogMeta));
     bufferPosition = 0;
-    
-    sampleInterval = 1000000 / sampleRate; // microseconds
 }
 
 LogicAnalyzer::~LogicAnalyzer() {
     stopCapture();
     
+    if (sampler && ownsSampler) {
+        delete sampler;
+        sampler = nullptr;
+    }
+    if (captureClock && ownsCaptureClock) {
+        delete captureClock;
+        captureClock = nullptr;
+    }
+    
     // Cleanup advanced buffers
     if (compressedBuffer) {
         free(compressedBuffer);
         compressedBuffer = nullptr;
     }
-    if (flashWriteBuffer) {
-        free(flashWriteBuffer);
+    if (flashWritePool) {
+        free(flashWritePool);
+        flashWritePool = nullptr;
         flashWriteBuffer = nullptr;
     }
+    if (flashPageMemory) {
+        free(flashPageMemory);
+        flashPageMemory = nullptr;
+    }
     if (flashDataFile) {
         flashDataFile.close();
     }
@@ -179,11 +253,43 @@ LogicAnalyzer::~LogicAnalyzer() {
 void LogicAnalyzer::begin() {
     Serial.println("Initializing M5Stack AtomProbe GPIO Monitor...");
     initializeGPIO1();
+    if (!storeLock) {
+        storeLock = xSemaphoreCreateRecursiveMutex();
+    }
     clearBuffer();
     
+    // Storage runs on the other core, so the producer never has to give up
+    // its core for the ring to be drained
+    if (!captureStoreHandle) {
+        if (xTaskCreatePinnedToCore(captureStoreTaskEntry, "capture_store", CAPTURE_STORE_TASK_STACK, this,
+                                    CAPTURE_STORE_TASK_PRIORITY, &captureStoreHandle, CAPTURE_STORE_TASK_CORE) != pdPASS) {
+            captureStoreHandle = nullptr;
+            Serial.println("Failed to create capture store task - loop() drains the ring");
+            addLogEntry("Capture store task creation failed");
+        }
+    }
+    
+    // Sample producer runs in its own task so capture timing does not depend
+    // on loop(), UART polling, display redraws or WiFi handling
+    if (!captureTaskHandle) {
+        if (xTaskCreatePinnedToCore(captureTaskEntry, "capture", CAPTURE_TASK_STACK, this,
+                                    CAPTURE_TASK_PRIORITY, &captureTaskHandle, CAPTURE_TASK_CORE) != pdPASS) {
+            captureTaskHandle = nullptr;
+            Serial.println("Failed to create capture task");
+            addLogEntry("Capture task creation failed");
+        }
+    }
+    
     // Initialize LittleFS for potential flash storage
     initFlashStorage();
     
+    // Raw log partition, if the partition table has one; the last log
+    // written before a reset is found so the next one starts after it
+    if (rawFlash.begin() && rawLog.begin(&rawFlash, RAW_LOG_SEGMENT_BYTES, FLASH_CHUNK_SIZE, RAW_LOG_ERASE_AHEAD)) {
+        uint32_t slots = rawLog.mount();
+        addLogEntry("Raw log partition: " + String(rawFlash.size() / 1024) + " KB, last log " + String(slots) + " chunks");
+    }
+    
     // Initialize flash storage for Logic Analyzer (default mode)
     if (logicConfig.bufferMode == BUFFER_FLASH) {
         enableFlashBuffering(BUFFER_FLASH, logicConfig.maxFlashSamples);
@@ -196,57 +302,839 @@ void LogicAnalyzer::begin() {
 }
 
 void LogicAnalyzer::initializeGPIO1() {
-    pinMode(gpio1Pin, INPUT);
-    Serial.printf("GPIO1 Pin: %d configured as input\n", gpio1Pin);
+    for (uint8_t c = 0; c < channelCount; c++) {
+        pinMode(channelPins[c], INPUT);
+    }
+    Serial.printf("GPIO1 Pin: %d configured as input (%d channel(s))\n", gpio1Pin, channelCount);
 }
 
 void LogicAnalyzer::process() {
-    // Dual-mode processing (UART + Logic on same pin)
-    if (dualModeActive && uartMonitoringEnabled && capturing) {
-        uint32_t currentTime = micros();
-        if (currentTime - lastSampleTime >= sampleInterval) {
-            bool currentState = readGPIO1();
-            processDualModeData(currentState);
-            lastSampleTime = currentTime;
+    // Process UART data monitoring (dual mode tags lines decoded from the logic pin)
+    if (uartMonitoringEnabled) {
+        if (dualModeActive && capturing) {
+            processDualModeData();
+        } else {
+            processUartData();
         }
+    }
+    
+    // Without the store task, store whatever the capture task has published
+    if (!captureStoreHandle) {
+        drainCaptureRing();
+    }
+    
+    if (counterActive) {
+        serviceCounter();
+    }
+}
+
+// ===== CAPTURE TASK (PRODUCER) =====
+
+void LogicAnalyzer::captureTaskEntry(void* param) {
+    static_cast<LogicAnalyzer*>(param)->captureTaskLoop();
+}
+
+bool IRAM_ATTR LogicAnalyzer::onSamplerBlockReady(void* context) {
+    LogicAnalyzer* self = static_cast<LogicAnalyzer*>(context);
+    BaseType_t woken = pdFALSE;
+    if (self->captureTaskHandle) {
+        vTaskNotifyGiveFromISR(self->captureTaskHandle, &woken);
+    }
+    return woken == pdTRUE;
+}
+
+void LogicAnalyzer::captureTaskLoop() {
+    for (;;) {
+        // Woken by startCapture() and by every finished sampler block
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(100));
+        
+        // Busy is raised before capturing is read, so a stop either sees the
+        // run in progress or the run sees the stop before touching a backend
+        captureTaskBusy = true;
+        if (!capturing) {
+            captureTaskBusy = false;
+            continue;
+        }
+        producerGeneration = captureGeneration;
+        openChunk = nullptr;
+        producerStoring = false;
+        triggerEngine.arm(samplerActive ? samplerRate : sampleRate, readChannels());
+        
+        if (samplerActive) {
+            runSamplerCapture();
+        } else if (edgeActive) {
+            runEdgeCapture();
+        } else if (rmtActive) {
+            runRmtCapture();
+        } else if (mcpwmActive) {
+            runMcpwmCapture();
+        } else if (burstActive) {
+            runBurstCapture();
+        } else {
+            runPolledCapture();
+        }
+        
+        flushCaptureChunk();
+        captureTaskBusy = false;
+    }
+}
+
+void LogicAnalyzer::runSamplerCapture() {
+    producerTimebase = {samplerStartTime, samplerRate, 0, nullptr};
+    while (capturing && captureGeneration == producerGeneration) {
+        drainSampler();
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(10));
+    }
+}
+
+void LogicAnalyzer::runPolledCapture() {
+    // Slot n is due exactly n * clockHz / sampleRate cycles after the start,
+    // so periods below 1 us or with a fractional part are not rounded.
+    // Whichever slot is due when the pin is read gets the reading, so the
+    // stored timeline stays on the fixed-rate grid even when the task is late.
+    CycleTimeline timeline;
+    SlotScheduler schedule;
+    uint32_t clockHz = captureClock->getFrequency();
+    uint64_t updateCycles = (uint64_t)clockHz * CAPTURE_RATE_UPDATE_US / 1000000ULL;
+    uint64_t yieldCycles = (uint64_t)clockHz * CAPTURE_YIELD_INTERVAL_US / 1000000ULL;
+    uint64_t lastUpdate = 0;
+    uint64_t lastYield = 0;
+    uint64_t reads = 0;
+    
+    // An adaptive capture restarts the grid at each rate change: slot 0 of
+    // the current rate is capture index indexBase, due at cycle cycleBase
+    uint32_t rate = sampleRate;
+    uint64_t cycleBase = 0;
+    uint64_t indexBase = 0;
+    uint64_t windowCycles = (uint64_t)clockHz * ADAPTIVE_WINDOW_MS / 1000;
+    uint64_t windowStart = 0;
+    uint32_t windowEdges = 0;
+    uint8_t lastLevels = readChannels();
+    
+    schedule.begin(clockHz, rate);
+    timeline.start(captureClock);
+    producerTimebase = {captureMicros(), rate, 0, nullptr};
+    adaptiveCurrentRate = rate;
+    if (adaptiveActive) {
+        ratePolicy.begin(sampleRate, logicConfig.adaptiveMinRate);
+        rateMap.begin(producerTimebase.baseTime, rate);
+        producerTimebase.rates = &rateMap;
+    }
+    
+    while (capturing && captureGeneration == producerGeneration) {
+        uint64_t now = timeline.now();
+        uint64_t due = cycleBase + schedule.nextDue();
+        
+        if (due > now) {
+            // Low rates sleep through most of the interval instead of spinning
+            uint64_t waitMs = (due - now) * 1000ULL / clockHz;
+            if (waitMs > 2) {
+                vTaskDelay(pdMS_TO_TICKS((uint32_t)waitMs - 1));
+                lastYield = timeline.now();
+            }
+            continue;
+        }
+        
+        if (healthActive) {
+            scheduleHealth.recordRead(now, due, schedule.getPeriodCycles());
+        }
+        
+        // More than a period late means later slots are due as well
+        if (now - due > schedule.getPeriodCycles()) {
+            schedule.jumpTo(schedule.slotAt(now - cycleBase));
+        }
+        uint8_t levels = readChannels();
+        captureSample(levels, indexBase + schedule.nextSlot());
+        schedule.advance();
+        reads++;
+        
+        if (adaptiveActive) {
+            windowEdges += __builtin_popcount(levels ^ lastLevels);
+            lastLevels = levels;
+            if (now - windowStart >= windowCycles) {
+                // Trigger widths are compiled for sampleRate, so the rate
+                // only adapts once nothing is waiting for the trigger
+                uint32_t next = sampleRate;
+                if (triggerArmed) {
+                    next = ratePolicy.update(windowEdges, (now - windowStart) * 1000000ULL / clockHz);
+                } else {
+                    ratePolicy.begin(sampleRate, logicConfig.adaptiveMinRate);
+                }
+                windowStart = now;
+                windowEdges = 0;
+                
+                // The new grid starts at the old grid's next slot
+                if (next != rate && !rateMap.full()) {
+                    cycleBase += schedule.nextDue();
+                    indexBase += schedule.nextSlot();
+                    uint64_t offsetUs = (cycleBase / clockHz) * 1000000ULL + (cycleBase % clockHz) * 1000000ULL / clockHz;
+                    rateMap.add(indexBase, producerTimebase.baseTime + offsetUs, next);
+                    rate = next;
+                    schedule.begin(clockHz, rate);
+                    adaptiveCurrentRate = rate;
+                }
+            }
+        }
+        
+        // loopTask and IDLE1 share this core below the producer's priority,
+        // so they get one tick every CAPTURE_YIELD_INTERVAL_US; the slots
+        // that pass meanwhile are stored as marked gaps
+        if (now - lastYield >= yieldCycles) {
+            vTaskDelay(1);
+            lastYield = timeline.now();
+        }
+        if (now - lastUpdate >= updateCycles) {
+            achievedRate = measureRate(reads, now, clockHz);
+            lastUpdate = now;
+        }
+    }
+    
+    achievedRate = measureRate(reads, timeline.now(), clockHz);
+}
+
+void LogicAnalyzer::runEdgeCapture() {
+    // Edges carry their own CCOUNT, so they land on the same slot grid the
+    // polled schedule uses. Between edges nothing runs except a periodic
+    // fill of the held level up to the present; it stays a little behind
+    // so an edge still waiting in the ring never lands in a filled slot.
+    CycleTimeline timeline;
+    SlotScheduler schedule;
+    uint32_t clockHz = captureClock->getFrequency();
+    uint64_t lagCycles = (uint64_t)clockHz * EDGE_FILL_LAG_US / 1000000ULL;
+    uint8_t levels = readChannels();
+    
+    schedule.begin(clockHz, sampleRate);
+    timeline.start(captureClock);
+    producerTimebase = {captureMicros(), sampleRate, 0, nullptr};
+    producerStoring = true;
+    producerNextIndex = 0;
+    producerLevels = levels;
+    
+    // Attached from this task so the ISR runs on the core whose CCOUNT the timeline reads
+    if (!edgeCapture.begin(channelPins, channelCount, levels, captureTaskHandle)) {
+        addLogEntry("Edge capture could not attach its interrupts");
         return;
     }
     
-    // Process UART data monitoring
-    if (uartMonitoringEnabled) {
-        processUartData();
+    while (capturing && captureGeneration == producerGeneration) {
+        EdgeEvent edge;
+        bool stored = true;
+        while (stored && edgeCapture.pop(edge)) {
+            stored = captureEdge(edge.levels, schedule.slotAt(timeline.at(edge.cycles)));
+        }
+        if (!stored) break;
+        
+        uint64_t now = timeline.now();
+        if (now > lagCycles) {
+            if (!holdCaptureLevels(schedule.slotAt(now - lagCycles))) break;
+            achievedRate = measureRate(producerNextIndex, now - lagCycles, clockHz);
+        }
+        
+        // Woken early by the first edge into an empty ring
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(1));
+    }
+    
+    edgeCapture.end();
+}
+
+void LogicAnalyzer::runRmtCapture() {
+    // The receiver does not time the gaps between frames, so each frame is
+    // anchored to the cycle counter: received at `now`, it started its own
+    // length plus the idle threshold earlier. The gap is the held level.
+    CycleTimeline clock;
+    RmtTimeline timeline;
+    uint32_t clockHz = captureClock->getFrequency();
+    uint8_t level = readChannels();
+    
+    clock.start(captureClock);
+    producerTimebase = {captureMicros(), sampleRate, 0, nullptr};
+    producerStoring = true;
+    producerNextIndex = 0;
+    producerLevels = level;
+    
+    if (!rmtCapture.begin(channelPins[0], logicConfig.rmtIdleUs, logicConfig.rmtFilterNs)) {
+        addLogEntry("RMT receiver could not be started");
+        return;
+    }
+    uint32_t resolution = rmtCapture.getResolution();
+    uint32_t idleTicks = rmtCapture.getIdleTicks();
+    timeline.begin(resolution, sampleRate, level);
+    achievedRate = sampleRate;
+    auto store = [this](uint8_t runLevel, uint64_t slots) { return appendCaptureRun(runLevel, slots); };
+    
+    while (capturing && captureGeneration == producerGeneration) {
+        const uint32_t* frame;
+        size_t count;
+        if (!rmtCapture.receive(frame, count, pdMS_TO_TICKS(10))) continue;
+        
+        uint64_t cycles = clock.now();
+        uint64_t receivedTicks = (cycles / clockHz) * resolution + ((cycles % clockHz) * resolution) / clockHz;
+        uint64_t frameTicks = rmtFrameTicks(frame, count) + idleTicks;
+        bool stored = receivedTicks <= frameTicks || timeline.holdUntil(receivedTicks - frameTicks, store);
+        stored = stored && timeline.feedFrame(frame, count, idleTicks, store);
+        rmtCapture.release(frame);
+        if (!stored) break;
+    }
+    
+    rmtCapture.end();
+}
+
+void LogicAnalyzer::runMcpwmCapture() {
+    // Edge times come from the capture timer latch, so only the start of
+    // the run is placed by the cycle counter; from the first edge on, edge
+    // spacing is exact to a timer tick. Between edges the held level is
+    // filled in as in runEdgeCapture().
+    CycleTimeline timeline;
+    SlotScheduler schedule;
+    uint32_t clockHz = captureClock->getFrequency();
+    uint32_t tickHz = mcpwmCapture.getResolution();
+    uint64_t lagCycles = (uint64_t)clockHz * EDGE_FILL_LAG_US / 1000000ULL;
+    uint8_t levels = readChannels();
+    auto cyclesToTicks = [clockHz, tickHz](uint64_t cycles) {
+        return (cycles / clockHz) * tickHz + ((cycles % clockHz) * tickHz) / clockHz;
+    };
+    
+    schedule.begin(clockHz, sampleRate);
+    timeline.start(captureClock);
+    producerTimebase = {captureMicros(), sampleRate, 0, nullptr};
+    producerStoring = true;
+    producerNextIndex = 0;
+    producerLevels = levels;
+    
+    // Enabled from this task so the ISR runs on the core whose CCOUNT the timeline reads
+    if (!mcpwmCapture.begin(channelPins, channelCount, levels, captureTaskHandle)) {
+        addLogEntry("MCPWM capture could not be enabled");
+        return;
+    }
+    
+    bool anchored = false;
+    uint64_t tickPosition = 0;  // Latest edge, in timer ticks since the start
+    uint32_t lastTicks = 0;
+    uint64_t lastCycles = 0;
+    
+    while (capturing && captureGeneration == producerGeneration) {
+        CaptureEdge edge;
+        bool stored = true;
+        while (stored && mcpwmCapture.pop(edge)) {
+            uint64_t cycles = timeline.at(edge.cycles);
+            if (!anchored) {
+                tickPosition = cyclesToTicks(cycles);
+                anchored = true;
+            } else {
+                // The latched values are exact; the cycle counts only say
+                // how many times the 32-bit timer wrapped in between
+                uint32_t delta = edge.ticks - lastTicks;
+                uint64_t approx = cycles > lastCycles ? cyclesToTicks(cycles - lastCycles) : 0;
+                uint64_t wraps = approx > delta ? (approx - delta + (1ULL << 31)) >> 32 : 0;
+                tickPosition += delta + (wraps << 32);
+            }
+            lastTicks = edge.ticks;
+            lastCycles = cycles;
+            uint64_t slot = (tickPosition / tickHz) * sampleRate + ((tickPosition % tickHz) * sampleRate) / tickHz;
+            stored = captureEdge(edge.levels, slot);
+        }
+        if (!stored) break;
+        
+        uint64_t now = timeline.now();
+        if (now > lagCycles) {
+            if (!holdCaptureLevels(schedule.slotAt(now - lagCycles))) break;
+            achievedRate = measureRate(producerNextIndex, now - lagCycles, clockHz);
+        }
+        
+        // Woken early by the first edge into an empty ring
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(1));
     }
     
-    if (!capturing) return;
+    mcpwmCapture.end();
+}
+
+void LogicAnalyzer::runBurstCapture() {
+    // Nothing else runs on this core during the burst, so the samples are
+    // stored only afterwards, on the timeline of the measured rate
+    uint64_t startTime = captureMicros();
+    BurstResult burst = burstSampler.capture(logicConfig.burstSamples, sampleRate);
+    const uint8_t* data = burstSampler.getData();
+    
+    achievedRate = burst.rate;
+    producerTimebase = {startTime, burst.rate, 0, nullptr};
+    if (burst.samples > 0) {
+        triggerEngine.arm(burst.rate, data[0]);
+    }
+    for (uint32_t i = 0; i < burst.samples && capturing; i++) {
+        if (!captureSample(data[i], i)) break;
+    }
+    burstDone = true;  // loop() stops the capture once this is stored
+}
+
+bool LogicAnalyzer::captureEdge(uint8_t levels, uint64_t slot) {
+    // An edge inside an already stored slot (a pulse shorter than the
+    // period, or an edge that arrived late) takes the next one, so it is
+    // still seen
+    return holdCaptureLevels(slot) && appendCaptureLevels(levels);
+}
+
+bool LogicAnalyzer::holdCaptureLevels(uint64_t slot) {
+    if (slot <= producerNextIndex) return true;
+    return appendCaptureRun(producerLevels, slot - producerNextIndex);
+}
+
+bool LogicAnalyzer::captureSample(uint8_t levels, uint64_t index) {
+    // Samples are stored whether or not the trigger has fired; the storage
+    // side keeps the pre-trigger part in a ring and trims it at the marked
+    // sample, which appendCaptureLevels() finds a word at a time
+    if (!producerStoring) {
+        producerStoring = true;
+        producerNextIndex = index;
+    }
     
-    uint32_t currentTime = micros();
+    // Storage has no per-sample timestamps, so slots that were not read in
+    // time are filled with the previous level to keep later samples aligned;
+    // the gap map tells exports which ones they are
+    if (producerNextIndex < index) {
+        uint64_t gap = index - producerNextIndex;
+        captureGaps.add(producerNextIndex, gap);
+        if (!appendCaptureRun(producerLevels, gap)) return false;
+        captureMissedSamples += gap;
+    }
+    return appendCaptureLevels(levels);
+}
+
+bool LogicAnalyzer::claimCaptureChunk() {
+    // Wait for the storage side rather than dropping: a sampler keeps
+    // filling its DMA ring meanwhile, and the polled schedule catches up
+    // through the missed-slot fill. The store task wakes us after a pop.
+    while (!(openChunk = captureRing.claim())) {
+        if (!capturing || captureGeneration != producerGeneration) {
+            producerWaiting = false;
+            return false;
+        }
+        producerWaiting = true;
+        if (!captureRing.full()) continue;  // Popped before the flag was seen
+        ulTaskNotifyTake(pdTRUE, 1);
+    }
+    producerWaiting = false;
+    openChunk->generation = producerGeneration;
+    openChunk->count = 0;
+    openChunk->planeWords = chunkSamples / 32;
+    openChunk->timebase = producerTimebase;
+    openChunk->timebase.firstIndex = producerNextIndex;
+    openChunk->triggerOffset = CAPTURE_NO_TRIGGER;
+    return true;
+}
+
+void LogicAnalyzer::completeCaptureWord(uint32_t first, uint8_t levels) {
+    if (!triggerArmed) {
+        // Every completed word of the planes goes through the trigger program
+        int32_t hit = triggerEngine.feed(&openChunk->bits[first >> 5], openChunk->planeWords, channelCount, 32);
+        if (hit >= 0) {
+            openChunk->triggerOffset = first + hit;
+            triggerArmed = true;
+            triggerFired = true;
+        }
+    } else if (rearmRequested) {
+        // Next segment is ready: evaluation resumes with the following word
+        rearmRequested = false;
+        triggerEngine.arm(producerTimebase.rate, levels);
+        triggerArmed = false;
+    }
+}
+
+bool LogicAnalyzer::appendCaptureLevels(uint8_t levels) {
+    return (this->*levelAppender)(levels);
+}
+
+template <uint8_t Channels, bool Triggered>
+bool LogicAnalyzer::appendCaptureLevelsAs(uint8_t levels) {
+    if (!openChunk && !claimCaptureChunk()) return false;
+    
+    // One bit in each channel plane
+    uint32_t n = openChunk->count;
+    uint32_t bit = n & 31;
+    writePlaneBits<Channels>(&openChunk->bits[n >> 5], openChunk->planeWords, bit, levels);
+    
+    // Without a trigger program there is nothing to evaluate or re-arm
+    if (Triggered && bit == 31) {
+        completeCaptureWord(n & ~31u, levels);
+    }
+    openChunk->count = n + 1;
+    producerNextIndex++;
+    producerLevels = levels;
     
-    // Check if it's time for next sample
-    if (currentTime - lastSampleTime >= sampleInterval) {
-        bool currentState = readGPIO1();
+    if (openChunk->count == chunkSamples) {
+        captureRing.publish();
+        openChunk = nullptr;
+    }
+    return true;
+}
+
+bool LogicAnalyzer::appendCaptureRun(uint8_t levels, uint64_t count) {
+    while (count > 0) {
+        if (!openChunk && !claimCaptureChunk()) return false;
+        uint32_t n = openChunk->count;
         
-        // Check trigger condition
-        if (triggerMode != TRIGGER_NONE && !triggerArmed) {
-            if (checkTrigger(currentState)) {
+        // Single samples up to a word boundary and for a short tail
+        if ((n & 31) || count < 32) {
+            if (!appendCaptureLevels(levels)) return false;
+            count--;
+            continue;
+        }
+        
+        // Whole words: every plane word is all zeros or all ones
+        uint64_t words = count / 32;
+        if (words > (chunkSamples - n) / 32) words = (chunkSamples - n) / 32;
+        for (uint64_t w = 0; w < words; w++, n += 32) {
+            uint32_t* word = &openChunk->bits[n >> 5];
+            for (uint8_t c = 0; c < channelCount; c++) {
+                *word = ((levels >> c) & 1) ? 0xFFFFFFFFu : 0;
+                word += openChunk->planeWords;
+            }
+            completeCaptureWord(n, levels);
+        }
+        openChunk->count = n;
+        producerNextIndex += words * 32;
+        producerLevels = levels;
+        count -= words * 32;
+        
+        if (openChunk->count == chunkSamples) {
+            captureRing.publish();
+            openChunk = nullptr;
+        }
+    }
+    return true;
+}
+
+void LogicAnalyzer::flushCaptureChunk() {
+    // An empty claimed slot was never published, so it can simply be abandoned
+    if (openChunk && openChunk->count > 0) {
+        uint32_t tail = openChunk->count & 31;
+        if (tail && !triggerArmed) {
+            uint32_t first = openChunk->count - tail;
+            int32_t hit = triggerEngine.feed(&openChunk->bits[first >> 5], openChunk->planeWords, channelCount, tail);
+            if (hit >= 0) {
+                openChunk->triggerOffset = first + hit;
                 triggerArmed = true;
-                addLogEntry("Trigger activated on GPIO1");
-                Serial.println("Trigger activated!");
+                triggerFired = true;
             }
-            lastState = currentState;
-            return; // Don't sample until triggered
+        }
+        captureRing.publish();
+    }
+    openChunk = nullptr;
+}
+
+void LogicAnalyzer::drainSampler() {
+    // Each byte's capture index is its sampler index, so the timeline is the
+    // sampler's; blocks lost to an overrun show up as missed slots
+    SampleBlock block;
+    uint8_t channelBits = (uint8_t)((1u << channelCount) - 1);  // CAM data line c = channel c
+    
+    while (capturing && sampler->acquireBlock(block)) {
+        for (uint32_t i = 0; i < block.count && capturing; i++) {
+            captureSample(block.data[i] & channelBits, block.firstIndex + i);
         }
         
-        addSample(currentState);
-        lastSampleTime = currentTime;
-        lastState = currentState;
+        sampler->releaseBlock();  // Late blocks are counted by the sampler as overruns
+        samplerBlocksDrained++;
+    }
+}
+
+// ===== STORAGE SIDE (CONSUMER, store task) =====
+
+namespace {
+// Held while the stores change hands: the ring has one consumer, whether
+// that is the store task or a start / stop from the web task
+class StoreLock {
+public:
+    explicit StoreLock(SemaphoreHandle_t lock) : lock(lock) {
+        if (lock) xSemaphoreTakeRecursive(lock, portMAX_DELAY);
+    }
+    ~StoreLock() {
+        if (lock) xSemaphoreGiveRecursive(lock);
+    }
+private:
+    SemaphoreHandle_t lock;
+};
+}
+
+void LogicAnalyzer::captureStoreTaskEntry(void* param) {
+    static_cast<LogicAnalyzer*>(param)->captureStoreLoop();
+}
+
+void LogicAnalyzer::captureStoreLoop() {
+    for (;;) {
+        // Polled each tick; a chunk is at least a few ms of samples
+        ulTaskNotifyTake(pdTRUE, 1);
+        drainCaptureRing();
+    }
+}
+
+void LogicAnalyzer::drainCaptureRing() {
+    StoreLock hold(storeLock);
+    bool staging = logicConfig.bufferMode != BUFFER_RAM;
+    CaptureChunk* chunk;
+    while ((chunk = captureRing.front()) != nullptr) {
+        // Chunks from an earlier capture (or after the buffer filled) are dropped
+        if (chunk->generation == captureGeneration && !isBufferFull()) {
+            // Flash modes stage through RAM; leave the chunk queued until flash catches up
+            if (staging && !stagingHasRoom(chunk->count)) break;
+            
+            // Samples before the trigger go into the wrapping window, the
+            // rest in after it has been trimmed
+            uint32_t split = chunk->triggerOffset < chunk->count ? chunk->triggerOffset : chunk->count;
+            stageChunkBits(chunk, 0, split);
+            if (split < chunk->count) {
+                applyTrigger(chunk->timebase.firstIndex + split);
+                stageChunkBits(chunk, split, chunk->count - split);
+            }
+        }
+        captureRing.pop();
+        if (producerWaiting && captureTaskHandle) {
+            xTaskNotifyGive(captureTaskHandle);
+        }
         
-        // Stop if buffer is full
-        if (isBufferFull()) {
+        if (capturing && flashSampleLimitReached()) {
+            addLogEntry("Flash capture reached " + String(FLASH_MAX_CAPTURE_SAMPLES) +
+                        " samples - stopping before sample numbers wrap");
+            stopCapture();
+        }
+        
+        // A segmented capture moves on to the next slice instead of stopping
+        if (capturing && isBufferFull() && !(segmentsActive > 1 && finishSegment())) {
             addLogEntry("Buffer full - auto-stopping capture");
             stopCapture();
             Serial.println("Buffer full, capture stopped");
         }
     }
+    
+    if (staging) {
+        uint64_t start = healthActive ? captureMicros() : 0;
+        writeStagedData(FLASH_DRAIN_SAMPLES);
+        if (healthActive) storeTimer.add((uint32_t)(captureMicros() - start));
+    }
+    
+    // A burst ends on its own once the producer has handed over every sample
+    if (capturing && burstDone && !captureTaskBusy && captureRing.size() == 0) {
+        const BurstResult& burst = burstSampler.getLastResult();
+        addLogEntry("Burst: " + String(burst.samples) + " samples in " + String(burst.cycles) + " cycles (" +
+                    String(burst.rate) + " Hz)");
+        stopCapture();
+    }
+    
+    if (triggerFired.exchange(false)) {
+        addLogEntry("Trigger activated on GPIO" + String(gpio1Pin) + " (pre-trigger " +
+                    String(logicConfig.preTriggerPercent) + "%)");
+        Serial.println("Trigger activated!");
+    }
+}
+
+void LogicAnalyzer::stageChunkBits(const CaptureChunk* chunk, uint32_t first, uint32_t count) {
+    if (count == 0) return;
+    
+    SampleTimebase tb = chunk->timebase;
+    tb.firstIndex += first;
+    if (usesEnvelopeStore()) {
+        if (!envelopeStore.hasTimebase()) {
+            envelopeStore.setTimebase(tb);
+            captureFirstIndex = tb.firstIndex;
+        }
+        envelopeStore.append(chunk->bits, chunk->planeWords, first, count);
+    } else if (usesTransitionStore()) {
+        if (!transitionStore.hasTimebase()) {
+            transitionStore.setTimebase(tb);
+            captureFirstIndex = tb.firstIndex;
+        }
+        transitionStore.append(chunk->bits, chunk->planeWords, first, count);
+    } else {
+        if (!packedStore.hasTimebase()) {
+            packedStore.setTimebase(tb);
+            captureFirstIndex = tb.firstIndex;
+        }
+        packedStore.append(chunk->bits, chunk->planeWords, first, count);
+    }
+}
+
+bool LogicAnalyzer::stagingHasRoom(uint32_t samples) const {
+    // A run of n samples encodes to at most n one-byte deltas plus one long one
+    if (usesTransitionStore()) {
+        return transitionStore.isWrapping() || transitionStore.getFreeBytes() >= samples + VARINT_MAX_BYTES;
+    }
+    return packedStore.isWrapping() || packedStore.getFreeSpace() >= samples;
+}
+
+void LogicAnalyzer::applyTrigger(uint64_t captureIndex) {
+    // Keep preTriggerPercent of the window before the trigger and leave the
+    // rest for what follows. Both stores drop from the front in place, so
+    // nothing is copied. In the flash modes the window is the flash
+    // allocation, limited to what the RAM staging store can hold.
+    uint32_t percent = logicConfig.preTriggerPercent;
+    bool flashBacked = logicConfig.bufferMode == BUFFER_FLASH || logicConfig.bufferMode == BUFFER_STREAMING;
+    
+    if (flashBacked && flashRingChunks) {
+        // The flash ring is the window and already holds what came before;
+        // writing goes on until the rest of the window is after the trigger
+        uint32_t after = (uint32_t)((uint64_t)flashRingChunks * (100 - percent) / 100);
+        if (after >= flashRingChunks) after = flashRingChunks - 1;
+        flashStopChunk = flashChunkCount + after;
+    } else if (usesEnvelopeStore()) {
+        // Whole buckets only; the bucket holding the trigger is still open
+        envelopeStore.trimTo((uint32_t)((uint64_t)envelopeStore.getCapacity() * percent / 100));
+        envelopeStore.setWrap(false);
+        captureFirstIndex = envelopeStore.getTimebase().firstIndex;
+    } else if (usesTransitionStore()) {
+        uint64_t window = transitionStore.getCapacityBytes();
+        uint64_t flashBytes = (uint64_t)logicConfig.maxFlashSamples * sizeof(FlashSampleRecord);
+        if (flashBacked && flashBytes < window) window = flashBytes;
+        transitionStore.trimBytes((uint32_t)(window * percent / 100));
+        transitionStore.setWrap(false);
+        captureFirstIndex = transitionStore.getTimebase().firstIndex;
+    } else {
+        uint64_t window = packedStore.getCapacity();
+        if (flashBacked && logicConfig.maxFlashSamples < window) window = logicConfig.maxFlashSamples;
+        packedStore.trimTo((uint32_t)(window * percent / 100));
+        packedStore.setWrap(false);
+        captureFirstIndex = packedStore.getTimebase().firstIndex;
+    }
+    
+    triggerCaptureIndex = captureIndex;
+    triggerSeen = true;
+    flashHeader.trigger_index = getTriggerIndex();
+}
+
+uint32_t LogicAnalyzer::getTriggerIndex() const {
+    if (!triggerSeen) return CAPTURE_NO_TRIGGER;
+    return (uint32_t)(triggerCaptureIndex - captureFirstIndex);
+}
+
+void LogicAnalyzer::writeStagedData(uint32_t limit) {
+    if (usesTransitionStore()) {
+        writeTransitions(limit);
+    } else {
+        writePackedSamples(limit);
+    }
+}
+
+void LogicAnalyzer::writePackedSamples(uint32_t limit) {
+    // Nothing in a wrapping pre-trigger window is final yet
+    if (packedStore.isWrapping()) return;
+    
+    // The store only stages samples here; unpack them for the flash writers
+    auto it = packedStore.iterate(0, limit);
+    Sample sample;
+    uint32_t written = 0;
+    while (!isBufferFull() && it.next(sample.timestamp, sample.data)) {
+        storeSample(sample);
+        written++;
+    }
+    packedStore.consume(written);
+}
+
+void LogicAnalyzer::writeTransitions(uint32_t limit) {
+    if (transitionStore.isWrapping()) return;
+    
+    if (logicConfig.bufferMode != BUFFER_FLASH &&
+        !(logicConfig.bufferMode == BUFFER_STREAMING && streamingActive)) {
+        transitionStore.consumeBytes(transitionStore.getUsedBytes());
+        return;
+    }
+    
+    // Encoded edges go to flash as they are; the starting levels go into
+    // the chunk headers
+    if (!transitionHeaderWritten) {
+        transitionHeaderWritten = true;
+        flashEdgeSample = 0;
+        flashEdgeLevels = transitionStore.getStartLevels();
+        flashEdgeLength = 0;
+        flashEdgeShift = 0;
+        flashEdgeDelta = 0;
+        flashHeader.first_timestamp = transitionStore.timestampAt(0);
+        flashHeader.sample_rate = transitionStore.getTimebase().rate;
+    }
+    
+    // Bytes are collected until an edge is complete, so a chunk can be
+    // decoded without the one before it
+    bool multiChannel = transitionStore.getChannels() > 1;
+    const uint8_t* data;
+    uint32_t run;
+    while (limit > 0 && (run = transitionStore.peekBytes(data)) > 0) {
+        if (run > limit) run = limit;
+        for (uint32_t i = 0; i < run; i++) {
+            uint8_t byte = data[i];
+            bool levelsByte = multiChannel && flashEdgeLength > 0 &&
+                              !(flashEdgeBytes[flashEdgeLength - 1] & 0x80);
+            flashEdgeBytes[flashEdgeLength++] = byte;
+            uint8_t levels;
+            if (levelsByte) {
+                levels = byte;
+            } else {
+                flashEdgeDelta |= (uint64_t)(byte & 0x7F) << flashEdgeShift;
+                flashEdgeShift += 7;
+                if ((byte & 0x80) || multiChannel) continue;
+                levels = flashEdgeLevels ^ 1;  // One channel: every edge toggles it
+            }
+            
+            if (beginFlashWrite(flashEdgeLength)) {
+                flashChunk.first_sample = flashEdgeSample;
+                flashChunk.first_timestamp = transitionStore.timestampAt(flashEdgeSample);
+                flashChunk.levels = flashEdgeLevels;
+                flashChunk.sample_count = 0;
+            }
+            writeFlashBytes(flashEdgeBytes, flashEdgeLength);
+            flashEdgeSample += flashEdgeDelta;
+            flashEdgeLevels = levels;
+            flashChunk.sample_count = flashEdgeSample - flashChunk.first_sample;
+            flashEdgeLength = 0;
+            flashEdgeShift = 0;
+            flashEdgeDelta = 0;
+        }
+        transitionStore.consumeBytes(run);
+        limit -= run;
+    }
+    
+    // The equivalent sample count keeps the flash usage figures in samples;
+    // flashSampleLimitReached() stops the capture before it passes 32 bits
+    flashSamplesWritten = (uint32_t)transitionStore.getSampleCount();
+    if (flashSamplesWritten > 0) {
+        flashHeader.last_timestamp = transitionStore.timestampAt(flashSamplesWritten - 1);
+    }
+}
+
+bool LogicAnalyzer::usesEnvelopeStore() const {
+    return activeEncoding == ENCODING_ENVELOPE;
+}
+
+bool LogicAnalyzer::usesTransitionStore() const {
+    // Compressed mode already run-length encodes unpacked samples
+    return activeEncoding == ENCODING_TRANSITIONS && logicConfig.bufferMode != BUFFER_COMPRESSED;
+}
+
+void LogicAnalyzer::waitForCaptureTaskIdle() {
+    // The producer notices capturing == false within one block, sample or
+    // burst (at most BURST_MAX_MASKED_US). No timeout: callers free backend
+    // buffers the producer may still be reading or writing.
+    while (captureTaskBusy) {
+        delay(1);
+    }
+}
+
+bool LogicAnalyzer::startSampler() {
+    if (!sampler) return false;
+    
+    if (!sampler->begin(sampleRate, channelPins, channelCount)) {
+        addLogEntry("Hardware sampler unavailable at " + String(sampleRate) + " Hz - using polled capture");
+        return false;
+    }
+    
+    samplerRate = sampler->getActualSampleRate();
+    achievedRate = samplerRate;
+    samplerBlocksDrained = 0;
+    sampler->setBlockReadyCallback(onSamplerBlockReady, this);
+    samplerStartTime = captureMicros();
+    if (!sampler->start()) {
+        addLogEntry("Hardware sampler failed to start - using polled capture");
+        return false;
+    }
+    
+    addLogEntry(String(sampler->getName()) + " sampling at " + String(samplerRate) + " Hz");
+    return true;
 }
 
 bool LogicAnalyzer::readGPIO1() {
@@ -255,65 +1143,275 @@ bool LogicAnalyzer::readGPIO1() {
     return (REG_READ(GPIO_IN_REG) & (1 << gpio1Pin)) != 0;
 }
 
-bool LogicAnalyzer::checkTrigger(bool currentState) {
-    switch (triggerMode) {
-        case TRIGGER_RISING_EDGE:
-            return !lastState && currentState;
-        case TRIGGER_FALLING_EDGE:
-            return lastState && !currentState;
-        case TRIGGER_BOTH_EDGES:
-            return lastState != currentState;
-        case TRIGGER_HIGH_LEVEL:
-            return currentState;
-        case TRIGGER_LOW_LEVEL:
-            return !currentState;
-        default:
-            return true;
+uint8_t LogicAnalyzer::readChannels() {
+    // Same single register read as readGPIO1(); the channel bits are
+    // gathered from it, so extra channels cost a shift each
+    uint32_t in = REG_READ(GPIO_IN_REG);
+    if (channelCount == 1) {
+        return (in >> channelPins[0]) & 1;
     }
+    uint8_t levels = 0;
+    for (uint8_t c = 0; c < channelCount; c++) {
+        levels |= ((in >> channelPins[c]) & 1) << c;
+    }
+    return levels;
 }
 
-void LogicAnalyzer::addSample(bool data) {
-    Sample sample;
-    sample.timestamp = micros();
-    sample.data = data;
-    
-    // Handle different buffer modes
-    switch (logicConfig.bufferMode) {
-        case BUFFER_RAM:
-            // Standard RAM buffer
-            buffer[writeIndex] = sample;
-            writeIndex = (writeIndex + 1) % BUFFER_SIZE;
-            break;
-            
-        case BUFFER_FLASH:
-            // Write directly to flash
-            writeToFlash(sample);
+void LogicAnalyzer::applyChannelLayout() {
+    // Chunks and the RAM arena are split into one bit plane per channel
+    chunkSamples = (CAPTURE_CHUNK_SAMPLES / channelCount) & ~31u;
+    attachCaptureMemory(0);
+}
+
+void LogicAnalyzer::attachCaptureMemory(uint8_t segment) {
+    if (segmentsActive <= 1) {
+        packedStore.attach(captureMemory, BUFFER_SIZE);
+        transitionStore.attach((uint8_t*)captureMemory, sizeof(captureMemory));
+        envelopeStore.attach(captureMemory, sizeof(captureMemory));
+    } else {
+        uint32_t sliceWords = (BUFFER_SIZE / 32) / segmentsActive;
+        uint32_t* slice = captureMemory + segment * sliceWords;
+        packedStore.attach(slice, sliceWords * 32);
+        transitionStore.attach((uint8_t*)slice, sliceWords * sizeof(uint32_t));
+    }
+    packedStore.setChannels(channelCount);
+    transitionStore.setChannels(channelCount);
+    envelopeStore.setChannels(channelCount);
+    envelopeStore.setBucketSamples(logicConfig.envelopeSamples);
+}
+
+CaptureSegment LogicAnalyzer::snapshotCapture() const {
+    CaptureSegment segment;
+    segment.transitions = usesTransitionStore();
+    segment.samples = packedStore.snapshot();
+    segment.edges = transitionStore.snapshot();
+    segment.sampleCount = segment.transitions ? segment.edges.sampleCount : segment.samples.count;
+    segment.triggerIndex = getTriggerIndex();
+    const SampleTimebase& tb = segment.transitions ? segment.edges.timebase : segment.samples.timebase;
+    segment.triggerTime = tb.timestampAt(triggerSeen ? triggerCaptureIndex : tb.firstIndex);
+    return segment;
+}
+
+bool LogicAnalyzer::finishSegment() {
+    // The filled slice is left as it is; the next one starts a fresh
+    // pre-trigger window while the producer keeps sampling
+    segments[segmentsDone] = snapshotCapture();
+    segmentsDone++;
+    addLogEntry("Segment " + String(segmentsDone) + "/" + String(segmentsActive) + " captured");
+    if (segmentsDone >= segmentsActive) return false;
+    
+    attachCaptureMemory(segmentsDone);
+    triggerSeen = false;
+    if (triggerActive) {
+        packedStore.setWrap(true);
+        transitionStore.setWrap(true);
+        rearmRequested = true;
+    }
+    return true;
+}
+
+void LogicAnalyzer::loadTriggerEngine() {
+    // The simple modes are one-stage programs on the trigger channel
+    TriggerProgram program;
+    program.clear();
+    switch (triggerMode) {
+        case TRIGGER_RISING_EDGE:  program.addStage(TRIGGER_OP_RISE, triggerChannel); break;
+        case TRIGGER_FALLING_EDGE: program.addStage(TRIGGER_OP_FALL, triggerChannel); break;
+        case TRIGGER_BOTH_EDGES:   program.addStage(TRIGGER_OP_EDGE, triggerChannel); break;
+        case TRIGGER_HIGH_LEVEL:   program.addStage(TRIGGER_OP_HIGH, triggerChannel); break;
+        case TRIGGER_LOW_LEVEL:    program.addStage(TRIGGER_OP_LOW, triggerChannel); break;
+        case TRIGGER_PULSE_SHORTER:
+        case TRIGGER_PULSE_LONGER:
+        case TRIGGER_GLITCH:
+        case TRIGGER_TIMEOUT: {
+            // Width triggers are compared at edges only, see TriggerEngine::scanEdges()
+            TriggerSpan width = {logicConfig.triggerWidthNs, false};
+            TriggerOp op = triggerMode == TRIGGER_PULSE_LONGER ? TRIGGER_OP_PULSE_LONGER :
+                           triggerMode == TRIGGER_TIMEOUT ? TRIGGER_OP_IDLE : TRIGGER_OP_PULSE_SHORTER;
+            program.addStage(op, triggerChannel, 1, width);
+            program.stages[0].value = triggerMode == TRIGGER_GLITCH ? TRIGGER_PULSE_EITHER : logicConfig.triggerPulseLevel;
             break;
-            
-        case BUFFER_STREAMING:
-            // Continuous streaming
-            processStreamingSample(sample);
+        }
+        case TRIGGER_SEQUENCE:
+            // Channels may have changed since the program was set
+            triggerProgramError = program.parse(logicConfig.triggerProgram.c_str(), triggerChannel, channelCount);
+            if (triggerProgramError) {
+                addLogEntry("Trigger program rejected: " + String(triggerProgramError));
+                program.clear();
+            }
             break;
-            
-        case BUFFER_COMPRESSED:
-            // Compressed storage
-            compressSample(sample);
+        default:
             break;
     }
+    triggerEngine.load(program);
+}
+
+void LogicAnalyzer::storeSample(const Sample& sample) {
+    (this->*sampleWriter)(sample);
+}
+
+template <BufferMode Mode, CompressionType Codec>
+void LogicAnalyzer::storeSampleAs(const Sample& sample) {
+    // Mode and Codec are constants here, so each instantiation keeps only its
+    // own writer (RAM samples stay in the packed store)
+    if (Mode == BUFFER_FLASH) {
+        writeToFlash(sample);
+    } else if (Mode == BUFFER_STREAMING) {
+        streamSampleAs<Codec>(sample);
+    } else if (Mode == BUFFER_COMPRESSED) {
+        compressSampleAs<Codec>(sample);
+    }
+}
+
+void LogicAnalyzer::selectSampleWriter() {
+    // One row per buffer mode, one column per compression type
+    static const SampleWriter writers[4][4] = {
+        {&LogicAnalyzer::storeSampleAs<BUFFER_RAM, COMPRESS_NONE>, &LogicAnalyzer::storeSampleAs<BUFFER_RAM, COMPRESS_RLE>,
+         &LogicAnalyzer::storeSampleAs<BUFFER_RAM, COMPRESS_DELTA>, &LogicAnalyzer::storeSampleAs<BUFFER_RAM, COMPRESS_HYBRID>},
+        {&LogicAnalyzer::storeSampleAs<BUFFER_FLASH, COMPRESS_NONE>, &LogicAnalyzer::storeSampleAs<BUFFER_FLASH, COMPRESS_RLE>,
+         &LogicAnalyzer::storeSampleAs<BUFFER_FLASH, COMPRESS_DELTA>, &LogicAnalyzer::storeSampleAs<BUFFER_FLASH, COMPRESS_HYBRID>},
+        {&LogicAnalyzer::storeSampleAs<BUFFER_STREAMING, COMPRESS_NONE>, &LogicAnalyzer::storeSampleAs<BUFFER_STREAMING, COMPRESS_RLE>,
+         &LogicAnalyzer::storeSampleAs<BUFFER_STREAMING, COMPRESS_DELTA>, &LogicAnalyzer::storeSampleAs<BUFFER_STREAMING, COMPRESS_HYBRID>},
+        {&LogicAnalyzer::storeSampleAs<BUFFER_COMPRESSED, COMPRESS_NONE>, &LogicAnalyzer::storeSampleAs<BUFFER_COMPRESSED, COMPRESS_RLE>,
+         &LogicAnalyzer::storeSampleAs<BUFFER_COMPRESSED, COMPRESS_DELTA>, &LogicAnalyzer::storeSampleAs<BUFFER_COMPRESSED, COMPRESS_HYBRID>},
+    };
+    uint32_t mode = logicConfig.bufferMode <= BUFFER_COMPRESSED ? logicConfig.bufferMode : BUFFER_RAM;
+    uint32_t codec = logicConfig.compression <= COMPRESS_HYBRID ? logicConfig.compression : COMPRESS_NONE;
+    sampleWriter = writers[mode][codec];
 }
 
 void LogicAnalyzer::startCapture() {
+    StoreLock hold(storeLock);
+    
+    // The previous run must have left the producer before its state is reset
+    capturing = false;
+    waitForCaptureTaskIdle();
+    
+    activeEncoding = logicConfig.encoding;
+    if (activeEncoding == ENCODING_ENVELOPE && logicConfig.bufferMode != BUFFER_RAM) {
+        addLogEntry("Envelope capture is RAM only - storing every sample");
+        activeEncoding = ENCODING_SAMPLES;
+    }
+    segmentsActive = logicConfig.bufferMode == BUFFER_RAM && activeEncoding != ENCODING_ENVELOPE ?
+                     logicConfig.segmentCount : 1;
+    applyChannelLayout();
     clearBuffer();
-    triggerArmed = (triggerMode == TRIGGER_NONE);
-    lastSampleTime = micros();
+    bool flashCapture = logicConfig.bufferMode == BUFFER_FLASH || logicConfig.bufferMode == BUFFER_STREAMING;
+    rawLogActive = logicConfig.rawPartition && flashCapture && rawLog.isReady();
+    if (logicConfig.rawPartition && flashCapture && !rawLogActive) {
+        addLogEntry("No raw log partition - capturing to LittleFS");
+    }
+    checkFlashSpaceAndRotate();
+    loadTriggerEngine();
+    // A mode without a program has nothing to wait for; the configured
+    // mode stays as it is for the next capture
+    triggerActive = triggerMode != TRIGGER_NONE && triggerEngine.hasProgram();
+    triggerSeen = false;
+    transitionHeaderWritten = false;
+    flashHeader.trigger_index = CAPTURE_NO_TRIGGER;
+    
+    // Fix the pipeline for this capture: channel count and trigger on the
+    // producer side, buffer mode and codec on the storage side
+    static_assert(MAX_CHANNELS == 8, "One appender per channel count");
+    static const LevelAppender appenders[2][MAX_CHANNELS] = {
+        {&LogicAnalyzer::appendCaptureLevelsAs<1, false>, &LogicAnalyzer::appendCaptureLevelsAs<2, false>,
+         &LogicAnalyzer::appendCaptureLevelsAs<3, false>, &LogicAnalyzer::appendCaptureLevelsAs<4, false>,
+         &LogicAnalyzer::appendCaptureLevelsAs<5, false>, &LogicAnalyzer::appendCaptureLevelsAs<6, false>,
+         &LogicAnalyzer::appendCaptureLevelsAs<7, false>, &LogicAnalyzer::appendCaptureLevelsAs<8, false>},
+        {&LogicAnalyzer::appendCaptureLevelsAs<1, true>, &LogicAnalyzer::appendCaptureLevelsAs<2, true>,
+         &LogicAnalyzer::appendCaptureLevelsAs<3, true>, &LogicAnalyzer::appendCaptureLevelsAs<4, true>,
+         &LogicAnalyzer::appendCaptureLevelsAs<5, true>, &LogicAnalyzer::appendCaptureLevelsAs<6, true>,
+         &LogicAnalyzer::appendCaptureLevelsAs<7, true>, &LogicAnalyzer::appendCaptureLevelsAs<8, true>},
+    };
+    levelAppender = appenders[triggerActive][channelCount - 1];
+    selectSampleWriter();
+    if (triggerActive) {
+        // Record continuously until the trigger fires so the pre-trigger
+        // part exists; a circular flash capture keeps it in the ring
+        packedStore.setWrap(flashRingChunks == 0);
+        transitionStore.setWrap(flashRingChunks == 0);
+        envelopeStore.setWrap(true);
+    }
+    captureGeneration++;
+    captureMissedSamples = 0;
+    captureGaps.clear();
+    achievedRate = 0;
+    rearmRequested = false;
+    triggerArmed = !triggerActive;
+    triggerFired = false;
+    samplerActive = logicConfig.captureBackend == BACKEND_AUTO && !logicConfig.adaptiveRate && startSampler();
+    edgeActive = logicConfig.captureBackend == BACKEND_EDGE_IRQ;
+    if (edgeActive && counterActive) {
+        addLogEntry("Counter mode holds the pin interrupt - using polled capture");
+        edgeActive = false;
+    }
+    rmtActive = logicConfig.captureBackend == BACKEND_RMT;
+    if (rmtActive && channelCount > 1) {
+        addLogEntry("RMT capture watches one pin - using polled capture for " + String(channelCount) + " channels");
+        rmtActive = false;
+    }
+    mcpwmActive = logicConfig.captureBackend == BACKEND_MCPWM;
+    if (mcpwmActive && channelCount > MCPWM_CAPTURE_CHANNELS) {
+        addLogEntry("MCPWM capture has " + String(MCPWM_CAPTURE_CHANNELS) + " inputs - using polled capture for " +
+                    String(channelCount) + " channels");
+        mcpwmActive = false;
+    }
+    burstActive = logicConfig.captureBackend == BACKEND_BURST;
+    burstDone = false;
+    if (burstActive && !burstSampler.begin(channelPins, channelCount, logicConfig.burstSamples)) {
+        addLogEntry("Burst sampling unavailable - using polled capture");
+        burstActive = false;
+    }
+    if (burstActive && logicConfig.burstSamples > BurstSampler::maxSamplesAt(sampleRate)) {
+        addLogEntry("Burst cut to " + String(BurstSampler::maxSamplesAt(sampleRate)) + " samples at " +
+                    String(sampleRate) + " Hz to keep interrupts masked under " +
+                    String(BURST_MAX_MASKED_US / 1000) + " ms");
+    }
+    activeBackend = samplerActive ? BACKEND_AUTO : edgeActive ? BACKEND_EDGE_IRQ : rmtActive ? BACKEND_RMT :
+                    mcpwmActive ? BACKEND_MCPWM : burstActive ? BACKEND_BURST : BACKEND_POLLED;
+    
+    // Only the polled schedule can change its rate mid-capture
+    bool polled = !samplerActive && !edgeActive && !rmtActive && !mcpwmActive && !burstActive;
+    adaptiveActive = logicConfig.adaptiveRate && polled && activeEncoding != ENCODING_ENVELOPE;
+    if (logicConfig.adaptiveRate && !adaptiveActive) {
+        addLogEntry("Adaptive rate needs polled capture without envelope encoding - fixed rate");
+    }
+    if (!adaptiveActive) {
+        rateMap.clear();
+    }
+    healthActive = logicConfig.captureHealth;
+    scheduleHealth.reset();
+    storeTimer.reset();
+    flushTimer.reset();
+    lastSampleTime = captureMicros();
     capturing = true;
+    if (captureTaskHandle) {
+        xTaskNotifyGive(captureTaskHandle);
+    }
     addLogEntry("Capture started on GPIO1");
     Serial.println("Capture started");
 }
 
 void LogicAnalyzer::stopCapture() {
+    StoreLock hold(storeLock);
     capturing = false;
     
+    // Every backend's producer publishes its open chunk on the way out, so
+    // wait for it, then store what is still in the ring before anything is
+    // snapshotted or the flash file is closed
+    waitForCaptureTaskIdle();
+    if (samplerActive) {
+        sampler->stop();
+        samplerActive = false;
+    }
+    if (burstActive) {
+        burstSampler.end();  // Frees the burst buffer until the next burst
+        burstActive = false;
+    }
+    for (int i = 0; i < 1000 && captureRing.size() > 0; i++) {
+        drainCaptureRing();
+    }
+    
     uint32_t maxSize = (logicConfig.bufferMode == BUFFER_FLASH || logicConfig.bufferMode == BUFFER_STREAMING) 
                        ? logicConfig.maxFlashSamples : BUFFER_SIZE;
     
@@ -321,10 +1419,28 @@ void LogicAnalyzer::stopCapture() {
                 (logicConfig.bufferMode == BUFFER_FLASH ? "Flash" : "RAM") + ")");
     Serial.println("Capture stopped");
     
-    // Flush any remaining flash data
-    if (logicConfig.bufferMode == BUFFER_FLASH) {
-        flushFlashBuffer();
+    // A partly filled segment is kept if its trigger fired
+    if (segmentsActive > 1 && segmentsDone < segmentsActive &&
+        (triggerSeen || !triggerActive) && getBufferUsage() > 0) {
+        segments[segmentsDone] = snapshotCapture();
+        segmentsDone++;
+    }
+    
+    // Write out what is still staged; without a trigger the last window is kept
+    if (logicConfig.bufferMode != BUFFER_RAM) {
+        packedStore.setWrap(false);
+        transitionStore.setWrap(false);
+        writeStagedData(0xFFFFFFFF);
     }
+    
+    // Close the file with its last chunk and index
+    if (logicConfig.bufferMode == BUFFER_FLASH || logicConfig.bufferMode == BUFFER_STREAMING) {
+        finalizeFlashFile();
+    }
+    
+    // Anything of this capture published from here on is dropped, so it
+    // cannot reopen the finalized file after its index
+    captureGeneration++;
 }
 
 bool LogicAnalyzer::isCapturing() const {
@@ -336,70 +1452,779 @@ void LogicAnalyzer::setSampleRate(uint32_t rate) {
     if (rate > MAX_SAMPLE_RATE) rate = MAX_SAMPLE_RATE;
     
     sampleRate = rate;
-    sampleInterval = 1000000 / sampleRate;
-    Serial.printf("Sample rate set to %d Hz (interval: %d µs)\n", sampleRate, sampleInterval);
+    Serial.printf("Sample rate set to %d Hz (period: %.3f µs)\n", sampleRate, 1000000.0 / sampleRate);
+}
+
+uint32_t LogicAnalyzer::getSampleRate() const {
+    return sampleRate;
+}
+
+void LogicAnalyzer::setSampler(Sampler* backend) {
+    if (capturing) stopCapture();
+    if (sampler && ownsSampler) {
+        sampler->end();
+        delete sampler;
+    }
+    sampler = backend;
+    ownsSampler = false;
+}
+
+bool LogicAnalyzer::isHardwareSampling() const {
+    return samplerActive;
+}
+
+uint32_t LogicAnalyzer::getMissedSampleCount() const {
+    return captureMissedSamples;
+}
+
+void LogicAnalyzer::setCaptureClock(CaptureClock* clock) {
+    if (capturing) stopCapture();
+    if (captureClock && ownsCaptureClock) {
+        delete captureClock;
+    }
+    captureClock = clock;
+    ownsCaptureClock = false;
+}
+
+uint32_t LogicAnalyzer::getAchievedSampleRate() const {
+    return achievedRate;
+}
+
+String LogicAnalyzer::getSamplerName() const {
+    if (logicConfig.captureBackend == BACKEND_EDGE_IRQ) return String(edgeCapture.getName());
+    if (logicConfig.captureBackend == BACKEND_RMT) return String(rmtCapture.getName());
+    if (logicConfig.captureBackend == BACKEND_MCPWM) return String(mcpwmCapture.getName());
+    if (logicConfig.captureBackend == BACKEND_BURST) return String(burstSampler.getName());
+    if (logicConfig.captureBackend == BACKEND_POLLED) return String("Polled");
+    return sampler ? String(sampler->getName()) : String("Polled");
+}
+
+void LogicAnalyzer::setCaptureBackend(CaptureBackend backend) {
+    if ((int)backend < 0 || (int)backend > BACKEND_BURST) backend = BACKEND_AUTO;
+    logicConfig.captureBackend = backend;  // Applies from the next startCapture()
+    addLogEntry("Capture backend: " + getCaptureBackendString());
+}
+
+CaptureBackend LogicAnalyzer::getCaptureBackend() const {
+    return logicConfig.captureBackend;
+}
+
+String LogicAnalyzer::getCaptureBackendString() const {
+    return logicConfig.captureBackend == BACKEND_EDGE_IRQ ? "Edge IRQ" :
+           logicConfig.captureBackend == BACKEND_RMT ? "RMT" :
+           logicConfig.captureBackend == BACKEND_MCPWM ? "MCPWM" :
+           logicConfig.captureBackend == BACKEND_BURST ? "Burst" :
+           logicConfig.captureBackend == BACKEND_POLLED ? "Polled" : "Auto";
+}
+
+uint32_t LogicAnalyzer::getEdgeInterruptCount() const {
+    return edgeCapture.getEdgeCount();
+}
+
+uint32_t LogicAnalyzer::getEdgeOverrunCount() const {
+    return edgeCapture.getOverrunCount();
+}
+
+void LogicAnalyzer::setRmtTiming(uint32_t filterNs, uint32_t idleUs) {
+    // The filter counts APB cycles in 8 bits; the idle threshold sets the
+    // clock divider, so longer thresholds cost resolution
+    uint32_t maxFilterNs = RMT_MAX_FILTER_TICKS * 1000 / (RMT_SOURCE_CLOCK_HZ / 1000000);
+    uint32_t maxIdleUs = (uint32_t)((uint64_t)RMT_MAX_DURATION * RMT_MAX_CLOCK_DIVIDER / (RMT_SOURCE_CLOCK_HZ / 1000000));
+    if (filterNs > maxFilterNs) filterNs = maxFilterNs;
+    if (idleUs < 1) idleUs = 1;
+    if (idleUs > maxIdleUs) idleUs = maxIdleUs;
+    logicConfig.rmtFilterNs = filterNs;  // Applies from the next startCapture()
+    logicConfig.rmtIdleUs = idleUs;
+    addLogEntry("RMT filter " + String(filterNs) + " ns, idle " + String(idleUs) + " us, resolution " +
+                String(RMT_SOURCE_CLOCK_HZ / rmtClockDivider(idleUs)) + " Hz");
+}
+
+uint32_t LogicAnalyzer::getRmtFilterNs() const {
+    return logicConfig.rmtFilterNs;
+}
+
+uint32_t LogicAnalyzer::getRmtIdleUs() const {
+    return logicConfig.rmtIdleUs;
+}
+
+void LogicAnalyzer::setBurstSamples(uint32_t samples) {
+    if (samples < BURST_UNROLL) samples = BURST_UNROLL;
+    if (samples > BURST_MAX_SAMPLES) samples = BURST_MAX_SAMPLES;
+    logicConfig.burstSamples = samples;  // Applies from the next startCapture()
+}
+
+uint32_t LogicAnalyzer::getBurstSamples() const {
+    return logicConfig.burstSamples;
+}
+
+uint32_t LogicAnalyzer::getBurstRate() const {
+    return burstSampler.getLastResult().rate;
+}
+
+double LogicAnalyzer::getTimestampResolutionNs() const {
+    // Stored samples sit on the sample-rate grid; this is how precisely an
+    // edge was timed before it was placed there
+    switch (activeBackend) {
+        case BACKEND_AUTO:
+            return 1e9 / samplerRate;  // DMA sampler: one sample period
+        case BACKEND_RMT:
+            return 1e9 / (rmtCapture.getResolution() ? rmtCapture.getResolution()
+                                                     : RMT_SOURCE_CLOCK_HZ / rmtClockDivider(logicConfig.rmtIdleUs));
+        case BACKEND_MCPWM:
+            return 1e9 / mcpwmCapture.getResolution();
+        case BACKEND_BURST:
+            return getBurstRate() ? 1e9 / getBurstRate() : 0;  // One sample period
+        default:
+            return 1e9 / captureClock->getFrequency();  // Polled and edge IRQ read the cycle counter
+    }
+}
+
+void LogicAnalyzer::setSegmentCount(uint8_t count) {
+    if (count < 1) count = 1;
+    if (count > MAX_CAPTURE_SEGMENTS) count = MAX_CAPTURE_SEGMENTS;
+    logicConfig.segmentCount = count;  // Applies from the next startCapture()
+    addLogEntry(count > 1 ? "Segmented capture: " + String(count) + " segments" : String("Segmented capture off"));
+}
+
+uint8_t LogicAnalyzer::getSegmentCount() const {
+    return logicConfig.segmentCount;
+}
+
+uint8_t LogicAnalyzer::getCompletedSegments() const {
+    return segmentsDone;
+}
+
+String LogicAnalyzer::getSegmentsAsJSON() const {
+    JsonDocument doc;
+    JsonArray list = doc["segments"].to<JsonArray>();
+    for (uint8_t i = 0; i < segmentsDone; i++) {
+        const CaptureSegment& segment = segments[i];
+        JsonObject entry = list.add<JsonObject>();
+        entry["index"] = i;
+        entry["samples"] = segment.sampleCount;
+        entry["trigger_time"] = segment.triggerTime;  // Monotonic us, same timeline as the samples
+        if (segment.triggerIndex != CAPTURE_NO_TRIGGER) {
+            entry["trigger_index"] = segment.triggerIndex;
+        }
+        entry["first_timestamp"] = segment.transitions ? segment.edges.timestampAt(0) : segment.samples.timestampAt(0);
+    }
+    doc["segment_count"] = segmentsActive;
+    doc["completed"] = segmentsDone;
+    doc["capturing"] = capturing.load();
+    
+    String result;
+    serializeJson(doc, result);
+    return result;
+}
+
+std::shared_ptr<CaptureExport> LogicAnalyzer::exportSegment(uint8_t index, bool csv) {
+    if (index >= segmentsDone) return nullptr;
+    const CaptureSegment& segment = segments[index];
+    std::shared_ptr<CaptureExport> stream = std::make_shared<CaptureExport>(segment);
+    stream->generation = captureGeneration;
+    stream->csv = csv;
+    
+    if (csv) {
+        String head = "# M5Stack AtomProbe - Capture Segment " + String(index) + " (CSV Format)\n";
+        head += "# Trigger Time: " + String(segment.triggerTime) + " us\n";
+        if (segment.triggerIndex != CAPTURE_NO_TRIGGER) {
+            head += "# Trigger Index: " + String(segment.triggerIndex) + "\n";
+        }
+        head += "\n";
+        head += captureColumnsCSV();
+        stream->text = head;
+        return stream;
+    }
+    
+    JsonDocument info;
+    info["segment"] = index;
+    info["sample_count"] = segment.sampleCount;
+    info["trigger_time"] = segment.triggerTime;
+    if (segment.triggerIndex != CAPTURE_NO_TRIGGER) {
+        info["trigger_index"] = segment.triggerIndex;
+    }
+    info["sample_rate"] = segment.transitions ? segment.edges.timebase.rate : segment.samples.timebase.rate;
+    if (segment.transitions) {
+        info["edge_count"] = segment.edges.edgeCount;
+    }
+    addChannelsJSON(info);
+    openExport(*stream, info, "samples");
+    return stream;
+}
+
+bool LogicAnalyzer::startCounter() {
+    if (counterActive) return true;
+    if (capturing && edgeActive) {
+        addLogEntry("Counter mode unavailable during an edge-interrupt capture");
+        return false;
+    }
+    if (!pulseCounter.begin(channelPins[0])) {
+        addLogEntry("Pulse counter could not be started");
+        return false;
+    }
+    counterSeries.begin(captureMicros());
+    counterIntervalStart = millis();
+    counterActive = true;
+    addLogEntry("Counter mode on GPIO" + String(channelPins[0]) + ", " + String(logicConfig.counterIntervalMs) + " ms intervals");
+    return true;
+}
+
+void LogicAnalyzer::stopCounter() {
+    if (!counterActive) return;
+    counterSeries.push(pulseCounter.sample());  // Keep the partial interval
+    pulseCounter.end();
+    counterActive = false;
+    addLogEntry("Counter mode stopped after " + String(counterSeries.size()) + " intervals");
+}
+
+bool LogicAnalyzer::isCounterRunning() const {
+    return counterActive;
+}
+
+void LogicAnalyzer::setCounterInterval(uint32_t ms) {
+    if (ms < COUNTER_MIN_INTERVAL_MS) ms = COUNTER_MIN_INTERVAL_MS;
+    if (ms > COUNTER_MAX_INTERVAL_MS) ms = COUNTER_MAX_INTERVAL_MS;
+    logicConfig.counterIntervalMs = ms;  // Takes effect with the next interval
+}
+
+uint32_t LogicAnalyzer::getCounterInterval() const {
+    return logicConfig.counterIntervalMs;
+}
+
+void LogicAnalyzer::serviceCounter() {
+    uint32_t now = millis();
+    if (now - counterIntervalStart < logicConfig.counterIntervalMs) return;
+    counterIntervalStart = now;
+    counterSeries.push(pulseCounter.sample());  // Measures its own duration, so loop() latency does not skew it
+}
+
+String LogicAnalyzer::getCounterAsJSON(uint32_t last) const {
+    JsonDocument doc;
+    doc["running"] = counterActive;
+    doc["gpio_pin"] = pulseCounter.getPin();
+    doc["interval_ms"] = logicConfig.counterIntervalMs;
+    doc["intervals"] = counterSeries.size();
+    doc["capacity"] = counterSeries.capacity();
+    
+    uint32_t count = counterSeries.size();
+    uint32_t first = last < count ? count - last : 0;
+    uint64_t start = counterSeries.getFirstStart();
+    JsonArray series = doc["series"].to<JsonArray>();
+    for (uint32_t i = 0; i < count; i++) {
+        const CounterInterval& interval = counterSeries.at(i);
+        if (i >= first) {
+            JsonObject entry = series.add<JsonObject>();
+            entry["start_us"] = start;
+            entry["duration_us"] = interval.durationUs;
+            entry["edges"] = interval.edges;
+            entry["frequency_hz"] = interval.frequency();
+            entry["duty_percent"] = interval.dutyPercent();
+            entry["high_us"] = interval.highUs;
+            entry["min_period_ns"] = interval.minPeriodNs;
+            entry["max_period_ns"] = interval.maxPeriodNs;
+        }
+        start += interval.durationUs;
+    }
+    
+    String result;
+    serializeJson(doc, result);
+    return result;
+}
+
+String LogicAnalyzer::getCounterAsCSV() const {
+    String result = "# M5Stack AtomProbe - Counter Series (CSV Format)\n";
+    result += "# GPIO: " + String(pulseCounter.getPin()) + ", Interval: " + String(logicConfig.counterIntervalMs) + " ms\n";
+    result += "# Min/max period cover the first " + String(COUNTER_TIMED_EDGES) + " edges of each interval\n\n";
+    result += "Start_us,Duration_us,Edges,Frequency_Hz,Duty_Percent,High_us,Min_Period_ns,Max_Period_ns\n";
+    
+    uint64_t start = counterSeries.getFirstStart();
+    for (uint32_t i = 0; i < counterSeries.size(); i++) {
+        const CounterInterval& interval = counterSeries.at(i);
+        result += String(start) + "," + String(interval.durationUs) + "," + String(interval.edges) + "," +
+                  String(interval.frequency(), 3) + "," + String(interval.dutyPercent(), 2) + "," +
+                  String(interval.highUs) + "," + String(interval.minPeriodNs) + "," + String(interval.maxPeriodNs) + "\n";
+        start += interval.durationUs;
+    }
+    return result;
+}
+
+bool LogicAnalyzer::setChannelMask(uint32_t mask) {
+    if (mask == 0 || (mask & ~(uint32_t)CHANNEL_PINS_ALLOWED) || __builtin_popcount(mask) > MAX_CHANNELS) {
+        addLogEntry("Channel mask 0x" + String(mask, HEX) + " rejected");
+        return false;
+    }
+    if (capturing) {
+        addLogEntry("Channel mask can not change during a capture");
+        return false;
+    }
+    
+    // Channel order follows GPIO number, so channel 0 is the lowest pin
+    uint8_t count = 0;
+    for (uint8_t pin = 0; pin < 32; pin++) {
+        if (mask & (1UL << pin)) {
+            channelPins[count++] = pin;
+            pinMode(pin, INPUT);
+        }
+    }
+    channelCount = count;
+    gpio1Pin = channelPins[0];
+    logicConfig.channelMask = mask;
+    logicConfig.gpioPin = gpio1Pin;
+    if (triggerChannel >= channelCount) triggerChannel = 0;
+    logicConfig.triggerChannel = triggerChannel;
+    applyChannelLayout();
+    
+    addLogEntry("Capturing " + String(channelCount) + " channel(s), mask 0x" + String(mask, HEX));
+    return true;
+}
+
+uint32_t LogicAnalyzer::getChannelMask() const {
+    uint32_t mask = 0;
+    for (uint8_t c = 0; c < channelCount; c++) {
+        mask |= 1UL << channelPins[c];
+    }
+    return mask;
+}
+
+uint8_t LogicAnalyzer::getChannelCount() const {
+    return channelCount;
+}
+
+uint8_t LogicAnalyzer::getChannelPin(uint8_t channel) const {
+    return channel < channelCount ? channelPins[channel] : channelPins[0];
+}
+
+void LogicAnalyzer::setTriggerChannel(uint8_t channel) {
+    if (channel >= channelCount) channel = 0;
+    triggerChannel = channel;  // Read by the capture task when it arms
+    logicConfig.triggerChannel = channel;
+    Serial.printf("Trigger channel: %d (GPIO%d)\n", channel, channelPins[channel]);
+}
+
+uint8_t LogicAnalyzer::getTriggerChannel() const {
+    return triggerChannel;
+}
+
+void LogicAnalyzer::setTrigger(TriggerMode mode) {
+    triggerMode = mode;
+    triggerArmed = false;
+    Serial.printf("GPIO1 Trigger set: mode=%d\n", mode);
+}
+
+void LogicAnalyzer::disableTrigger() {
+    triggerMode = TRIGGER_NONE;
+    triggerArmed = true;
+    Serial.println("GPIO1 Trigger disabled");
+}
+
+TriggerMode LogicAnalyzer::getTriggerMode() const {
+    return triggerMode;
+}
+
+bool LogicAnalyzer::setTriggerProgram(const String& program) {
+    if (program.length() == 0) {
+        logicConfig.triggerProgram = "";
+        triggerProgramError = nullptr;
+        if (triggerMode == TRIGGER_SEQUENCE) setTrigger(TRIGGER_NONE);
+        return true;
+    }
+    
+    TriggerProgram parsed;
+    triggerProgramError = parsed.parse(program.c_str(), triggerChannel, channelCount);
+    if (triggerProgramError) {
+        addLogEntry("Trigger program rejected: " + String(triggerProgramError));
+        return false;
+    }
+    triggerProgram = parsed;
+    logicConfig.triggerProgram = program;
+    logicConfig.triggerMode = TRIGGER_SEQUENCE;
+    setTrigger(TRIGGER_SEQUENCE);  // Compiled for the sample rate at startCapture()
+    addLogEntry("Trigger program: " + program + " (" + String(parsed.stageCount) + " stages)");
+    return true;
+}
+
+void LogicAnalyzer::setTriggerWidth(uint64_t widthNs, uint8_t pulseLevel) {
+    logicConfig.triggerWidthNs = widthNs ? widthNs : 1;
+    logicConfig.triggerPulseLevel = pulseLevel ? 1 : 0;
+    Serial.printf("Trigger width: %llu ns, %s pulse\n", logicConfig.triggerWidthNs,
+                  logicConfig.triggerPulseLevel ? "high" : "low");
+}
+
+uint64_t LogicAnalyzer::getTriggerWidth() const {
+    return logicConfig.triggerWidthNs;
+}
+
+uint8_t LogicAnalyzer::getTriggerPulseLevel() const {
+    return logicConfig.triggerPulseLevel;
+}
+
+String LogicAnalyzer::getTriggerProgram() const {
+    return logicConfig.triggerProgram;
+}
+
+String LogicAnalyzer::getTriggerProgramError() const {
+    return triggerProgramError ? String(triggerProgramError) : String("");
+}
+
+std::shared_ptr<CaptureExport> LogicAnalyzer::exportCapture(bool csv) {
+    // The store task cannot move the stores while the snapshot is taken
+    StoreLock hold(storeLock);
+    std::shared_ptr<CaptureExport> stream = std::make_shared<CaptureExport>(snapshotCapture());
+    stream->generation = captureGeneration;
+    stream->live = true;
+    stream->csv = csv;
+    stream->envelope = usesEnvelopeStore();
+    if (stream->envelope) {
+        stream->buckets = envelopeStore.size();
+        stream->pendingSamples = envelopeStore.getPendingSamples();
+        stream->pending = envelopeStore.getPending();
+        stream->firstIndex = envelopeStore.getTimebase().firstIndex;
+    }
+    if (csv) {
+        stream->text = captureHeaderCSV(stream->envelope);
+        if (getBufferUsage() == 0) {
+            stream->tail = "# No capture data available\n";
+            stream->tail += "# Connect a signal to GPIO" + String(gpio1Pin) + " and start capture\n";
+        }
+        return stream;
+    }
+    
+    JsonDocument info;
+    if (stream->envelope) {
+        info["bucket_samples"] = envelopeStore.getBucketSamples();
+        info["bucket_count"] = stream->buckets;
+    } else if (stream->segment.transitions) {
+        info["edge_count"] = stream->segment.edges.edgeCount;
+    }
+    addChannelsJSON(info);
+    info["encoding"] = getCaptureEncodingString();
+    info["sample_count"] = getBufferUsage();
+    if (segmentsActive > 1) {
+        info["segments"] = segmentsDone;  // Finished segments, see /api/logic/segments
+    }
+    if (getTriggerIndex() != CAPTURE_NO_TRIGGER) {
+        info["trigger_index"] = getTriggerIndex();  // Samples before it are pre-trigger
+        info["pre_trigger_percent"] = logicConfig.preTriggerPercent;
+    }
+    info["sample_rate"] = sampleRate;
+    info["achieved_sample_rate"] = getAchievedSampleRate();
+    // Exact timescale for exporters: sample n is n sample periods after the
+    // first; timestamps are whole microseconds
+    uint32_t periodRate = activeBackend == BACKEND_AUTO ? samplerRate : activeBackend == BACKEND_BURST ? getBurstRate() : sampleRate;
+    info["sample_period_ns"] = periodRate ? 1e9 / periodRate : 0;
+    info["timestamp_resolution_ns"] = getTimestampResolutionNs();
+    info["timestamp_unit"] = "us";
+    if (adaptiveActive) {
+        addRateMarkersJSON(info);
+    }
+    if (captureGaps.size() > 0 || captureGaps.getUnlisted() > 0) {
+        addGapsJSON(info);
+    }
+    info["gpio_pin"] = gpio1Pin;
+    info["buffer_size"] = BUFFER_SIZE;
+    info["trigger_mode"] = (int)triggerMode;
+    openExport(*stream, info, stream->envelope ? "buckets" : "samples");
+    return stream;
+}
+
+void LogicAnalyzer::openExport(CaptureExport& stream, const JsonDocument& info, const char* rowsKey) const {
+    // The info object goes first with its closing brace replaced by the
+    // rows array; the tail closes both
+    String head;
+    serializeJson(info, head);
+    head.remove(head.length() - 1);
+    head += ",\"";
+    head += rowsKey;
+    head += "\":[";
+    stream.text = head;
+    stream.tail = "]}";
+}
+
+size_t LogicAnalyzer::readExport(CaptureExport& stream, uint8_t* buffer, size_t maxLen) const {
+    size_t written = 0;
+    while (written < maxLen) {
+        size_t left = stream.text.length() - stream.sent;
+        if (left > 0) {
+            size_t n = left < maxLen - written ? left : maxLen - written;
+            memcpy(buffer + written, stream.text.c_str() + stream.sent, n);
+            stream.sent += n;
+            written += n;
+            continue;
+        }
+        if (stream.done) break;
+        
+        // Refill with about one buffer of rows, then the tail. The rows are
+        // read under the store lock, after checking nothing rewrote them.
+        stream.text = "";
+        stream.sent = 0;
+        StoreLock hold(storeLock);
+        if (!exportIntact(stream)) {
+            stream.text = stream.csv ? "# Export truncated: the capture changed during the download\n" :
+                                       "],\"truncated\":true}";
+            stream.done = true;
+            continue;
+        }
+        while (stream.text.length() < maxLen && !stream.done) {
+            if (!nextExportRow(stream)) {
+                stream.text += stream.tail;
+                stream.done = true;
+            }
+        }
+    }
+    return written;
+}
+
+bool LogicAnalyzer::exportIntact(const CaptureExport& stream) const {
+    // startCapture() and stopCapture() bump the generation. Within one, the
+    // live store rewrites snapshot memory only after dropping its oldest
+    // data (wrap, trim, flash hand-off) or a clearBuffer() reset, which
+    // move its head or first index or shrink it below the snapshot.
+    if (stream.generation != captureGeneration) return false;
+    if (!stream.live) return true;
+    if (stream.envelope) {
+        return envelopeStore.getTimebase().firstIndex == stream.firstIndex && envelopeStore.size() >= stream.buckets;
+    }
+    if (stream.segment.transitions) {
+        TransitionStore::Snapshot now = transitionStore.snapshot();
+        const TransitionStore::Snapshot& then = stream.segment.edges;
+        if (now.bytes != then.bytes) return true;  // A finished segment's slice, no longer written
+        return now.head == then.head && now.timebase.firstIndex == then.timebase.firstIndex && now.used >= then.used;
+    }
+    PackedSampleStore::Snapshot now = packedStore.snapshot();
+    const PackedSampleStore::Snapshot& then = stream.segment.samples;
+    if (now.words != then.words) return true;
+    return now.head == then.head && now.timebase.firstIndex == then.timebase.firstIndex && now.count >= then.count;
+}
+
+bool LogicAnalyzer::nextExportRow(CaptureExport& stream) const {
+    if (stream.envelope) {
+        // The bucket after the complete ones is still filling
+        uint32_t bucket = (uint32_t)stream.rows;
+        if (bucket > stream.buckets || (bucket == stream.buckets && stream.pendingSamples == 0)) return false;
+        appendBucketRow(stream, bucket);
+        return true;
+    }
+    
+    uint8_t levels;
+    if (stream.segment.transitions) {
+        // One row per edge (plus the first and last sample), tagged with
+        // its sample number so the waveform can be rebuilt
+        uint64_t offset;
+        if (stream.edges.next(offset, levels)) {
+            appendSampleRow(stream, offset + 1, stream.segment.edges.timestampAt(offset), levels);
+            stream.lastOffset = offset;
+            stream.lastLevels = levels;
+            return true;
+        }
+        uint64_t count = stream.segment.sampleCount;
+        if (stream.closed || count == 0 || stream.lastOffset + 1 >= count) return false;
+        stream.closed = true;
+        appendSampleRow(stream, count, stream.segment.edges.timestampAt(count - 1), stream.lastLevels);
+        return true;
+    }
+    
+    uint64_t timestamp;
+    if (!stream.samples.next(timestamp, levels)) return false;
+    appendSampleRow(stream, stream.samples.position(), timestamp, levels);
+    return true;
+}
+
+void LogicAnalyzer::appendSampleRow(CaptureExport& stream, uint64_t sample, uint64_t timestamp, uint8_t levels) const {
+    String& text = stream.text;
+    bool high = levels & 1;
+    if (stream.csv) {
+        text += String(sample) + "," + String(timestamp);
+        text += high ? ",1,HIGH" : ",0,LOW";
+        text += csvChannelColumns(levels);
+        text += "\n";
+    } else {
+        // Rows of a sample capture are consecutive, so only edge rows carry
+        // their sample number
+        if (stream.rows > 0) text += ",";
+        text += "{";
+        if (stream.segment.transitions) text += "\"sample\":" + String(sample) + ",";
+        text += "\"timestamp\":" + String(timestamp);
+        text += high ? ",\"gpio1\":true,\"state\":\"HIGH\"" : ",\"gpio1\":false,\"state\":\"LOW\"";
+        if (channelCount > 1) text += ",\"channels\":" + String(levels);  // Bit c = channel c
+        text += "}";
+    }
+    stream.rows++;
+}
+
+void LogicAnalyzer::addChannelsJSON(JsonDocument& doc) const {
+    if (channelCount > 1) {
+        JsonArray pins = doc["channel_pins"].to<JsonArray>();
+        for (uint8_t c = 0; c < channelCount; c++) {
+            pins.add(channelPins[c]);
+        }
+    }
+    doc["channel_count"] = channelCount;
 }
 
-uint32_t LogicAnalyzer::getSampleRate() const {
-    return sampleRate;
+void LogicAnalyzer::addRateMarkersJSON(JsonDocument& doc) const {
+    // sample_period_ns only holds for the first stretch; from each marker's
+    // sample on, samples are 1/rate apart. A marker before the first stored
+    // sample (trimmed pre-trigger data) is listed at sample 0.
+    JsonArray markers = doc["rate_markers"].to<JsonArray>();
+    uint32_t count = rateMap.size();
+    for (uint32_t i = 0; i < count; i++) {
+        const RateMarker& m = rateMap.at(i);
+        if (i + 1 < count && rateMap.at(i + 1).index <= captureFirstIndex) continue;
+        JsonObject marker = markers.add<JsonObject>();
+        marker["sample"] = m.index > captureFirstIndex ? m.index - captureFirstIndex : 0;
+        marker["timestamp"] = m.index > captureFirstIndex ? m.time : rateMap.timestampAt(captureFirstIndex);
+        marker["rate"] = m.rate;
+    }
+    doc["adaptive_rate"] = true;
 }
 
-void LogicAnalyzer::setTrigger(TriggerMode mode) {
-    triggerMode = mode;
-    triggerArmed = false;
-    Serial.printf("GPIO1 Trigger set: mode=%d\n", mode);
+void LogicAnalyzer::addGapsJSON(JsonDocument& doc) const {
+    // Samples in these stretches were not read; they repeat the level
+    // before them. Gaps before the first stored sample are left out.
+    JsonArray gaps = doc["gaps"].to<JsonArray>();
+    uint32_t count = captureGaps.size();
+    for (uint32_t i = 0; i < count; i++) {
+        const SampleGap& g = captureGaps.at(i);
+        if (g.index + g.count <= captureFirstIndex) continue;
+        uint64_t first = g.index > captureFirstIndex ? g.index - captureFirstIndex : 0;
+        JsonObject gap = gaps.add<JsonObject>();
+        gap["sample"] = first;
+        gap["count"] = g.index + g.count - captureFirstIndex - first;
+    }
+    if (captureGaps.getUnlisted() > 0) {
+        doc["gaps_unlisted"] = captureGaps.getUnlisted();  // Filled slots past GAP_MAP_MAX_GAPS gaps
+    }
 }
 
-void LogicAnalyzer::disableTrigger() {
-    triggerMode = TRIGGER_NONE;
-    triggerArmed = true;
-    Serial.println("GPIO1 Trigger disabled");
+void LogicAnalyzer::addHealthJSON(JsonDocument& doc) const {
+    // Read intervals and latency are timed on the polled schedule only;
+    // hardware-paced backends report their own overruns
+    JsonObject health = doc["capture_health"].to<JsonObject>();
+    health["enabled"] = healthActive;
+    health["missed_slots"] = captureMissedSamples.load();
+    if (!healthActive) return;
+    
+    double cycleNs = 1e9 / captureClock->getFrequency();
+    health["reads"] = scheduleHealth.reads;
+    health["late_reads"] = scheduleHealth.lateReads;
+    health["worst_latency_ns"] = scheduleHealth.worstLatency * cycleNs;
+    JsonArray bins = health["interval_histogram"].to<JsonArray>();
+    for (uint32_t i = 0; i < HEALTH_HISTOGRAM_BINS; i++) {
+        if (scheduleHealth.intervals[i] == 0) continue;
+        JsonObject bin = bins.add<JsonObject>();
+        bin["min_ns"] = (double)(1ULL << i) * cycleNs;  // Up to twice this
+        bin["count"] = scheduleHealth.intervals[i];
+    }
+    health["store_calls"] = storeTimer.calls;
+    health["store_us"] = storeTimer.totalUs;
+    health["store_max_us"] = storeTimer.maxUs;
+    health["flush_calls"] = flushTimer.calls;
+    health["flush_us"] = flushTimer.totalUs;
+    health["flush_max_us"] = flushTimer.maxUs;
 }
 
-TriggerMode LogicAnalyzer::getTriggerMode() const {
-    return triggerMode;
+void LogicAnalyzer::addFlashWriterJSON(JsonDocument& doc) const {
+    // Write bandwidth is bytes over the time spent inside writes, so it is
+    // what the flash sustains, not what the current capture asks of it
+    JsonObject writer = doc["flash_writer"].to<JsonObject>();
+    writer["task"] = flashWriterHandle != nullptr;
+    writer["buffers"] = FLASH_WRITE_BUFFERS;
+    writer["queued"] = flashWriteJobs.size();
+    writer["overruns"] = flashWriteOverruns.load();
+    writer["errors"] = flashWriteErrors.load();
+    writer["chunks_written"] = flashWriteTimer.calls;
+    writer["write_max_us"] = flashWriteTimer.maxUs;
+    if (flashWriteTimer.totalUs == 0) return;
+    double bytesPerSecond = (double)flashWriteTimer.calls * FLASH_CHUNK_SIZE * 1e6 / flashWriteTimer.totalUs;
+    writer["write_avg_us"] = flashWriteTimer.totalUs / flashWriteTimer.calls;
+    writer["write_kb_per_s"] = bytesPerSecond / 1024;
+    // Fastest loss-free rate for 8-byte sample records; edge captures
+    // reach further, depending on how often the signal changes
+    writer["max_record_rate"] = (uint32_t)(bytesPerSecond * FLASH_CHUNK_PAYLOAD / FLASH_CHUNK_SIZE /
+                                           sizeof(FlashSampleRecord));
+    if (!rawLog.isReady()) return;
+    
+    // Inline erases are appends that had to erase their segment first
+    JsonObject raw = writer["raw_log"].to<JsonObject>();
+    raw["active"] = rawLogActive.load();
+    raw["partition_kb"] = rawFlash.size() / 1024;
+    raw["segments"] = rawLog.getSegments();
+    raw["segment_bytes"] = rawLog.getSegmentBytes();
+    raw["chunks"] = rawLog.getSlotCount();
+    raw["capacity_chunks"] = rawLog.getCapacitySlots();
+    raw["full"] = rawLog.isFull();
+    raw["erased_ahead"] = rawLog.getErasedAhead();
+    raw["ahead_erases"] = rawLog.getAheadErases();
+    raw["inline_erases"] = rawLog.getInlineErases();
+    raw["errors"] = rawLog.getWriteErrors();
 }
 
-String LogicAnalyzer::getDataAsJSON() {
-    JsonDocument doc;
-    JsonArray samples = doc["samples"].to<JsonArray>();
-    
-    uint32_t count = getBufferUsage();
-    uint32_t index = readIndex;
-    
-    for (uint32_t i = 0; i < count; i++) {
-        JsonObject sample = samples.add<JsonObject>();
-        sample["timestamp"] = buffer[index].timestamp;
-        sample["gpio1"] = buffer[index].data;  // Single boolean for GPIO1
-        sample["state"] = buffer[index].data ? "HIGH" : "LOW";
-        
-        index = (index + 1) % BUFFER_SIZE;
+void LogicAnalyzer::appendBucketRow(CaptureExport& stream, uint32_t bucket) const {
+    // Pulse widths are those that ended in the bucket, so a glitch shorter
+    // than a bucket still shows as a small minimum pulse. The CSV pulse
+    // columns are empty when no pulse ended in the bucket.
+    uint32_t rate = envelopeStore.getTimebase().rate;
+    double sampleNs = rate ? 1e9 / rate : 0;
+    bool filling = bucket == stream.buckets;
+    const EnvelopeBucket& b = filling ? stream.pending : envelopeStore.at(bucket);
+    bool pulse = b.minPulse != ENVELOPE_NO_PULSE;
+    String& text = stream.text;
+    
+    if (stream.csv) {
+        text += String(bucket + 1) + "," + String(envelopeStore.timestampAt(bucket)) + ",";
+        text += String(filling ? stream.pendingSamples : envelopeStore.getBucketSamples()) + ",";
+        text += String(b.firstLevels & 1);
+        text += csvChannelColumns(b.firstLevels);
+        text += "," + String(b.transitions) + "," + String(b.toggled) + ",";
+        if (pulse) {
+            text += String(b.minPulse * sampleNs, 1) + "," + String(b.maxPulse * sampleNs, 1);
+        } else {
+            text += ",";
+        }
+        text += "\n";
+    } else {
+        if (stream.rows > 0) text += ",";
+        text += "{\"timestamp\":" + String(envelopeStore.timestampAt(bucket));
+        if (filling) text += ",\"samples\":" + String(stream.pendingSamples);
+        text += (b.firstLevels & 1) ? ",\"gpio1\":true" : ",\"gpio1\":false";
+        if (channelCount > 1) {
+            text += ",\"channels\":" + String(b.firstLevels) + ",\"toggled\":" + String(b.toggled);
+        }
+        text += ",\"transitions\":" + String(b.transitions);
+        if (pulse) {
+            text += ",\"min_pulse_ns\":" + String(b.minPulse * sampleNs, 1);
+            text += ",\"max_pulse_ns\":" + String(b.maxPulse * sampleNs, 1);
+        }
+        text += "}";
     }
-    
-    doc["sample_count"] = count;
-    doc["sample_rate"] = sampleRate;
-    doc["gpio_pin"] = gpio1Pin;
-    doc["buffer_size"] = BUFFER_SIZE;
-    doc["trigger_mode"] = (int)triggerMode;
-    
-    String result;
-    serializeJson(doc, result);
-    return result;
+    stream.rows++;
 }
 
 void LogicAnalyzer::clearBuffer() {
-    writeIndex = 0;
-    readIndex = 0;
+    StoreLock hold(storeLock);
+    packedStore.reset();
+    transitionStore.reset();
+    envelopeStore.reset();
+    segmentsDone = 0;
     
     // Clear flash storage if in flash mode
     if (logicConfig.bufferMode == BUFFER_FLASH || logicConfig.bufferMode == BUFFER_STREAMING) {
         flashSamplesWritten = 0;
+        flashLastTimestamp = 0;
+        flashRecordsSinceKeyframe = 0;
         flashWritePosition = 0;
         bufferPosition = 0;
+        flashChunkCount = 0;
+        flashPageCache.invalidate();
         
+        waitForFlashWriter();
+        flashWriteOverruns = 0;
+        flashWriteErrors = 0;
+        flashWriteTimer.reset();
         if (flashDataFile) {
             flashDataFile.close();
         }
+        rawLogOpen = false;  // The next chunk starts a new raw log
         
         // Remove existing flash file
         if (LittleFS.exists(flashLogicFileName)) {
@@ -413,11 +2238,16 @@ uint32_t LogicAnalyzer::getBufferUsage() const {
         return flashSamplesWritten;
     }
     
-    if (writeIndex >= readIndex) {
-        return writeIndex - readIndex;
-    } else {
-        return (BUFFER_SIZE - readIndex) + writeIndex;
+    // Transition and envelope mode report the samples covered, not what is stored
+    if (usesEnvelopeStore()) {
+        uint64_t samples = envelopeStore.getSampleCount();
+        return samples > 0xFFFFFFFF ? 0xFFFFFFFF : (uint32_t)samples;
+    }
+    if (usesTransitionStore()) {
+        uint64_t samples = transitionStore.getSampleCount();
+        return samples > 0xFFFFFFFF ? 0xFFFFFFFF : (uint32_t)samples;
     }
+    return packedStore.size();
 }
 
 uint32_t LogicAnalyzer::getCurrentBufferSize() const {
@@ -427,23 +2257,146 @@ uint32_t LogicAnalyzer::getCurrentBufferSize() const {
     return BUFFER_SIZE;
 }
 
+bool LogicAnalyzer::flashSampleLimitReached() const {
+    // Samples written plus those still staged; a wrapping pre-trigger window
+    // counts from its current first sample, as the file will
+    if (logicConfig.bufferMode != BUFFER_FLASH && logicConfig.bufferMode != BUFFER_STREAMING) return false;
+    uint64_t samples = usesTransitionStore() ? transitionStore.getSampleCount() :
+                       (uint64_t)flashSamplesWritten + packedStore.size();
+    return samples >= FLASH_MAX_CAPTURE_SAMPLES;
+}
+
 bool LogicAnalyzer::isBufferFull() const {
     if (logicConfig.bufferMode == BUFFER_FLASH || logicConfig.bufferMode == BUFFER_STREAMING) {
+        if (rawLogActive && rawLog.isFull()) {
+            return true;
+        }
+        if (flashSampleLimitReached()) {
+            return true;
+        }
+        if (flashRingChunks) {
+            return flashChunkCount >= flashStopChunk;  // Rolls over until then
+        }
+        if (usesTransitionStore()) {
+            // Edges get the flash space the sample records would have used
+            return flashWritePosition + bufferPosition >= logicConfig.maxFlashSamples * sizeof(FlashSampleRecord);
+        }
         return flashSamplesWritten >= logicConfig.maxFlashSamples;
     }
     
-    return getBufferUsage() >= (BUFFER_SIZE - 1);
+    if (usesEnvelopeStore()) {
+        return envelopeStore.full();
+    }
+    if (usesTransitionStore()) {
+        return transitionStore.full();
+    }
+    return packedStore.full();
+}
+
+uint32_t LogicAnalyzer::getStorageUsedPercent() const {
+    if (logicConfig.bufferMode == BUFFER_FLASH || logicConfig.bufferMode == BUFFER_STREAMING) {
+        if (flashRingChunks) {
+            return (uint32_t)(flashKeptChunks() * 100ULL / flashRingChunks);
+        }
+        if (usesTransitionStore()) {
+            uint64_t budget = (uint64_t)logicConfig.maxFlashSamples * sizeof(FlashSampleRecord);
+            return budget ? (uint32_t)((flashWritePosition + bufferPosition) * 100ULL / budget) : 0;
+        }
+        return logicConfig.maxFlashSamples ? (uint32_t)(flashSamplesWritten * 100ULL / logicConfig.maxFlashSamples) : 0;
+    }
+    
+    if (usesEnvelopeStore()) {
+        return (uint32_t)(envelopeStore.size() * 100ULL / envelopeStore.getCapacity());
+    }
+    if (usesTransitionStore()) {
+        return (uint32_t)(transitionStore.getUsedBytes() * 100ULL / transitionStore.getCapacityBytes());
+    }
+    return (uint32_t)(packedStore.size() * 100ULL / packedStore.getCapacity());
+}
+
+uint32_t LogicAnalyzer::getEdgeCount() const {
+    return usesTransitionStore() ? transitionStore.getEdgeCount() : 0;
+}
+
+void LogicAnalyzer::setCaptureEncoding(CaptureEncoding encoding) {
+    if ((int)encoding < 0 || (int)encoding > ENCODING_ENVELOPE) encoding = ENCODING_SAMPLES;
+    logicConfig.encoding = encoding;  // Applies from the next startCapture()
+    addLogEntry("Capture encoding: " + getCaptureEncodingString());
+}
+
+CaptureEncoding LogicAnalyzer::getCaptureEncoding() const {
+    return logicConfig.encoding;
+}
+
+String LogicAnalyzer::getCaptureEncodingString() const {
+    return activeEncoding == ENCODING_TRANSITIONS ? "Transitions" :
+           activeEncoding == ENCODING_ENVELOPE ? "Envelope" : "Samples";
+}
+
+void LogicAnalyzer::setEnvelopeSamples(uint32_t samples) {
+    if (samples < 1) samples = 1;
+    if (samples > ENVELOPE_MAX_SAMPLES) samples = ENVELOPE_MAX_SAMPLES;
+    logicConfig.envelopeSamples = samples;  // Applies from the next startCapture()
+}
+
+uint32_t LogicAnalyzer::getEnvelopeSamples() const {
+    return logicConfig.envelopeSamples;
+}
+
+void LogicAnalyzer::setAdaptiveRate(bool enable, uint32_t minRate) {
+    if (minRate < MIN_SAMPLE_RATE) minRate = MIN_SAMPLE_RATE;
+    if (minRate > MAX_SAMPLE_RATE) minRate = MAX_SAMPLE_RATE;
+    logicConfig.adaptiveRate = enable;  // Applies from the next startCapture()
+    logicConfig.adaptiveMinRate = minRate;
+    addLogEntry(enable ? "Adaptive rate: " + String(minRate) + " Hz to " + String(sampleRate) + " Hz" :
+                String("Adaptive rate off"));
+}
+
+bool LogicAnalyzer::isAdaptiveRate() const {
+    return logicConfig.adaptiveRate;
+}
+
+uint32_t LogicAnalyzer::getAdaptiveMinRate() const {
+    return logicConfig.adaptiveMinRate;
+}
+
+uint32_t LogicAnalyzer::getCurrentSampleRate() const {
+    return adaptiveActive && capturing ? adaptiveCurrentRate.load() : sampleRate;
+}
+
+void LogicAnalyzer::setCaptureHealth(bool enable) {
+    logicConfig.captureHealth = enable;  // Applies from the next startCapture()
+}
+
+bool LogicAnalyzer::isCaptureHealth() const {
+    return logicConfig.captureHealth;
+}
+
+void LogicAnalyzer::setRawPartition(bool enable) {
+    logicConfig.rawPartition = enable;  // Applies from the next startCapture()
+}
+
+bool LogicAnalyzer::isRawPartition() const {
+    return logicConfig.rawPartition;
+}
+
+void LogicAnalyzer::setCircularFlash(bool enable) {
+    circularFlashMode = enable;  // Applies from the next startCapture()
+}
+
+bool LogicAnalyzer::isCircularFlash() const {
+    return circularFlashMode;
 }
 
 void LogicAnalyzer::printStatus() {
     Serial.println("=== M5Stack AtomProbe GPIO1 Monitor Status ===");
-    Serial.printf("Capturing: %s\n", capturing ? "YES" : "NO");
+    Serial.printf("Capturing: %s\n", capturing.load() ? "YES" : "NO");
     Serial.printf("Sample Rate: %d Hz\n", sampleRate);
     Serial.printf("GPIO Pin: %d\n", gpio1Pin);
     Serial.printf("Buffer Usage: %d/%d (%.1f%%)\n", getBufferUsage(), BUFFER_SIZE, 
                   (getBufferUsage() * 100.0) / BUFFER_SIZE);
     Serial.printf("Trigger Mode: %d\n", triggerMode);
-    Serial.printf("Trigger Armed: %s\n", triggerArmed ? "YES" : "NO");
+    Serial.printf("Trigger Armed: %s\n", triggerArmed.load() ? "YES" : "NO");
 }
 
 void LogicAnalyzer::printChannelStates() {
@@ -812,40 +2765,87 @@ String LogicAnalyzer::getLogsAsPlainText() {
     return result;
 }
 
-String LogicAnalyzer::getDataAsCSV() {
+String LogicAnalyzer::captureHeaderCSV(bool envelope) const {
     String result = "# M5Stack AtomProbe - GPIO1 Capture Data (CSV Format)\\n";
     result += "# Generated: " + String(millis()) + "ms\n";
     result += "# Sample Rate: " + String(sampleRate) + " Hz\n";
+    result += "# Achieved Rate: " + String(getAchievedSampleRate()) + " Hz\n";
     result += "# GPIO Pin: " + String(gpio1Pin) + "\n";
+    if (channelCount > 1) {
+        result += "# Channels: " + String(channelCount) + " (mask 0x" + String(getChannelMask(), HEX) + ")\n";
+    }
     result += "# Buffer Size: " + String(BUFFER_SIZE) + " samples\n";
     result += "# Buffer Usage: " + String(getBufferUsage()) + "/" + String(BUFFER_SIZE) + 
                 " (" + String((getBufferUsage() * 100.0) / BUFFER_SIZE, 1) + "%)\n";
-    result += "# Trigger Mode: " + String((int)triggerMode) + "\n\n";
-    
-    // CSV Header - optimized for single GPIO1 channel
-    result += "Sample,Timestamp_us,GPIO1_Digital,GPIO1_State\n";
-    
-    uint32_t count = getBufferUsage();
-    uint32_t index = readIndex;
-    
-    for (uint32_t i = 0; i < count; i++) {
-        result += String(i + 1) + ",";  // Sample number
-        result += String(buffer[index].timestamp) + ",";  // Timestamp
-        result += String(buffer[index].data ? 1 : 0) + ",";  // Digital value (0/1)
-        result += String(buffer[index].data ? "HIGH" : "LOW");  // State string
-        result += "\n";
-        
-        index = (index + 1) % BUFFER_SIZE;
+    result += "# Trigger Mode: " + String((int)triggerMode) + "\n";
+    if (getTriggerIndex() != CAPTURE_NO_TRIGGER) {
+        result += "# Trigger Index: " + String(getTriggerIndex()) + " (pre-trigger " +
+                  String(logicConfig.preTriggerPercent) + "%)\n";
     }
-    
-    if (count == 0) {
-        result += "# No capture data available\n";
-        result += "# Connect a signal to GPIO" + String(gpio1Pin) + " and start capture\n";
+    if (usesTransitionStore()) {
+        result += "# Encoding: Transitions (" + String(transitionStore.getEdgeCount()) + " edges, " +
+                  String(getStorageUsedPercent()) + "% storage used)\n";
     }
+    if (adaptiveActive) {
+        // Sample numbers count from 1, as in the rows below
+        uint32_t markers = rateMap.size();
+        for (uint32_t i = 0; i < markers; i++) {
+            const RateMarker& m = rateMap.at(i);
+            if (i + 1 < markers && rateMap.at(i + 1).index <= captureFirstIndex) continue;
+            uint64_t sample = m.index > captureFirstIndex ? m.index - captureFirstIndex : 0;
+            result += "# Rate: " + String(m.rate) + " Hz from sample " + String(sample + 1) + "\n";
+        }
+    }
+    if (captureGaps.size() > 0 || captureGaps.getUnlisted() > 0) {
+        // Rows in these stretches repeat the level before them; nothing was read
+        uint32_t gaps = captureGaps.size();
+        for (uint32_t i = 0; i < gaps; i++) {
+            const SampleGap& g = captureGaps.at(i);
+            if (g.index + g.count <= captureFirstIndex) continue;
+            uint64_t first = g.index > captureFirstIndex ? g.index - captureFirstIndex : 0;
+            uint64_t missed = g.index + g.count - captureFirstIndex - first;
+            result += "# Gap: " + String(missed) + " samples held from sample " + String(first + 1) + "\n";
+        }
+        if (captureGaps.getUnlisted() > 0) {
+            result += "# Gap: " + String(captureGaps.getUnlisted()) + " further held samples not listed\n";
+        }
+    }
+    if (envelope) {
+        result += "# Encoding: Envelope (" + String(envelopeStore.getBucketSamples()) + " samples per bucket, " +
+                  String(getStorageUsedPercent()) + "% storage used)\n";
+    }
+    result += "\n";
     
+    if (envelope) {
+        // One row per bucket: levels at its first sample, then its edge summary
+        result += "Bucket,Timestamp_us,Samples,GPIO1_First";
+        for (uint8_t c = 1; c < channelCount; c++) {
+            result += ",CH" + String(c) + "_GPIO" + String(channelPins[c]);
+        }
+        result += ",Transitions,Toggled_Mask,Min_Pulse_ns,Max_Pulse_ns\n";
+        return result;
+    }
+    return result + captureColumnsCSV();
+}
+
+String LogicAnalyzer::captureColumnsCSV() const {
+    // GPIO1 columns first, one extra column per additional channel
+    String result = "Sample,Timestamp_us,GPIO1_Digital,GPIO1_State";
+    for (uint8_t c = 1; c < channelCount; c++) {
+        result += ",CH" + String(c) + "_GPIO" + String(channelPins[c]);
+    }
+    result += "\n";
     return result;
 }
 
+String LogicAnalyzer::csvChannelColumns(uint8_t levels) const {
+    String columns;
+    for (uint8_t c = 1; c < channelCount; c++) {
+        columns += (levels >> c) & 1 ? ",1" : ",0";
+    }
+    return columns;
+}
+
 // Logic Analyzer Configuration Functions
 void LogicAnalyzer::configureLogic(uint32_t sampleRate, uint8_t gpioPin, TriggerMode triggerMode, uint32_t bufferSize, uint8_t preTriggerPercent) {
     // Input validation
@@ -855,7 +2855,7 @@ void LogicAnalyzer::configureLogic(uint32_t sampleRate, uint8_t gpioPin, Trigger
     if (bufferSize > MAX_BUFFER_SIZE) bufferSize = MAX_BUFFER_SIZE;
     if (bufferSize < 1024) bufferSize = 1024;  // Minimum sensible buffer size
     if (preTriggerPercent > 90) preTriggerPercent = 90;
-    if ((int)triggerMode < 0 || (int)triggerMode > 5) triggerMode = TRIGGER_NONE;
+    if ((int)triggerMode < 0 || (int)triggerMode > TRIGGER_TIMEOUT) triggerMode = TRIGGER_NONE;
     
     logicConfig.sampleRate = sampleRate;
     logicConfig.gpioPin = gpioPin;
@@ -867,6 +2867,15 @@ void LogicAnalyzer::configureLogic(uint32_t sampleRate, uint8_t gpioPin, Trigger
     setSampleRate(sampleRate);
     setTrigger(triggerMode);
     gpio1Pin = gpioPin;
+    if (channelPins[0] != gpioPin && !capturing) {
+        // A new primary pin starts over as a single-channel capture
+        channelPins[0] = gpioPin;
+        channelCount = 1;
+        triggerChannel = 0;
+        logicConfig.channelMask = 1UL << gpioPin;
+        logicConfig.triggerChannel = 0;
+        applyChannelLayout();
+    }
     
     saveLogicConfig();
     
@@ -887,9 +2896,36 @@ String LogicAnalyzer::getLogicConfigAsJSON() {
                                   logicConfig.triggerMode == TRIGGER_FALLING_EDGE ? "Falling Edge" :
                                   logicConfig.triggerMode == TRIGGER_BOTH_EDGES ? "Both Edges" :
                                   logicConfig.triggerMode == TRIGGER_HIGH_LEVEL ? "High Level" :
-                                  logicConfig.triggerMode == TRIGGER_LOW_LEVEL ? "Low Level" : "Unknown");
+                                  logicConfig.triggerMode == TRIGGER_LOW_LEVEL ? "Low Level" :
+                                  logicConfig.triggerMode == TRIGGER_SEQUENCE ? "Sequence" :
+                                  logicConfig.triggerMode == TRIGGER_PULSE_SHORTER ? "Pulse Shorter" :
+                                  logicConfig.triggerMode == TRIGGER_PULSE_LONGER ? "Pulse Longer" :
+                                  logicConfig.triggerMode == TRIGGER_GLITCH ? "Glitch" :
+                                  logicConfig.triggerMode == TRIGGER_TIMEOUT ? "Timeout" : "Unknown");
+    doc["trigger_program"] = logicConfig.triggerProgram;
+    doc["trigger_width_ns"] = logicConfig.triggerWidthNs;
+    doc["segment_count"] = logicConfig.segmentCount;
+    doc["trigger_pulse_level"] = logicConfig.triggerPulseLevel;
     doc["buffer_size"] = logicConfig.bufferSize;
     doc["pre_trigger_percent"] = logicConfig.preTriggerPercent;
+    doc["encoding"] = (int)logicConfig.encoding;
+    doc["capture_backend"] = (int)logicConfig.captureBackend;
+    doc["rmt_filter_ns"] = logicConfig.rmtFilterNs;
+    doc["rmt_idle_us"] = logicConfig.rmtIdleUs;
+    doc["burst_samples"] = logicConfig.burstSamples;
+    doc["max_burst_samples"] = BURST_MAX_SAMPLES;
+    doc["envelope_samples"] = logicConfig.envelopeSamples;
+    doc["adaptive_rate"] = logicConfig.adaptiveRate;
+    doc["adaptive_min_rate"] = logicConfig.adaptiveMinRate;
+    doc["capture_health"] = logicConfig.captureHealth;
+    doc["raw_partition"] = logicConfig.rawPartition;
+    doc["raw_partition_found"] = rawLog.isReady();
+    doc["circular_flash"] = circularFlashMode;
+    doc["counter_interval_ms"] = logicConfig.counterIntervalMs;
+    doc["channel_mask"] = getChannelMask();
+    doc["channel_count"] = channelCount;
+    doc["trigger_channel"] = triggerChannel;
+    doc["max_channels"] = MAX_CHANNELS;
     doc["enabled"] = logicConfig.enabled;
     doc["buffer_duration_seconds"] = calculateBufferDuration();
     doc["min_sample_rate"] = MIN_SAMPLE_RATE;
@@ -907,6 +2943,24 @@ void LogicAnalyzer::saveLogicConfig() {
         preferences->putUChar("logic_trig", (uint8_t)logicConfig.triggerMode);
         preferences->putUInt("logic_buffer", logicConfig.bufferSize);
         preferences->putUChar("logic_pretrig", logicConfig.preTriggerPercent);
+        preferences->putUChar("logic_encoding", (uint8_t)logicConfig.encoding);
+        preferences->putUChar("logic_backend", (uint8_t)logicConfig.captureBackend);
+        preferences->putUInt("logic_rmt_flt", logicConfig.rmtFilterNs);
+        preferences->putUInt("logic_rmt_idle", logicConfig.rmtIdleUs);
+        preferences->putUInt("logic_burst", logicConfig.burstSamples);
+        preferences->putUInt("logic_env", logicConfig.envelopeSamples);
+        preferences->putBool("logic_adapt", logicConfig.adaptiveRate);
+        preferences->putUInt("logic_adapt_min", logicConfig.adaptiveMinRate);
+        preferences->putBool("logic_health", logicConfig.captureHealth);
+        preferences->putBool("logic_raw", logicConfig.rawPartition);
+        preferences->putBool("logic_circ", circularFlashMode);
+        preferences->putUInt("logic_cnt_int", logicConfig.counterIntervalMs);
+        preferences->putUInt("logic_chmask", getChannelMask());
+        preferences->putUChar("logic_trig_ch", triggerChannel);
+        preferences->putString("logic_trig_prog", logicConfig.triggerProgram);
+        preferences->putULong64("logic_trig_w", logicConfig.triggerWidthNs);
+        preferences->putUChar("logic_trig_lvl", logicConfig.triggerPulseLevel);
+        preferences->putUChar("logic_segments", logicConfig.segmentCount);
         preferences->putBool("logic_enabled", logicConfig.enabled);
         
         String configMsg = "Logic config saved: " + String(logicConfig.sampleRate) + "Hz, GPIO" + 
@@ -926,12 +2980,45 @@ void LogicAnalyzer::loadLogicConfig() {
         logicConfig.triggerMode = (TriggerMode)preferences->getUChar("logic_trig", TRIGGER_NONE);
         logicConfig.bufferSize = preferences->getUInt("logic_buffer", BUFFER_SIZE);
         logicConfig.preTriggerPercent = preferences->getUChar("logic_pretrig", 10);
+        logicConfig.encoding = (CaptureEncoding)preferences->getUChar("logic_encoding", ENCODING_SAMPLES);
+        if (logicConfig.encoding > ENCODING_ENVELOPE) logicConfig.encoding = ENCODING_SAMPLES;
+        logicConfig.captureBackend = (CaptureBackend)preferences->getUChar("logic_backend", BACKEND_AUTO);
+        if (logicConfig.captureBackend > BACKEND_BURST) logicConfig.captureBackend = BACKEND_AUTO;
+        logicConfig.rmtFilterNs = preferences->getUInt("logic_rmt_flt", 0);
+        logicConfig.rmtIdleUs = preferences->getUInt("logic_rmt_idle", 1000);
+        logicConfig.burstSamples = preferences->getUInt("logic_burst", BURST_MAX_SAMPLES);
+        if (logicConfig.burstSamples < BURST_UNROLL || logicConfig.burstSamples > BURST_MAX_SAMPLES) {
+            logicConfig.burstSamples = BURST_MAX_SAMPLES;
+        }
+        setEnvelopeSamples(preferences->getUInt("logic_env", ENVELOPE_DEFAULT_SAMPLES));
+        logicConfig.adaptiveRate = preferences->getBool("logic_adapt", false);
+        logicConfig.adaptiveMinRate = preferences->getUInt("logic_adapt_min", ADAPTIVE_DEFAULT_MIN_RATE);
+        if (logicConfig.adaptiveMinRate < MIN_SAMPLE_RATE) logicConfig.adaptiveMinRate = ADAPTIVE_DEFAULT_MIN_RATE;
+        logicConfig.captureHealth = preferences->getBool("logic_health", false);
+        logicConfig.rawPartition = preferences->getBool("logic_raw", false);
+        circularFlashMode = preferences->getBool("logic_circ", false);
+        setCounterInterval(preferences->getUInt("logic_cnt_int", 60000));
+        logicConfig.channelMask = preferences->getUInt("logic_chmask", 1UL << logicConfig.gpioPin);
+        logicConfig.triggerChannel = preferences->getUChar("logic_trig_ch", 0);
+        logicConfig.triggerProgram = preferences->getString("logic_trig_prog", "");
+        logicConfig.triggerWidthNs = preferences->getULong64("logic_trig_w", 1000000);
+        logicConfig.triggerPulseLevel = preferences->getUChar("logic_trig_lvl", 1);
+        logicConfig.segmentCount = preferences->getUChar("logic_segments", 1);
+        if (logicConfig.segmentCount < 1 || logicConfig.segmentCount > MAX_CAPTURE_SEGMENTS) logicConfig.segmentCount = 1;
         logicConfig.enabled = preferences->getBool("logic_enabled", true);
         
         // Apply loaded configuration
         setSampleRate(logicConfig.sampleRate);
         setTrigger(logicConfig.triggerMode);
         gpio1Pin = logicConfig.gpioPin;
+        channelPins[0] = gpio1Pin;
+        if (!setChannelMask(logicConfig.channelMask)) {
+            logicConfig.channelMask = 1UL << gpio1Pin;  // Keep the single configured pin
+        }
+        setTriggerChannel(logicConfig.triggerChannel);
+        if (logicConfig.triggerMode == TRIGGER_SEQUENCE && !setTriggerProgram(logicConfig.triggerProgram)) {
+            setTrigger(TRIGGER_NONE);
+        }
         
         String configMsg = "Logic config loaded: " + String(logicConfig.sampleRate) + "Hz, GPIO" + 
                            String(logicConfig.gpioPin) + ", Trigger:" + String((int)logicConfig.triggerMode);
@@ -944,6 +3031,24 @@ void LogicAnalyzer::loadLogicConfig() {
         logicConfig.triggerMode = TRIGGER_NONE;
         logicConfig.bufferSize = BUFFER_SIZE;
         logicConfig.preTriggerPercent = 10;
+        logicConfig.encoding = ENCODING_SAMPLES;
+        logicConfig.captureBackend = BACKEND_AUTO;
+        logicConfig.rmtFilterNs = 0;
+        logicConfig.rmtIdleUs = 1000;
+        logicConfig.burstSamples = BURST_MAX_SAMPLES;
+        logicConfig.envelopeSamples = ENVELOPE_DEFAULT_SAMPLES;
+        logicConfig.adaptiveRate = false;
+        logicConfig.adaptiveMinRate = ADAPTIVE_DEFAULT_MIN_RATE;
+        logicConfig.captureHealth = false;
+        logicConfig.rawPartition = false;
+        circularFlashMode = false;
+        logicConfig.counterIntervalMs = 60000;
+        logicConfig.channelMask = 1UL << CHANNEL_0_PIN;
+        logicConfig.triggerChannel = 0;
+        logicConfig.triggerProgram = "";
+        logicConfig.triggerWidthNs = 1000000;
+        logicConfig.triggerPulseLevel = 1;
+        logicConfig.segmentCount = 1;
         logicConfig.enabled = true;
         addLogEntry("Logic config loaded (defaults - no preferences available)");
     }
@@ -1102,7 +3207,7 @@ void LogicAnalyzer::processUartData() {
 }
 
 void LogicAnalyzer::addUartEntry(const String& data, bool isRx) {
-    uint32_t timestamp = millis();
+    uint64_t timestamp = captureMicros() / 1000;  // ms, does not wrap like millis()
     String direction = isRx ? "RX" : "TX";
     String uartEntry = String(timestamp) + ": [UART " + direction + "] " + data;
     
@@ -1496,13 +3601,28 @@ void LogicAnalyzer::initFlashLogicStorage() {
         return;
     }
     
-    // Initialize flash write buffer
-    if (!flashWriteBuffer) {
-        flashWriteBuffer = (uint8_t*)malloc(FLASH_CHUNK_SIZE);
-        if (!flashWriteBuffer) {
-            Serial.println("Failed to allocate flash write buffer");
+    // Initialize flash write buffers: the first is filled, the others
+    // wait in the free ring for the writer task to hand them back
+    static_assert(FLASH_WRITE_BUFFERS >= 2 && FLASH_WRITE_BUFFERS <= 4, "Buffers must fit the writer rings");
+    if (!flashWritePool) {
+        flashWritePool = (uint8_t*)malloc(FLASH_WRITE_BUFFERS * FLASH_CHUNK_SIZE);
+        if (!flashWritePool) {
+            Serial.println("Failed to allocate flash write buffers");
             return;
         }
+        flashWriteBuffer = flashWritePool;
+        for (uint8_t i = 1; i < FLASH_WRITE_BUFFERS; i++) {
+            flashFreeBuffers.push(flashWritePool + i * FLASH_CHUNK_SIZE);
+        }
+    }
+    
+    // Without the task, chunks are written inline as before
+    if (!flashWriterHandle) {
+        if (xTaskCreatePinnedToCore(flashWriterTaskEntry, "flash_writer", FLASH_WRITER_TASK_STACK, this,
+                                    FLASH_WRITER_TASK_PRIORITY, &flashWriterHandle, FLASH_WRITER_TASK_CORE) != pdPASS) {
+            flashWriterHandle = nullptr;
+            addLogEntry("Flash writer task creation failed - writing chunks inline");
+        }
     }
     
     // Initialize compression buffer
@@ -1516,6 +3636,7 @@ void LogicAnalyzer::initFlashLogicStorage() {
     flashStorageActive = true;
     bufferPosition = 0;
     compressedCount = 0;
+    compressedLastTime = 0;  // Next entry starts a new chain
     
     addLogEntry("Logic flash storage initialized");
     Serial.println("Logic Analyzer Flash Storage ready");
@@ -1523,6 +3644,7 @@ void LogicAnalyzer::initFlashLogicStorage() {
 
 void LogicAnalyzer::enableFlashBuffering(BufferMode mode, uint32_t maxSamples) {
     logicConfig.bufferMode = mode;
+    selectSampleWriter();
     
     // Limit flash samples to realistic values (5.6MB total shared with UART)
     if (maxSamples > MAX_FLASH_BUFFER_SIZE) {
@@ -1534,12 +3656,15 @@ void LogicAnalyzer::enableFlashBuffering(BufferMode mode, uint32_t maxSamples) {
         initFlashLogicStorage();
         
         // Initialize flash header
-        flashHeader.magic = 0x4C4F4749;  // "LOGI"
-        flashHeader.version = 1;
+        flashHeader.magic = FLASH_FORMAT_MAGIC;
+        flashHeader.version = FLASH_FORMAT_VERSION;
         flashHeader.sample_count = 0;
         flashHeader.buffer_size = maxSamples;
         flashHeader.sample_rate = sampleRate;
-        flashHeader.compression = (uint32_t)logicConfig.compression;
+        flashHeader.compression = (uint8_t)logicConfig.compression;
+        flashHeader.trigger_index = CAPTURE_NO_TRIGGER;
+        flashHeader.first_timestamp = 0;
+        flashHeader.last_timestamp = 0;
         
         String msg = "Flash buffering enabled: " + String(maxSamples) + " max samples (shared 5.6MB flash)";
         addLogEntry(msg);
@@ -1557,37 +3682,345 @@ void LogicAnalyzer::enableFlashBuffering(BufferMode mode, uint32_t maxSamples) {
 void LogicAnalyzer::writeToFlash(const Sample& sample) {
     if (!flashWriteBuffer) return;
     
-    // Write sample to buffer
-    memcpy(flashWriteBuffer + bufferPosition, &sample, sizeof(Sample));
-    bufferPosition += sizeof(Sample);
-    flashSamplesWritten++;
+    // Room for a keyframe and the record, so a record never opens a chunk
+    // without its keyframe
+    bool chunkStart = beginFlashWrite(2 * sizeof(FlashSampleRecord));
+    if (chunkStart) {
+        flashChunk.first_sample = flashSamplesWritten;
+        flashChunk.first_timestamp = sample.timestamp;
+        flashChunk.levels = sample.data;
+        flashChunk.sample_count = 0;
+    }
     
-    // Flush if buffer is full
-    if (bufferPosition >= FLASH_CHUNK_SIZE - sizeof(Sample)) {
+    // 32-bit deltas keep records at 8 bytes; keyframes carry the full 64-bit
+    // time so a reader can resynchronise at any chunk
+    FlashSampleRecord record = {};
+    uint64_t delta = sample.timestamp - flashLastTimestamp;
+    if (chunkStart || flashRecordsSinceKeyframe >= FLASH_KEYFRAME_INTERVAL ||
+        sample.timestamp < flashLastTimestamp || delta > 0xFFFFFFFF) {
+        record.time = (uint32_t)(sample.timestamp >> 32);
+        record.flags = FLASH_RECORD_KEYFRAME;
+        writeFlashBytes((const uint8_t*)&record, sizeof(record));
+        record.time = (uint32_t)sample.timestamp;
+        flashRecordsSinceKeyframe = 0;
+    } else {
+        record.time = (uint32_t)delta;
+    }
+    record.flags = 0;
+    record.levels = sample.data;
+    writeFlashBytes((const uint8_t*)&record, sizeof(record));
+    
+    if (flashSamplesWritten == 0) {
+        flashHeader.first_timestamp = sample.timestamp;
+    }
+    flashHeader.last_timestamp = sample.timestamp;
+    flashLastTimestamp = sample.timestamp;
+    flashRecordsSinceKeyframe++;
+    flashSamplesWritten++;
+    flashChunk.sample_count++;
+}
+
+bool LogicAnalyzer::beginFlashWrite(uint32_t length) {
+    if (bufferPosition + length > FLASH_CHUNK_PAYLOAD) {
         flushFlashBuffer();
     }
+    return bufferPosition == 0;
+}
+
+void LogicAnalyzer::writeFlashBytes(const uint8_t* data, uint32_t length) {
+    // Callers make room with beginFlashWrite(), so nothing straddles chunks
+    if (!flashWriteBuffer || bufferPosition + length > FLASH_CHUNK_PAYLOAD) return;
+    memcpy(flashWriteBuffer + sizeof(FlashChunkHeader) + bufferPosition, data, length);
+    bufferPosition += length;
+}
+
+uint8_t LogicAnalyzer::flashCodec() const {
+    if (usesTransitionStore()) return FLASH_CODEC_TRANSITIONS;
+    if (logicConfig.bufferMode == BUFFER_STREAMING && logicConfig.compression != COMPRESS_NONE) {
+        return FLASH_CODEC_COMPRESSED;
+    }
+    return FLASH_CODEC_RECORDS;
+}
+
+void LogicAnalyzer::writeFlashHeader(File& file) {
+    flashHeader.crc32 = flashHeaderCrc(flashHeader);
+    file.seek(0);
+    file.write((const uint8_t*)&flashHeader, sizeof(flashHeader));
+}
+
+void LogicAnalyzer::openFlashFile() {
+    // The raw log carries on after its last chunk; a new capture gets a new
+    // log, started by the writer task along with chunk 0
+    if (rawLogActive) {
+        if (flashChunkCount == 0) {
+            flashPageCache.invalidate();
+            fillFlashHeader();
+            flashHeader.crc32 = flashHeaderCrc(flashHeader);
+            rawLogMeta = flashHeader;
+            flashWritePosition = sizeof(FlashStorageHeader);
+        }
+        rawLogOpen = true;
+        return;
+    }
+    
+    // Chunks sit at fixed offsets after the header. A file that already
+    // holds chunks of this capture is reopened after the last one, which
+    // also overwrites an index written when the capture was last stopped.
+    if (flashChunkCount > 0 && LittleFS.exists(flashLogicFileName)) {
+        flashDataFile = LittleFS.open(flashLogicFileName, "r+");
+        if (flashDataFile) {
+            flashDataFile.seek(flashChunkOffset(flashChunkCount));
+        }
+        return;
+    }
+    
+    flashDataFile = LittleFS.open(flashLogicFileName, "w");
+    flashPageCache.invalidate();
+    if (!flashDataFile) return;
+    fillFlashHeader();
+    writeFlashHeader(flashDataFile);
+    flashWritePosition = sizeof(FlashStorageHeader);
+}
+
+void LogicAnalyzer::fillFlashHeader() {
+    flashChunkCount = 0;
+    flashHeader.magic = FLASH_FORMAT_MAGIC;
+    flashHeader.version = FLASH_FORMAT_VERSION;
+    flashHeader.header_bytes = sizeof(FlashStorageHeader);
+    flashHeader.chunk_bytes = FLASH_CHUNK_SIZE;
+    flashHeader.codec = flashCodec();
+    flashHeader.channels = channelCount;
+    flashHeader.compression = (uint8_t)logicConfig.compression;
+    if (flashHeader.codec != FLASH_CODEC_TRANSITIONS) flashHeader.sample_rate = sampleRate;
+    flashHeader.chunk_count = 0;
+    flashHeader.index_offset = 0;
+    flashHeader.flags = flashRingChunks ? FLASH_HEADER_CIRCULAR : 0;
+    flashHeader.ring_chunks = flashRingChunks;
+}
+
+uint32_t LogicAnalyzer::flashChunkOffset(uint32_t sequence) const {
+    // Once a circular capture's ring is full, a chunk takes the oldest one's slot
+    uint32_t slot = flashRingChunks ? sequence % flashRingChunks : sequence;
+    return sizeof(FlashStorageHeader) + slot * FLASH_CHUNK_SIZE;
+}
+
+uint32_t LogicAnalyzer::flashKeptChunks() const {
+    return flashRingChunks && flashChunkCount > flashRingChunks ? flashRingChunks : flashChunkCount;
+}
+
+void LogicAnalyzer::checkFlashSpaceAndRotate() {
+    flashRingChunks = 0;
+    flashStopChunk = 0xFFFFFFFF;
+    maxFlashSizeBytes = logicConfig.maxFlashSamples * sizeof(FlashSampleRecord);
+    bool flashCapture = logicConfig.bufferMode == BUFFER_FLASH || logicConfig.bufferMode == BUFFER_STREAMING;
+    if (!circularFlashMode || !flashCapture) return;
+    
+    if (rawLogActive) {
+        // The log wraps over the whole partition; the segment being filled
+        // and those erased ahead of it hold no kept chunks
+        uint32_t segments = rawLog.getSegments();
+        if (segments > RAW_LOG_ERASE_AHEAD + 1) {
+            flashRingChunks = (segments - RAW_LOG_ERASE_AHEAD - 1) * rawLog.getSlotsPerSegment();
+        }
+    } else {
+        // maxFlashSamples records, as far as LittleFS can spare the slots
+        // and their index entries next to the UART logs
+        uint32_t wanted = (maxFlashSizeBytes + FLASH_CHUNK_PAYLOAD - 1) / FLASH_CHUNK_PAYLOAD;
+        size_t total = LittleFS.totalBytes();
+        size_t used = LittleFS.usedBytes() + FLASH_RING_RESERVE_BYTES;
+        uint32_t fits = total > used ? (total - used) / (FLASH_CHUNK_SIZE + sizeof(FlashIndexEntry)) : 0;
+        flashRingChunks = wanted < fits ? wanted : fits;
+    }
+    if (flashRingChunks < 2) {
+        flashRingChunks = 0;
+        addLogEntry("Not enough flash for a circular capture - stopping when full");
+        return;
+    }
+    maxFlashSizeBytes = flashRingChunks * FLASH_CHUNK_SIZE;
+    addLogEntry("Circular flash capture: " + String(flashRingChunks) + " chunks (" + String(maxFlashSizeBytes / 1024) +
+                " KB)");
+}
+
+bool LogicAnalyzer::isFlashOutputOpen() const {
+    return rawLogActive ? rawLogOpen : (bool)flashDataFile;
 }
 
 void LogicAnalyzer::flushFlashBuffer() {
     if (!flashWriteBuffer || bufferPosition == 0) return;
+    uint64_t start = healthActive ? captureMicros() : 0;
     
-    if (!flashDataFile) {
-        flashDataFile = LittleFS.open(flashLogicFileName, "a");
+    if (!isFlashOutputOpen()) {
+        openFlashFile();
     }
     
+    if (isFlashOutputOpen()) {
+        // Chunks are padded so chunk i is always at the same offset
+        uint8_t* payload = flashWriteBuffer + sizeof(FlashChunkHeader);
+        memset(payload + bufferPosition, 0, FLASH_CHUNK_PAYLOAD - bufferPosition);
+        flashChunk.magic = FLASH_CHUNK_MAGIC;
+        flashChunk.sequence = flashChunkCount;
+        flashChunk.payload_bytes = (uint16_t)bufferPosition;
+        flashChunk.codec = flashHeader.codec;
+        flashChunk.crc32 = flashCrc32(payload, bufferPosition);
+        memcpy(flashWriteBuffer, &flashChunk, sizeof(flashChunk));
+        
+        uint32_t chunkStart = flashChunkOffset(flashChunkCount);
+        if (flashWriterHandle) {
+            // Queue the chunk and carry on in a free buffer. With none free
+            // the writer is behind; during a capture the chunk is dropped and
+            // counted rather than waiting here while the capture ring fills.
+            // When the file is finalized nothing is time-critical, so the
+            // last chunks wait for a buffer instead.
+            uint8_t* next;
+            bool freed = flashFreeBuffers.pop(next);
+            while (!freed && flashFinalizing) {
+                delay(1);
+                freed = flashFreeBuffers.pop(next);
+            }
+            if (freed) {
+                FlashWriteJob job = {flashWriteBuffer, chunkStart};
+                flashWriteJobs.push(job);
+                xTaskNotifyGive(flashWriterHandle);
+                flashWriteBuffer = next;
+                flashChunkCount++;
+                flashWritePosition = sizeof(FlashStorageHeader) + flashKeptChunks() * FLASH_CHUNK_SIZE;
+            } else {
+                flashWriteOverruns++;
+            }
+        } else if (writeFlashChunk(flashWriteBuffer, chunkStart)) {
+            flashChunkCount++;
+            flashWritePosition = sizeof(FlashStorageHeader) + flashKeptChunks() * FLASH_CHUNK_SIZE;
+        }
+    }
+    bufferPosition = 0;
+    if (healthActive) flushTimer.add((uint32_t)(captureMicros() - start));
+}
+
+bool LogicAnalyzer::writeFlashChunk(const uint8_t* chunk, uint32_t offset) {
+    uint64_t start = captureMicros();
+    bool ok;
+    if (rawLogActive) {
+        // Chunk n of the capture is slot n of the log; a circular capture
+        // lets the log wrap
+        if (((const FlashChunkHeader*)chunk)->sequence == 0) {
+            rawLog.start(&rawLogMeta, sizeof(rawLogMeta), flashRingChunks != 0);
+        }
+        ok = rawLog.append(chunk);
+    } else {
+        ok = flashDataFile.seek(offset) && flashDataFile.write(chunk, FLASH_CHUNK_SIZE) == FLASH_CHUNK_SIZE;
+    }
+    if (ok) {
+        flashWriteTimer.add((uint32_t)(captureMicros() - start));
+    } else {
+        flashWriteErrors++;  // Flash full; a reader finds the chunk missing
+    }
+    return ok;
+}
+
+void LogicAnalyzer::flashWriterTaskEntry(void* param) {
+    static_cast<LogicAnalyzer*>(param)->flashWriterLoop();
+}
+
+void LogicAnalyzer::flashWriterLoop() {
+    bool erasing = false;
+    for (;;) {
+        // Woken by every queued chunk. While the raw log still wants
+        // segments erased ahead, the queue is only checked between erases.
+        ulTaskNotifyTake(pdTRUE, erasing ? 0 : pdMS_TO_TICKS(100));
+        
+        // A job is popped only once written, so an empty queue means idle
+        FlashWriteJob* job;
+        while ((job = flashWriteJobs.front()) != nullptr) {
+            writeFlashChunk(job->buffer, job->offset);
+            flashFreeBuffers.push(job->buffer);
+            flashWriteJobs.pop();
+        }
+        erasing = rawLogActive && rawLog.service();
+    }
+}
+
+void LogicAnalyzer::waitForFlashWriter() {
+    // A 4 KB write normally takes milliseconds and an erase longer, but the
+    // writer may be using the file until its queue is empty, so no timeout
+    while (!flashWriteJobs.empty()) {
+        delay(1);
+    }
+}
+
+void LogicAnalyzer::finalizeFlashFile() {
+    // Every chunk is queued and written before the file is closed under
+    // the writer
+    flashFinalizing = true;
+    if (flashCodec() == FLASH_CODEC_COMPRESSED) {
+        writeCompressedEntries();
+    }
+    flushFlashBuffer();
+    flashFinalizing = false;
+    waitForFlashWriter();
+    if (rawLogActive) {
+        // Every segment carries the header; chunks are found by slot, so
+        // the raw log has no index or final header
+        rawLogOpen = false;
+        return;
+    }
     if (flashDataFile) {
-        size_t written = flashDataFile.write(flashWriteBuffer, bufferPosition);
-        flashWritePosition += written;
-        bufferPosition = 0;
+        flashDataFile.close();
+    }
+    if (flashChunkCount == 0) return;
+    
+    File file = LittleFS.open(flashLogicFileName, "r+");
+    if (!file) return;
+    uint64_t start = healthActive ? captureMicros() : 0;
+    
+    // The index is copied from the chunk headers a few at a time, so its
+    // size does not depend on the RAM left. It lists the kept chunks oldest
+    // first, which for a circular capture starts part way round the ring.
+    uint32_t kept = flashKeptChunks();
+    uint32_t oldest = flashChunkCount - kept;
+    uint32_t indexOffset = sizeof(FlashStorageHeader) + kept * FLASH_CHUNK_SIZE;
+    FlashIndexEntry entries[16];
+    uint32_t crc = 0;
+    bool ok = true;
+    for (uint32_t first = 0; first < kept && ok; first += 16) {
+        uint32_t n = kept - first < 16 ? kept - first : 16;
+        for (uint32_t i = 0; i < n && ok; i++) {
+            FlashChunkHeader chunk;
+            file.seek(flashChunkOffset(oldest + first + i));
+            ok = file.read((uint8_t*)&chunk, sizeof(chunk)) == sizeof(chunk);
+            entries[i].first_timestamp = chunk.first_timestamp;
+            entries[i].first_sample = chunk.first_sample;
+            entries[i].sample_count = chunk.sample_count;
+            if (first + i == 0 && oldest > 0 && flashHeader.codec != FLASH_CODEC_TRANSITIONS) {
+                flashHeader.first_timestamp = chunk.first_timestamp;  // Edge times stay on the capture's timebase
+            }
+        }
+        file.seek(indexOffset + first * sizeof(FlashIndexEntry));
+        ok = ok && file.write((const uint8_t*)entries, n * sizeof(FlashIndexEntry)) == n * sizeof(FlashIndexEntry);
+        crc = flashCrc32(entries, n * sizeof(FlashIndexEntry), crc);
     }
+    if (ok) {
+        FlashIndexTrailer trailer = {FLASH_INDEX_MAGIC, kept, crc, 0};
+        ok = file.write((const uint8_t*)&trailer, sizeof(trailer)) == sizeof(trailer);
+    }
+    
+    // Without an index a reader still finds the chunks from the file size
+    flashHeader.sample_count = flashSamplesWritten;
+    flashHeader.chunk_count = flashChunkCount;
+    flashHeader.index_offset = ok ? indexOffset : 0;
+    flashHeader.flags = (flashHeader.flags & FLASH_HEADER_CIRCULAR) | (ok ? FLASH_HEADER_FINALIZED : 0);
+    writeFlashHeader(file);
+    flashWritePosition = file.size();
+    file.close();
+    if (healthActive) flushTimer.add((uint32_t)(captureMicros() - start));
 }
 
 // Compression Methods
 void LogicAnalyzer::enableCompression(CompressionType type) {
     logicConfig.compression = type;
+    selectSampleWriter();
     runLength = 0;
     lastTimestamp = 0;
-    lastData = false;
+    lastData = 0;
     
     String compressionName = (type == COMPRESS_RLE ? "RLE" :
                              type == COMPRESS_DELTA ? "Delta" :
@@ -1597,39 +4030,63 @@ void LogicAnalyzer::enableCompression(CompressionType type) {
 }
 
 void LogicAnalyzer::compressSample(const Sample& sample) {
-    if (!compressedBuffer) return;
-    
     switch (logicConfig.compression) {
         case COMPRESS_RLE:
-            compressRunLength(sample.data, sample.timestamp, 1);
+            compressSampleAs<COMPRESS_RLE>(sample);
             break;
         case COMPRESS_DELTA:
-            compressDelta(sample.timestamp, sample.data);
+            compressSampleAs<COMPRESS_DELTA>(sample);
             break;
         case COMPRESS_HYBRID:
-            // Use RLE for consecutive same values, delta for changes
-            if (sample.data == lastData && runLength < 65535) {
-                runLength++;
-            } else {
-                if (runLength > 0) {
-                    compressRunLength(lastData, lastTimestamp, runLength);
-                }
-                compressDelta(sample.timestamp, sample.data);
-                runLength = 1;
-            }
+            compressSampleAs<COMPRESS_HYBRID>(sample);
             break;
         default:
+            compressSampleAs<COMPRESS_NONE>(sample);
             break;
     }
+}
+
+template <CompressionType Codec>
+void LogicAnalyzer::compressSampleAs(const Sample& sample) {
+    if (!compressedBuffer) return;
+    
+    if (Codec == COMPRESS_RLE) {
+        compressRunLength(sample.data, sample.timestamp, 1);
+    } else if (Codec == COMPRESS_DELTA) {
+        compressDelta(sample.timestamp, sample.data);
+    } else if (Codec == COMPRESS_HYBRID) {
+        // Use RLE for consecutive same values, delta for changes
+        if (sample.data == lastData && runLength < 65535) {
+            runLength++;
+        } else {
+            if (runLength > 0) {
+                compressRunLength(lastData, lastTimestamp, runLength);
+            }
+            compressDelta(sample.timestamp, sample.data);
+            runLength = 1;
+        }
+    }
     
     lastTimestamp = sample.timestamp;
     lastData = sample.data;
 }
 
-void LogicAnalyzer::compressRunLength(bool data, uint32_t timestamp, uint16_t count) {
+uint32_t LogicAnalyzer::compressedDeltaTo(uint64_t timestamp) {
+    // Entries chain from compressedBaseTime, so the buffer can span more
+    // than a 32-bit microsecond range
+    if (compressedLastTime == 0) {
+        compressedBaseTime = timestamp;
+        compressedLastTime = timestamp;
+    }
+    uint64_t delta = timestamp - compressedLastTime;
+    compressedLastTime = timestamp;
+    return delta > 0xFFFFFFFF ? 0xFFFFFFFF : (uint32_t)delta;
+}
+
+void LogicAnalyzer::compressRunLength(uint8_t data, uint64_t timestamp, uint16_t count) {
     if (compressedCount < 1000) {
         CompressedSample& compressed = compressedBuffer[compressedCount];
-        compressed.timestamp = timestamp;
+        compressed.timestamp = compressedDeltaTo(timestamp);
         compressed.count = count;
         compressed.data = data;
         compressed.type = COMPRESS_RLE;
@@ -1637,10 +4094,10 @@ void LogicAnalyzer::compressRunLength(bool data, uint32_t timestamp, uint16_t co
     }
 }
 
-void LogicAnalyzer::compressDelta(uint32_t timestamp, bool data) {
+void LogicAnalyzer::compressDelta(uint64_t timestamp, uint8_t data) {
     if (compressedCount < 1000) {
         CompressedSample& compressed = compressedBuffer[compressedCount];
-        compressed.timestamp = timestamp - lastTimestamp;
+        compressed.timestamp = compressedDeltaTo(timestamp);
         compressed.count = 1;
         compressed.data = data;
         compressed.type = COMPRESS_DELTA;
@@ -1658,40 +4115,86 @@ void LogicAnalyzer::enableStreamingMode(bool enable) {
         initFlashLogicStorage();
         addLogEntry("Streaming mode enabled - continuous capture to flash");
     } else {
-        flushFlashBuffer();
-        if (flashDataFile) {
-            flashDataFile.close();
-        }
+        finalizeFlashFile();
         addLogEntry("Streaming mode disabled");
     }
 }
 
 void LogicAnalyzer::processStreamingSample(const Sample& sample) {
+    switch (logicConfig.compression) {
+        case COMPRESS_RLE:
+            streamSampleAs<COMPRESS_RLE>(sample);
+            break;
+        case COMPRESS_DELTA:
+            streamSampleAs<COMPRESS_DELTA>(sample);
+            break;
+        case COMPRESS_HYBRID:
+            streamSampleAs<COMPRESS_HYBRID>(sample);
+            break;
+        default:
+            streamSampleAs<COMPRESS_NONE>(sample);
+            break;
+    }
+}
+
+template <CompressionType Codec>
+void LogicAnalyzer::streamSampleAs(const Sample& sample) {
     if (!streamingActive) return;
     
     streamingCount++;
     
-    if (logicConfig.compression != COMPRESS_NONE) {
-        compressSample(sample);
+    if (Codec != COMPRESS_NONE) {
+        compressSampleAs<Codec>(sample);
         
-        // Flush compressed data periodically
+        // Hand compressed entries to the flash writer in batches
         if (compressedCount >= 500) {
-            // Write compressed samples to flash
-            for (uint32_t i = 0; i < compressedCount; i++) {
-                writeToFlash(*(Sample*)&compressedBuffer[i]);
-            }
-            compressedCount = 0;
+            writeCompressedEntries();
         }
     } else {
         writeToFlash(sample);
     }
+}
+
+void LogicAnalyzer::writeCompressedEntries() {
+    if (!compressedBuffer) return;
     
-    // Flush to flash every 1000 samples
-    if (streamingCount % 1000 == 0) {
-        flushFlashBuffer();
+    // Entry times chain from compressedBaseTime; each chunk records where
+    // the chain stands before its first entry
+    if (flashSamplesWritten == 0) {
+        flashLastTimestamp = compressedBaseTime;
+        flashHeader.first_timestamp = compressedBaseTime;
+    }
+    for (uint32_t i = 0; i < compressedCount; i++) {
+        if (beginFlashWrite(sizeof(CompressedSample))) {
+            flashChunk.first_sample = flashSamplesWritten;
+            flashChunk.first_timestamp = flashLastTimestamp;
+            flashChunk.levels = compressedBuffer[i].data;
+            flashChunk.sample_count = 0;
+        }
+        writeFlashBytes((const uint8_t*)&compressedBuffer[i], sizeof(CompressedSample));
+        flashLastTimestamp += compressedBuffer[i].timestamp;
+        flashChunk.sample_count++;
+        flashSamplesWritten++;
+    }
+    if (compressedCount > 0) {
+        flashHeader.last_timestamp = flashLastTimestamp;
     }
+    compressedCount = 0;  // The delta chain continues in the next batch
 }
 
+// The capture file as the page reader sees it
+class FlashFileSource : public FlashByteSource {
+private:
+    File& file;
+
+public:
+    explicit FlashFileSource(File& f) : file(f) {}
+    uint32_t size() override { return file.size(); }
+    bool read(uint32_t offset, void* data, uint32_t length) override {
+        return file.seek(offset) && file.read((uint8_t*)data, length) == length;
+    }
+};
+
 String LogicAnalyzer::getFlashDataAsJSON(uint32_t offset, uint32_t count) {
     JsonDocument doc;
     doc["flash_samples"] = flashSamplesWritten;
@@ -1699,6 +4202,67 @@ String LogicAnalyzer::getFlashDataAsJSON(uint32_t offset, uint32_t count) {
     doc["storage_mb"] = getFlashStorageUsedMB();
     doc["buffer_mode"] = getBufferModeString();
     doc["compression_ratio"] = getCompressionRatio();
+    if (flashHeader.trigger_index != CAPTURE_NO_TRIGGER) {
+        doc["trigger_index"] = flashHeader.trigger_index;
+    }
+    doc["first_timestamp"] = flashHeader.first_timestamp;
+    doc["last_timestamp"] = flashHeader.last_timestamp;
+    doc["format_version"] = FLASH_FORMAT_VERSION;
+    doc["codec"] = flashHeader.codec;
+    doc["chunk_bytes"] = FLASH_CHUNK_SIZE;
+    doc["chunk_count"] = flashChunkCount;
+    doc["finalized"] = (flashHeader.flags & FLASH_HEADER_FINALIZED) != 0;
+    doc["circular"] = flashRingChunks != 0;
+    if (flashRingChunks) {
+        doc["ring_chunks"] = flashRingChunks;
+        doc["kept_chunks"] = flashKeptChunks();
+    }
+    
+    // The page comes from the chunks that hold it, found through the chunk
+    // index. Samples still in the chunk being filled are not on flash yet.
+    if (count > FLASH_PAGE_MAX_SAMPLES) count = FLASH_PAGE_MAX_SAMPLES;
+    doc["offset"] = offset;
+    JsonArray samples = doc["samples"].to<JsonArray>();
+    if (!flashPageMemory) {
+        flashPageMemory = (uint8_t*)malloc(FLASH_PAGE_CACHE_CHUNKS * FLASH_CHUNK_SIZE);
+        flashPageCache.attach(flashPageMemory, FLASH_CHUNK_SIZE);
+    }
+    File file;
+    bool fromRawLog = rawLogActive && flashPageMemory && offset < flashSamplesWritten;
+    if (!fromRawLog && flashPageMemory && offset < flashSamplesWritten && LittleFS.exists(flashLogicFileName)) {
+        file = LittleFS.open(flashLogicFileName, "r");
+    }
+    if (file || fromRawLog) {
+        FlashFileSource fileSource(file);
+        SegmentLogSource logSource(rawLog);
+        FlashCaptureReader reader;
+        FlashCaptureReader::Status status = reader.open(fromRawLog ? (FlashByteSource*)&logSource : &fileSource);
+        FlashIndexEntry oldest;
+        if (status == FlashCaptureReader::FLASH_OK && reader.isCircular() &&
+            reader.readIndexEntry(0, oldest) == FlashCaptureReader::FLASH_OK) {
+            doc["first_sample"] = oldest.first_sample;  // Earlier samples were overwritten
+        }
+        if (status == FlashCaptureReader::FLASH_OK) {
+            bool multiChannel = reader.getHeader().channels > 1;
+            status = readFlashPage(reader, flashPageCache, offset, count,
+                [&](uint32_t sampleNumber, uint64_t timestamp, uint8_t levels) -> bool {
+                    JsonObject sample = samples.add<JsonObject>();
+                    sample["sample"] = sampleNumber;
+                    sample["timestamp"] = timestamp;
+                    sample["gpio1"] = (bool)(levels & 1);
+                    sample["state"] = (levels & 1) ? "HIGH" : "LOW";
+                    if (multiChannel) sample["channels"] = levels;  // Bit c = channel c
+                    return true;
+                });
+        }
+        if (status != FlashCaptureReader::FLASH_OK) {
+            doc["read_error"] = (int)status;  // FlashCaptureReader::Status
+        }
+        if (file) file.close();
+    }
+    doc["returned"] = samples.size();
+    doc["page_cache_hits"] = flashPageCache.getHits();
+    doc["page_cache_misses"] = flashPageCache.getMisses();
     
     String result;
     serializeJson(doc, result);
@@ -1708,7 +4272,7 @@ String LogicAnalyzer::getFlashDataAsJSON(uint32_t offset, uint32_t count) {
 uint32_t LogicAnalyzer::getCompressionRatio() const {
     if (flashSamplesWritten == 0) return 0;
     
-    uint32_t originalSize = flashSamplesWritten * sizeof(Sample);
+    uint32_t originalSize = flashSamplesWritten * sizeof(FlashSampleRecord);
     uint32_t compressedSize = compressedCount * sizeof(CompressedSample);
     
     if (compressedSize == 0) return 0;
@@ -1734,24 +4298,32 @@ uint32_t LogicAnalyzer::getFlashSampleCount() const {
 }
 
 void LogicAnalyzer::clearFlashLogicData() {
+    waitForFlashWriter();
     if (flashDataFile) {
         flashDataFile.close();
     }
+    rawLogOpen = false;
     
     if (LittleFS.exists(flashLogicFileName)) {
         LittleFS.remove(flashLogicFileName);
     }
     
     flashSamplesWritten = 0;
+    flashLastTimestamp = 0;
+    flashRecordsSinceKeyframe = 0;
     flashWritePosition = 0;
     bufferPosition = 0;
+    flashChunkCount = 0;
+    flashPageCache.invalidate();
     compressedCount = 0;
+    compressedLastTime = 0;  // Next entry starts a new chain
     
     addLogEntry("Flash logic data cleared");
 }
 
 void LogicAnalyzer::setBufferMode(BufferMode mode) {
     logicConfig.bufferMode = mode;
+    selectSampleWriter();
     
     switch (mode) {
         case BUFFER_FLASH:
@@ -1778,6 +4350,44 @@ String LogicAnalyzer::getAdvancedStatusJSON() const {
     doc["streaming_count"] = streamingCount;
     doc["compression_ratio"] = getCompressionRatio();
     doc["compressed_samples"] = compressedCount;
+    doc["sampler_backend"] = getSamplerName();
+    doc["hardware_sampling"] = samplerActive;
+    doc["sampler_rate"] = samplerActive ? samplerRate : sampleRate;
+    doc["achieved_rate"] = getAchievedSampleRate();
+    doc["capture_clock"] = captureClock ? captureClock->getName() : "none";
+    doc["sampler_blocks"] = samplerBlocksDrained;
+    doc["sampler_overruns"] = sampler ? sampler->getOverrunCount() : 0;
+    doc["capture_backend"] = getCaptureBackendString();
+    doc["edge_interrupts"] = getEdgeInterruptCount();
+    doc["edge_overruns"] = getEdgeOverrunCount();
+    doc["rmt_resolution_hz"] = rmtCapture.getResolution();
+    doc["rmt_frames"] = rmtCapture.getFrameCount();
+    doc["rmt_symbols"] = rmtCapture.getSymbolCount();
+    doc["mcpwm_edges"] = mcpwmCapture.getEdgeCount();
+    doc["mcpwm_overruns"] = mcpwmCapture.getOverrunCount();
+    doc["timestamp_resolution_ns"] = getTimestampResolutionNs();
+    doc["burst_samples"] = burstSampler.getLastResult().samples;
+    doc["burst_cycles"] = burstSampler.getLastResult().cycles;
+    doc["burst_rate"] = getBurstRate();
+    doc["adaptive_rate"] = adaptiveActive;
+    doc["current_sample_rate"] = getCurrentSampleRate();
+    doc["rate_changes"] = rateMap.size() > 0 ? rateMap.size() - 1 : 0;
+    doc["capture_task"] = captureTaskHandle != nullptr;
+    doc["capture_ring_chunks"] = captureRing.size();
+    doc["missed_samples"] = captureMissedSamples.load();
+    addHealthJSON(doc);
+    addFlashWriterJSON(doc);
+    doc["ram_capacity"] = packedStore.getCapacity();
+    doc["capture_encoding"] = getCaptureEncodingString();
+    doc["channel_count"] = channelCount;
+    doc["channel_mask"] = getChannelMask();
+    doc["trigger_channel"] = triggerChannel;
+    doc["edge_count"] = getEdgeCount();
+    doc["storage_used_percent"] = getStorageUsedPercent();
+    doc["pre_trigger_percent"] = logicConfig.preTriggerPercent;
+    doc["trigger_index"] = (int32_t)getTriggerIndex();  // -1 when no trigger fired
+    doc["segments_completed"] = segmentsDone;
+    doc["segment_count"] = segmentsActive;
     
     String result;
     serializeJson(doc, result);
@@ -1794,10 +4404,7 @@ uint32_t LogicAnalyzer::getStreamingSampleCount() const {
 
 void LogicAnalyzer::stopStreaming() {
     if (streamingActive) {
-        flushFlashBuffer();
-        if (flashDataFile) {
-            flashDataFile.close();
-        }
+        finalizeFlashFile();
         streamingActive = false;
         addLogEntry("Streaming capture stopped - " + String(streamingCount) + " samples captured");
     }
@@ -1819,6 +4426,7 @@ String LogicAnalyzer::getCompressedDataAsJSON() {
         sample["type"] = compressedBuffer[i].type;
     }
     
+    doc["base_time"] = compressedBaseTime;  // Entry timestamps are deltas from here
     doc["total_compressed"] = compressedCount;
     doc["compression_ratio"] = getCompressionRatio();
     doc["original_samples"] = flashSamplesWritten;
@@ -1830,9 +4438,10 @@ String LogicAnalyzer::getCompressedDataAsJSON() {
 
 void LogicAnalyzer::clearCompressedBuffer() {
     compressedCount = 0;
+    compressedLastTime = 0;  // Next entry starts a new chain
     runLength = 0;
     lastTimestamp = 0;
-    lastData = false;
+    lastData = 0;
 }
 
 // Half-Duplex UART Communication Methods
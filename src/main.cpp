@@ -43,6 +43,8 @@ void startAPMode();
 void checkWiFiConnection();
 void handleWiFiReconnection();
 String getWiFiStatus();
+AsyncWebServerResponse* beginExportResponse(AsyncWebServerRequest* request, const String& contentType,
+                                            std::shared_ptr<CaptureExport> stream);
 
 void setup() {
 #ifdef ATOMS3_BUILD
@@ -139,8 +141,9 @@ void loop() {
     checkWiFiConnection();
 #endif
     
-    // Small delay to prevent watchdog issues
-    delay(10);
+    // Short delay keeps the watchdog fed; sampling and storing run in
+    // their own tasks
+    delay(1);
 }
 
 void setupWebServer() {
@@ -166,8 +169,7 @@ void setupWebServer() {
     });
     
     server.on("/api/data", HTTP_GET, [](AsyncWebServerRequest *request){
-        String data = analyzer.getDataAsJSON();
-        request->send(200, "application/json", data);
+        request->send(beginExportResponse(request, "application/json", analyzer.exportCapture(false)));
     });
     
     server.on("/api/status", HTTP_GET, [](AsyncWebServerRequest *request){
@@ -177,6 +179,8 @@ void setupWebServer() {
         doc["gpio_pin"] = 1;  // GPIO1 only
         doc["buffer_usage"] = analyzer.getBufferUsage();
         doc["buffer_size"] = analyzer.getCurrentBufferSize();
+        doc["capture_encoding"] = analyzer.getCaptureEncodingString();
+        doc["storage_used_percent"] = analyzer.getStorageUsedPercent();
         doc["wifi_connected"] = wifi_connected;
         doc["ap_mode"] = ap_mode;
         doc["wifi_ssid"] = wifi_connected ? WiFi.SSID() : (ap_mode ? String(ap_ssid) : "");
@@ -245,6 +249,39 @@ void setupWebServer() {
         if (request->hasParam("pre_trigger_percent", true)) {
             preTriggerPercent = request->getParam("pre_trigger_percent", true)->value().toInt();
         }
+        if (request->hasParam("encoding", true)) {
+            // 0 = every sample, 1 = transitions only, 2 = min/max envelope (saved with the config below)
+            analyzer.setCaptureEncoding((CaptureEncoding)request->getParam("encoding", true)->value().toInt());
+        }
+        if (request->hasParam("capture_backend", true)) {
+            // 0 = auto (DMA when possible), 1 = polled, 2 = edge interrupts, 3 = RMT receiver,
+            // 4 = MCPWM capture, 5 = dedicated-GPIO burst
+            analyzer.setCaptureBackend((CaptureBackend)request->getParam("capture_backend", true)->value().toInt());
+        }
+        if (request->hasParam("burst_samples", true)) {
+            analyzer.setBurstSamples(request->getParam("burst_samples", true)->value().toInt());
+        }
+        if (request->hasParam("adaptive_rate", true)) {
+            // 1 = follow edge density between adaptive_min_rate and sample_rate (polled capture)
+            uint32_t minRate = request->hasParam("adaptive_min_rate", true) ?
+                               request->getParam("adaptive_min_rate", true)->value().toInt() : analyzer.getAdaptiveMinRate();
+            analyzer.setAdaptiveRate(request->getParam("adaptive_rate", true)->value().toInt() != 0, minRate);
+        }
+        if (request->hasParam("capture_health", true)) {
+            // 1 = interval histogram, late reads and store/flush timing in advanced status
+            analyzer.setCaptureHealth(request->getParam("capture_health", true)->value().toInt() != 0);
+        }
+        if (request->hasParam("raw_partition", true)) {
+            // 1 = flash captures to the "logdata" partition (partitions_atoms3_rawlog.csv) instead of LittleFS
+            analyzer.setRawPartition(request->getParam("raw_partition", true)->value().toInt() != 0);
+        }
+        if (request->hasParam("circular_flash", true)) {
+            // 1 = flash captures roll over and keep the newest data until stopped or triggered
+            analyzer.setCircularFlash(request->getParam("circular_flash", true)->value().toInt() != 0);
+        }
+        if (request->hasParam("envelope_samples", true)) {
+            analyzer.setEnvelopeSamples(request->getParam("envelope_samples", true)->value().toInt());
+        }
         
         // Handle new parameters for advanced modes
         uint8_t bufferMode = 1; // Default to Flash (BUFFER_FLASH)
@@ -263,6 +300,61 @@ void setupWebServer() {
         
         analyzer.configureLogic(sampleRate, gpioPin, (TriggerMode)triggerMode, bufferSize, preTriggerPercent);
         
+        // Multi-channel capture: bit n of channel_mask selects GPIOn
+        if (request->hasParam("channel_mask", true)) {
+            uint32_t channelMask = strtoul(request->getParam("channel_mask", true)->value().c_str(), nullptr, 0);
+            if (!analyzer.setChannelMask(channelMask)) {
+                request->send(400, "application/json", "{\"status\":\"error\",\"message\":\"Invalid channel_mask\"}");
+                return;
+            }
+        }
+        if (request->hasParam("trigger_channel", true)) {
+            analyzer.setTriggerChannel(request->getParam("trigger_channel", true)->value().toInt());
+        }
+        if (request->hasParam("segments", true)) {
+            // RAM buffer split into this many trigger windows (1 = off)
+            analyzer.setSegmentCount(request->getParam("segments", true)->value().toInt());
+        }
+        if (request->hasParam("trigger_width_ns", true) || request->hasParam("trigger_pulse_level", true)) {
+            // Width for the pulse (7, 8), glitch (9) and timeout (10) trigger modes
+            uint64_t widthNs = analyzer.getTriggerWidth();
+            uint8_t pulseLevel = analyzer.getTriggerPulseLevel();
+            if (request->hasParam("trigger_width_ns", true)) {
+                widthNs = strtoull(request->getParam("trigger_width_ns", true)->value().c_str(), nullptr, 10);
+            }
+            if (request->hasParam("trigger_pulse_level", true)) {
+                pulseLevel = request->getParam("trigger_pulse_level", true)->value().toInt();
+            }
+            analyzer.setTriggerWidth(widthNs, pulseLevel);
+        }
+        if (request->hasParam("rmt_filter_ns", true) || request->hasParam("rmt_idle_us", true)) {
+            // RMT backend: pulses below the filter are dropped, a frame ends after the idle time
+            uint32_t filterNs = analyzer.getRmtFilterNs();
+            uint32_t idleUs = analyzer.getRmtIdleUs();
+            if (request->hasParam("rmt_filter_ns", true)) {
+                filterNs = request->getParam("rmt_filter_ns", true)->value().toInt();
+            }
+            if (request->hasParam("rmt_idle_us", true)) {
+                idleUs = request->getParam("rmt_idle_us", true)->value().toInt();
+            }
+            analyzer.setRmtTiming(filterNs, idleUs);
+        }
+        if (request->hasParam("trigger_program", true)) {
+            // e.g. "rise, low>=50us, fall*3, nth=2"; switches to the sequence trigger
+            if (!analyzer.setTriggerProgram(request->getParam("trigger_program", true)->value())) {
+                String error = "{\"status\":\"error\",\"message\":\"Invalid trigger_program: " +
+                               analyzer.getTriggerProgramError() + "\"}";
+                request->send(400, "application/json", error);
+                return;
+            }
+        }
+        if (request->hasParam("channel_mask", true) || request->hasParam("trigger_channel", true) ||
+            request->hasParam("trigger_program", true) || request->hasParam("trigger_width_ns", true) ||
+            request->hasParam("trigger_pulse_level", true) || request->hasParam("segments", true) ||
+            request->hasParam("rmt_filter_ns", true) || request->hasParam("rmt_idle_us", true)) {
+            analyzer.saveLogicConfig();
+        }
+        
         // Configure advanced modes
         analyzer.setBufferMode((BufferMode)bufferMode);
         if (compression > 0) {
@@ -439,6 +531,64 @@ void setupWebServer() {
         request->send(200, "application/json", flashData);
     });
     
+    // Segmented capture: list finished segments, fetch one at a time
+    server.on("/api/logic/segments", HTTP_GET, [](AsyncWebServerRequest *request){
+        request->send(200, "application/json", analyzer.getSegmentsAsJSON());
+    });
+    
+    server.on("/api/logic/segment", HTTP_GET, [](AsyncWebServerRequest *request){
+        if (!request->hasParam("index")) {
+            request->send(400, "application/json", "{\"status\":\"error\",\"message\":\"index is required\"}");
+            return;
+        }
+        int index = request->getParam("index")->value().toInt();
+        String format = request->hasParam("format") ? request->getParam("format")->value() : "json";
+        bool csv = format == "csv";
+        std::shared_ptr<CaptureExport> stream;
+        if (index >= 0 && index < MAX_CAPTURE_SEGMENTS) {
+            stream = analyzer.exportSegment(index, csv);
+        }
+        if (!stream) {
+            request->send(404, "application/json", "{\"status\":\"error\",\"message\":\"No such segment\"}");
+            return;
+        }
+        String contentType = csv ? "text/csv" : "application/json";
+        String filename = "m5stack-atomprobe_segment_" + String(index) + (csv ? ".csv" : ".json");
+        
+        AsyncWebServerResponse *response = beginExportResponse(request, contentType, stream);
+        response->addHeader("Content-Disposition", "attachment; filename=\"" + filename + "\"");
+        request->send(response);
+    });
+    
+    // Counter mode: frequency / duty / edge aggregates per interval, no samples stored
+    // Registered first: "/api/logic/counter" would also match its sub-paths
+    server.on("/api/logic/counter/export", HTTP_GET, [](AsyncWebServerRequest *request){
+        AsyncWebServerResponse *response = request->beginResponse(200, "text/csv", analyzer.getCounterAsCSV());
+        response->addHeader("Content-Disposition", "attachment; filename=\"m5stack-atomprobe_counter.csv\"");
+        request->send(response);
+    });
+    
+    server.on("/api/logic/counter", HTTP_GET, [](AsyncWebServerRequest *request){
+        uint32_t last = request->hasParam("last") ? request->getParam("last")->value().toInt() : 60;
+        request->send(200, "application/json", analyzer.getCounterAsJSON(last));
+    });
+    
+    server.on("/api/logic/counter", HTTP_POST, [](AsyncWebServerRequest *request){
+        if (request->hasParam("interval_ms", true)) {
+            analyzer.setCounterInterval(request->getParam("interval_ms", true)->value().toInt());
+            analyzer.saveLogicConfig();
+        }
+        if (request->hasParam("enable", true)) {
+            bool enable = request->getParam("enable", true)->value().toInt() != 0;
+            if (enable && !analyzer.startCounter()) {
+                request->send(409, "application/json", "{\"status\":\"error\",\"message\":\"Counter mode unavailable\"}");
+                return;
+            }
+            if (!enable) analyzer.stopCounter();
+        }
+        request->send(200, "application/json", analyzer.getCounterAsJSON(0));
+    });
+    
     // Set buffer mode endpoint
     server.on("/api/logic/buffer-mode", HTTP_POST, [](AsyncWebServerRequest *request){
         uint8_t mode = 0; // Default RAM
@@ -652,21 +802,12 @@ void setupWebServer() {
         }
         
         String timestamp = String(millis());
-        String data;
-        String filename;
-        String contentType;
+        bool csv = format == "csv";
+        String filename = "m5stack-atomprobe_capture_" + timestamp + (csv ? ".csv" : ".json");
+        String contentType = csv ? "text/csv" : "application/json";
         
-        if (format == "csv") {
-            data = analyzer.getDataAsCSV();
-            filename = "m5stack-atomprobe_capture_" + timestamp + ".csv";
-            contentType = "text/csv";
-        } else {
-            data = analyzer.getDataAsJSON();
-            filename = "m5stack-atomprobe_capture_" + timestamp + ".json";
-            contentType = "application/json";
-        }
-        
-        AsyncWebServerResponse *response = request->beginResponse(200, contentType, data);
+        // Streamed: rows are produced as the client reads them
+        AsyncWebServerResponse *response = beginExportResponse(request, contentType, analyzer.exportCapture(csv));
         response->addHeader("Content-Disposition", "attachment; filename=\"" + filename + "\"");
         response->addHeader("Content-Type", contentType + "; charset=utf-8");
         request->send(response);
@@ -677,6 +818,15 @@ void setupWebServer() {
     });
 }
 
+// Chunked response that pulls a capture export from the analyzer as the
+// client reads it; the stream is freed with the response
+AsyncWebServerResponse* beginExportResponse(AsyncWebServerRequest* request, const String& contentType,
+                                            std::shared_ptr<CaptureExport> stream) {
+    return request->beginChunkedResponse(contentType, [stream](uint8_t* buffer, size_t maxLen, size_t index) -> size_t {
+        return analyzer.readExport(*stream, buffer, maxLen);
+    });
+}
+
 String getIndexHTML() {
     return "<!DOCTYPE html><html><head><title>M5Stack AtomProbe</title><meta charset='UTF-8'>"
            "<style>" 
@@ -820,7 +970,15 @@ String getIndexHTML() {
            "<div style='display:flex;flex-direction:column;margin:5px;'><label>Trigger Mode:</label>" 
            "<select id='logic-trigger' style='padding:8px;border-radius:4px;background:#1a1a1a;color:#e0e0e0;border:1px solid #444;'>" 
            "<option value='0' selected>None</option><option value='1'>Rising Edge</option><option value='2'>Falling Edge</option>" 
-           "<option value='3'>Both Edges</option><option value='4'>High Level</option><option value='5'>Low Level</option></select></div>" 
+           "<option value='3'>Both Edges</option><option value='4'>High Level</option><option value='5'>Low Level</option><option value='6'>Sequence</option>" 
+           "<option value='7'>Pulse Shorter Than</option><option value='8'>Pulse Longer Than</option><option value='9'>Glitch</option><option value='10'>Timeout</option></select></div>" 
+           "<div style='display:flex;flex-direction:column;margin:5px;'><label>Trigger Width (ns):</label>" 
+           "<input id='logic-trigwidth' type='number' min='1' value='1000000' style='padding:8px;border-radius:4px;background:#1a1a1a;color:#e0e0e0;border:1px solid #444;'></div>" 
+           "<div style='display:flex;flex-direction:column;margin:5px;'><label>Pulse Level:</label>" 
+           "<select id='logic-triglevel' style='padding:8px;border-radius:4px;background:#1a1a1a;color:#e0e0e0;border:1px solid #444;'>" 
+           "<option value='1' selected>High</option><option value='0'>Low</option></select></div>" 
+           "<div style='display:flex;flex-direction:column;margin:5px;'><label>Trigger Program:</label>" 
+           "<input id='logic-trigprog' placeholder='rise, low>=50us, fall*3' style='padding:8px;border-radius:4px;background:#1a1a1a;color:#e0e0e0;border:1px solid #444;'></div>" 
            "<div style='display:flex;flex-direction:column;margin:5px;'><label>Buffer Size:</label>" 
            "<select id='logic-buffersize' style='padding:8px;border-radius:4px;background:#1a1a1a;color:#e0e0e0;border:1px solid #444;' onchange='updateLogicTimeEstimates()'>" 
            "<option value='4096'>4,096 samples (20KB - RAM)</option><option value='8192'>8,192 samples (40KB - RAM)</option>" 
@@ -907,10 +1065,10 @@ String getIndexHTML() {
            "}" 
            "function loadUartConfig(){fetch('/api/uart/config').then(r=>r.json()).then(d=>{document.getElementById('uart-baudrate').value=d.baudrate;document.getElementById('uart-databits').value=d.data_bits;document.getElementById('uart-parity').value=d.parity;document.getElementById('uart-stopbits').value=d.stop_bits;document.getElementById('uart-rxpin').value=d.rx_pin;document.getElementById('uart-txpin').value=d.tx_pin;document.getElementById('uart-duplex').value=d.duplex_mode||0;updateBufferTimeEstimates();updateHalfDuplexPanel();}).catch(e=>console.error('UART config load error:',e));}"
            "function toggleLogicConfig(){const config=document.getElementById('logic-config');config.style.display=config.style.display==='none'?'block':'none';if(config.style.display==='block'){loadLogicConfig();};}" 
-           "function loadLogicConfig(){fetch('/api/logic/config').then(r=>r.json()).then(d=>{document.getElementById('logic-samplerate').value=d.sample_rate||1000000;document.getElementById('logic-gpiopin').value=d.gpio_pin||1;document.getElementById('logic-trigger').value=d.trigger_mode||0;document.getElementById('logic-buffersize').value=d.buffer_size||16384;document.getElementById('logic-pretrigger').value=d.pre_trigger_percent||10;updateLogicTimeEstimates();}).catch(e=>console.error('Logic config load error:',e));}"
-           "function saveLogicConfig(){const formData=new FormData();formData.append('sample_rate',document.getElementById('logic-samplerate').value);formData.append('gpio_pin',document.getElementById('logic-gpiopin').value);formData.append('trigger_mode',document.getElementById('logic-trigger').value);formData.append('buffer_size',document.getElementById('logic-buffersize').value);formData.append('pre_trigger_percent',document.getElementById('logic-pretrigger').value);fetch('/api/logic/config',{method:'POST',body:formData}).then(()=>{loadLogicConfig();updateLogicStatus();document.getElementById('logic-config').style.display='none';alert('Logic Analyzer configuration saved!');});}"
+           "function loadLogicConfig(){fetch('/api/logic/config').then(r=>r.json()).then(d=>{document.getElementById('logic-samplerate').value=d.sample_rate||1000000;document.getElementById('logic-gpiopin').value=d.gpio_pin||1;document.getElementById('logic-trigger').value=d.trigger_mode||0;document.getElementById('logic-trigprog').value=d.trigger_program||'';document.getElementById('logic-trigwidth').value=d.trigger_width_ns||1000000;document.getElementById('logic-triglevel').value=d.trigger_pulse_level!==undefined?d.trigger_pulse_level:1;document.getElementById('logic-buffersize').value=d.buffer_size||16384;document.getElementById('logic-pretrigger').value=d.pre_trigger_percent||10;updateLogicTimeEstimates();}).catch(e=>console.error('Logic config load error:',e));}"
+           "function saveLogicConfig(){const formData=new FormData();formData.append('sample_rate',document.getElementById('logic-samplerate').value);formData.append('gpio_pin',document.getElementById('logic-gpiopin').value);formData.append('trigger_mode',document.getElementById('logic-trigger').value);if(document.getElementById('logic-trigger').value==='6'){formData.append('trigger_program',document.getElementById('logic-trigprog').value);}formData.append('trigger_width_ns',document.getElementById('logic-trigwidth').value);formData.append('trigger_pulse_level',document.getElementById('logic-triglevel').value);formData.append('buffer_size',document.getElementById('logic-buffersize').value);formData.append('pre_trigger_percent',document.getElementById('logic-pretrigger').value);fetch('/api/logic/config',{method:'POST',body:formData}).then(()=>{loadLogicConfig();updateLogicStatus();document.getElementById('logic-config').style.display='none';alert('Logic Analyzer configuration saved!');});}"
            "function updateLogicTimeEstimates(){const sampleRate=parseInt(document.getElementById('logic-samplerate').value);const bufferSize=parseInt(document.getElementById('logic-buffersize').value);const durationSeconds=bufferSize/sampleRate;let timeStr='';if(durationSeconds<0.001){timeStr=Math.round(durationSeconds*1000000)+'μs';}else if(durationSeconds<1){timeStr=Math.round(durationSeconds*1000*10)/10+'ms';}else if(durationSeconds<60){timeStr=Math.round(durationSeconds*10)/10+'s';}else if(durationSeconds<3600){timeStr=Math.round(durationSeconds/60*10)/10+'min';}else if(durationSeconds<86400){timeStr=Math.round(durationSeconds/3600*10)/10+'h';}else{timeStr=Math.round(durationSeconds/86400*10)/10+'d';}document.getElementById('logic-time-estimate').innerHTML='📊 '+bufferSize.toLocaleString()+' samples ≈ '+timeStr+' @ '+(sampleRate>=1000000?Math.round(sampleRate/1000000*10)/10+'MHz':sampleRate>=1000?Math.round(sampleRate/1000)+'kHz':sampleRate+'Hz');}"
-           "function updateLogicStatus(){fetch('/api/logic/config').then(r=>r.json()).then(d=>{document.getElementById('logic-current-channel').textContent='GPIO'+d.gpio_pin;document.getElementById('logic-current-rate').textContent=d.sample_rate>=1000000?Math.round(d.sample_rate/1000000*10)/10+'MHz':d.sample_rate>=1000?Math.round(d.sample_rate/1000)+'kHz':d.sample_rate+'Hz';document.getElementById('logic-current-trigger').textContent=d.trigger_mode_string;document.getElementById('logic-buffer-info').textContent=d.buffer_size.toLocaleString()+' samples';const duration=d.buffer_duration_seconds;let durationStr='';if(duration<0.001){durationStr=Math.round(duration*1000000)+'μs';}else if(duration<1){durationStr=Math.round(duration*1000*10)/10+'ms';}else if(duration<60){durationStr=Math.round(duration*10)/10+'s';}else if(duration<3600){durationStr=Math.round(duration/60*10)/10+'min';}else if(duration<86400){durationStr=Math.round(duration/3600*10)/10+'h';}else{durationStr=Math.round(duration/86400*10)/10+'d';}document.getElementById('logic-duration').textContent=durationStr;});fetch('/api/status').then(r=>r.json()).then(d=>{const usage=d.buffer_usage||0;const total=d.buffer_size||1000000;const percent=Math.round((usage/total)*100);document.getElementById('logic-buffer-usage').textContent=usage.toLocaleString()+'/'+total.toLocaleString()+' ('+percent+'%)';const storageType=total>50000?'Flash':'RAM';const storageMB=(total*5/1024/1024).toFixed(1);document.getElementById('logic-storage-type').textContent=storageType;document.getElementById('logic-storage-size').textContent='('+storageMB+'MB)';}).catch(e=>console.error('Logic status update error:',e));}"
+           "function updateLogicStatus(){fetch('/api/logic/config').then(r=>r.json()).then(d=>{document.getElementById('logic-current-channel').textContent='GPIO'+d.gpio_pin;document.getElementById('logic-current-rate').textContent=d.sample_rate>=1000000?Math.round(d.sample_rate/1000000*10)/10+'MHz':d.sample_rate>=1000?Math.round(d.sample_rate/1000)+'kHz':d.sample_rate+'Hz';document.getElementById('logic-current-trigger').textContent=d.trigger_mode_string;document.getElementById('logic-buffer-info').textContent=d.buffer_size.toLocaleString()+' samples';const duration=d.buffer_duration_seconds;let durationStr='';if(duration<0.001){durationStr=Math.round(duration*1000000)+'μs';}else if(duration<1){durationStr=Math.round(duration*1000*10)/10+'ms';}else if(duration<60){durationStr=Math.round(duration*10)/10+'s';}else if(duration<3600){durationStr=Math.round(duration/60*10)/10+'min';}else if(duration<86400){durationStr=Math.round(duration/3600*10)/10+'h';}else{durationStr=Math.round(duration/86400*10)/10+'d';}document.getElementById('logic-duration').textContent=durationStr;});fetch('/api/status').then(r=>r.json()).then(d=>{const usage=d.buffer_usage||0;const total=d.buffer_size||1000000;const percent=d.storage_used_percent!==undefined?d.storage_used_percent:Math.round((usage/total)*100);document.getElementById('logic-buffer-usage').textContent=usage.toLocaleString()+'/'+total.toLocaleString()+' ('+percent+'%)';const storageType=total>50000?'Flash':'RAM';const storageMB=(total*5/1024/1024).toFixed(1);document.getElementById('logic-storage-type').textContent=storageType;document.getElementById('logic-storage-size').textContent='('+storageMB+'MB)';}).catch(e=>console.error('Logic status update error:',e));}"
            "function toggleFlashStorage(){"
            "fetch('/api/uart/storage').then(r=>r.json()).then(d=>{" 
            "const newState = !d.flash_enabled;" 
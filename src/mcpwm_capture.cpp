@@ -0,0 +1,87 @@
+#include "mcpwm_capture.h"
+
+static const mcpwm_io_signals_t CAPTURE_SIGNALS[MCPWM_CAPTURE_CHANNELS] = {MCPWM_CAP_0, MCPWM_CAP_1, MCPWM_CAP_2};
+static const mcpwm_capture_channel_id_t CAPTURE_CHANNELS[MCPWM_CAPTURE_CHANNELS] = {MCPWM_SELECT_CAP0, MCPWM_SELECT_CAP1, MCPWM_SELECT_CAP2};
+
+McpwmCapture::McpwmCapture() {
+    pinCount = 0;
+    lastLevels = 0;
+    edges = 0;
+    overruns = 0;
+    notifyTask = nullptr;
+    attached = false;
+}
+
+McpwmCapture::~McpwmCapture() {
+    end();
+}
+
+bool McpwmCapture::begin(const uint8_t* channelPins, uint8_t count, uint8_t levels, TaskHandle_t task) {
+    if (count == 0 || count > MCPWM_CAPTURE_CHANNELS) return false;
+    end();
+
+    // Leftovers of the previous run would carry stale timer values
+    CaptureEdge stale;
+    while (ring.pop(stale)) {}
+
+    pinCount = count;
+    lastLevels = levels;
+    edges = 0;
+    overruns = 0;
+    notifyTask = task;
+
+    for (uint8_t i = 0; i < pinCount; i++) {
+        pins[i] = channelPins[i];
+        mcpwm_capture_config_t config = {};
+        config.cap_edge = MCPWM_BOTH_EDGE;
+        config.cap_prescale = 1;
+        config.capture_cb = onCapture;
+        config.user_data = this;
+        if (mcpwm_gpio_init(MCPWM_UNIT_0, CAPTURE_SIGNALS[i], pins[i]) != ESP_OK ||
+            mcpwm_capture_enable_channel(MCPWM_UNIT_0, CAPTURE_CHANNELS[i], &config) != ESP_OK) {
+            pinCount = i;
+            attached = true;
+            end();
+            return false;
+        }
+    }
+    attached = true;
+    return true;
+}
+
+void McpwmCapture::end() {
+    if (!attached) return;
+    for (uint8_t i = 0; i < pinCount; i++) {
+        mcpwm_capture_disable_channel(MCPWM_UNIT_0, CAPTURE_CHANNELS[i]);
+    }
+    attached = false;
+}
+
+bool IRAM_ATTR McpwmCapture::onCapture(mcpwm_unit_t unit, mcpwm_capture_channel_id_t channel,
+                                       const cap_event_data_t* event, void* context) {
+    McpwmCapture* self = static_cast<McpwmCapture*>(context);
+    uint32_t cycles = ESP.getCycleCount();
+
+    uint8_t bit = 1 << (uint8_t)channel;  // MCPWM_SELECT_CAPn is capture channel n
+    uint8_t levels = (event->cap_edge == MCPWM_POS_EDGE) ? (self->lastLevels | bit) : (self->lastLevels & ~bit);
+
+    // Same direction twice: the opposite edge was overwritten in the latch
+    if (levels == self->lastLevels) {
+        self->overruns.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    self->lastLevels = levels;
+
+    bool wasEmpty = self->ring.size() == 0;
+    if (!self->ring.push({event->cap_value, cycles, levels})) {
+        self->overruns.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    self->edges.fetch_add(1, std::memory_order_relaxed);
+
+    BaseType_t woken = pdFALSE;
+    if (wasEmpty && self->notifyTask) {
+        vTaskNotifyGiveFromISR(self->notifyTask, &woken);
+    }
+    return woken == pdTRUE;  // The driver yields on true
+}
@@ -0,0 +1,35 @@
+#include "partition_flash.h"
+
+PartitionFlash::PartitionFlash() {
+    partition = nullptr;
+}
+
+bool PartitionFlash::begin(const char* label) {
+    partition = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, label);
+    return partition != nullptr;
+}
+
+uint32_t PartitionFlash::getAddress() const {
+    return partition ? partition->address : 0;
+}
+
+uint32_t PartitionFlash::size() const {
+    return partition ? partition->size : 0;
+}
+
+uint32_t PartitionFlash::eraseBytes() const {
+    // Sector size; larger aligned ranges are erased as 64 KB blocks
+    return SPI_FLASH_SEC_SIZE;
+}
+
+bool PartitionFlash::erase(uint32_t offset, uint32_t length) {
+    return partition && esp_partition_erase_range(partition, offset, length) == ESP_OK;
+}
+
+bool PartitionFlash::write(uint32_t offset, const void* data, uint32_t length) {
+    return partition && esp_partition_write(partition, offset, data, length) == ESP_OK;
+}
+
+bool PartitionFlash::read(uint32_t offset, void* data, uint32_t length) {
+    return partition && esp_partition_read(partition, offset, data, length) == ESP_OK;
+}
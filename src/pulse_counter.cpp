@@ -0,0 +1,177 @@
+#include "pulse_counter.h"
+#include <driver/gpio.h>
+#include <soc/gpio_reg.h>
+
+PulseCounter::PulseCounter() {
+    pin = 0;
+    running = false;
+    overflows = 0;
+    lock = portMUX_INITIALIZER_UNLOCKED;
+    timedEdges = 0;
+    lastEdge = 0;
+    lastRise = 0;
+    haveEdge = false;
+    haveRise = false;
+    level = 0;
+    highCycles = 0;
+    timedCycles = 0;
+    minPeriod = 0;
+    maxPeriod = 0;
+    lastSampleTime = 0;
+    lastTotal = 0;
+}
+
+PulseCounter::~PulseCounter() {
+    end();
+}
+
+bool PulseCounter::begin(uint8_t inputPin) {
+    end();
+    pin = inputPin;
+
+    pcnt_config_t config = {};
+    config.pulse_gpio_num = pin;
+    config.ctrl_gpio_num = PCNT_PIN_NOT_USED;
+    config.channel = PCNT_CHANNEL_0;
+    config.unit = COUNTER_PCNT_UNIT;
+    config.pos_mode = PCNT_COUNT_INC;   // Both edges
+    config.neg_mode = PCNT_COUNT_INC;
+    config.lctrl_mode = PCNT_MODE_KEEP;
+    config.hctrl_mode = PCNT_MODE_KEEP;
+    config.counter_h_lim = COUNTER_PCNT_LIMIT;
+    config.counter_l_lim = 0;
+    if (pcnt_unit_config(&config) != ESP_OK) return false;
+
+    pcnt_counter_pause(COUNTER_PCNT_UNIT);
+    pcnt_counter_clear(COUNTER_PCNT_UNIT);
+    pcnt_event_enable(COUNTER_PCNT_UNIT, PCNT_EVT_H_LIM);
+    pcnt_isr_service_install(0);  // Already installed is fine
+    if (pcnt_isr_handler_add(COUNTER_PCNT_UNIT, onLimit, this) != ESP_OK) return false;
+
+    overflows = 0;
+    lastTotal = 0;
+    haveEdge = false;
+    haveRise = false;
+    timedEdges = 0;
+    highCycles = 0;
+    timedCycles = 0;
+    minPeriod = 0;
+    maxPeriod = 0;
+    level = (REG_READ(GPIO_IN_REG) >> pin) & 1;
+
+    attachInterruptArg(digitalPinToInterrupt(pin), onEdge, this, CHANGE);
+    pcnt_counter_resume(COUNTER_PCNT_UNIT);
+    lastSampleTime = micros();
+    running = true;
+    return true;
+}
+
+void PulseCounter::end() {
+    if (!running) return;
+    detachInterrupt(digitalPinToInterrupt(pin));
+    pcnt_counter_pause(COUNTER_PCNT_UNIT);
+    pcnt_isr_handler_remove(COUNTER_PCNT_UNIT);
+    pcnt_event_disable(COUNTER_PCNT_UNIT, PCNT_EVT_H_LIM);
+    running = false;
+}
+
+void IRAM_ATTR PulseCounter::onLimit(void* context) {
+    // The counter has just wrapped to zero at the high limit
+    static_cast<PulseCounter*>(context)->overflows++;
+}
+
+void IRAM_ATTR PulseCounter::onEdge(void* context) {
+    PulseCounter* self = static_cast<PulseCounter*>(context);
+    uint32_t cycles = ESP.getCycleCount();
+    uint8_t newLevel = (REG_READ(GPIO_IN_REG) >> self->pin) & 1;
+
+    portENTER_CRITICAL_ISR(&self->lock);
+    if (self->haveEdge) {
+        uint32_t span = cycles - self->lastEdge;
+        self->timedCycles += span;
+        if (self->level) self->highCycles += span;
+    }
+    if (newLevel && !self->level) {
+        if (self->haveRise) {
+            uint32_t period = cycles - self->lastRise;
+            if (self->minPeriod == 0 || period < self->minPeriod) self->minPeriod = period;
+            if (period > self->maxPeriod) self->maxPeriod = period;
+        }
+        self->lastRise = cycles;
+        self->haveRise = true;
+    }
+    self->lastEdge = cycles;
+    self->haveEdge = true;
+    self->level = newLevel;
+    // Enough edges timed for this interval; sample() unmasks the interrupt
+    if (++self->timedEdges >= COUNTER_TIMED_EDGES) {
+        gpio_intr_disable((gpio_num_t)self->pin);
+    }
+    portEXIT_CRITICAL_ISR(&self->lock);
+}
+
+uint64_t PulseCounter::readTotal() {
+    // Overflows read on both sides of the counter so a wrap in between is not half-seen
+    uint32_t before, after;
+    int16_t count;
+    do {
+        before = overflows;
+        pcnt_get_counter_value(COUNTER_PCNT_UNIT, &count);
+        after = overflows;
+    } while (before != after);
+    return (uint64_t)after * COUNTER_PCNT_LIMIT + (uint16_t)count;
+}
+
+CounterInterval PulseCounter::sample() {
+    CounterInterval interval = {0, 0, 0, 0, 0};
+    if (!running) return interval;
+
+    uint32_t now = micros();
+    uint64_t total = readTotal();
+    interval.durationUs = now - lastSampleTime;
+    lastSampleTime = now;
+    // A wrap whose interrupt is still pending reads low; it is counted next time
+    if (total >= lastTotal) {
+        interval.edges = (uint32_t)(total - lastTotal);
+        lastTotal = total;
+    }
+
+    portENTER_CRITICAL(&lock);
+    uint32_t cycles = ESP.getCycleCount();
+    if (haveEdge && timedEdges < COUNTER_TIMED_EDGES) {
+        // Timing ran to the end of the interval: the current level counts up to now
+        uint32_t span = cycles - lastEdge;
+        timedCycles += span;
+        if (level) highCycles += span;
+        lastEdge = cycles;
+    }
+    uint64_t high = highCycles;
+    uint64_t timed = timedCycles;
+    uint32_t shortest = minPeriod;
+    uint32_t longest = maxPeriod;
+    bool masked = timedEdges >= COUNTER_TIMED_EDGES;
+    highCycles = 0;
+    timedCycles = 0;
+    minPeriod = 0;
+    maxPeriod = 0;
+    timedEdges = 0;
+    if (masked) {
+        haveEdge = false;  // The time since the last timed edge was not watched
+        haveRise = false;
+    }
+    portEXIT_CRITICAL(&lock);
+    if (masked) {
+        level = (REG_READ(GPIO_IN_REG) >> pin) & 1;
+        gpio_intr_enable((gpio_num_t)pin);
+    }
+
+    uint32_t cyclesPerUs = ESP.getCpuFreqMHz();
+    if (timed > 0) {
+        interval.highUs = (uint32_t)((double)high / timed * interval.durationUs);
+    } else {
+        interval.highUs = level ? interval.durationUs : 0;  // No edge: the level held all along
+    }
+    interval.minPeriodNs = (uint32_t)((uint64_t)shortest * 1000 / cyclesPerUs);
+    interval.maxPeriodNs = (uint32_t)((uint64_t)longest * 1000 / cyclesPerUs);
+    return interval;
+}
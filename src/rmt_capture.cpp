@@ -0,0 +1,78 @@
+#include "rmt_capture.h"
+
+#if CONFIG_IDF_TARGET_ESP32S3
+    #define RMT_CAPTURE_CHANNEL RMT_CHANNEL_4  // Channels 4-7 are the receivers on the S3
+#else
+    #define RMT_CAPTURE_CHANNEL RMT_CHANNEL_0
+#endif
+
+RmtCapture::RmtCapture() {
+    channel = RMT_CAPTURE_CHANNEL;
+    rxRing = nullptr;
+    installed = false;
+    resolutionHz = 0;
+    idleTicks = 0;
+    frames = 0;
+    symbols = 0;
+}
+
+RmtCapture::~RmtCapture() {
+    end();
+}
+
+bool RmtCapture::begin(uint8_t pin, uint32_t idleUs, uint32_t filterNs) {
+    end();
+
+    uint8_t divider = rmtClockDivider(idleUs);
+    uint64_t ticks = (uint64_t)idleUs * (RMT_SOURCE_CLOCK_HZ / divider) / 1000000ULL;
+    if (ticks < 1) ticks = 1;
+    if (ticks > RMT_MAX_DURATION) ticks = RMT_MAX_DURATION;
+    uint8_t filterTicks = rmtFilterTicks(filterNs);
+
+    rmt_config_t config = RMT_DEFAULT_CONFIG_RX((gpio_num_t)pin, channel);
+    config.clk_div = divider;
+    config.mem_block_num = RMT_RX_MEM_BLOCKS;
+    config.rx_config.filter_en = filterTicks > 0;
+    config.rx_config.filter_ticks_thresh = filterTicks;
+    config.rx_config.idle_threshold = (uint16_t)ticks;
+
+    if (rmt_config(&config) != ESP_OK) return false;
+    if (rmt_driver_install(channel, RMT_RX_RING_BYTES, 0) != ESP_OK) return false;
+    if (rmt_get_ringbuf_handle(channel, &rxRing) != ESP_OK || !rxRing) {
+        rmt_driver_uninstall(channel);
+        return false;
+    }
+
+    resolutionHz = RMT_SOURCE_CLOCK_HZ / divider;
+    idleTicks = (uint16_t)ticks;
+    frames = 0;
+    symbols = 0;
+    installed = true;
+
+    rmt_rx_start(channel, true);
+    return true;
+}
+
+void RmtCapture::end() {
+    if (!installed) return;
+    rmt_rx_stop(channel);
+    rmt_driver_uninstall(channel);
+    rxRing = nullptr;
+    installed = false;
+}
+
+bool RmtCapture::receive(const uint32_t*& frame, size_t& count, TickType_t wait) {
+    if (!installed) return false;
+    size_t bytes = 0;
+    void* item = xRingbufferReceive(rxRing, &bytes, wait);
+    if (!item) return false;
+    frame = static_cast<const uint32_t*>(item);
+    count = bytes / sizeof(uint32_t);
+    frames++;
+    symbols += count;
+    return true;
+}
+
+void RmtCapture::release(const uint32_t* frame) {
+    vRingbufferReturnItem(rxRing, (void*)frame);
+}
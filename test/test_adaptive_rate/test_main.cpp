@@ -0,0 +1,203 @@
+// Host replay of the adaptive-rate policy: the rate sequence for synthetic
+// edge patterns, and the rate-change markers a capture records, checked
+// against the true time of every sample.
+// Run with: pio test -e native -f test_adaptive_rate
+#include <unity.h>
+#include <vector>
+#include "adaptive_rate.h"
+#include "capture_clock.h"
+#include "rate_map.h"
+
+static const uint32_t CPU_HZ = 240000000;
+static const uint32_t MAX_RATE = 1000000;
+static const uint32_t MIN_RATE = 1000;
+static const uint64_t WINDOW_US = ADAPTIVE_WINDOW_MS * 1000;
+
+// Edges per window for a stretch of the pattern
+static void addWindows(std::vector<uint32_t>& pattern, uint32_t windows, uint32_t edges) {
+    pattern.insert(pattern.end(), windows, edges);
+}
+
+// Rates the policy picks after each window of the pattern
+static std::vector<uint32_t> replayPolicy(const std::vector<uint32_t>& pattern) {
+    AdaptiveRatePolicy policy;
+    policy.begin(MAX_RATE, MIN_RATE);
+    std::vector<uint32_t> rates;
+    for (size_t i = 0; i < pattern.size(); i++) rates.push_back(policy.update(pattern[i], WINDOW_US));
+    return rates;
+}
+
+// Outcome of replaying a pattern through the capture task's grid
+struct CaptureReplay {
+    uint64_t samples;
+    uint32_t changes;
+    uint32_t worstErrorUs;  // |marker time - true time| over all samples
+    bool monotonic;
+};
+
+// The polled loop's rate switching without the pins: each window's slots
+// run on a SlotScheduler, and a new rate starts a new grid at the old
+// grid's next slot with a marker at the cycle it is due. Every sample's
+// timestamp from the map is compared with its true cycle time.
+static CaptureReplay replayCapture(const std::vector<uint32_t>& pattern, RateMap& map) {
+    CaptureReplay replay = {0, 0, 0, true};
+    AdaptiveRatePolicy policy;
+    policy.begin(MAX_RATE, MIN_RATE);
+    SlotScheduler schedule;
+    uint32_t rate = MAX_RATE;
+    uint64_t cycleBase = 0;
+    uint64_t indexBase = 0;
+    uint64_t windowCycles = (uint64_t)CPU_HZ * ADAPTIVE_WINDOW_MS / 1000;
+    uint64_t lastTime = 0;
+    schedule.begin(CPU_HZ, rate);
+    map.begin(0, rate);
+
+    for (size_t w = 0; w < pattern.size(); w++) {
+        uint64_t windowEnd = (w + 1) * windowCycles;
+        while (cycleBase + schedule.nextDue() < windowEnd) {
+            uint64_t cycles = cycleBase + schedule.nextDue();
+            uint64_t trueUs = (cycles / CPU_HZ) * 1000000ULL + (cycles % CPU_HZ) * 1000000ULL / CPU_HZ;
+            uint64_t mapUs = map.timestampAt(indexBase + schedule.nextSlot());
+            uint32_t error = (uint32_t)(mapUs > trueUs ? mapUs - trueUs : trueUs - mapUs);
+            if (error > replay.worstErrorUs) replay.worstErrorUs = error;
+            if (mapUs < lastTime) replay.monotonic = false;
+            lastTime = mapUs;
+            schedule.advance();
+            replay.samples++;
+        }
+
+        uint32_t next = policy.update(pattern[w], WINDOW_US);
+        if (next != rate && !map.full()) {
+            cycleBase += schedule.nextDue();
+            indexBase += schedule.nextSlot();
+            uint64_t offsetUs = (cycleBase / CPU_HZ) * 1000000ULL + (cycleBase % CPU_HZ) * 1000000ULL / CPU_HZ;
+            TEST_ASSERT_TRUE(map.add(indexBase, offsetUs, next));
+            rate = next;
+            schedule.begin(CPU_HZ, rate);
+            replay.changes++;
+        }
+    }
+    TEST_ASSERT_EQUAL_UINT64(indexBase + schedule.nextSlot(), replay.samples);
+    return replay;
+}
+
+void setUp() {}
+void tearDown() {}
+
+// ----- Policy -----
+
+void test_idle_halves_after_quiet_windows() {
+    std::vector<uint32_t> pattern;
+    addWindows(pattern, 10, 0);
+    std::vector<uint32_t> rates = replayPolicy(pattern);
+    static const uint32_t expected[10] = {1000000, 1000000, 1000000, 500000, 500000,
+                                          500000, 500000, 250000, 250000, 250000};
+    TEST_ASSERT_EQUAL_UINT32_ARRAY(expected, rates.data(), 10);
+}
+
+void test_burst_jumps_straight_to_needed_rate() {
+    // 100 edges per 50 ms want 64 kHz: the lowest step above is 125 kHz
+    std::vector<uint32_t> pattern;
+    addWindows(pattern, 40, 0);
+    addWindows(pattern, 1, 100);
+    addWindows(pattern, 1, 2000);
+    std::vector<uint32_t> rates = replayPolicy(pattern);
+    TEST_ASSERT_TRUE(rates[39] < 125000);
+    TEST_ASSERT_EQUAL_UINT32(125000, rates[40]);
+    TEST_ASSERT_EQUAL_UINT32(MAX_RATE, rates[41]);
+}
+
+void test_short_pause_keeps_rate() {
+    // Bursts with pauses shorter than the idle windows never lose resolution
+    std::vector<uint32_t> pattern;
+    for (uint32_t i = 0; i < 20; i++) {
+        addWindows(pattern, 1, 2000);
+        addWindows(pattern, ADAPTIVE_IDLE_WINDOWS - 1, 0);
+    }
+    std::vector<uint32_t> rates = replayPolicy(pattern);
+    for (size_t i = 0; i < rates.size(); i++) TEST_ASSERT_EQUAL_UINT32(MAX_RATE, rates[i]);
+}
+
+void test_rates_stay_on_ladder_above_minimum() {
+    // The ladder is the maximum over powers of two; the minimum is not a
+    // step, so the lowest rate is the last step above it
+    std::vector<uint32_t> pattern;
+    addWindows(pattern, 100, 0);
+    addWindows(pattern, 1, 3);  // 1920 Hz wanted
+    addWindows(pattern, 100, 0);
+    std::vector<uint32_t> rates = replayPolicy(pattern);
+    for (size_t i = 0; i < rates.size(); i++) {
+        TEST_ASSERT_TRUE(rates[i] >= MIN_RATE);
+        uint32_t step = MAX_RATE;
+        while (step > rates[i]) step /= 2;
+        TEST_ASSERT_EQUAL_UINT32(step, rates[i]);
+    }
+    TEST_ASSERT_EQUAL_UINT32(1953, rates[99]);
+    TEST_ASSERT_EQUAL_UINT32(1953, rates[100]);
+    TEST_ASSERT_EQUAL_UINT32(1953, rates.back());
+}
+
+void test_zero_length_window_keeps_rate() {
+    AdaptiveRatePolicy policy;
+    policy.begin(MAX_RATE, MIN_RATE);
+    TEST_ASSERT_EQUAL_UINT32(MAX_RATE, policy.update(0, 0));
+    TEST_ASSERT_EQUAL_UINT32(MAX_RATE, policy.getRate());
+}
+
+// ----- Capture replay with rate markers -----
+
+void test_marker_times_follow_every_sample() {
+    // Idle, a burst, a slow stretch and idle again: six seconds, several
+    // changes, and rates like 7812 Hz whose period is not whole microseconds
+    std::vector<uint32_t> pattern;
+    addWindows(pattern, 30, 0);
+    addWindows(pattern, 5, 2000);
+    addWindows(pattern, 20, 100);
+    addWindows(pattern, 65, 0);
+    static RateMap map;
+    CaptureReplay replay = replayCapture(pattern, map);
+
+    TEST_ASSERT_TRUE(replay.changes >= 10);
+    TEST_ASSERT_EQUAL_UINT32(replay.changes + 1, map.size());
+    TEST_ASSERT_TRUE(replay.monotonic);
+    TEST_ASSERT_TRUE(replay.worstErrorUs <= 1);
+
+    // Samples are contiguous across each change, and the first one at the
+    // new rate is timed by its own marker
+    for (uint32_t i = 1; i < map.size(); i++) {
+        const RateMarker& m = map.at(i);
+        TEST_ASSERT_TRUE(m.index > map.at(i - 1).index);
+        TEST_ASSERT_EQUAL_UINT64(m.time, map.timestampAt(m.index));
+        TEST_ASSERT_TRUE(map.timestampAt(m.index - 1) < m.time);
+        TEST_ASSERT_TRUE(&map.markerFor(m.index - 1) == &map.at(i - 1));
+    }
+}
+
+void test_full_map_keeps_current_rate() {
+    // A pattern that changes rate every few windows runs the map full; the
+    // capture then stays at its rate and timestamps stay right
+    std::vector<uint32_t> pattern;
+    for (uint32_t i = 0; i < RATE_MAP_MAX_MARKERS; i++) {
+        addWindows(pattern, 1, 2000);
+        addWindows(pattern, ADAPTIVE_IDLE_WINDOWS, 0);
+    }
+    static RateMap map;
+    CaptureReplay replay = replayCapture(pattern, map);
+    TEST_ASSERT_TRUE(map.full());
+    TEST_ASSERT_EQUAL_UINT32(RATE_MAP_MAX_MARKERS - 1, replay.changes);
+    TEST_ASSERT_FALSE(map.add(replay.samples, 0, MAX_RATE));
+    TEST_ASSERT_TRUE(replay.monotonic);
+    TEST_ASSERT_TRUE(replay.worstErrorUs <= 1);
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_idle_halves_after_quiet_windows);
+    RUN_TEST(test_burst_jumps_straight_to_needed_rate);
+    RUN_TEST(test_short_pause_keeps_rate);
+    RUN_TEST(test_rates_stay_on_ladder_above_minimum);
+    RUN_TEST(test_zero_length_window_keeps_rate);
+    RUN_TEST(test_marker_times_follow_every_sample);
+    RUN_TEST(test_full_map_keeps_current_rate);
+    return UNITY_END();
+}
@@ -0,0 +1,260 @@
+// Host benchmark of the capture pipeline: nanoseconds per sample for each
+// levelAppender instantiation (appendCaptureLevelsAs<Channels, Triggered>)
+// and for the storage side the drain feeds - the staging store of each
+// encoding and the unpack loop that hands samples to the sampleWriter.
+// The flash, streaming and compressed writer bodies sit on the Arduino File
+// layer and are timed on the device by the capture health report.
+// Run with: pio test -e native_bench -v
+#include <unity.h>
+#include <stdio.h>
+#include <chrono>
+#include <vector>
+#include "capture_pipeline.h"
+#include "packed_sample_store.h"
+#include "transition_store.h"
+#include "envelope_store.h"
+#include "trigger_engine.h"
+
+static const uint32_t SAMPLES = 1u << 18;     // Fixed input of every run
+static const uint32_t RUNS = 5;               // Best of
+static const uint32_t CHUNK_SAMPLES = 4096;   // CAPTURE_CHUNK_SAMPLES
+static const uint32_t RATE = 1000000;
+static const uint32_t BUCKET_SAMPLES = 64;
+
+// Never completes at the input's run lengths, so every word is evaluated
+static const char* const IDLE_PROGRAM = "high>=1ms";
+
+static std::vector<uint8_t> input;  // Levels per sample, bit c = channel c
+
+// Runs of 1..16 samples at pseudo-random levels, the same on every host
+static void buildInput() {
+    uint32_t seed = 12345;
+    while (input.size() < SAMPLES) {
+        seed = seed * 1664525u + 1013904223u;
+        uint8_t levels = (uint8_t)(seed >> 24);
+        uint32_t run = 1 + ((seed >> 8) & 15);
+        for (uint32_t i = 0; i < run && input.size() < SAMPLES; i++) {
+            input.push_back(levels);
+        }
+    }
+}
+
+// The planes of one hand-off, as in CaptureChunk
+struct BenchChunk {
+    uint32_t count;
+    uint32_t planeWords;
+    uint32_t bits[CHUNK_SAMPLES / 32];
+};
+
+// Producer state of one capture. Chunks are claimed in order and never
+// recycled, so the ring hand-off stays out of the timing.
+struct BenchProducer {
+    std::vector<BenchChunk> chunks;
+    uint32_t chunkSamples;
+    uint32_t claimed;
+    BenchChunk* open;
+    TriggerEngine engine;
+    uint32_t fired;
+
+    void start(uint8_t channels, const TriggerProgram& program) {
+        chunkSamples = (CHUNK_SAMPLES / channels) & ~31u;
+        chunks.resize(SAMPLES / chunkSamples + 1);
+        for (size_t i = 0; i < chunks.size(); i++) {
+            chunks[i].count = 0;
+            chunks[i].planeWords = chunkSamples / 32;
+        }
+        claimed = 0;
+        open = nullptr;
+        fired = 0;
+        engine.load(program);
+        engine.arm(RATE, input[0]);
+    }
+};
+
+// appendCaptureLevelsAs<Channels, Triggered> without the ring
+template <uint8_t Channels, bool Triggered>
+static void appendLevels(BenchProducer& p, uint8_t levels) {
+    if (!p.open) {
+        p.open = &p.chunks[p.claimed++];
+        p.open->count = 0;
+    }
+    uint32_t n = p.open->count;
+    uint32_t bit = n & 31;
+    writePlaneBits<Channels>(&p.open->bits[n >> 5], p.open->planeWords, bit, levels);
+    if (Triggered && bit == 31) {
+        if (p.engine.feed(&p.open->bits[n >> 5], p.open->planeWords, Channels, 32) >= 0) p.fired++;
+    }
+    p.open->count = n + 1;
+    if (p.open->count == p.chunkSamples) p.open = nullptr;
+}
+
+typedef void (*BenchAppender)(BenchProducer&, uint8_t);
+
+// Same layout as the analyzer's table: [triggered][channels - 1]
+static const BenchAppender appenders[2][8] = {
+    {&appendLevels<1, false>, &appendLevels<2, false>, &appendLevels<3, false>, &appendLevels<4, false>,
+     &appendLevels<5, false>, &appendLevels<6, false>, &appendLevels<7, false>, &appendLevels<8, false>},
+    {&appendLevels<1, true>, &appendLevels<2, true>, &appendLevels<3, true>, &appendLevels<4, true>,
+     &appendLevels<5, true>, &appendLevels<6, true>, &appendLevels<7, true>, &appendLevels<8, true>},
+};
+
+// Best time of RUNS calls, per input sample
+template <typename Run>
+static double nsPerSample(Run run) {
+    double best = 0;
+    for (uint32_t r = 0; r < RUNS; r++) {
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        run();
+        std::chrono::duration<double, std::nano> took = std::chrono::steady_clock::now() - start;
+        double ns = took.count() / SAMPLES;
+        if (r == 0 || ns < best) best = ns;
+    }
+    return best;
+}
+
+static TriggerProgram idleProgram(uint8_t channels) {
+    TriggerProgram program;
+    TEST_ASSERT_NULL(program.parse(IDLE_PROGRAM, 0, channels));
+    return program;
+}
+
+// Fill a producer with the whole input through the untriggered appender
+static void produce(BenchProducer& p, uint8_t channels) {
+    p.start(channels, idleProgram(channels));
+    BenchAppender append = appenders[0][channels - 1];
+    for (uint32_t i = 0; i < SAMPLES; i++) append(p, input[i]);
+}
+
+// The planes must hold the input, or the timing measured something else
+static void checkPlanes(const BenchProducer& p, uint8_t channels) {
+    uint8_t mask = (uint8_t)((1u << channels) - 1);
+    for (uint32_t i = 0; i < SAMPLES; i += 97) {
+        const BenchChunk& chunk = p.chunks[i / p.chunkSamples];
+        uint32_t bit = i % p.chunkSamples;
+        uint8_t levels = 0;
+        for (uint8_t c = 0; c < channels; c++) {
+            levels |= ((chunk.bits[c * chunk.planeWords + (bit >> 5)] >> (bit & 31)) & 1) << c;
+        }
+        TEST_ASSERT_EQUAL_HEX8(input[i] & mask, levels);
+    }
+}
+
+void setUp() {}
+void tearDown() {}
+
+void test_level_appenders() {
+    static BenchProducer p;
+    printf("\nlevelAppender             ns/sample\n");
+    for (uint8_t channels = 1; channels <= 8; channels++) {
+        TriggerProgram program = idleProgram(channels);
+        for (int triggered = 0; triggered < 2; triggered++) {
+            BenchAppender append = appenders[triggered][channels - 1];
+            double ns = nsPerSample([&]() {
+                p.start(channels, program);
+                for (uint32_t i = 0; i < SAMPLES; i++) append(p, input[i]);
+            });
+            checkPlanes(p, channels);
+            TEST_ASSERT_EQUAL_UINT32(0, p.fired);
+            printf("  <%u, %-5s>             %7.2f\n", channels, triggered ? "true" : "false", ns);
+        }
+    }
+}
+
+void test_staging_stores() {
+    static BenchProducer p;
+    std::vector<uint32_t> packedWords(SAMPLES * 8 / 32);
+    std::vector<uint8_t> transitionBytes(SAMPLES * 2);
+    std::vector<EnvelopeBucket> buckets(SAMPLES / BUCKET_SAMPLES + 1);
+    static PackedSampleStore packed;
+    static TransitionStore transitions;
+    static EnvelopeStore envelope;
+    packed.attach(packedWords.data(), SAMPLES * 8);
+    transitions.attach(transitionBytes.data(), transitionBytes.size());
+    envelope.attach(buckets.data(), buckets.size() * sizeof(EnvelopeBucket));
+    envelope.setBucketSamples(BUCKET_SAMPLES);
+
+    printf("\nstaging append            samples  transitions  envelope  (ns/sample)\n");
+    for (uint8_t channels = 1; channels <= 8; channels++) {
+        produce(p, channels);
+        uint32_t chunks = p.claimed;
+
+        double packedNs = nsPerSample([&]() {
+            packed.setChannels(channels);
+            for (uint32_t i = 0; i < chunks; i++) {
+                packed.append(p.chunks[i].bits, p.chunks[i].planeWords, 0, p.chunks[i].count);
+            }
+        });
+        TEST_ASSERT_EQUAL_UINT32(SAMPLES, packed.size());
+
+        double transitionNs = nsPerSample([&]() {
+            transitions.setChannels(channels);
+            for (uint32_t i = 0; i < chunks; i++) {
+                transitions.append(p.chunks[i].bits, p.chunks[i].planeWords, 0, p.chunks[i].count);
+            }
+        });
+        TEST_ASSERT_FALSE(transitions.full());
+        TEST_ASSERT_EQUAL_UINT64(SAMPLES, transitions.getSampleCount());
+
+        double envelopeNs = nsPerSample([&]() {
+            envelope.setChannels(channels);
+            for (uint32_t i = 0; i < chunks; i++) {
+                envelope.append(p.chunks[i].bits, p.chunks[i].planeWords, 0, p.chunks[i].count);
+            }
+        });
+        TEST_ASSERT_EQUAL_UINT32(SAMPLES / BUCKET_SAMPLES, envelope.size());
+
+        printf("  %u channel%s              %7.2f      %7.2f   %7.2f\n", channels, channels > 1 ? "s" : " ",
+               packedNs, transitionNs, envelopeNs);
+    }
+}
+
+void test_writer_feed() {
+    // writePackedSamples: every staged sample is unpacked for the writer
+    static BenchProducer p;
+    std::vector<uint32_t> packedWords(SAMPLES * 8 / 32);
+    static PackedSampleStore packed;
+    packed.attach(packedWords.data(), SAMPLES * 8);
+
+    printf("\nsampleWriter feed         ns/sample\n");
+    for (uint8_t channels = 1; channels <= 8; channels++) {
+        produce(p, channels);
+        packed.setChannels(channels);
+        for (uint32_t i = 0; i < p.claimed; i++) {
+            packed.append(p.chunks[i].bits, p.chunks[i].planeWords, 0, p.chunks[i].count);
+        }
+        SampleTimebase tb;
+        tb.baseTime = 0;
+        tb.rate = RATE;
+        tb.firstIndex = 0;
+        tb.rates = nullptr;
+        packed.setTimebase(tb);
+
+        uint32_t sum = 0;
+        uint64_t lastTimestamp = 0;
+        double ns = nsPerSample([&]() {
+            PackedSampleStore::Iterator it = packed.iterate();
+            uint64_t timestamp;
+            uint8_t levels;
+            sum = 0;
+            while (it.next(timestamp, levels)) {
+                sum += levels;
+                lastTimestamp = timestamp;
+            }
+        });
+        uint32_t expected = 0;
+        uint8_t mask = (uint8_t)((1u << channels) - 1);
+        for (uint32_t i = 0; i < SAMPLES; i++) expected += input[i] & mask;
+        TEST_ASSERT_EQUAL_UINT32(expected, sum);
+        TEST_ASSERT_EQUAL_UINT64(SAMPLES - 1, lastTimestamp);
+        printf("  %u channel%s              %7.2f\n", channels, channels > 1 ? "s" : " ", ns);
+    }
+}
+
+int main() {
+    buildInput();
+    UNITY_BEGIN();
+    RUN_TEST(test_level_appenders);
+    RUN_TEST(test_staging_stores);
+    RUN_TEST(test_writer_feed);
+    return UNITY_END();
+}
@@ -0,0 +1,197 @@
+// Host tests of the cycle-counter schedule, driven by a SyntheticClock:
+// slot times, rate error and how a late loop lands back on the grid.
+// Run with: pio test -e native -f test_capture_clock
+#include <unity.h>
+#include "capture_clock.h"
+
+static const uint32_t CPU_HZ = 240000000;
+
+// What the polled capture loop did over a run
+struct ScheduleRun {
+    uint64_t reads;
+    uint64_t cycles;
+    uint64_t lastSlot;
+    uint64_t jumps;         // Times the loop skipped ahead
+    bool onGrid;            // Every read was at most a period late for its slot
+    uint32_t achievedRate;
+};
+
+// The polled loop of the capture task without the pins: wait for the next
+// slot, skip ahead when more than a period late, read, advance. A read costs
+// readCycles on top of the clock's own cost per counter read.
+static ScheduleRun runSchedule(SyntheticClock& clock, uint32_t rate, uint64_t runCycles, uint32_t readCycles) {
+    CycleTimeline timeline;
+    SlotScheduler schedule;
+    ScheduleRun run = {0, 0, 0, 0, true, 0};
+    schedule.begin(clock.getFrequency(), rate);
+    timeline.start(&clock);
+
+    for (;;) {
+        uint64_t now = timeline.now();
+        if (now >= runCycles) break;
+        uint64_t due = schedule.nextDue();
+        if (due > now) {
+            clock.advance(due - now);  // Spin or sleep until the slot
+            continue;
+        }
+        if (now - due > schedule.getPeriodCycles()) {
+            schedule.jumpTo(schedule.slotAt(now));
+            run.jumps++;
+        }
+        uint64_t current = schedule.slotAt(now);
+        if (current < schedule.nextSlot() || current > schedule.nextSlot() + 1) run.onGrid = false;
+        run.lastSlot = schedule.nextSlot();
+        clock.advance(readCycles);
+        schedule.advance();
+        run.reads++;
+    }
+    run.cycles = timeline.now();
+    run.achievedRate = measureRate(run.reads, run.cycles, clock.getFrequency());
+    return run;
+}
+
+static double rateError(uint32_t achieved, uint32_t target) {
+    double error = ((double)achieved - target) / target;
+    return error < 0 ? -error : error;
+}
+
+void setUp() {}
+void tearDown() {}
+
+// ----- Slot grid -----
+
+void test_slot_due_is_exact() {
+    // Slot n is due at floor(n * clockHz / rate) with no rounded period,
+    // including periods below a microsecond and with a fraction
+    static const uint32_t rates[] = {1, 7, 12345, 1000000, 3000000, 7000000, 33333333};
+    for (size_t r = 0; r < sizeof(rates) / sizeof(rates[0]); r++) {
+        SlotScheduler schedule;
+        schedule.begin(CPU_HZ, rates[r]);
+        for (uint64_t n = 0; n < 100000; n++) {
+            TEST_ASSERT_EQUAL_UINT64(n, schedule.nextSlot());
+            TEST_ASSERT_EQUAL_UINT64(n * CPU_HZ / rates[r], schedule.nextDue());
+            schedule.advance();
+        }
+    }
+}
+
+void test_jump_matches_advance_on_long_runs() {
+    // Ten hours in at 40 MHz slot * clockHz no longer fits 64 bits
+    SlotScheduler stepped, jumped;
+    stepped.begin(CPU_HZ, 40000000);
+    uint64_t start = 40000000ULL * 36000;
+    stepped.jumpTo(start);
+    for (uint32_t i = 0; i < 1000; i++) stepped.advance();
+
+    jumped.begin(CPU_HZ, 40000000);
+    jumped.jumpTo(start + 1000);
+    TEST_ASSERT_EQUAL_UINT64(start + 1000, stepped.nextSlot());
+    TEST_ASSERT_EQUAL_UINT64(jumped.nextDue(), stepped.nextDue());
+    TEST_ASSERT_EQUAL_UINT64(6ULL * (start + 1000), stepped.nextDue());
+}
+
+void test_slot_at_counts_passed_slots() {
+    // slotAt works from the exact slot times n * clockHz / rate, so slot n
+    // counts from the first whole cycle at or after its exact time
+    SlotScheduler schedule;
+    schedule.begin(CPU_HZ, 7000000);
+    for (uint64_t n = 1; n < 50000; n += 37) {
+        uint64_t exact = (n * CPU_HZ + 7000000 - 1) / 7000000;
+        TEST_ASSERT_EQUAL_UINT64(n, schedule.slotAt(exact));
+        TEST_ASSERT_EQUAL_UINT64(n - 1, schedule.slotAt(exact - 1));
+        schedule.jumpTo(n);
+        TEST_ASSERT_TRUE(schedule.nextDue() <= exact);
+    }
+}
+
+// ----- Rate error -----
+
+void test_rate_error_when_loop_keeps_up() {
+    // One simulated second per rate: every slot is read, none skipped
+    static const uint32_t rates[] = {1000, 12345, 1000000, 3000000, 7000000};
+    for (size_t r = 0; r < sizeof(rates) / sizeof(rates[0]); r++) {
+        SyntheticClock clock(CPU_HZ, 2);
+        ScheduleRun run = runSchedule(clock, rates[r], CPU_HZ, 20);
+        TEST_ASSERT_EQUAL_UINT64(0, run.jumps);
+        TEST_ASSERT_TRUE(run.onGrid);
+        TEST_ASSERT_EQUAL_UINT64(run.reads - 1, run.lastSlot);
+        TEST_ASSERT_UINT64_WITHIN(1, rates[r], run.reads);
+        TEST_ASSERT_TRUE(rateError(run.achievedRate, rates[r]) < 1e-5);
+    }
+}
+
+void test_fractional_period_does_not_drift() {
+    // 240 MHz / 7 MHz = 34.28 cycles: a rounded period would be 0.8% off
+    SyntheticClock clock(CPU_HZ, 1);
+    ScheduleRun run = runSchedule(clock, 7000000, (uint64_t)CPU_HZ * 3, 10);
+    TEST_ASSERT_UINT64_WITHIN(1, 21000000ULL, run.reads);
+    TEST_ASSERT_EQUAL_UINT32(7000000, run.achievedRate);
+}
+
+void test_overloaded_loop_stays_on_grid() {
+    // A read that takes longer than a period: the loop reaches only part of
+    // the slots, skips to the one due instead of drifting behind, and the
+    // measured rate reports what it really managed
+    SyntheticClock clock(CPU_HZ, 4);
+    ScheduleRun run = runSchedule(clock, 10000000, CPU_HZ / 10, 56);
+    TEST_ASSERT_TRUE(run.jumps > 0);
+    TEST_ASSERT_TRUE(run.onGrid);
+    TEST_ASSERT_UINT64_WITHIN(10, 1000000ULL - 1, run.lastSlot);
+    TEST_ASSERT_TRUE(rateError(run.achievedRate, CPU_HZ / 60) < 1e-3);
+    TEST_ASSERT_TRUE(run.achievedRate < 10000000 / 2);
+}
+
+void test_measure_rate_rounds_to_nearest() {
+    TEST_ASSERT_EQUAL_UINT32(0, measureRate(100, 0, CPU_HZ));
+    TEST_ASSERT_EQUAL_UINT32(1000000, measureRate(1000000, CPU_HZ, CPU_HZ));
+    TEST_ASSERT_EQUAL_UINT32(3, measureRate(5, 400000000, CPU_HZ));  // 3.0
+    TEST_ASSERT_EQUAL_UINT32(7, measureRate(7, CPU_HZ + CPU_HZ / 20, CPU_HZ));  // 6.67
+}
+
+// ----- 64-bit timeline -----
+
+void test_timeline_extends_counter_past_wrap() {
+    // Over a minute at 240 MHz the 32-bit counter wraps three times
+    SyntheticClock clock(CPU_HZ);
+    clock.advance(0xFFFFFF00u);  // Start just before a wrap
+    CycleTimeline timeline;
+    timeline.start(&clock);
+    uint64_t expected = 0;
+    for (uint32_t i = 0; i < 70; i++) {
+        uint64_t step = (uint64_t)CPU_HZ + i * 1000003ULL;
+        clock.advance(step);
+        expected += step;
+        TEST_ASSERT_EQUAL_UINT64(expected, timeline.now());
+    }
+}
+
+void test_timeline_places_isr_readings() {
+    SyntheticClock clock(CPU_HZ);
+    clock.advance(0xFFFFFFF0u);
+    CycleTimeline timeline;
+    timeline.start(&clock);
+    clock.advance(1000);
+    TEST_ASSERT_EQUAL_UINT64(1000, timeline.now());
+
+    // Read in an ISR before and after the latest reading, across the wrap
+    uint32_t base = 0xFFFFFFF0u;
+    TEST_ASSERT_EQUAL_UINT64(400, timeline.at(base + 400));
+    TEST_ASSERT_EQUAL_UINT64(1000, timeline.now());
+    TEST_ASSERT_EQUAL_UINT64(1500, timeline.at(base + 1500));
+    clock.advance(1000);
+    TEST_ASSERT_EQUAL_UINT64(2000, timeline.now());
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_slot_due_is_exact);
+    RUN_TEST(test_jump_matches_advance_on_long_runs);
+    RUN_TEST(test_slot_at_counts_passed_slots);
+    RUN_TEST(test_rate_error_when_loop_keeps_up);
+    RUN_TEST(test_fractional_period_does_not_drift);
+    RUN_TEST(test_overloaded_loop_stays_on_grid);
+    RUN_TEST(test_measure_rate_rounds_to_nearest);
+    RUN_TEST(test_timeline_extends_counter_past_wrap);
+    RUN_TEST(test_timeline_places_isr_readings);
+    return UNITY_END();
+}
@@ -0,0 +1,357 @@
+// Host tests of FlashCaptureReader::verify() on capture files built in
+// memory: clean linear, circular and unfinished files, and the damage a
+// power loss or a bad sector leaves behind.
+// Run with: pio test -e native -f test_flash_format
+#include <unity.h>
+#include <cstring>
+#include <vector>
+#include "flash_format.h"
+#include "segment_log.h"
+#include "simulated_nor_flash.h"
+
+static const uint32_t CHUNK = 256;
+static const uint32_t RECORDS_PER_CHUNK = (CHUNK - sizeof(FlashChunkHeader)) / sizeof(FlashSampleRecord) - 1;
+static const uint32_t SAMPLE_US = 10;
+
+// Version 2 file written the way the capture writes it: header, chunks in
+// sequence (through a ring of slots when circular), then optionally the
+// index of the kept chunks
+struct CaptureFile {
+    std::vector<uint8_t> bytes;
+    FlashStorageHeader header;
+    uint32_t written;
+
+    CaptureFile(uint8_t codec, uint8_t channels, uint32_t ringChunks = 0) : written(0) {
+        memset(&header, 0, sizeof(header));
+        header.magic = FLASH_FORMAT_MAGIC;
+        header.version = FLASH_FORMAT_VERSION;
+        header.header_bytes = sizeof(FlashStorageHeader);
+        header.chunk_bytes = CHUNK;
+        header.sample_rate = 1000000 / SAMPLE_US;
+        header.trigger_index = 0xFFFFFFFF;
+        header.codec = codec;
+        header.channels = channels;
+        header.flags = ringChunks ? FLASH_HEADER_CIRCULAR : 0;
+        header.ring_chunks = ringChunks;
+        bytes.resize(sizeof(header));
+        writeHeader();
+    }
+
+    void writeHeader() {
+        header.crc32 = flashHeaderCrc(header);
+        memcpy(&bytes[0], &header, sizeof(header));
+    }
+
+    uint32_t slotOffset(uint32_t sequence) const {
+        uint32_t slot = header.ring_chunks ? sequence % header.ring_chunks : sequence;
+        return header.header_bytes + slot * CHUNK;
+    }
+
+    void putChunk(FlashChunkHeader chunk, const std::vector<uint8_t>& payload) {
+        chunk.magic = FLASH_CHUNK_MAGIC;
+        chunk.sequence = written;
+        chunk.codec = header.codec;
+        chunk.payload_bytes = (uint16_t)payload.size();
+        chunk.crc32 = flashCrc32(payload.data(), (uint32_t)payload.size());
+        uint32_t at = slotOffset(written);
+        if (bytes.size() < at + CHUNK) bytes.resize(at + CHUNK, 0);
+        memcpy(&bytes[at], &chunk, sizeof(chunk));
+        memcpy(&bytes[at + sizeof(chunk)], payload.data(), payload.size());
+        written++;
+        header.chunk_count = written;
+    }
+
+    // Sample n at n * SAMPLE_US us with levels n & 0xFF; each chunk opens
+    // with a keyframe
+    void addRecords(uint32_t firstSample, uint32_t count) {
+        std::vector<uint8_t> payload;
+        uint64_t time = (uint64_t)firstSample * SAMPLE_US;
+        FlashSampleRecord key = {(uint32_t)(time >> 32), FLASH_RECORD_KEYFRAME, 0};
+        payload.insert(payload.end(), (uint8_t*)&key, (uint8_t*)&key + sizeof(key));
+        for (uint32_t i = 0; i < count; i++) {
+            FlashSampleRecord r = {i == 0 ? (uint32_t)time : SAMPLE_US, 0, (uint8_t)(firstSample + i)};
+            payload.insert(payload.end(), (uint8_t*)&r, (uint8_t*)&r + sizeof(r));
+        }
+        FlashChunkHeader chunk;
+        memset(&chunk, 0, sizeof(chunk));
+        chunk.first_timestamp = time;
+        chunk.first_sample = firstSample;
+        chunk.sample_count = count;
+        putChunk(chunk, payload);
+    }
+
+    // Single-channel edges every `spacing` samples from firstSample
+    void addEdges(uint32_t firstSample, uint32_t edges, uint32_t spacing, uint8_t levels) {
+        std::vector<uint8_t> payload;
+        for (uint32_t i = 0; i < edges; i++) {
+            uint32_t delta = spacing;
+            do {
+                uint8_t byte = delta & 0x7F;
+                delta >>= 7;
+                payload.push_back(delta ? byte | 0x80 : byte);
+            } while (delta);
+        }
+        FlashChunkHeader chunk;
+        memset(&chunk, 0, sizeof(chunk));
+        chunk.first_timestamp = (uint64_t)firstSample * SAMPLE_US;
+        chunk.first_sample = firstSample;
+        chunk.sample_count = edges * spacing;
+        chunk.levels = levels;
+        putChunk(chunk, payload);
+    }
+
+    // Index of the kept chunks, oldest first, and the finalized header
+    void finalize() {
+        uint32_t kept = header.ring_chunks && written > header.ring_chunks ? header.ring_chunks : written;
+        header.index_offset = header.header_bytes + kept * CHUNK;
+        bytes.resize(header.index_offset);
+        uint32_t crc = 0;
+        for (uint32_t s = written - kept; s < written; s++) {
+            FlashChunkHeader chunk;
+            memcpy(&chunk, &bytes[slotOffset(s)], sizeof(chunk));
+            FlashIndexEntry entry = {chunk.first_timestamp, chunk.first_sample, chunk.sample_count};
+            bytes.insert(bytes.end(), (uint8_t*)&entry, (uint8_t*)&entry + sizeof(entry));
+            crc = flashCrc32(&entry, sizeof(entry), crc);
+        }
+        FlashIndexTrailer trailer = {FLASH_INDEX_MAGIC, kept, crc, 0};
+        bytes.insert(bytes.end(), (uint8_t*)&trailer, (uint8_t*)&trailer + sizeof(trailer));
+        header.flags |= FLASH_HEADER_FINALIZED;
+        writeHeader();
+    }
+};
+
+// Records file of `chunks` full chunks
+static CaptureFile recordsFile(uint32_t chunks, uint32_t ringChunks = 0) {
+    CaptureFile file(FLASH_CODEC_RECORDS, 8, ringChunks);
+    for (uint32_t c = 0; c < chunks; c++) file.addRecords(c * RECORDS_PER_CHUNK, RECORDS_PER_CHUNK);
+    return file;
+}
+
+// A file opened from memory and, when that worked, verified
+struct VerifiedFile {
+    FlashMemorySource source;
+    FlashCaptureReader reader;
+    FlashCaptureReader::Status status;
+    uint32_t bad;
+
+    explicit VerifiedFile(const std::vector<uint8_t>& bytes)
+        : source(bytes.data(), (uint32_t)bytes.size()), bad(0xFFFFFFFF) {
+        status = reader.open(&source);
+        if (status != FlashCaptureReader::FLASH_OK) return;
+        std::vector<uint8_t> scratch(reader.getHeader().chunk_bytes);
+        status = reader.verify(scratch.data(), &bad);
+    }
+};
+
+// Every sample of the chunk is where and when the writer put it
+static void checkRecordsChunk(FlashCaptureReader& reader, uint32_t chunk) {
+    std::vector<uint8_t> scratch(CHUNK);
+    uint32_t next = (reader.getFirstSequence() + chunk) * RECORDS_PER_CHUNK;
+    uint32_t seen = 0;
+    FlashCaptureReader::Status status =
+        reader.decodeChunk(chunk, scratch.data(), [&](uint32_t sample, uint64_t time, uint8_t levels) {
+            TEST_ASSERT_EQUAL_UINT32(next, sample);
+            TEST_ASSERT_EQUAL_UINT64((uint64_t)next * SAMPLE_US, time);
+            TEST_ASSERT_EQUAL_UINT8((uint8_t)next, levels);
+            next++;
+            seen++;
+            return true;
+        });
+    TEST_ASSERT_EQUAL(FlashCaptureReader::FLASH_OK, status);
+    TEST_ASSERT_EQUAL_UINT32(RECORDS_PER_CHUNK, seen);
+}
+
+void setUp() {}
+void tearDown() {}
+
+// ----- Clean files -----
+
+void test_finalized_file_verifies() {
+    CaptureFile file = recordsFile(6);
+    file.finalize();
+    VerifiedFile opened(file.bytes);
+    TEST_ASSERT_EQUAL(FlashCaptureReader::FLASH_OK, opened.status);
+    TEST_ASSERT_EQUAL_UINT32(0, opened.bad);
+    TEST_ASSERT_TRUE(opened.reader.isIndexed());
+    TEST_ASSERT_EQUAL_UINT32(6, opened.reader.getChunkCount());
+    for (uint32_t c = 0; c < 6; c++) checkRecordsChunk(opened.reader, c);
+}
+
+void test_unfinished_file_counts_whole_chunks() {
+    // Power lost while the seventh chunk was being written: six are whole
+    CaptureFile file = recordsFile(7);
+    file.bytes.resize(file.bytes.size() - CHUNK / 2);
+    VerifiedFile opened(file.bytes);
+    TEST_ASSERT_EQUAL(FlashCaptureReader::FLASH_OK, opened.status);
+    TEST_ASSERT_EQUAL_UINT32(0, opened.bad);
+    TEST_ASSERT_FALSE(opened.reader.isIndexed());
+    TEST_ASSERT_EQUAL_UINT32(6, opened.reader.getChunkCount());
+}
+
+void test_circular_file_verifies_from_oldest_chunk() {
+    // 13 chunks through 5 slots: chunks 8..12 are kept, 8 sits in slot 3
+    CaptureFile file = recordsFile(13, 5);
+    {
+        VerifiedFile opened(file.bytes);
+        TEST_ASSERT_EQUAL(FlashCaptureReader::FLASH_OK, opened.status);
+        TEST_ASSERT_EQUAL_UINT32(0, opened.bad);
+        TEST_ASSERT_EQUAL_UINT32(5, opened.reader.getChunkCount());
+        TEST_ASSERT_EQUAL_UINT32(8, opened.reader.getFirstSequence());
+        for (uint32_t c = 0; c < 5; c++) checkRecordsChunk(opened.reader, c);
+    }
+
+    file.finalize();
+    VerifiedFile opened(file.bytes);
+    TEST_ASSERT_EQUAL(FlashCaptureReader::FLASH_OK, opened.status);
+    TEST_ASSERT_TRUE(opened.reader.isIndexed());
+    TEST_ASSERT_EQUAL_UINT32(8, opened.reader.getFirstSequence());
+    TEST_ASSERT_EQUAL_INT32(2, opened.reader.findChunkBySample(10 * RECORDS_PER_CHUNK + 3));
+}
+
+void test_edge_file_verifies_and_decodes() {
+    CaptureFile file(FLASH_CODEC_TRANSITIONS, 1);
+    file.addEdges(0, 50, 300, 1);     // Two-byte deltas
+    file.addEdges(15000, 100, 7, 1);  // One-byte deltas
+    file.finalize();
+    VerifiedFile opened(file.bytes);
+    TEST_ASSERT_EQUAL(FlashCaptureReader::FLASH_OK, opened.status);
+    TEST_ASSERT_EQUAL_UINT32(0, opened.bad);
+
+    std::vector<uint8_t> scratch(CHUNK);
+    uint32_t edges = 0;
+    uint32_t lastSample = 0;
+    uint8_t lastLevels = 0;
+    opened.reader.decodeChunk(1, scratch.data(), [&](uint32_t sample, uint64_t time, uint8_t levels) {
+        TEST_ASSERT_EQUAL_UINT64((uint64_t)sample * SAMPLE_US, time);
+        lastSample = sample;
+        lastLevels = levels;
+        edges++;
+        return true;
+    });
+    TEST_ASSERT_EQUAL_UINT32(100, edges);
+    TEST_ASSERT_EQUAL_UINT32(15700, lastSample);
+    TEST_ASSERT_EQUAL_UINT8(1, lastLevels);  // An even number of toggles from high
+}
+
+void test_segment_log_source_verifies() {
+    // A wrapping raw-partition log reads as an unfinished circular file
+    static const uint32_t SLOT = 4096;
+    SimulatedNorFlash nor(8 * 4 * SLOT, SLOT);
+    SegmentLog log;
+    TEST_ASSERT_TRUE(log.begin(&nor, 4 * SLOT, SLOT, 2));
+    CaptureFile meta(FLASH_CODEC_RECORDS, 8);
+    TEST_ASSERT_TRUE(log.start(&meta.header, sizeof(meta.header), true));
+
+    CaptureFile chunks = recordsFile(40);
+    std::vector<uint8_t> slot(SLOT, 0);
+    for (uint32_t s = 0; s < 40; s++) {
+        memcpy(slot.data(), &chunks.bytes[chunks.slotOffset(s)], CHUNK);
+        TEST_ASSERT_TRUE(log.append(slot.data()));
+        log.service();
+    }
+    TEST_ASSERT_TRUE(log.getFirstSlot() > 0);
+
+    SegmentLogSource source(log);
+    FlashCaptureReader reader;
+    TEST_ASSERT_EQUAL(FlashCaptureReader::FLASH_OK, reader.open(&source));
+    TEST_ASSERT_EQUAL_UINT32(log.getSlotCount(), reader.getChunkCount());
+    TEST_ASSERT_EQUAL_UINT32(log.getFirstSlot(), reader.getFirstSequence());
+    std::vector<uint8_t> scratch(SLOT);
+    uint32_t bad = 0xFFFFFFFF;
+    TEST_ASSERT_EQUAL(FlashCaptureReader::FLASH_OK, reader.verify(scratch.data(), &bad));
+    TEST_ASSERT_EQUAL_UINT32(0, bad);
+}
+
+// ----- Damage -----
+
+void test_flipped_payload_bit_fails_that_chunk_only() {
+    CaptureFile file = recordsFile(6);
+    file.finalize();
+    file.bytes[file.slotOffset(2) + sizeof(FlashChunkHeader) + 20] ^= 0x04;
+    VerifiedFile opened(file.bytes);
+    TEST_ASSERT_EQUAL(FlashCaptureReader::FLASH_BAD_CHUNK_CRC, opened.status);
+    TEST_ASSERT_EQUAL_UINT32(1, opened.bad);
+
+    // The other chunks still decode on their own
+    std::vector<uint8_t> scratch(CHUNK);
+    TEST_ASSERT_EQUAL(FlashCaptureReader::FLASH_BAD_CHUNK_CRC, opened.reader.loadChunk(2, scratch.data()));
+    checkRecordsChunk(opened.reader, 1);
+    checkRecordsChunk(opened.reader, 3);
+}
+
+void test_erased_and_torn_chunks_are_counted() {
+    // Chunk 1 never programmed (still erased), the last one cut off mid-payload
+    CaptureFile file = recordsFile(6);
+    memset(&file.bytes[file.slotOffset(1)], 0xFF, CHUNK);
+    memset(&file.bytes[file.slotOffset(5) + 100], 0xFF, CHUNK - 100);
+    VerifiedFile opened(file.bytes);
+    TEST_ASSERT_EQUAL(FlashCaptureReader::FLASH_BAD_CHUNK, opened.status);
+    TEST_ASSERT_EQUAL_UINT32(2, opened.bad);
+}
+
+void test_chunk_out_of_sequence_is_bad() {
+    // A stale chunk from an earlier capture left in a slot
+    CaptureFile file = recordsFile(4);
+    FlashChunkHeader chunk;
+    memcpy(&chunk, &file.bytes[file.slotOffset(3)], sizeof(chunk));
+    chunk.sequence = 7;
+    memcpy(&file.bytes[file.slotOffset(3)], &chunk, sizeof(chunk));
+    VerifiedFile opened(file.bytes);
+    TEST_ASSERT_EQUAL(FlashCaptureReader::FLASH_BAD_CHUNK, opened.status);
+    TEST_ASSERT_EQUAL_UINT32(1, opened.bad);
+}
+
+void test_chunk_with_other_codec_is_bad() {
+    CaptureFile file = recordsFile(3);
+    file.header.codec = FLASH_CODEC_COMPRESSED;
+    file.writeHeader();
+    VerifiedFile opened(file.bytes);
+    TEST_ASSERT_EQUAL(FlashCaptureReader::FLASH_BAD_CHUNK, opened.status);
+    TEST_ASSERT_EQUAL_UINT32(3, opened.bad);
+}
+
+void test_index_must_match_chunks() {
+    CaptureFile file = recordsFile(5);
+    file.finalize();
+    std::vector<uint8_t> wrongEntry = file.bytes;
+    wrongEntry[file.header.index_offset + 3 * sizeof(FlashIndexEntry) + 8] ^= 0x01;  // first_sample
+    VerifiedFile entry(wrongEntry);
+    TEST_ASSERT_EQUAL(FlashCaptureReader::FLASH_BAD_INDEX, entry.status);
+    TEST_ASSERT_EQUAL_UINT32(1, entry.bad);
+
+    // Entries that match the chunks but not the trailer's CRC
+    std::vector<uint8_t> wrongCrc = file.bytes;
+    wrongCrc[wrongCrc.size() - sizeof(FlashIndexTrailer) + 8] ^= 0x01;
+    VerifiedFile trailer(wrongCrc);
+    TEST_ASSERT_EQUAL(FlashCaptureReader::FLASH_BAD_INDEX, trailer.status);
+    TEST_ASSERT_EQUAL_UINT32(0, trailer.bad);
+}
+
+void test_damaged_header_fails_open() {
+    CaptureFile file = recordsFile(2);
+    std::vector<uint8_t> flipped = file.bytes;
+    flipped[12] ^= 0x01;  // sample_rate
+    TEST_ASSERT_EQUAL(FlashCaptureReader::FLASH_BAD_HEADER_CRC, VerifiedFile(flipped).status);
+
+    std::vector<uint8_t> erased(file.bytes.size(), 0xFF);
+    TEST_ASSERT_EQUAL(FlashCaptureReader::FLASH_BAD_MAGIC, VerifiedFile(erased).status);
+
+    std::vector<uint8_t> shortFile(file.bytes.begin(), file.bytes.begin() + 40);
+    TEST_ASSERT_EQUAL(FlashCaptureReader::FLASH_TOO_SHORT, VerifiedFile(shortFile).status);
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_finalized_file_verifies);
+    RUN_TEST(test_unfinished_file_counts_whole_chunks);
+    RUN_TEST(test_circular_file_verifies_from_oldest_chunk);
+    RUN_TEST(test_edge_file_verifies_and_decodes);
+    RUN_TEST(test_segment_log_source_verifies);
+    RUN_TEST(test_flipped_payload_bit_fails_that_chunk_only);
+    RUN_TEST(test_erased_and_torn_chunks_are_counted);
+    RUN_TEST(test_chunk_out_of_sequence_is_bad);
+    RUN_TEST(test_chunk_with_other_codec_is_bad);
+    RUN_TEST(test_index_must_match_chunks);
+    RUN_TEST(test_damaged_header_fails_open);
+    return UNITY_END();
+}
@@ -0,0 +1,269 @@
+// Host replay of RMT receive symbol dumps through rmt_symbols.h: the
+// symbol fields, the receiver settings, and the slots RmtTimeline hands to
+// the capture compared with a direct sampling of the same runs.
+// Run with: pio test -e native -f test_rmt_symbols
+#include <unity.h>
+#include <vector>
+#include "rmt_symbols.h"
+
+// NEC remote frame as the receiver reports it at 1 us ticks (divider 80),
+// with a remote's timing jitter: 9 ms low / 4.5 ms high leader, 32 bits of
+// 562 us low then 562 us (0) or 1687 us (1) high, LSB first, a stop pulse
+// and the end marker carrying the idle level (high). Address 0x04,
+// command 0x08.
+static const uint32_t NEC_FRAME[] = {
+    0x91842323, 0x82420232, 0x821D021C, 0x8684023B, 0x823E0230, 0x8239021C,
+    0x821B0226, 0x8234021E, 0x821D0233, 0x86830228, 0x8699023C, 0x823D021C,
+    0x868C0220, 0x86A60241, 0x8681023E, 0x86A3023D, 0x86810232, 0x821B0227,
+    0x8221023C, 0x8233022B, 0x86A00222, 0x823D0220, 0x823C022C, 0x82240244,
+    0x823E021F, 0x86A6023D, 0x86950225, 0x86A1021F, 0x821D0246, 0x8681023D,
+    0x868B0240, 0x86A90238, 0x8699023B, 0x8000024A,
+};
+static const size_t NEC_SYMBOLS = sizeof(NEC_FRAME) / sizeof(NEC_FRAME[0]);
+static const uint32_t NEC_TICK_HZ = 1000000;
+
+// One level held for a number of ticks
+struct Run {
+    uint8_t level;
+    uint64_t ticks;
+};
+
+// Collects the slots RmtTimeline hands over, one level per slot
+struct SlotRecorder {
+    std::vector<uint8_t>* slots;
+
+    bool operator()(uint8_t level, uint64_t count) {
+        slots->insert(slots->end(), count, level);
+        return true;
+    }
+};
+
+// The runs a frame describes, read field by field, idle run last
+static void appendRuns(std::vector<Run>& runs, const uint32_t* symbols, size_t count, uint32_t idleTicks) {
+    for (size_t i = 0; i < count; i++) {
+        uint32_t s = symbols[i];
+        if ((s & 0x7FFF) == 0) {
+            runs.push_back({(uint8_t)((s >> 15) & 1), idleTicks});
+            return;
+        }
+        runs.push_back({(uint8_t)((s >> 15) & 1), s & 0x7FFF});
+        if (((s >> 16) & 0x7FFF) == 0) {
+            runs.push_back({(uint8_t)(s >> 31), idleTicks});
+            return;
+        }
+        runs.push_back({(uint8_t)(s >> 31), (s >> 16) & 0x7FFF});
+    }
+}
+
+// Slot k is complete once the timeline passes (k + 1) / rate, so it takes
+// the level of the last tick before that
+static std::vector<uint8_t> sampleRuns(const std::vector<Run>& runs, uint32_t tickHz, uint32_t rate) {
+    uint64_t total = 0;
+    for (size_t i = 0; i < runs.size(); i++) total += runs[i].ticks;
+    std::vector<uint8_t> slots;
+    size_t run = 0;
+    uint64_t runEnd = runs.empty() ? 0 : runs[0].ticks;
+    for (uint64_t k = 0;; k++) {
+        uint64_t due = ((k + 1) * tickHz + rate - 1) / rate;  // First tick of slot k + 1
+        if (due > total) break;
+        while (due - 1 >= runEnd) runEnd += runs[++run].ticks;
+        slots.push_back(runs[run].level);
+    }
+    return slots;
+}
+
+// Lengths of the runs in a slot sequence
+static std::vector<uint32_t> runLengths(const std::vector<uint8_t>& slots, uint8_t level) {
+    std::vector<uint32_t> lengths;
+    for (size_t i = 0; i < slots.size();) {
+        size_t j = i;
+        while (j < slots.size() && slots[j] == slots[i]) j++;
+        if (slots[i] == level) lengths.push_back((uint32_t)(j - i));
+        i = j;
+    }
+    return lengths;
+}
+
+void setUp() {}
+void tearDown() {}
+
+// ----- Symbols and receiver settings -----
+
+void test_symbol_fields() {
+    uint32_t s = makeRmtSymbol(1, 12345, 0, 32767);
+    TEST_ASSERT_EQUAL_UINT32(12345, rmtDuration0(s));
+    TEST_ASSERT_EQUAL_UINT8(1, rmtLevel0(s));
+    TEST_ASSERT_EQUAL_UINT32(32767, rmtDuration1(s));
+    TEST_ASSERT_EQUAL_UINT8(0, rmtLevel1(s));
+    TEST_ASSERT_EQUAL_HEX32(0x7FFFB039, s);
+    TEST_ASSERT_EQUAL_HEX32(0x8000024A, makeRmtSymbol(0, 586, 1, 0));
+}
+
+void test_clock_divider_and_filter() {
+    TEST_ASSERT_EQUAL_UINT8(1, rmtClockDivider(0));
+    TEST_ASSERT_EQUAL_UINT8(1, rmtClockDivider(409));    // 32720 ticks at 12.5 ns
+    TEST_ASSERT_EQUAL_UINT8(2, rmtClockDivider(410));
+    TEST_ASSERT_EQUAL_UINT8(80, rmtClockDivider(32767));  // 1 us ticks
+    TEST_ASSERT_EQUAL_UINT8(255, rmtClockDivider(1000000));
+    TEST_ASSERT_EQUAL_UINT8(0, rmtFilterTicks(10));
+    TEST_ASSERT_EQUAL_UINT8(80, rmtFilterTicks(1000));
+    TEST_ASSERT_EQUAL_UINT8(255, rmtFilterTicks(100000));
+}
+
+void test_frame_ticks_stop_at_end_marker() {
+    uint64_t ticks = 0;
+    for (size_t i = 0; i + 1 < NEC_SYMBOLS; i++) ticks += rmtDuration0(NEC_FRAME[i]) + rmtDuration1(NEC_FRAME[i]);
+    ticks += rmtDuration0(NEC_FRAME[NEC_SYMBOLS - 1]);
+    TEST_ASSERT_EQUAL_UINT64(ticks, rmtFrameTicks(NEC_FRAME, NEC_SYMBOLS));
+
+    const uint32_t early[] = {makeRmtSymbol(1, 100, 0, 200), makeRmtSymbol(1, 0, 0, 0), makeRmtSymbol(0, 999, 1, 999)};
+    TEST_ASSERT_EQUAL_UINT64(300, rmtFrameTicks(early, 3));
+}
+
+// ----- Timeline replay -----
+
+void test_nec_dump_replays_to_sampled_levels() {
+    // At 100 kHz every slot must match sampling the runs directly
+    const uint32_t rate = 100000;
+    const uint32_t idle = 10000;
+    std::vector<uint8_t> slots;
+    RmtTimeline timeline;
+    timeline.begin(NEC_TICK_HZ, rate, 1);
+    SlotRecorder recorder = {&slots};
+    TEST_ASSERT_TRUE(timeline.feedFrame(NEC_FRAME, NEC_SYMBOLS, idle, recorder));
+
+    std::vector<Run> runs;
+    appendRuns(runs, NEC_FRAME, NEC_SYMBOLS, idle);
+    std::vector<uint8_t> expected = sampleRuns(runs, NEC_TICK_HZ, rate);
+    TEST_ASSERT_EQUAL_UINT32(expected.size(), slots.size());
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(expected.data(), slots.data(), slots.size());
+    TEST_ASSERT_EQUAL_UINT64(rmtFrameTicks(NEC_FRAME, NEC_SYMBOLS) + idle, timeline.getTicks());
+    TEST_ASSERT_EQUAL_UINT64(slots.size(), timeline.getSlots());
+    TEST_ASSERT_EQUAL_UINT8(1, timeline.getLevel());
+}
+
+void test_nec_dump_decodes_from_slots() {
+    // The sampled frame still carries the message: high runs after the
+    // leader are 0 bits near 56 slots and 1 bits near 169
+    std::vector<uint8_t> slots;
+    RmtTimeline timeline;
+    timeline.begin(NEC_TICK_HZ, 100000, 1);
+    SlotRecorder recorder = {&slots};
+    timeline.feedFrame(NEC_FRAME, NEC_SYMBOLS, 10000, recorder);
+
+    std::vector<uint32_t> lows = runLengths(slots, 0);
+    std::vector<uint32_t> highs = runLengths(slots, 1);
+    TEST_ASSERT_EQUAL_UINT32(34, lows.size());  // Leader, 32 bits, stop
+    TEST_ASSERT_UINT32_WITHIN(2, 900, lows[0]);
+    TEST_ASSERT_UINT32_WITHIN(2, 450, highs[0]);
+
+    uint32_t message = 0;
+    for (uint32_t bit = 0; bit < 32; bit++) {
+        if (highs[1 + bit] > 112) message |= 1u << bit;
+    }
+    TEST_ASSERT_EQUAL_HEX32(0xF708FB04, message);
+}
+
+void test_frames_and_gaps_do_not_drift() {
+    // Ten frames about 110 ms apart at a rate that does not divide the tick
+    // rate: the slot count follows the tick position exactly
+    const uint32_t rate = 30000;
+    std::vector<uint8_t> slots;
+    std::vector<Run> runs;
+    RmtTimeline timeline;
+    timeline.begin(NEC_TICK_HZ, rate, 1);
+    SlotRecorder recorder = {&slots};
+    uint64_t start = 0;
+    for (uint32_t frame = 0; frame < 10; frame++) {
+        if (start > timeline.getTicks()) {
+            runs.push_back({timeline.getLevel(), start - timeline.getTicks()});
+        }
+        TEST_ASSERT_TRUE(timeline.holdUntil(start, recorder));
+        TEST_ASSERT_TRUE(timeline.feedFrame(NEC_FRAME, NEC_SYMBOLS, 5000, recorder));
+        appendRuns(runs, NEC_FRAME, NEC_SYMBOLS, 5000);
+        start += 110000 + frame * 7;
+    }
+    TEST_ASSERT_EQUAL_UINT64(timeline.getTicks() * rate / NEC_TICK_HZ, timeline.getSlots());
+    std::vector<uint8_t> expected = sampleRuns(runs, NEC_TICK_HZ, rate);
+    TEST_ASSERT_EQUAL_UINT32(expected.size(), slots.size());
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(expected.data(), slots.data(), slots.size());
+}
+
+void test_ws2812_bits_at_full_resolution() {
+    // LED data at 12.5 ns ticks: 0 = 400 ns high / 850 ns low, 1 = 800 / 450.
+    // At 20 MHz a high is 8 or 16 slots
+    std::vector<uint32_t> frame;
+    const uint8_t grb[3] = {0xA5, 0x0F, 0x81};
+    for (uint32_t i = 0; i < 24; i++) {
+        bool one = (grb[i / 8] >> (7 - i % 8)) & 1;
+        frame.push_back(one ? makeRmtSymbol(1, 64, 0, 36) : makeRmtSymbol(1, 32, 0, 68));
+    }
+    frame.push_back(makeRmtSymbol(0, 0, 0, 0));
+
+    std::vector<uint8_t> slots;
+    RmtTimeline timeline;
+    timeline.begin(RMT_SOURCE_CLOCK_HZ, 20000000, 0);
+    SlotRecorder recorder = {&slots};
+    TEST_ASSERT_TRUE(timeline.feedFrame(frame.data(), frame.size(), 4000, recorder));
+
+    std::vector<uint32_t> highs = runLengths(slots, 1);
+    TEST_ASSERT_EQUAL_UINT32(24, highs.size());
+    uint8_t decoded[3] = {0, 0, 0};
+    for (uint32_t i = 0; i < 24; i++) {
+        TEST_ASSERT_TRUE(highs[i] == 8 || highs[i] == 16);
+        if (highs[i] == 16) decoded[i / 8] |= 0x80 >> (i % 8);
+    }
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(grb, decoded, 3);
+    TEST_ASSERT_EQUAL_UINT64((24 * 100 + 4000) / 4, timeline.getSlots());
+}
+
+void test_pulse_shorter_than_a_slot_can_vanish() {
+    // A 20 us pulse at 1 kHz falls between two slots, as it would when polled
+    const uint32_t frame[] = {makeRmtSymbol(0, 300, 1, 20), makeRmtSymbol(0, 580, 0, 0)};
+    std::vector<uint8_t> slots;
+    RmtTimeline timeline;
+    timeline.begin(NEC_TICK_HZ, 1000, 0);
+    SlotRecorder recorder = {&slots};
+    TEST_ASSERT_TRUE(timeline.feedFrame(frame, 2, 100, recorder));
+    TEST_ASSERT_EQUAL_UINT32(1, slots.size());
+    TEST_ASSERT_EQUAL_UINT8(0, slots[0]);
+}
+
+void test_sink_can_stop_replay() {
+    RmtTimeline timeline;
+    timeline.begin(NEC_TICK_HZ, 100000, 1);
+    uint32_t calls = 0;
+    bool done = timeline.feedFrame(NEC_FRAME, NEC_SYMBOLS, 10000, [&calls](uint8_t, uint64_t) {
+        return ++calls < 5;
+    });
+    TEST_ASSERT_FALSE(done);
+    TEST_ASSERT_EQUAL_UINT32(5, calls);
+}
+
+void test_multi_hour_idle_is_exact() {
+    // Ten hours at 12.5 ns ticks overflows ticks * rate in 64 bits
+    RmtTimeline timeline;
+    timeline.begin(RMT_SOURCE_CLOCK_HZ, 40000000, 1);
+    uint64_t slots = 0;
+    uint64_t tenHours = (uint64_t)RMT_SOURCE_CLOCK_HZ * 36000;
+    TEST_ASSERT_TRUE(timeline.holdUntil(tenHours, [&slots](uint8_t, uint64_t n) {
+        slots += n;
+        return true;
+    }));
+    TEST_ASSERT_EQUAL_UINT64(40000000ULL * 36000, slots);
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_symbol_fields);
+    RUN_TEST(test_clock_divider_and_filter);
+    RUN_TEST(test_frame_ticks_stop_at_end_marker);
+    RUN_TEST(test_nec_dump_replays_to_sampled_levels);
+    RUN_TEST(test_nec_dump_decodes_from_slots);
+    RUN_TEST(test_frames_and_gaps_do_not_drift);
+    RUN_TEST(test_ws2812_bits_at_full_resolution);
+    RUN_TEST(test_pulse_shorter_than_a_slot_can_vanish);
+    RUN_TEST(test_sink_can_stop_replay);
+    RUN_TEST(test_multi_hour_idle_is_exact);
+    return UNITY_END();
+}
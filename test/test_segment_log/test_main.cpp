@@ -0,0 +1,227 @@
+// Host tests of the raw-partition segment log on a SimulatedNorFlash, which
+// refuses any write that would need an erase first.
+// Run with: pio test -e native -f test_segment_log
+#include <unity.h>
+#include <vector>
+#include "segment_log.h"
+#include "simulated_nor_flash.h"
+
+static const uint32_t ERASE = 4096;
+static const uint32_t SEGMENT = 8192;
+static const uint32_t SEGMENTS = 8;
+static const uint32_t SLOT = 512;
+static const uint32_t SLOTS_PER_SEGMENT = SEGMENT / SLOT - 1;  // Slot 0 is the header
+
+static const char META[] = "capture header";
+
+// Slot n holds n in every word, so it never starts with an erased word
+static std::vector<uint32_t> slotData(uint32_t n) {
+    return std::vector<uint32_t>(SLOT / 4, n);
+}
+
+static void checkSlot(SegmentLog& log, uint32_t slot) {
+    std::vector<uint32_t> data(SLOT / 4);
+    TEST_ASSERT_TRUE(log.readSlot(slot, 0, data.data(), SLOT));
+    std::vector<uint32_t> expected = slotData(slot);
+    TEST_ASSERT_EQUAL_MEMORY(expected.data(), data.data(), SLOT);
+}
+
+static void startLog(SegmentLog& log, SimulatedNorFlash& nor, uint8_t eraseAhead, bool wrap) {
+    TEST_ASSERT_TRUE(log.begin(&nor, SEGMENT, SLOT, eraseAhead));
+    TEST_ASSERT_TRUE(log.start(META, sizeof(META), wrap));
+}
+
+void setUp() {}
+void tearDown() {}
+
+// ----- Simulated NOR rules -----
+
+void test_write_needs_erase_to_set_bits() {
+    SimulatedNorFlash nor(4 * ERASE, ERASE);
+    uint8_t value = 0x5A;
+    TEST_ASSERT_TRUE(nor.write(100, &value, 1));
+
+    // Clearing more bits is a valid program, setting one back is not
+    uint8_t fewer = 0x48;
+    TEST_ASSERT_TRUE(nor.write(100, &fewer, 1));
+    uint8_t more = 0x5A;
+    TEST_ASSERT_FALSE(nor.write(100, &more, 1));
+    TEST_ASSERT_EQUAL_UINT32(1, nor.getViolations());
+
+    uint8_t read = 0;
+    TEST_ASSERT_TRUE(nor.read(100, &read, 1));
+    TEST_ASSERT_EQUAL_HEX8(0x48, read);
+
+    TEST_ASSERT_TRUE(nor.erase(0, ERASE));
+    TEST_ASSERT_TRUE(nor.read(100, &read, 1));
+    TEST_ASSERT_EQUAL_HEX8(0xFF, read);
+    TEST_ASSERT_TRUE(nor.write(100, &more, 1));
+    TEST_ASSERT_EQUAL_UINT32(1, nor.getViolations());
+}
+
+void test_refused_write_leaves_flash_unchanged() {
+    SimulatedNorFlash nor(ERASE, ERASE);
+    uint8_t zero = 0;
+    TEST_ASSERT_TRUE(nor.write(3, &zero, 1));
+    uint8_t data[8] = {0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x77, 0x88};
+    TEST_ASSERT_FALSE(nor.write(0, data, sizeof(data)));  // Byte 3 would need an erase
+
+    uint8_t read[8];
+    TEST_ASSERT_TRUE(nor.read(0, read, sizeof(read)));
+    static const uint8_t expected[8] = {0xFF, 0xFF, 0xFF, 0x00, 0xFF, 0xFF, 0xFF, 0xFF};
+    TEST_ASSERT_EQUAL_MEMORY(expected, read, sizeof(read));
+    TEST_ASSERT_EQUAL_UINT64(1, nor.getProgrammedBytes());
+}
+
+void test_erase_must_be_block_aligned() {
+    SimulatedNorFlash nor(4 * ERASE, ERASE);
+    TEST_ASSERT_FALSE(nor.erase(100, ERASE));
+    TEST_ASSERT_FALSE(nor.erase(0, ERASE + 1));
+    TEST_ASSERT_FALSE(nor.erase(3 * ERASE, 2 * ERASE));
+    TEST_ASSERT_TRUE(nor.erase(ERASE, 2 * ERASE));
+    TEST_ASSERT_EQUAL_UINT32(0, nor.getEraseCount(0));
+    TEST_ASSERT_EQUAL_UINT32(1, nor.getEraseCount(1));
+    TEST_ASSERT_EQUAL_UINT32(1, nor.getEraseCount(2));
+    TEST_ASSERT_EQUAL_UINT32(0, nor.getEraseCount(3));
+}
+
+// ----- Segment log -----
+
+void test_begin_rejects_bad_geometry() {
+    SimulatedNorFlash nor(SEGMENTS * SEGMENT, ERASE);
+    SegmentLog log;
+    TEST_ASSERT_FALSE(log.begin(&nor, SEGMENT + ERASE / 2, SLOT, 1));  // Not erase aligned
+    TEST_ASSERT_FALSE(log.begin(&nor, SEGMENT, 64, 1));                 // Header does not fit
+    TEST_ASSERT_FALSE(log.begin(&nor, SEGMENTS * SEGMENT, SLOT, 1));    // One segment
+    TEST_ASSERT_TRUE(log.begin(&nor, SEGMENT, SLOT, 1));
+    TEST_ASSERT_EQUAL_UINT32(SEGMENTS * SLOTS_PER_SEGMENT, log.getCapacitySlots());
+}
+
+void test_fills_then_refuses_without_wrap() {
+    SimulatedNorFlash nor(SEGMENTS * SEGMENT, ERASE);
+    SegmentLog log;
+    startLog(log, nor, 2, false);
+
+    uint32_t n = 0;
+    while (log.append(slotData(n).data())) {
+        n++;
+        log.service();
+    }
+    TEST_ASSERT_TRUE(log.isFull());
+    TEST_ASSERT_EQUAL_UINT32(SEGMENTS * SLOTS_PER_SEGMENT, n);
+    TEST_ASSERT_EQUAL_UINT32(n, log.getSlotCount());
+    for (uint32_t slot = 0; slot < n; slot++) checkSlot(log, slot);
+    TEST_ASSERT_EQUAL_UINT32(0, nor.getViolations());
+    TEST_ASSERT_EQUAL_UINT32(0, log.getWriteErrors());
+}
+
+void test_unserviced_log_erases_inline() {
+    // Without service() every new segment is erased on the append path
+    SimulatedNorFlash nor(SEGMENTS * SEGMENT, ERASE);
+    SegmentLog log;
+    startLog(log, nor, 2, false);
+    for (uint32_t n = 0; n < 3 * SLOTS_PER_SEGMENT; n++) {
+        TEST_ASSERT_TRUE(log.append(slotData(n).data()));
+    }
+    TEST_ASSERT_EQUAL_UINT32(3, log.getInlineErases());
+    TEST_ASSERT_EQUAL_UINT32(0, log.getAheadErases());
+    TEST_ASSERT_EQUAL_UINT32(0, nor.getViolations());
+}
+
+void test_serviced_log_erases_ahead() {
+    SimulatedNorFlash nor(SEGMENTS * SEGMENT, ERASE);
+    SegmentLog log;
+    startLog(log, nor, 2, false);
+    while (log.service()) {}
+    TEST_ASSERT_EQUAL_UINT32(2, log.getErasedAhead());
+    for (uint32_t n = 0; n < 2 * SLOTS_PER_SEGMENT + 1; n++) {
+        TEST_ASSERT_TRUE(log.append(slotData(n).data()));
+    }
+    TEST_ASSERT_EQUAL_UINT32(1, log.getInlineErases());  // Only the first segment at start()
+    TEST_ASSERT_EQUAL_UINT32(0, nor.getViolations());
+}
+
+void test_wrapping_log_keeps_newest_and_spreads_wear() {
+    SimulatedNorFlash nor(SEGMENTS * SEGMENT, ERASE);
+    SegmentLog log;
+    startLog(log, nor, 2, true);
+
+    uint32_t total = 25 * SEGMENTS * SLOTS_PER_SEGMENT + 7;
+    for (uint32_t n = 0; n < total; n++) {
+        TEST_ASSERT_TRUE(log.append(slotData(n).data()));
+        log.service();
+    }
+    TEST_ASSERT_EQUAL_UINT32(0, nor.getViolations());
+    TEST_ASSERT_EQUAL_UINT32(0, log.getWriteErrors());
+
+    // The erased-ahead segments are not data; the rest holds the newest slots
+    uint32_t first = log.getFirstSlot();
+    uint32_t count = log.getSlotCount();
+    TEST_ASSERT_EQUAL_UINT32(total, first + count);
+    TEST_ASSERT_TRUE(count >= (SEGMENTS - 3) * SLOTS_PER_SEGMENT);
+    for (uint32_t slot = first; slot < total; slot++) checkSlot(log, slot);
+    uint32_t data[SLOT / 4];
+    TEST_ASSERT_FALSE(log.readSlot(first - 1, 0, data, SLOT));
+
+    uint32_t least = nor.getEraseCount(0), most = least;
+    for (uint32_t block = 1; block < SEGMENTS * SEGMENT / ERASE; block++) {
+        uint32_t n = nor.getEraseCount(block);
+        if (n < least) least = n;
+        if (n > most) most = n;
+    }
+    TEST_ASSERT_TRUE(least >= 24);
+    TEST_ASSERT_TRUE(most - least <= 1);
+}
+
+void test_mount_finds_last_log_and_next_starts_after_it() {
+    SimulatedNorFlash nor(SEGMENTS * SEGMENT, ERASE);
+    {
+        SegmentLog log;
+        startLog(log, nor, 1, true);
+        for (uint32_t n = 0; n < 3 * SLOTS_PER_SEGMENT + 4; n++) {
+            log.append(slotData(n).data());
+            log.service();
+        }
+        // Power lost: no stop()
+    }
+
+    // After a reset nothing in RAM is left; the headers on flash are enough
+    SegmentLog log;
+    TEST_ASSERT_TRUE(log.begin(&nor, SEGMENT, SLOT, 1));
+    TEST_ASSERT_EQUAL_UINT32(3 * SLOTS_PER_SEGMENT + 4, log.mount());
+    TEST_ASSERT_EQUAL_UINT32(1, log.getEpoch());
+    char meta[sizeof(META)];
+    TEST_ASSERT_EQUAL_UINT32(sizeof(META), log.getMeta(meta, sizeof(meta)));
+    TEST_ASSERT_EQUAL_STRING(META, meta);
+    for (uint32_t slot = 0; slot < log.getSlotCount(); slot++) checkSlot(log, slot);
+
+    // The next log gets a new epoch and never programs over the old one
+    // without an erase, although the erase-ahead state was lost
+    TEST_ASSERT_TRUE(log.start(META, sizeof(META), true));
+    TEST_ASSERT_EQUAL_UINT32(2, log.getEpoch());
+    for (uint32_t n = 0; n < 2 * SEGMENTS * SLOTS_PER_SEGMENT; n++) {
+        TEST_ASSERT_TRUE(log.append(slotData(n).data()));
+        log.service();
+    }
+    TEST_ASSERT_EQUAL_UINT32(0, nor.getViolations());
+
+    SegmentLog again;
+    TEST_ASSERT_TRUE(again.begin(&nor, SEGMENT, SLOT, 1));
+    TEST_ASSERT_EQUAL_UINT32(log.getSlotCount(), again.mount());
+    TEST_ASSERT_EQUAL_UINT32(2, again.getEpoch());
+    TEST_ASSERT_EQUAL_UINT32(log.getFirstSlot(), again.getFirstSlot());
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_write_needs_erase_to_set_bits);
+    RUN_TEST(test_refused_write_leaves_flash_unchanged);
+    RUN_TEST(test_erase_must_be_block_aligned);
+    RUN_TEST(test_begin_rejects_bad_geometry);
+    RUN_TEST(test_fills_then_refuses_without_wrap);
+    RUN_TEST(test_unserviced_log_erases_inline);
+    RUN_TEST(test_serviced_log_erases_ahead);
+    RUN_TEST(test_wrapping_log_keeps_newest_and_spreads_wear);
+    RUN_TEST(test_mount_finds_last_log_and_next_starts_after_it);
+    return UNITY_END();
+}
@@ -0,0 +1,224 @@
+// Host tests of the LCD_CAM clock divider and the DMA block hand-off,
+// driven through SimulatedSampler.
+// Run with: pio test -e native -f test_simulated_sampler
+#include <unity.h>
+#include "simulated_sampler.h"
+
+static const uint32_t BLOCK = 64;  // Small blocks keep the cases readable
+static const uint32_t SLOTS = 4;
+
+// Sample n carries the low byte of its own index
+static uint8_t indexSignal(uint64_t sampleIndex, void* context) {
+    (void)context;
+    return (uint8_t)sampleIndex;
+}
+
+static uint32_t readyCalls;
+
+static bool countReady(void* context) {
+    (void)context;
+    readyCalls++;
+    return false;
+}
+
+// Nanoseconds that produce exactly `samples` more samples at `rate`
+static uint64_t nsFor(uint64_t samples, uint32_t rate) {
+    return (samples * 1000000000ULL + rate - 1) / rate;
+}
+
+static void startSampler(SimulatedSampler& sampler, uint32_t rate) {
+    TEST_ASSERT_TRUE(sampler.begin(rate, nullptr, 8));
+    sampler.setSignal(indexSignal);
+    TEST_ASSERT_TRUE(sampler.start());
+}
+
+// Every byte of the block must be the sample it claims to hold
+static void checkBlock(const SampleBlock& block, uint64_t firstIndex) {
+    TEST_ASSERT_EQUAL_UINT64(firstIndex, block.firstIndex);
+    TEST_ASSERT_EQUAL_UINT32(BLOCK, block.count);
+    for (uint32_t i = 0; i < block.count; i++) {
+        TEST_ASSERT_EQUAL_UINT8((uint8_t)(firstIndex + i), block.data[i]);
+    }
+}
+
+void setUp() {
+    readyCalls = 0;
+}
+void tearDown() {}
+
+// ----- Clock divider -----
+
+void test_divider_exact_rates() {
+    // Rates with a divider of the form n + b/a, a <= 63, come out exact
+    static const uint32_t exact[] = {625000, 1000000, 1234567, 3000000, 7000000, 20000000, 40000000, 80000000};
+    for (size_t i = 0; i < sizeof(exact) / sizeof(exact[0]); i++) {
+        ClockDivider div;
+        TEST_ASSERT_EQUAL_UINT32(exact[i], computeClockDivider(CAM_SOURCE_CLOCK_HZ, exact[i], div));
+    }
+    ClockDivider div;
+    computeClockDivider(CAM_SOURCE_CLOCK_HZ, 3000000, div);
+    TEST_ASSERT_EQUAL_UINT16(53, div.integer);
+    TEST_ASSERT_EQUAL_UINT8(1, div.numerator);
+    TEST_ASSERT_EQUAL_UINT8(3, div.denominator);
+}
+
+void test_divider_rate_accuracy() {
+    // The fraction lands within half a 1/63 step of the ideal divider, so the
+    // rate error is at most 1 / (126 * integer); the returned rate is what
+    // the programmed fields really produce
+    for (uint32_t target = getMinHardwareSampleRate(); target <= CAM_SOURCE_CLOCK_HZ / CAM_MIN_DIVIDER;
+         target += 7919) {
+        ClockDivider div;
+        uint32_t actual = computeClockDivider(CAM_SOURCE_CLOCK_HZ, target, div);
+        TEST_ASSERT_TRUE(div.integer >= CAM_MIN_DIVIDER && div.integer <= CAM_MAX_DIVIDER);
+        TEST_ASSERT_TRUE(div.denominator <= CAM_MAX_FRACTION);
+        TEST_ASSERT_TRUE(div.numerator < (div.denominator ? div.denominator : 1));
+
+        uint32_t a = div.denominator ? div.denominator : 1;
+        uint64_t produced = (uint64_t)CAM_SOURCE_CLOCK_HZ * a / ((uint64_t)div.integer * a + div.numerator);
+        TEST_ASSERT_EQUAL_UINT32((uint32_t)produced, actual);
+
+        double error = ((double)actual - target) / target;
+        if (error < 0) error = -error;
+        TEST_ASSERT_TRUE_MESSAGE(error * 126 * div.integer <= 1.0, "divider off by more than half a step");
+    }
+}
+
+void test_begin_rejects_slow_rates() {
+    SimulatedSampler sampler(BLOCK, SLOTS);
+    TEST_ASSERT_FALSE(sampler.begin(getMinHardwareSampleRate() - 1, nullptr, 8));
+    TEST_ASSERT_FALSE(sampler.start());
+    TEST_ASSERT_TRUE(sampler.begin(getMinHardwareSampleRate(), nullptr, 8));
+}
+
+// ----- Produced rate -----
+
+void test_samples_follow_actual_rate() {
+    // Uneven steps add up to exactly one second of samples at the real rate
+    SimulatedSampler sampler(BLOCK, SLOTS);
+    startSampler(sampler, 12345678);
+    uint32_t rate = sampler.getActualSampleRate();
+    TEST_ASSERT_EQUAL_UINT32(12345679, rate);
+
+    uint64_t elapsed = 0;
+    for (uint64_t step = 1; elapsed + step <= 1000000000ULL; step = step * 3 + 7) {
+        sampler.advance(step);
+        elapsed += step;
+        TEST_ASSERT_EQUAL_UINT64(elapsed * rate / 1000000000ULL, sampler.getSamplesProduced());
+    }
+    sampler.advance(1000000000ULL - elapsed);
+    TEST_ASSERT_EQUAL_UINT64(rate, sampler.getSamplesProduced());
+}
+
+void test_block_ready_once_per_block() {
+    SimulatedSampler sampler(BLOCK, SLOTS);
+    sampler.setBlockReadyCallback(countReady, nullptr);
+    startSampler(sampler, 1000000);
+
+    sampler.advance(nsFor(BLOCK - 1, 1000000));
+    TEST_ASSERT_EQUAL_UINT32(0, readyCalls);
+    SampleBlock block;
+    TEST_ASSERT_FALSE(sampler.acquireBlock(block));
+
+    sampler.advance(nsFor(1, 1000000));
+    TEST_ASSERT_EQUAL_UINT32(1, readyCalls);
+    sampler.advance(nsFor(10 * BLOCK, 1000000));
+    TEST_ASSERT_EQUAL_UINT32(11, readyCalls);
+}
+
+void test_stopped_sampler_produces_nothing() {
+    SimulatedSampler sampler(BLOCK, SLOTS);
+    startSampler(sampler, 1000000);
+    sampler.advance(nsFor(BLOCK, 1000000));
+    sampler.stop();
+    sampler.advance(nsFor(10 * BLOCK, 1000000));
+    TEST_ASSERT_EQUAL_UINT64(BLOCK, sampler.getSamplesProduced());
+}
+
+// ----- Block hand-off -----
+
+void test_blocks_arrive_in_order() {
+    // A consumer that keeps up sees every block once, in order, intact
+    SimulatedSampler sampler(BLOCK, SLOTS);
+    startSampler(sampler, 2000000);
+    uint64_t expected = 0;
+    for (uint32_t round = 0; round < 50; round++) {
+        sampler.advance(nsFor((round % 3) * BLOCK, 2000000));
+        SampleBlock block;
+        while (sampler.acquireBlock(block)) {
+            checkBlock(block, expected);
+            TEST_ASSERT_TRUE(sampler.releaseBlock());
+            expected += BLOCK;
+        }
+    }
+    TEST_ASSERT_EQUAL_UINT64(sampler.getSamplesProduced() / BLOCK * BLOCK, expected);
+    TEST_ASSERT_EQUAL_UINT32(0, sampler.getOverrunCount());
+}
+
+void test_late_consumer_skips_to_intact_blocks() {
+    // The DMA never waits: after SLOTS + 3 blocks only the newest SLOTS - 1
+    // finished ones are still whole, the rest count as overruns
+    SimulatedSampler sampler(BLOCK, SLOTS);
+    startSampler(sampler, 1000000);
+    sampler.advance(nsFor((SLOTS + 3) * BLOCK, 1000000));
+
+    SampleBlock block;
+    uint64_t expected = 4 * BLOCK;
+    while (sampler.acquireBlock(block)) {
+        checkBlock(block, expected);
+        TEST_ASSERT_TRUE(sampler.releaseBlock());
+        expected += BLOCK;
+    }
+    TEST_ASSERT_EQUAL_UINT64((SLOTS + 3) * BLOCK, expected);
+    TEST_ASSERT_EQUAL_UINT32(4, sampler.getOverrunCount());
+}
+
+void test_release_reports_lapped_block() {
+    // A block held while the producer comes round to its slot again
+    SimulatedSampler sampler(BLOCK, SLOTS);
+    startSampler(sampler, 1000000);
+    sampler.advance(nsFor(BLOCK, 1000000));
+
+    SampleBlock block;
+    TEST_ASSERT_TRUE(sampler.acquireBlock(block));
+    checkBlock(block, 0);
+    sampler.advance(nsFor((SLOTS - 2) * BLOCK, 1000000));
+    TEST_ASSERT_TRUE(sampler.releaseBlock());  // Slot 0 not reused yet
+
+    TEST_ASSERT_TRUE(sampler.acquireBlock(block));
+    checkBlock(block, BLOCK);
+    sampler.advance(nsFor(SLOTS * BLOCK, 1000000));
+    TEST_ASSERT_FALSE(sampler.releaseBlock());
+    TEST_ASSERT_TRUE(sampler.getOverrunCount() >= 1);
+}
+
+void test_restart_resets_indices() {
+    SimulatedSampler sampler(BLOCK, SLOTS);
+    startSampler(sampler, 1000000);
+    sampler.advance(nsFor(3 * BLOCK, 1000000));
+    sampler.stop();
+
+    TEST_ASSERT_TRUE(sampler.start());
+    SampleBlock block;
+    TEST_ASSERT_FALSE(sampler.acquireBlock(block));
+    sampler.advance(nsFor(BLOCK, 1000000));
+    TEST_ASSERT_TRUE(sampler.acquireBlock(block));
+    checkBlock(block, 0);
+    TEST_ASSERT_TRUE(sampler.releaseBlock());
+    TEST_ASSERT_EQUAL_UINT32(0, sampler.getOverrunCount());
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_divider_exact_rates);
+    RUN_TEST(test_divider_rate_accuracy);
+    RUN_TEST(test_begin_rejects_slow_rates);
+    RUN_TEST(test_samples_follow_actual_rate);
+    RUN_TEST(test_block_ready_once_per_block);
+    RUN_TEST(test_stopped_sampler_produces_nothing);
+    RUN_TEST(test_blocks_arrive_in_order);
+    RUN_TEST(test_late_consumer_skips_to_intact_blocks);
+    RUN_TEST(test_release_reports_lapped_block);
+    RUN_TEST(test_restart_resets_indices);
+    return UNITY_END();
+}
@@ -0,0 +1,149 @@
+// Host tests of the SPSC ring, including a two-thread stress run that
+// checks ordering and that every slot is complete when the consumer sees it.
+// Run with: pio test -e native -f test_spsc_ring
+#include <unity.h>
+#include <thread>
+#include "spsc_ring.h"
+
+static const uint32_t STRESS_ITEMS = 2000000;
+
+// A chunk-sized element filled in place, like CaptureChunk
+struct Block {
+    uint32_t sequence;
+    uint32_t words[63];
+};
+
+void setUp() {}
+void tearDown() {}
+
+void test_fifo_order_and_capacity() {
+    SpscRing<uint32_t, 8> ring;
+    TEST_ASSERT_TRUE(ring.empty());
+    TEST_ASSERT_NULL(ring.front());
+    for (uint32_t i = 0; i < 8; i++) TEST_ASSERT_TRUE(ring.push(i));
+    TEST_ASSERT_TRUE(ring.full());
+    TEST_ASSERT_NULL(ring.claim());  // All Capacity slots are usable, no more
+    TEST_ASSERT_FALSE(ring.push(99));
+
+    uint32_t value;
+    for (uint32_t i = 0; i < 8; i++) {
+        TEST_ASSERT_TRUE(ring.pop(value));
+        TEST_ASSERT_EQUAL_UINT32(i, value);
+    }
+    TEST_ASSERT_FALSE(ring.pop(value));
+    TEST_ASSERT_EQUAL_UINT32(0, ring.size());
+}
+
+void test_claim_is_invisible_until_publish() {
+    SpscRing<Block, 4> ring;
+    Block* slot = ring.claim();
+    TEST_ASSERT_NOT_NULL(slot);
+    slot->sequence = 7;
+    TEST_ASSERT_NULL(ring.front());
+    TEST_ASSERT_EQUAL_UINT32(0, ring.size());
+
+    ring.publish();
+    TEST_ASSERT_EQUAL_UINT32(1, ring.size());
+    TEST_ASSERT_TRUE(ring.front() == slot);
+    TEST_ASSERT_EQUAL_UINT32(7, ring.front()->sequence);
+    ring.pop();
+    TEST_ASSERT_TRUE(ring.empty());
+}
+
+void test_slots_reused_in_turn() {
+    // Counters run freely past the capacity; slots come round in order
+    SpscRing<uint32_t, 4> ring;
+    for (uint32_t i = 0; i < 1000; i++) {
+        uint32_t* slot = ring.claim();
+        TEST_ASSERT_NOT_NULL(slot);
+        *slot = i;
+        ring.publish();
+        if (i % 3 == 2) {
+            // Let the ring run up to two behind
+            uint32_t value;
+            TEST_ASSERT_TRUE(ring.pop(value));
+            TEST_ASSERT_EQUAL_UINT32(i - 2, value);
+            TEST_ASSERT_TRUE(ring.pop(value));
+            TEST_ASSERT_EQUAL_UINT32(i - 1, value);
+            TEST_ASSERT_TRUE(ring.pop(value));
+            TEST_ASSERT_EQUAL_UINT32(i, value);
+        }
+    }
+}
+
+void test_two_thread_values_arrive_in_order() {
+    // A small ring keeps both sides running into full and empty
+    static SpscRing<uint32_t, 8> ring;
+    std::thread producer([]() {
+        for (uint32_t i = 0; i < STRESS_ITEMS; i++) {
+            while (!ring.push(i)) std::this_thread::yield();
+        }
+    });
+
+    uint32_t expected = 0;
+    uint32_t outOfOrder = 0;
+    uint32_t badSize = 0;
+    while (expected < STRESS_ITEMS) {
+        uint32_t size = ring.size();
+        if (size > ring.capacity()) badSize++;
+        uint32_t value;
+        if (!ring.pop(value)) {
+            std::this_thread::yield();
+            continue;
+        }
+        if (value != expected) outOfOrder++;
+        expected++;
+    }
+    producer.join();
+    TEST_ASSERT_EQUAL_UINT32(0, outOfOrder);
+    TEST_ASSERT_EQUAL_UINT32(0, badSize);
+    TEST_ASSERT_TRUE(ring.empty());
+}
+
+void test_two_thread_blocks_complete_when_published() {
+    // Filled in place through claim()/publish() and read through front()/pop():
+    // the consumer must never see a block the producer is still writing
+    static SpscRing<Block, 4> ring;
+    const uint32_t blocks = STRESS_ITEMS / 4;
+    std::thread producer([blocks]() {
+        for (uint32_t i = 0; i < blocks; i++) {
+            Block* slot;
+            while ((slot = ring.claim()) == nullptr) std::this_thread::yield();
+            slot->sequence = i;
+            for (uint32_t w = 0; w < 63; w++) slot->words[w] = i * 63 + w;
+            ring.publish();
+        }
+    });
+
+    uint32_t torn = 0;
+    uint32_t outOfOrder = 0;
+    for (uint32_t i = 0; i < blocks;) {
+        const Block* slot = ring.front();
+        if (!slot) {
+            std::this_thread::yield();
+            continue;
+        }
+        if (slot->sequence != i) outOfOrder++;
+        for (uint32_t w = 0; w < 63; w++) {
+            if (slot->words[w] != slot->sequence * 63 + w) {
+                torn++;
+                break;
+            }
+        }
+        ring.pop();
+        i++;
+    }
+    producer.join();
+    TEST_ASSERT_EQUAL_UINT32(0, torn);
+    TEST_ASSERT_EQUAL_UINT32(0, outOfOrder);
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_fifo_order_and_capacity);
+    RUN_TEST(test_claim_is_invisible_until_publish);
+    RUN_TEST(test_slots_reused_in_turn);
+    RUN_TEST(test_two_thread_values_arrive_in_order);
+    RUN_TEST(test_two_thread_blocks_complete_when_published);
+    return UNITY_END();
+}
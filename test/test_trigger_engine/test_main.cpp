@@ -0,0 +1,305 @@
+// Host tests of the trigger program parser and the word-at-a-time engine.
+// Run with: pio test -e native -f test_trigger_engine
+#include <unity.h>
+#include <vector>
+#include "trigger_engine.h"
+
+static const uint32_t RATE = 1000000;  // One sample per microsecond
+
+// Per-sample levels (bit c = channel c), built from held stretches
+struct Waveform {
+    std::vector<uint8_t> samples;
+
+    Waveform& hold(uint8_t levels, uint32_t count) {
+        samples.insert(samples.end(), count, levels);
+        return *this;
+    }
+};
+
+// Pack the waveform into bit planes and feed it a word at a time, as the
+// capture task does. Returns the sample that completed the program, or -1.
+static int64_t runTrigger(const char* text, const Waveform& wave, uint8_t channels = 1,
+                          uint8_t initial = 0, uint32_t rate = RATE) {
+    TriggerProgram program;
+    TEST_ASSERT_NULL_MESSAGE(program.parse(text, 0, channels), text);
+    TriggerEngine engine;
+    engine.load(program);
+    engine.arm(rate, initial);
+
+    const std::vector<uint8_t>& s = wave.samples;
+    for (size_t first = 0; first < s.size(); first += 32) {
+        uint32_t valid = s.size() - first < 32 ? (uint32_t)(s.size() - first) : 32;
+        uint32_t words[8] = {0};
+        for (uint32_t i = 0; i < valid; i++) {
+            for (uint8_t c = 0; c < channels; c++) {
+                words[c] |= (uint32_t)((s[first + i] >> c) & 1) << i;
+            }
+        }
+        int32_t hit = engine.feed(words, 1, channels, valid);
+        if (hit >= 0) {
+            TEST_ASSERT_TRUE(engine.hasFired());
+            return (int64_t)first + hit;
+        }
+    }
+    return -1;
+}
+
+void setUp() {}
+void tearDown() {}
+
+// ----- Parser -----
+
+void test_parse_stages_and_modifiers() {
+    TriggerProgram p;
+    TEST_ASSERT_NULL(p.parse("rise@1, low>=50us, fall*3, holdoff=1ms, nth=2", 0, 2));
+    TEST_ASSERT_EQUAL_UINT8(3, p.stageCount);
+    TEST_ASSERT_EQUAL(TRIGGER_OP_RISE, p.stages[0].op);
+    TEST_ASSERT_EQUAL_UINT8(1, p.stages[0].channel);
+    TEST_ASSERT_EQUAL(TRIGGER_OP_LOW, p.stages[1].op);
+    TEST_ASSERT_EQUAL_UINT8(0, p.stages[1].channel);
+    TEST_ASSERT_FALSE(p.stages[1].hold.samples);
+    TEST_ASSERT_EQUAL_UINT64(50000, p.stages[1].hold.amount);
+    TEST_ASSERT_EQUAL(TRIGGER_OP_FALL, p.stages[2].op);
+    TEST_ASSERT_EQUAL_UINT32(3, p.stages[2].count);
+    TEST_ASSERT_EQUAL_UINT64(1000000, p.holdoff.amount);
+    TEST_ASSERT_EQUAL_UINT32(2, p.occurrences);
+}
+
+void test_parse_pulse_and_idle() {
+    TriggerProgram p;
+    TEST_ASSERT_NULL(p.parse("hpulse<10us; lpulse>200; pulse<5ns idle>=2s", 0, 1));
+    TEST_ASSERT_EQUAL_UINT8(4, p.stageCount);
+    TEST_ASSERT_EQUAL(TRIGGER_OP_PULSE_SHORTER, p.stages[0].op);
+    TEST_ASSERT_EQUAL_UINT8(1, p.stages[0].value);
+    TEST_ASSERT_EQUAL(TRIGGER_OP_PULSE_LONGER, p.stages[1].op);
+    TEST_ASSERT_EQUAL_UINT8(0, p.stages[1].value);
+    TEST_ASSERT_TRUE(p.stages[1].hold.samples);
+    TEST_ASSERT_EQUAL_UINT64(200, p.stages[1].hold.amount);
+    TEST_ASSERT_EQUAL_UINT8(TRIGGER_PULSE_EITHER, p.stages[2].value);
+    TEST_ASSERT_EQUAL_UINT64(5, p.stages[2].hold.amount);
+    TEST_ASSERT_EQUAL(TRIGGER_OP_IDLE, p.stages[3].op);
+    TEST_ASSERT_EQUAL_UINT64(2000000000ULL, p.stages[3].hold.amount);
+}
+
+void test_parse_pattern() {
+    TriggerProgram p;
+    TEST_ASSERT_NULL(p.parse("pattern:0x5=0x7", 0, 3));
+    TEST_ASSERT_EQUAL(TRIGGER_OP_PATTERN, p.stages[0].op);
+    TEST_ASSERT_EQUAL_UINT8(0x5, p.stages[0].mask);
+    TEST_ASSERT_EQUAL_UINT8(0x5, p.stages[0].value);  // Bits outside the mask are dropped
+    TEST_ASSERT_NOT_NULL(p.parse("pattern:0x8=0x8", 0, 3));
+}
+
+void test_parse_errors() {
+    TriggerProgram p;
+    TEST_ASSERT_EQUAL_STRING("no trigger stages", p.parse("", 0, 1));
+    TEST_ASSERT_EQUAL_STRING("no trigger stages", p.parse(" , ;", 0, 1));
+    TEST_ASSERT_EQUAL_STRING("unknown trigger condition", p.parse("bogus", 0, 1));
+    TEST_ASSERT_EQUAL_STRING("bad edge count", p.parse("rise*0", 0, 1));
+    TEST_ASSERT_EQUAL_STRING("counts apply to edges only", p.parse("high*2", 0, 1));
+    TEST_ASSERT_EQUAL_STRING("hold times apply to levels only", p.parse("rise>=5", 0, 1));
+    TEST_ASSERT_EQUAL_STRING("bad trigger channel", p.parse("rise@2", 0, 2));
+    TEST_ASSERT_EQUAL_STRING("pulse needs <T or >T", p.parse("hpulse=5", 0, 1));
+    TEST_ASSERT_EQUAL_STRING("idle needs >=T", p.parse("idle>5", 0, 1));
+    TEST_ASSERT_EQUAL_STRING("bad nth count", p.parse("rise, nth=0", 0, 1));
+    TEST_ASSERT_EQUAL_STRING("bad holdoff time", p.parse("rise, holdoff=ms", 0, 1));
+    TEST_ASSERT_EQUAL_STRING("too many stages", p.parse("rise,rise,rise,rise,rise,rise,rise,rise,rise", 0, 1));
+}
+
+void test_parse_word_boundaries() {
+    // Terms need a separator after them; prefixes of other terms are not matched
+    TriggerProgram p;
+    TEST_ASSERT_EQUAL_STRING("unexpected character", p.parse("risefall", 0, 1));
+    TEST_ASSERT_EQUAL_STRING("unexpected character", p.parse("high>=5usx", 0, 1));
+    TEST_ASSERT_EQUAL_STRING("unexpected character", p.parse("lowest", 0, 1));
+    TEST_ASSERT_EQUAL_STRING("unknown trigger condition", p.parse("ris", 0, 1));
+    TEST_ASSERT_NULL(p.parse("rise,fall;edge high", 0, 1));
+    TEST_ASSERT_EQUAL_UINT8(4, p.stageCount);
+    TEST_ASSERT_NULL(p.parse("  rise  ,  ", 0, 1));
+    TEST_ASSERT_EQUAL_UINT8(1, p.stageCount);
+}
+
+void test_span_conversion() {
+    TriggerSpan us = {1500, false};  // 1.5 us
+    TEST_ASSERT_EQUAL_UINT32(2, us.toSamples(1000000));     // Rounded up, never shorter
+    TEST_ASSERT_EQUAL_UINT32(15, us.toSamples(10000000));
+    TriggerSpan seconds = {3000000000ULL, false};
+    TEST_ASSERT_EQUAL_UINT32(3 * 40000000U, seconds.toSamples(40000000));
+    TriggerSpan samples = {7, true};
+    TEST_ASSERT_EQUAL_UINT32(7, samples.toSamples(123456));
+    TriggerSpan huge = {100000000000ULL, false};
+    TEST_ASSERT_EQUAL_UINT32(0xFFFFFFFF, huge.toSamples(80000000));  // Saturates
+}
+
+// ----- Engine -----
+
+void test_rise() {
+    Waveform w;
+    w.hold(0, 40).hold(1, 10).hold(0, 10);
+    TEST_ASSERT_EQUAL_INT32(40, runTrigger("rise", w));
+    // Already high when armed: no edge until it falls and rises again
+    Waveform h;
+    h.hold(1, 20).hold(0, 5).hold(1, 5);
+    TEST_ASSERT_EQUAL_INT32(25, runTrigger("rise", h, 1, 1));
+}
+
+void test_fall_with_count() {
+    Waveform w;
+    for (int i = 0; i < 6; i++) w.hold(1, 10).hold(0, 10);
+    // Falls at 10, 30, 50, ...
+    TEST_ASSERT_EQUAL_INT32(10, runTrigger("fall", w));
+    TEST_ASSERT_EQUAL_INT32(50, runTrigger("fall*3", w));
+    TEST_ASSERT_EQUAL_INT32(110, runTrigger("fall*6", w));
+    TEST_ASSERT_EQUAL_INT32(-1, runTrigger("fall*7", w));
+    TEST_ASSERT_EQUAL_INT32(40, runTrigger("edge*4", w, 1, 1));  // Starts high: edges at 10, 20, 30, 40
+}
+
+void test_level_width() {
+    Waveform w;
+    w.hold(0, 10).hold(1, 30).hold(0, 10).hold(1, 60);
+    // 50 us at 1 MHz: the 30-sample stretch is too short, the second one
+    // completes on its 50th sample
+    TEST_ASSERT_EQUAL_INT32(50 + 49, runTrigger("high>=50us", w));
+    TEST_ASSERT_EQUAL_INT32(10 + 29, runTrigger("high>=30", w));
+    TEST_ASSERT_EQUAL_INT32(9, runTrigger("low>=10", w));
+    TEST_ASSERT_EQUAL_INT32(-1, runTrigger("low>=11", w));
+}
+
+void test_sequence() {
+    Waveform w;
+    w.hold(0, 5).hold(1, 5)      // rise at 5
+     .hold(0, 8)                 // too short for low>=10
+     .hold(1, 4)                 // 18..21
+     .hold(0, 12)                // 22..33: low held 10 at 31
+     .hold(1, 3).hold(0, 3)      // fall at 37
+     .hold(1, 3).hold(0, 3);     // fall at 43
+    TEST_ASSERT_EQUAL_INT32(43, runTrigger("rise, low>=10, fall*2", w));
+    TEST_ASSERT_EQUAL_INT32(37, runTrigger("rise, low>=10, fall", w));
+    TEST_ASSERT_EQUAL_INT32(-1, runTrigger("rise, low>=10, fall*3", w));
+}
+
+void test_pulse_width() {
+    Waveform w;
+    w.hold(0, 10).hold(1, 20)    // 20 us high pulse, ends at 30
+     .hold(0, 40)                // 40 us low pulse, ends at 70
+     .hold(1, 5)                 // 5 us high pulse, ends at 75
+     .hold(0, 20);
+    TEST_ASSERT_EQUAL_INT32(75, runTrigger("hpulse<10us", w));
+    TEST_ASSERT_EQUAL_INT32(30, runTrigger("hpulse>10us", w));
+    TEST_ASSERT_EQUAL_INT32(70, runTrigger("lpulse>30us", w));
+    TEST_ASSERT_EQUAL_INT32(-1, runTrigger("lpulse<30us", w));
+    TEST_ASSERT_EQUAL_INT32(75, runTrigger("pulse<6", w));
+    // The stretch before the first edge is not a pulse: its start is unknown
+    TEST_ASSERT_EQUAL_INT32(-1, runTrigger("lpulse<15us", w));
+}
+
+void test_idle() {
+    Waveform w;
+    w.hold(0, 10).hold(1, 30).hold(0, 150);
+    // Measured from the last edge (at 40), or from arming
+    TEST_ASSERT_EQUAL_INT32(40 + 100, runTrigger("idle>=100us", w));
+    TEST_ASSERT_EQUAL_INT32(8, runTrigger("idle>=8", w));
+    TEST_ASSERT_EQUAL_INT32(-1, runTrigger("idle>=200", w));
+}
+
+void test_nth() {
+    Waveform w;
+    for (int i = 0; i < 5; i++) w.hold(0, 7).hold(1, 7);
+    // Rises at 7, 21, 35, ...
+    TEST_ASSERT_EQUAL_INT32(35, runTrigger("rise, nth=3", w));
+    TEST_ASSERT_EQUAL_INT32(-1, runTrigger("rise, nth=6", w));
+    // A whole sequence is one occurrence
+    TEST_ASSERT_EQUAL_INT32(49, runTrigger("rise, rise, nth=2", w));
+}
+
+void test_holdoff() {
+    Waveform w;
+    w.hold(0, 20).hold(1, 10)    // rise at 20, inside the holdoff
+     .hold(0, 50).hold(1, 10)    // rise at 80
+     .hold(0, 10);
+    TEST_ASSERT_EQUAL_INT32(80, runTrigger("rise, holdoff=50us", w));
+    TEST_ASSERT_EQUAL_INT32(20, runTrigger("rise, holdoff=20", w));
+
+    // Holdoff also follows each completed sequence
+    Waveform r;
+    for (int i = 0; i < 8; i++) r.hold(0, 10).hold(1, 10);
+    // Rises at 10, 30, 50, 70: the one at 10 falls in the holdoff after
+    // arming, 30 completes the first sequence, 50 falls in the holdoff
+    // after it (31..55), so the second occurrence is the rise at 70
+    TEST_ASSERT_EQUAL_INT32(70, runTrigger("rise, holdoff=25, nth=2", r));
+    TEST_ASSERT_EQUAL_INT32(30, runTrigger("rise, holdoff=5, nth=2", r));
+}
+
+void test_microsecond_widths_follow_rate() {
+    // The same program at 10 MHz: 2 us is 20 samples
+    Waveform w;
+    w.hold(0, 5).hold(1, 19).hold(0, 5).hold(1, 25);
+    TEST_ASSERT_EQUAL_INT32(29 + 19, runTrigger("high>=2us", w, 1, 0, 10000000));
+    TEST_ASSERT_EQUAL_INT32(5 + 1, runTrigger("high>=2us", w, 1, 0, 1000000));
+    // hpulse<2us at 10 MHz: the 19-sample pulse (ends at 24) qualifies
+    TEST_ASSERT_EQUAL_INT32(24, runTrigger("hpulse<2us", w, 1, 0, 10000000));
+}
+
+void test_word_boundaries() {
+    // Edge on bit 0: the previous word's last level is carried over
+    Waveform a;
+    a.hold(0, 32).hold(1, 32);
+    TEST_ASSERT_EQUAL_INT32(32, runTrigger("rise", a));
+    // Edge on bit 31
+    Waveform b;
+    b.hold(1, 31).hold(0, 33);
+    TEST_ASSERT_EQUAL_INT32(31, runTrigger("fall", b, 1, 1));
+    // Edge count split across words
+    Waveform c;
+    for (int i = 0; i < 20; i++) c.hold(0, 3).hold(1, 3);
+    // Rises at 3, 9, 15, ...; the 10th (at 57) is in the second word
+    TEST_ASSERT_EQUAL_INT32(57, runTrigger("rise*10", c));
+    // Level run that starts in one word and completes two words later
+    Waveform d;
+    d.hold(0, 20).hold(1, 80);
+    TEST_ASSERT_EQUAL_INT32(20 + 69, runTrigger("high>=70", d));
+    // A run broken exactly at a word boundary starts over
+    Waveform e;
+    e.hold(1, 32).hold(0, 1).hold(1, 40);
+    TEST_ASSERT_EQUAL_INT32(33 + 39, runTrigger("high>=40", e, 1, 1));
+    // Pulse and idle spans that cross several words
+    Waveform f;
+    f.hold(0, 10).hold(1, 90).hold(0, 100);
+    TEST_ASSERT_EQUAL_INT32(100, runTrigger("hpulse>64", f));
+    TEST_ASSERT_EQUAL_INT32(10 + 64, runTrigger("idle>=64", f));
+    TEST_ASSERT_EQUAL_INT32(100 + 95, runTrigger("idle>=95", f));
+    // A partial last word only evaluates its valid samples
+    Waveform g;
+    g.hold(0, 40);
+    TEST_ASSERT_EQUAL_INT32(-1, runTrigger("high", g));
+}
+
+void test_pattern_on_several_channels() {
+    Waveform w;
+    w.hold(0x0, 10).hold(0x1, 10).hold(0x3, 10).hold(0x2, 10);
+    TEST_ASSERT_EQUAL_INT32(30, runTrigger("pattern:0x3=0x2", w, 2));
+    TEST_ASSERT_EQUAL_INT32(20 + 4, runTrigger("pattern:0x3=0x3>=5", w, 2));
+    TEST_ASSERT_EQUAL_INT32(20, runTrigger("rise@1", w, 2));
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_parse_stages_and_modifiers);
+    RUN_TEST(test_parse_pulse_and_idle);
+    RUN_TEST(test_parse_pattern);
+    RUN_TEST(test_parse_errors);
+    RUN_TEST(test_parse_word_boundaries);
+    RUN_TEST(test_span_conversion);
+    RUN_TEST(test_rise);
+    RUN_TEST(test_fall_with_count);
+    RUN_TEST(test_level_width);
+    RUN_TEST(test_sequence);
+    RUN_TEST(test_pulse_width);
+    RUN_TEST(test_idle);
+    RUN_TEST(test_nth);
+    RUN_TEST(test_holdoff);
+    RUN_TEST(test_microsecond_widths_follow_rate);
+    RUN_TEST(test_word_boundaries);
+    RUN_TEST(test_pattern_on_several_channels);
+    return UNITY_END();
+}